@@ -1,12 +1,7 @@
 # -----------------------------------------------------------------------------
 # Target include directories, linking and properties
 # -----------------------------------------------------------------------------
-function(SetBuildSettings PROJNAME)
-
-	target_link_libraries(${PROJNAME} PRIVATE OpenMP::OpenMP_CXX)
-
-	target_compile_features(${PROJNAME} PRIVATE cxx_std_20)
-	target_compile_definitions(${PROJNAME} PRIVATE BIOVAULT_BFLOAT16_CONVERTING_CONSTRUCTORS)
+function(LinkHDF5 PROJNAME)
 
     if(MV_H5_USE_VCPKG)
         target_link_libraries (${PROJNAME} PRIVATE hdf5::hdf5_cpp-static hdf5::hdf5_hl_cpp-static)
@@ -28,6 +23,45 @@ function(SetBuildSettings PROJNAME)
 
     endif()
 
+endfunction()
+
+# The core library has no Qt or ManiVault dependencies
+function(SetCoreBuildSettings PROJNAME)
+
+	target_link_libraries(${PROJNAME} PRIVATE OpenMP::OpenMP_CXX)
+
+	# dladdr and shm_open of the sharded reads
+	target_link_libraries(${PROJNAME} PRIVATE ${CMAKE_DL_LIBS})
+	if(UNIX AND NOT APPLE)
+		target_link_libraries(${PROJNAME} PRIVATE rt)
+	endif()
+
+	target_compile_features(${PROJNAME} PUBLIC cxx_std_20)
+	set_target_properties(${PROJNAME} PROPERTIES POSITION_INDEPENDENT_CODE ON AUTOMOC OFF)
+
+	if(MV_H5_ENABLE_TRACING)
+		target_compile_definitions(${PROJNAME} PUBLIC MV_H5_ENABLE_TRACING)
+	endif()
+
+	LinkHDF5(${PROJNAME})
+
+	target_include_directories(${PROJNAME} PUBLIC "${COMMON_HDF5_DIR}")
+
+endfunction()
+
+function(SetBuildSettings PROJNAME)
+
+	target_link_libraries(${PROJNAME} PRIVATE OpenMP::OpenMP_CXX)
+
+	target_compile_features(${PROJNAME} PRIVATE cxx_std_20)
+	target_compile_definitions(${PROJNAME} PRIVATE BIOVAULT_BFLOAT16_CONVERTING_CONSTRUCTORS)
+
+	if(MV_H5_ENABLE_TRACING)
+		target_compile_definitions(${PROJNAME} PRIVATE MV_H5_ENABLE_TRACING)
+	endif()
+
+	LinkHDF5(${PROJNAME})
+
 	target_link_libraries(${PROJNAME} PRIVATE Qt6::Widgets)
 	target_link_libraries(${PROJNAME} PRIVATE Qt6::WebEngineWidgets)
 
@@ -37,6 +71,7 @@ function(SetBuildSettings PROJNAME)
 	target_link_libraries(${PROJNAME} PRIVATE ManiVault::ClusterData)
 
 	target_include_directories(${PROJNAME} PRIVATE "${COMMON_HDF5_DIR}")
+	target_link_libraries(${PROJNAME} PRIVATE ${COREPROJECT})
 
 	if(CMAKE_CXX_COMPILER_ID STREQUAL "MSVC")
     	target_compile_options(${PROJNAME} PRIVATE /bigobj)
@@ -53,6 +88,14 @@ function(SetPluginSettings PROJNAME)
 		RUNTIME DESTINATION Plugins COMPONENT ${PROJNAME} # Windows .dll
 		LIBRARY DESTINATION Plugins COMPONENT ${PROJNAME} # Linux/Mac .so
 	)
+
+	# sharded reads start the worker from the plugin directory
+	if(TARGET H5ShardWorker)
+		add_dependencies(${PROJNAME} H5ShardWorker)
+		install(TARGETS H5ShardWorker
+			RUNTIME DESTINATION Plugins COMPONENT ${PROJNAME}
+		)
+	endif()
 	
 	add_custom_command(TARGET ${PROJNAME} POST_BUILD
 		COMMAND "${CMAKE_COMMAND}"
@@ -0,0 +1,74 @@
+# -----------------------------------------------------------------------------
+# End-to-end decode benchmark, run by the HDF5LoaderEndToEnd target:
+#   cmake -DGENERATOR=<H5SyntheticGenerator> -DCONVERT=<H5BatchConvert> -DOUTPUT_DIR=<dir> [-DROWS=N] [-DCOLUMNS=N] -P EndToEndBenchmark.cmake
+# Writes a synthetic file per configuration and decodes it with H5BatchConvert --read-only, which runs
+# H5Utils::decode_matrix: the readers, index checks and sparse scatter of the loader plugins. Every configuration is
+# decoded in its own process, so its peak memory is its own. The time, throughput and peak memory of every
+# configuration, named after its file, end up in OUTPUT_DIR/end_to_end.csv.
+# -----------------------------------------------------------------------------
+foreach(VARIABLE GENERATOR CONVERT OUTPUT_DIR)
+	if(NOT DEFINED ${VARIABLE})
+		message(FATAL_ERROR "EndToEndBenchmark.cmake needs -D${VARIABLE}=...")
+	endif()
+endforeach()
+if(NOT DEFINED ROWS)
+	set(ROWS 100000)
+endif()
+if(NOT DEFINED COLUMNS)
+	set(COLUMNS 5000)
+endif()
+
+# name|format|options
+set(CONFIGURATIONS
+	"10x_uniform|10x|--density 0.05"
+	"10x_skewed|10x|--density 0.05 --distribution skewed"
+	"10x_bf16|10x|--density 0.05 --bf16"
+	"10x_chunked_gzip|10x|--density 0.05 --chunk 65536 --compression 4 --shuffle"
+	"tome|tome|--density 0.05"
+	"h5ad_csr|h5ad|--density 0.05 --layout csr"
+	"h5ad_csr_skewed|h5ad|--density 0.05 --distribution skewed --layout csr"
+	"h5ad_csr_uint16|h5ad|--density 0.05 --layout csr --dtype uint16 --index-type int64"
+	"h5ad_csr_chunked_gzip|h5ad|--density 0.05 --layout csr --chunk 65536 --compression 4 --shuffle"
+	"h5ad_csc|h5ad|--density 0.05 --layout csc"
+	"h5ad_dense|h5ad|--density 0.05 --layout dense"
+	"h5ad_dense_chunked|h5ad|--density 0.05 --layout dense --chunk 65536"
+)
+
+file(MAKE_DIRECTORY ${OUTPUT_DIR})
+set(REPORT ${OUTPUT_DIR}/end_to_end.csv)
+file(REMOVE ${REPORT})
+foreach(CONFIGURATION IN LISTS CONFIGURATIONS)
+	string(REPLACE "|" ";" FIELDS "${CONFIGURATION}")
+	list(GET FIELDS 0 NAME)
+	list(GET FIELDS 1 FORMAT)
+	list(GET FIELDS 2 OPTIONS)
+	separate_arguments(OPTIONS)
+	set(FILE ${OUTPUT_DIR}/${NAME}.h5)
+	if(NOT EXISTS ${FILE})
+		message(STATUS "Generating ${NAME}")
+		execute_process(COMMAND ${GENERATOR} ${FORMAT} ${FILE} --rows ${ROWS} --columns ${COLUMNS} ${OPTIONS} OUTPUT_QUIET RESULT_VARIABLE RESULT)
+		if(NOT RESULT EQUAL 0)
+			message(FATAL_ERROR "H5SyntheticGenerator failed for ${NAME}")
+		endif()
+	endif()
+
+	set(MANIFEST ${OUTPUT_DIR}/${NAME}.txt)
+	file(WRITE ${MANIFEST} "${FILE}\n")
+	execute_process(COMMAND ${CONVERT} ${MANIFEST} --read-only --report ${OUTPUT_DIR}/${NAME}.csv RESULT_VARIABLE RESULT)
+	if(NOT RESULT EQUAL 0)
+		message(FATAL_ERROR "H5BatchConvert could not decode ${NAME}")
+	endif()
+
+	# one report, with the header of the first configuration
+	file(STRINGS ${OUTPUT_DIR}/${NAME}.csv LINES)
+	if(NOT EXISTS ${REPORT})
+		list(GET LINES 0 HEADER)
+		file(WRITE ${REPORT} "${HEADER}\n")
+	endif()
+	list(REMOVE_AT LINES 0)
+	foreach(LINE IN LISTS LINES)
+		file(APPEND ${REPORT} "${LINE}\n")
+	endforeach()
+	file(REMOVE ${MANIFEST} ${OUTPUT_DIR}/${NAME}.csv)
+endforeach()
+message(STATUS "Report: ${REPORT}")
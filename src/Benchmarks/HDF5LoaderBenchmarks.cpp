@@ -0,0 +1,580 @@
+/*
+* Microbenchmarks of the loader kernels in SparseKernels.h and ValueKernels.h on in-memory data, over element types
+* and densities, so a change to a kernel can be timed without ManiVault, a file or the disk. The kernels are called
+* the way DataContainerInterface calls them, on InMemoryPoints, a stand-in for mv::Dataset<Points> that only has the
+* visitFromBeginToEnd the loaders use.
+*
+* The options follow Google Benchmark, so its tools/compare.py can compare two runs:
+*	--benchmark_filter=<regex>		run the benchmarks whose name matches
+*	--benchmark_min_time=<seconds>	time every benchmark for at least this long (0.5)
+*	--benchmark_format=<console|json>	output on stdout
+*	--benchmark_out=<file>			also write the results as JSON to file
+*	--benchmark_list_tests			print the names and exit
+*/
+
+#include "SparseKernels.h"
+#include "ValueKernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+namespace local
+{
+	// Stand-in for biovault::bfloat16_t: the upper 16 bits of a float, rounded to nearest even.
+	struct bfloat16
+	{
+		std::uint16_t bits = 0;
+
+		bfloat16() = default;
+
+		bfloat16(double value)
+		{
+			const float f = static_cast<float>(value);
+			std::uint32_t raw;
+			std::memcpy(&raw, &f, sizeof(raw));
+			raw += 0x7FFF + ((raw >> 16) & 1);
+			bits = static_cast<std::uint16_t>(raw >> 16);
+		}
+
+		operator float() const
+		{
+			const std::uint32_t raw = static_cast<std::uint32_t>(bits) << 16;
+			float f;
+			std::memcpy(&f, &raw, sizeof(f));
+			return f;
+		}
+
+		bfloat16& operator+=(double value)
+		{
+			*this = bfloat16(static_cast<float>(*this) + value);
+			return *this;
+		}
+	};
+
+	// The part of mv::Dataset<Points> the kernels see: a row major rows x columns matrix of element type T.
+	template<typename T>
+	class InMemoryPoints
+	{
+	public:
+		InMemoryPoints(std::int64_t rows, std::int64_t columns)
+			: _rows(rows)
+			, _columns(columns)
+			, _data(rows * columns)
+		{
+		}
+
+		std::int64_t getNumPoints() const { return _rows; }
+		std::int64_t getNumDimensions() const { return _columns; }
+
+		template<typename Function>
+		void visitFromBeginToEnd(Function function)
+		{
+			function(_data.begin(), _data.end());
+		}
+
+		std::uint64_t bytes() const { return _data.size() * sizeof(T); }
+
+	private:
+		std::int64_t _rows;
+		std::int64_t _columns;
+		std::vector<T> _data;
+	};
+
+	template<typename T> const char* element_type_name();
+	template<> const char* element_type_name<float>() { return "float32"; }
+	template<> const char* element_type_name<bfloat16>() { return "bfloat16"; }
+	template<> const char* element_type_name<std::uint16_t>() { return "uint16"; }
+	template<> const char* element_type_name<std::int8_t>() { return "int8"; }
+
+	// Compressed sparse rows (or columns) with the index types IndexVectorHolder selects for a matrix of this size.
+	struct SparseMatrix
+	{
+		std::int64_t rows = 0;
+		std::int64_t columns = 0;
+		std::vector<std::uint64_t> offsets;
+		std::vector<std::uint32_t> indices;
+		std::vector<float> values;
+
+		std::uint64_t bytes() const
+		{
+			return offsets.size() * sizeof(offsets[0]) + indices.size() * (sizeof(indices[0]) + sizeof(values[0]));
+		}
+	};
+
+	// Count data with a log-normal number of nonzeros per row, as in single cell data.
+	SparseMatrix generate_sparse(std::int64_t rows, std::int64_t columns, double density, std::uint32_t seed)
+	{
+		SparseMatrix matrix;
+		matrix.rows = rows;
+		matrix.columns = columns;
+		matrix.offsets.assign(rows + 1, 0);
+		std::mt19937_64 generator(seed);
+		std::lognormal_distribution<double> scale(-0.5, 1.0);
+		std::geometric_distribution<int> count(0.4);
+		std::vector<char> taken(columns, 0);
+		for (std::int64_t row = 0; row < rows; ++row)
+		{
+			const std::int64_t nnz = std::min<std::int64_t>(columns, static_cast<std::int64_t>(density * columns * scale(generator)));
+			const std::size_t first = matrix.indices.size();
+			// Floyd's sampling of nnz distinct columns
+			for (std::int64_t j = columns - nnz; j < columns; ++j)
+			{
+				std::uniform_int_distribution<std::int64_t> column(0, j);
+				std::int64_t c = column(generator);
+				if (taken[c])
+					c = j;
+				taken[c] = 1;
+				matrix.indices.push_back(static_cast<std::uint32_t>(c));
+			}
+			std::sort(matrix.indices.begin() + first, matrix.indices.end());
+			for (std::size_t i = first; i < matrix.indices.size(); ++i)
+			{
+				taken[matrix.indices[i]] = 0;
+				matrix.values.push_back(static_cast<float>(1 + count(generator)));
+			}
+			matrix.offsets[row + 1] = matrix.indices.size();
+		}
+		return matrix;
+	}
+
+	SparseMatrix transpose(const SparseMatrix& matrix)
+	{
+		SparseMatrix result;
+		result.rows = matrix.columns;
+		result.columns = matrix.rows;
+		result.offsets.assign(result.rows + 1, 0);
+		for (const auto column : matrix.indices)
+			++result.offsets[column + 1];
+		for (std::int64_t row = 0; row < result.rows; ++row)
+			result.offsets[row + 1] += result.offsets[row];
+		result.indices.resize(matrix.indices.size());
+		result.values.resize(matrix.values.size());
+		std::vector<std::uint64_t> position(result.offsets.cbegin(), result.offsets.cend() - 1);
+		for (std::int64_t row = 0; row < matrix.rows; ++row)
+		{
+			for (std::uint64_t i = matrix.offsets[row]; i < matrix.offsets[row + 1]; ++i)
+			{
+				const std::uint64_t p = position[matrix.indices[i]]++;
+				result.indices[p] = static_cast<std::uint32_t>(row);
+				result.values[p] = matrix.values[i];
+			}
+		}
+		return result;
+	}
+
+	void no_progress(std::uint64_t)
+	{
+	}
+
+	// -----------------------------------------------------------------------------
+	// Runner
+	// -----------------------------------------------------------------------------
+
+	struct Benchmark
+	{
+		std::string name;
+		std::uint64_t bytes = 0;				// bytes processed per iteration, for bytes_per_second
+		std::function<void()> setup;			// before every iteration, not timed
+		std::function<void()> run;				// timed
+	};
+
+	struct Result
+	{
+		std::string name;
+		std::uint64_t iterations = 0;
+		double realTime = 0;	// ns per iteration
+		double cpuTime = 0;		// ns per iteration, all threads of the process
+		double bytesPerSecond = 0;
+	};
+
+	Result run_benchmark(const Benchmark& benchmark, double minTime)
+	{
+		Result result;
+		result.name = benchmark.name;
+
+		// one untimed iteration to fault in the memory
+		if (benchmark.setup)
+			benchmark.setup();
+		benchmark.run();
+
+		double realSeconds = 0;
+		double cpuSeconds = 0;
+		while ((realSeconds < minTime) || (result.iterations == 0))
+		{
+			if (benchmark.setup)
+				benchmark.setup();
+			const std::clock_t cpuStart = std::clock();
+			const auto start = std::chrono::steady_clock::now();
+			benchmark.run();
+			realSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			cpuSeconds += static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+			++result.iterations;
+		}
+		result.realTime = 1e9 * realSeconds / result.iterations;
+		result.cpuTime = 1e9 * cpuSeconds / result.iterations;
+		result.bytesPerSecond = (realSeconds > 0) ? (static_cast<double>(benchmark.bytes) * result.iterations / realSeconds) : 0;
+		return result;
+	}
+
+	std::string json_string(const std::string& value)
+	{
+		std::string result = "\"";
+		for (const char c : value)
+		{
+			if ((c == '"') || (c == '\\'))
+				result += '\\';
+			result += c;
+		}
+		return result + "\"";
+	}
+
+	// The JSON of Google Benchmark, with the fields tools/compare.py reads.
+	void write_json(std::ostream& out, const std::vector<Result>& results, const char* executable)
+	{
+		const std::time_t now = std::time(nullptr);
+		char date[64];
+		std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+#if defined(NDEBUG)
+		const char* buildType = "release";
+#else
+		const char* buildType = "debug";
+#endif
+#if defined(_OPENMP)
+		const int threads = omp_get_max_threads();
+#else
+		const int threads = 1;
+#endif
+
+		out << "{\n"
+			<< "  \"context\": {\n"
+			<< "    \"date\": " << json_string(date) << ",\n"
+			<< "    \"executable\": " << json_string(executable) << ",\n"
+			<< "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+			<< "    \"omp_threads\": " << threads << ",\n"
+			<< "    \"library_build_type\": " << json_string(buildType) << "\n"
+			<< "  },\n"
+			<< "  \"benchmarks\": [";
+		out << std::setprecision(10);
+		for (std::size_t r = 0; r < results.size(); ++r)
+		{
+			const Result& result = results[r];
+			out << (r ? "," : "") << "\n    {\n"
+				<< "      \"name\": " << json_string(result.name) << ",\n"
+				<< "      \"family_index\": " << r << ",\n"
+				<< "      \"per_family_instance_index\": 0,\n"
+				<< "      \"run_name\": " << json_string(result.name) << ",\n"
+				<< "      \"run_type\": \"iteration\",\n"
+				<< "      \"repetitions\": 1,\n"
+				<< "      \"repetition_index\": 0,\n"
+				<< "      \"threads\": 1,\n"
+				<< "      \"iterations\": " << result.iterations << ",\n"
+				<< "      \"real_time\": " << result.realTime << ",\n"
+				<< "      \"cpu_time\": " << result.cpuTime << ",\n"
+				<< "      \"time_unit\": \"ns\",\n"
+				<< "      \"bytes_per_second\": " << result.bytesPerSecond << "\n"
+				<< "    }";
+		}
+		out << "\n  ]\n}\n";
+	}
+
+	void write_console_line(const Result& result)
+	{
+		std::cout << std::left << std::setw(56) << result.name << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(12) << result.realTime / 1e6 << " ms" << std::setw(12) << result.cpuTime / 1e6 << " ms cpu"
+			<< std::setw(10) << result.bytesPerSecond / (1 << 20) << " MB/s" << std::setw(8) << result.iterations << std::endl;
+	}
+
+	// -----------------------------------------------------------------------------
+	// Benchmarks
+	// -----------------------------------------------------------------------------
+
+	constexpr std::int64_t Rows = 10000;
+	constexpr std::int64_t Columns = 2000;
+	const double Densities[] = { 0.01, 0.05, 0.2 };
+
+	std::string density_name(double density)
+	{
+		std::ostringstream name;
+		name << "density:" << density;
+		return name.str();
+	}
+
+	// The sparse paths of DataContainerInterface (set_sparse_row_data, increase_sparse_row_data,
+	// set_sparse_column_data, increase_sparse_column_data) for output element type T.
+	template<typename T>
+	void add_sparse_benchmarks(std::vector<Benchmark>& benchmarks, std::vector<std::shared_ptr<void>>& keepAlive)
+	{
+		const std::string type = element_type_name<T>();
+		auto points = std::make_shared<InMemoryPoints<T>>(Rows, Columns);
+		keepAlive.push_back(points);
+		for (const double density : Densities)
+		{
+			auto csr = std::make_shared<SparseMatrix>(generate_sparse(Rows, Columns, density, 1));
+			auto csc = std::make_shared<SparseMatrix>(transpose(*csr));
+			keepAlive.push_back(csr);
+			keepAlive.push_back(csc);
+			const std::string suffix = "/" + type + "/" + density_name(density);
+			const std::uint64_t bytes = csr->bytes() + points->bytes();
+
+			benchmarks.push_back({ "set_sparse_row_data" + suffix, bytes, {}, [points, csr]()
+				{
+					points->visitFromBeginToEnd([&csr](auto beginOfData, auto)
+						{
+							H5Utils::scatter_sparse_rows<false>(beginOfData, csr->rows, csr->columns, csr->indices, csr->offsets, csr->values, TRANSFORM::None(), no_progress);
+						});
+				} });
+			benchmarks.push_back({ "set_sparse_row_data_zero_fill" + suffix, bytes, {}, [points, csr]()
+				{
+					points->visitFromBeginToEnd([&csr](auto beginOfData, auto)
+						{
+							H5Utils::scatter_sparse_rows<false, true>(beginOfData, csr->rows, csr->columns, csr->indices, csr->offsets, csr->values, TRANSFORM::None(), no_progress);
+						});
+				} });
+			benchmarks.push_back({ "increase_sparse_row_data" + suffix, bytes, {}, [points, csr]()
+				{
+					points->visitFromBeginToEnd([&csr](auto beginOfData, auto)
+						{
+							H5Utils::scatter_sparse_rows<true>(beginOfData, csr->rows, csr->columns, csr->indices, csr->offsets, csr->values, TRANSFORM::None(), no_progress);
+						});
+				} });
+			benchmarks.push_back({ "set_sparse_row_data_log" + suffix, bytes, {}, [points, csr]()
+				{
+					points->visitFromBeginToEnd([&csr](auto beginOfData, auto)
+						{
+							H5Utils::scatter_sparse_rows<false>(beginOfData, csr->rows, csr->columns, csr->indices, csr->offsets, csr->values, TRANSFORM::Type(TRANSFORM::LOG, false), no_progress);
+						});
+				} });
+			benchmarks.push_back({ "set_sparse_column_data" + suffix, bytes, {}, [points, csc]()
+				{
+					points->visitFromBeginToEnd([&csc](auto beginOfData, auto)
+						{
+							H5Utils::scatter_sparse_columns<false>(beginOfData, csc->columns, csc->rows, csc->indices, csc->offsets, csc->values, TRANSFORM::None(), no_progress);
+						});
+				} });
+			benchmarks.push_back({ "set_sparse_column_data_zero_fill" + suffix, bytes, {}, [points, csc]()
+				{
+					points->visitFromBeginToEnd([&csc](auto beginOfData, auto)
+						{
+							H5Utils::scatter_sparse_columns<false, true>(beginOfData, csc->columns, csc->rows, csc->indices, csc->offsets, csc->values, TRANSFORM::None(), no_progress);
+						});
+				} });
+			benchmarks.push_back({ "increase_sparse_column_data" + suffix, bytes, {}, [points, csc]()
+				{
+					points->visitFromBeginToEnd([&csc](auto beginOfData, auto)
+						{
+							H5Utils::scatter_sparse_columns<true>(beginOfData, csc->columns, csc->rows, csc->indices, csc->offsets, csc->values, TRANSFORM::None(), no_progress);
+						});
+				} });
+		}
+	}
+
+	void add_value_benchmarks(std::vector<Benchmark>& benchmarks, std::vector<std::shared_ptr<void>>& keepAlive)
+	{
+		// dense count matrix, as applyTransform sees it after a sparse load
+		auto counts = std::make_shared<std::vector<float>>(Rows * Columns, 0.0f);
+		{
+			const SparseMatrix csr = generate_sparse(Rows, Columns, 0.05, 2);
+			for (std::int64_t row = 0; row < Rows; ++row)
+			{
+				for (std::uint64_t i = csr.offsets[row]; i < csr.offsets[row + 1]; ++i)
+					(*counts)[row * Columns + csr.indices[i]] = csr.values[i];
+			}
+		}
+		keepAlive.push_back(counts);
+		const std::uint64_t matrixBytes = counts->size() * sizeof(float);
+
+		auto points = std::make_shared<InMemoryPoints<float>>(Rows, Columns);
+		keepAlive.push_back(points);
+		const std::pair<const char*, TRANSFORM::Type> transforms[] = { { "none", TRANSFORM::None() }, { "log", TRANSFORM::Type(TRANSFORM::LOG, false) }, { "arcsin5", TRANSFORM::Type(TRANSFORM::ARCSIN5, false) } };
+		for (const auto& [transformName, transform] : transforms)
+		{
+			benchmarks.push_back({ std::string("applyTransform/float32/") + transformName, matrixBytes, [points, counts]()
+				{
+					points->visitFromBeginToEnd([&counts](auto beginOfData, auto) { std::copy(counts->cbegin(), counts->cend(), beginOfData); });
+				}, [points, transform = transform]()
+				{
+					points->visitFromBeginToEnd([transform](auto beginOfData, auto)
+						{
+							H5Utils::normalize_and_transform_rows(beginOfData, Rows, Columns, transform, no_progress);
+						});
+				} });
+		}
+
+		// metadata sized: transpose, the integer check and min-max run on obsm and numerical metadata
+		constexpr std::int64_t MetadataRows = 200000;
+		constexpr std::int64_t MetadataColumns = 50;
+		auto metadata = std::make_shared<std::vector<float>>(MetadataRows * MetadataColumns);
+		{
+			std::mt19937_64 generator(3);
+			std::geometric_distribution<int> count(0.2);
+			for (auto& value : *metadata)
+				value = static_cast<float>(count(generator));
+		}
+		keepAlive.push_back(metadata);
+		const std::uint64_t metadataBytes = metadata->size() * sizeof(float);
+
+		benchmarks.push_back({ "transpose/float32", metadataBytes, {}, [metadata]()
+			{
+				H5Utils::transpose_in_place(metadata->begin(), metadata->end(), MetadataRows, no_progress);
+			} });
+		benchmarks.push_back({ "contains_only_integers/float32", metadataBytes, {}, [metadata]()
+			{
+				volatile bool result = H5Utils::contains_only_integers(*metadata);
+				(void)result;
+			} });
+		benchmarks.push_back({ "minmax_element/float32", metadataBytes, {}, [metadata]()
+			{
+				volatile float result = *std::minmax_element(metadata->cbegin(), metadata->cend()).second;
+				(void)result;
+			} });
+
+		auto converted = std::make_shared<std::vector<bfloat16>>();
+		keepAlive.push_back(converted);
+		benchmarks.push_back({ "convert_values/float32_to_bfloat16", metadataBytes, {}, [metadata, converted]()
+			{
+				H5Utils::convert_values(*metadata, *converted);
+			} });
+
+		// var and obs values of an h5ad with half of the dimensions selected
+		auto lut = std::make_shared<std::vector<std::ptrdiff_t>>(metadata->size(), -1);
+		{
+			std::ptrdiff_t next = 0;
+			for (std::size_t i = 0; i < lut->size(); i += 2)
+				(*lut)[i] = next++;
+		}
+		auto values = std::make_shared<std::vector<float>>();
+		keepAlive.push_back(lut);
+		keepAlive.push_back(values);
+		benchmarks.push_back({ "filter_values/float32/selected:0.5", metadataBytes, [metadata, values]() { *values = *metadata; }, [values, lut]()
+			{
+				H5Utils::filter_values(*values, *lut);
+			} });
+
+		// barcodes and gene names as read from fixed length string datasets
+		for (const std::size_t stringSize : { 16, 64 })
+		{
+			constexpr std::size_t Count = 200000;
+			auto raw = std::make_shared<std::vector<char>>(Count * stringSize, '\0');
+			for (std::size_t s = 0; s < Count; ++s)
+				std::snprintf(raw->data() + s * stringSize, stringSize, "CELL_%08zu", s);
+			auto strings = std::make_shared<std::vector<std::string>>();
+			keepAlive.push_back(raw);
+			keepAlive.push_back(strings);
+			benchmarks.push_back({ "read_strings_decode/length:" + std::to_string(stringSize), raw->size(), {}, [raw, strings, stringSize]()
+				{
+					H5Utils::decode_fixed_length_strings(*raw, Count, stringSize, *strings, [](const char* s) { return std::string(s); });
+				} });
+		}
+	}
+
+	bool starts_with(const std::string& argument, const std::string& prefix, std::string& value)
+	{
+		if (argument.compare(0, prefix.size(), prefix) != 0)
+			return false;
+		value = argument.substr(prefix.size());
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string filter = ".";
+	double minTime = 0.5;
+	std::string format = "console";
+	std::string outFile;
+	bool list = false;
+	for (int a = 1; a < argc; ++a)
+	{
+		const std::string argument = argv[a];
+		std::string value;
+		if (local::starts_with(argument, "--benchmark_filter=", value))
+			filter = value;
+		else if (local::starts_with(argument, "--benchmark_min_time=", value))
+			minTime = std::atof(value.c_str()); // a trailing s, as in 0.5s, is ignored
+		else if (local::starts_with(argument, "--benchmark_format=", value))
+			format = value;
+		else if (local::starts_with(argument, "--benchmark_out=", value))
+			outFile = value;
+		else if (argument == "--benchmark_list_tests")
+			list = true;
+		else
+		{
+			std::cout << "Unknown option " << argument << "\n"
+				<< "Options: --benchmark_filter=<regex> --benchmark_min_time=<seconds> --benchmark_format=<console|json> --benchmark_out=<file> --benchmark_list_tests" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	if ((format != "console") && (format != "json"))
+	{
+		std::cout << "Unknown format " << format << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::regex pattern;
+	try
+	{
+		pattern = std::regex(filter);
+	}
+	catch (const std::regex_error&)
+	{
+		std::cout << "Invalid filter " << filter << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::vector<local::Benchmark> benchmarks;
+	std::vector<std::shared_ptr<void>> keepAlive;
+	local::add_sparse_benchmarks<float>(benchmarks, keepAlive);
+	local::add_sparse_benchmarks<local::bfloat16>(benchmarks, keepAlive);
+	local::add_sparse_benchmarks<std::uint16_t>(benchmarks, keepAlive);
+	local::add_sparse_benchmarks<std::int8_t>(benchmarks, keepAlive);
+	local::add_value_benchmarks(benchmarks, keepAlive);
+
+	std::vector<local::Result> results;
+	for (const auto& benchmark : benchmarks)
+	{
+		if (!std::regex_search(benchmark.name, pattern))
+			continue;
+		if (list)
+		{
+			std::cout << benchmark.name << std::endl;
+			continue;
+		}
+		results.push_back(local::run_benchmark(benchmark, minTime));
+		if (format == "console")
+			local::write_console_line(results.back());
+	}
+
+	if (format == "json")
+		local::write_json(std::cout, results, argv[0]);
+	if (!outFile.empty())
+	{
+		std::ofstream out(outFile);
+		local::write_json(out, results, argv[0]);
+		if (!out)
+		{
+			std::cout << "Could not write " << outFile << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,263 @@
+#include "BackedMatrix.h"
+
+#include "Trace.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace H5Utils
+{
+	BackedMatrix::BackedMatrix(std::shared_ptr<H5::H5File> file, const H5::Group& group, std::uint64_t columns, const std::string& dataName, const std::string& indicesName, const std::string& indptrName)
+		: _file(std::move(file))
+		, _sparse(std::make_unique<RowBlockReader>(group, columns, dataName, indicesName, indptrName))
+		, _rows(_sparse->rows())
+		, _columns(columns)
+	{
+	}
+
+	BackedMatrix::BackedMatrix(std::shared_ptr<H5::H5File> file, const H5::DataSet& dataset)
+		: _file(std::move(file))
+		, _dense(dataset)
+	{
+		try
+		{
+			H5::DataSpace dataspace = dataset.getSpace();
+			if (dataspace.getSimpleExtentNdims() != 2)
+				return;
+			hsize_t dimensions[2] = { 0, 0 };
+			dataspace.getSimpleExtentDims(dimensions, NULL);
+			_rows = dimensions[0];
+			_columns = dimensions[1];
+		}
+		catch (const H5::Exception& e)
+		{
+			std::cout << "Backed matrix: " << e.getCDetailMsg() << std::endl;
+			_rows = 0;
+			_columns = 0;
+		}
+	}
+
+	bool BackedMatrix::valid() const
+	{
+		return (_rows > 0) && (_columns > 0);
+	}
+
+	bool BackedMatrix::sparse() const
+	{
+		return _sparse != nullptr;
+	}
+
+	std::uint64_t BackedMatrix::rows() const
+	{
+		return _rows;
+	}
+
+	std::uint64_t BackedMatrix::columns() const
+	{
+		return _columns;
+	}
+
+	void BackedMatrix::setBlockRows(std::uint64_t rows)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_blockRows = std::max<std::uint64_t>(rows, 1);
+		clearCache();
+	}
+
+	std::uint64_t BackedMatrix::blockRows() const
+	{
+		return _blockRows;
+	}
+
+	std::uint64_t BackedMatrix::blockCount() const
+	{
+		return (_rows + _blockRows - 1) / _blockRows;
+	}
+
+	void BackedMatrix::setCacheLimit(std::uint64_t bytes)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_cacheLimit = bytes;
+	}
+
+	std::uint64_t BackedMatrix::cacheLimit() const
+	{
+		return _cacheLimit;
+	}
+
+	void BackedMatrix::clearCache()
+	{
+		_cache.clear();
+		_recentBlocks.clear();
+		_statistics.cachedBytes = 0;
+		_cacheMemory.setBytes(0);
+	}
+
+	std::shared_ptr<const RowBlock> BackedMatrix::readBlock(std::uint64_t index) const
+	{
+		MV_H5_TRACE_SCOPE("BackedMatrix::readBlock");
+		const std::uint64_t firstRow = std::min(_rows, index * _blockRows);
+		if (_sparse)
+			return std::make_shared<const RowBlock>(_sparse->readRows(firstRow, _blockRows));
+
+		auto result = std::make_shared<RowBlock>();
+		const std::uint64_t lastRow = std::min(_rows, firstRow + _blockRows);
+		result->firstRow = firstRow;
+		result->indptr.resize(lastRow - firstRow + 1, 0);
+		if (lastRow == firstRow)
+			return result;
+
+		// dense rows are kept as sparse rows, most expression matrices are mostly zeros
+		std::vector<float> dense((lastRow - firstRow) * _columns);
+		H5::DataSpace fileSpace = _dense.getSpace();
+		const hsize_t offset[2] = { firstRow, 0 };
+		const hsize_t count[2] = { lastRow - firstRow, _columns };
+		fileSpace.selectHyperslab(H5S_SELECT_SET, count, offset);
+		const hsize_t memorySize = dense.size();
+		H5::DataSpace memorySpace(1, &memorySize);
+		_dense.read(dense.data(), H5::PredType::NATIVE_FLOAT, memorySpace, fileSpace);
+
+		for (std::uint64_t row = 0; row < lastRow - firstRow; ++row)
+		{
+			const float* rowData = dense.data() + row * _columns;
+			for (std::uint64_t column = 0; column < _columns; ++column)
+			{
+				if (rowData[column] != 0)
+				{
+					result->indices.push_back(static_cast<std::uint32_t>(column));
+					result->values.push_back(rowData[column]);
+				}
+			}
+			result->indptr[row + 1] = result->values.size();
+		}
+		return result;
+	}
+
+	std::shared_ptr<const RowBlock> BackedMatrix::block(std::uint64_t index)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		auto cached = _cache.find(index);
+		if (cached != _cache.end())
+		{
+			_recentBlocks.splice(_recentBlocks.begin(), _recentBlocks, cached->second.second);
+			++_statistics.cacheHits;
+			return cached->second.first;
+		}
+
+		std::shared_ptr<const RowBlock> result = readBlock(index);
+		++_statistics.blockReads;
+		_statistics.bytesRead += result->bytes();
+
+		_recentBlocks.push_front(index);
+		_cache[index] = std::make_pair(result, _recentBlocks.begin());
+		_statistics.cachedBytes += result->bytes();
+		// the block just read is always kept, so a limit smaller than one block still works
+		while ((_statistics.cachedBytes > _cacheLimit) && (_recentBlocks.size() > 1))
+		{
+			auto oldest = _cache.find(_recentBlocks.back());
+			_statistics.cachedBytes -= oldest->second.first->bytes();
+			_cache.erase(oldest);
+			_recentBlocks.pop_back();
+		}
+		_cacheMemory.setBytes(_statistics.cachedBytes);
+		return result;
+	}
+
+	std::vector<float> BackedMatrix::column(std::uint64_t column)
+	{
+		return columns({ column });
+	}
+
+	std::vector<float> BackedMatrix::columns(const std::vector<std::uint64_t>& columnIndices)
+	{
+		MV_H5_TRACE_SCOPE("BackedMatrix::columns");
+		const std::uint64_t nrOfColumns = columnIndices.size();
+		std::vector<float> result(_rows * nrOfColumns, 0.0f);
+		if (!valid() || (nrOfColumns == 0))
+			return result;
+
+		if (!_sparse)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			std::vector<float> values(_rows);
+			for (std::uint64_t c = 0; c < nrOfColumns; ++c)
+			{
+				if (columnIndices[c] >= _columns)
+					continue;
+				H5::DataSpace fileSpace = _dense.getSpace();
+				const hsize_t offset[2] = { 0, columnIndices[c] };
+				const hsize_t count[2] = { _rows, 1 };
+				fileSpace.selectHyperslab(H5S_SELECT_SET, count, offset);
+				const hsize_t memorySize = _rows;
+				H5::DataSpace memorySpace(1, &memorySize);
+				_dense.read(values.data(), H5::PredType::NATIVE_FLOAT, memorySpace, fileSpace);
+				for (std::uint64_t row = 0; row < _rows; ++row)
+					result[row * nrOfColumns + c] = values[row];
+			}
+			return result;
+		}
+
+		// position of every matrix column in the result, -1 for the columns that are not asked for
+		std::vector<std::int64_t> resultColumn(_columns, -1);
+		for (std::uint64_t c = 0; c < nrOfColumns; ++c)
+		{
+			if (columnIndices[c] < _columns)
+				resultColumn[columnIndices[c]] = static_cast<std::int64_t>(c);
+		}
+
+		for (std::uint64_t b = 0; b < blockCount(); ++b)
+		{
+			const auto rowBlock = block(b);
+			#pragma omp parallel for
+			for (std::int64_t row = 0; row < static_cast<std::int64_t>(rowBlock->rows()); ++row)
+			{
+				float* destination = result.data() + (rowBlock->firstRow + row) * nrOfColumns;
+				for (std::uint64_t k = rowBlock->indptr[row]; k < rowBlock->indptr[row + 1]; ++k)
+				{
+					const std::uint32_t matrixColumn = rowBlock->indices[k];
+					if ((matrixColumn < _columns) && (resultColumn[matrixColumn] >= 0))
+						destination[resultColumn[matrixColumn]] = rowBlock->values[k];
+				}
+			}
+		}
+		return result;
+	}
+
+	std::vector<float> BackedMatrix::readRows(const std::vector<std::uint64_t>& rowIndices)
+	{
+		MV_H5_TRACE_SCOPE("BackedMatrix::readRows");
+		std::vector<float> result(rowIndices.size() * _columns, 0.0f);
+
+		// visit the rows grouped by block so every block is fetched once
+		std::vector<std::uint64_t> order(rowIndices.size());
+		for (std::uint64_t i = 0; i < order.size(); ++i)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&rowIndices](std::uint64_t a, std::uint64_t b) { return rowIndices[a] < rowIndices[b]; });
+
+		std::shared_ptr<const RowBlock> rowBlock;
+		for (const auto i : order)
+		{
+			const std::uint64_t row = rowIndices[i];
+			if (row >= _rows)
+				continue;
+			if (!rowBlock || (row < rowBlock->firstRow) || (row >= rowBlock->firstRow + rowBlock->rows()))
+				rowBlock = block(row / _blockRows);
+
+			const std::uint64_t localRow = row - rowBlock->firstRow;
+			float* destination = result.data() + i * _columns;
+			for (std::uint64_t k = rowBlock->indptr[localRow]; k < rowBlock->indptr[localRow + 1]; ++k)
+			{
+				if (rowBlock->indices[k] < _columns)
+					destination[rowBlock->indices[k]] = rowBlock->values[k];
+			}
+		}
+		return result;
+	}
+
+	BackedMatrixStatistics BackedMatrix::statistics() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _statistics;
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "H5Cpp.h"
+
+#include "MemoryTracker.h"
+#include "RowBlockReader.h"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace H5Utils
+{
+	// Default size limit of the block cache of a BackedMatrix.
+	constexpr std::uint64_t backed_matrix_cache_limit = 256 * 1024 * 1024;
+
+	struct BackedMatrixStatistics
+	{
+		std::uint64_t blockReads = 0;	// blocks read from the file
+		std::uint64_t cacheHits = 0;	// blocks served from the cache
+		std::uint64_t bytesRead = 0;	// decoded bytes of the blocks read
+		std::uint64_t cachedBytes = 0;	// decoded bytes of the blocks in the cache
+	};
+
+	/*
+	* Out-of-core access to the matrix of an open file, for files that do not fit in memory. Rows are read on demand in
+	* blocks: sparse blocks with the hyperslab reads of a RowBlockReader (only indptr is held in memory), dense blocks
+	* with a hyperslab of rows that is kept as sparse rows. Decoded blocks are kept in an LRU cache with a size limit.
+	* The matrix holds the file, so it stays open for as long as the matrix is alive, after the loader is gone.
+	* Thread safe, the blocks are read one at a time.
+	*/
+	class BackedMatrix
+	{
+	public:
+		// Compressed sparse rows in group, columns is the size of the minor dimension (not stored in the group).
+		BackedMatrix(std::shared_ptr<H5::H5File> file, const H5::Group& group, std::uint64_t columns, const std::string& dataName = "data", const std::string& indicesName = "indices", const std::string& indptrName = "indptr");
+
+		// Two dimensional dense dataset, rows are the first dimension.
+		BackedMatrix(std::shared_ptr<H5::H5File> file, const H5::DataSet& dataset);
+
+		BackedMatrix(const BackedMatrix&) = delete;
+		BackedMatrix& operator=(const BackedMatrix&) = delete;
+
+		// False if the matrix could not be opened or indptr is inconsistent.
+		bool valid() const;
+		bool sparse() const;
+
+		std::uint64_t rows() const;
+		std::uint64_t columns() const;
+
+		// Rows per block, default_block_rows by default. Clears the cache.
+		void setBlockRows(std::uint64_t rows);
+		std::uint64_t blockRows() const;
+		std::uint64_t blockCount() const;
+
+		// Size limit of the block cache in bytes, backed_matrix_cache_limit by default. The block read last is always kept.
+		void setCacheLimit(std::uint64_t bytes);
+		std::uint64_t cacheLimit() const;
+
+		// Block index (not row), read from the file if it is not cached. Throws like H5::DataSet::read.
+		std::shared_ptr<const RowBlock> block(std::uint64_t index);
+
+		// Values of one column for all rows, e.g. to color by a gene.
+		std::vector<float> column(std::uint64_t column);
+
+		// Dense rows() x columnIndices.size() values, row major. Sparse matrices visit every block (through the cache),
+		// dense ones read the columns with a hyperslab and leave the cache alone.
+		std::vector<float> columns(const std::vector<std::uint64_t>& columnIndices);
+
+		// Dense rowIndices.size() x columns() values, only the blocks holding the rows are read.
+		std::vector<float> readRows(const std::vector<std::uint64_t>& rowIndices);
+
+		BackedMatrixStatistics statistics() const;
+
+	private:
+		std::shared_ptr<const RowBlock> readBlock(std::uint64_t index) const;
+		void clearCache();
+
+		std::shared_ptr<H5::H5File> _file;
+		std::unique_ptr<RowBlockReader> _sparse; // null for a dense matrix
+		H5::DataSet _dense;
+		std::uint64_t _rows = 0;
+		std::uint64_t _columns = 0;
+		std::uint64_t _blockRows = default_block_rows;
+
+		mutable std::mutex _mutex;
+		std::uint64_t _cacheLimit = backed_matrix_cache_limit;
+		std::list<std::uint64_t> _recentBlocks; // most recently used first
+		std::unordered_map<std::uint64_t, std::pair<std::shared_ptr<const RowBlock>, std::list<std::uint64_t>::iterator>> _cache;
+		TrackedBuffer _cacheMemory{ "BackedMatrix cache" };
+		BackedMatrixStatistics _statistics;
+	};
+}
@@ -0,0 +1,155 @@
+#include "BackedPoints.h"
+
+#include "LoadPlanner.h"
+#include "SparseKernels.h"
+
+#include <CoreInterface.h>
+
+#include <QSignalBlocker>
+#include <QStringList>
+
+#include <algorithm>
+#include <iostream>
+
+using namespace mv;
+
+namespace H5Utils
+{
+	BackedPoints::BackedPoints(Dataset<Points> points, std::shared_ptr<BackedMatrix> matrix, const std::vector<QString>& columnNames, TRANSFORM::Type transform, std::uint64_t memoryBudget)
+		: QObject(points.get())
+		, _points(points)
+		, _matrix(std::move(matrix))
+		, _columnNames(columnNames)
+		, _transform(transform)
+		, _memoryBudget(memory_budget(memoryBudget))
+		, _groupAction(this, "Backed matrix", true)
+		, _shownColumnsAction(this, "Shown columns", QStringList(columnNames.cbegin(), columnNames.cend()))
+		, _readSelectedRowsAction(this, "Read selected rows")
+	{
+		_shownColumnsAction.setToolTip("Columns of the matrix in the file that are read into the points");
+		_readSelectedRowsAction.setToolTip("Reads the selected rows with all columns from the file into a child dataset");
+		_groupAction.addAction(&_shownColumnsAction);
+		_groupAction.addAction(&_readSelectedRowsAction);
+		_points->addAction(_groupAction);
+
+		connect(&_shownColumnsAction, &gui::OptionsAction::selectedOptionsChanged, this, [this](const QStringList& selectedOptions)
+			{
+				std::vector<std::uint64_t> columns;
+				for (const QString& option : selectedOptions)
+				{
+					const auto found = std::find(_columnNames.cbegin(), _columnNames.cend(), option);
+					if (found != _columnNames.cend())
+						columns.push_back(static_cast<std::uint64_t>(found - _columnNames.cbegin()));
+				}
+				if (columns != _shownColumns)
+					showColumns(columns);
+			});
+		connect(&_readSelectedRowsAction, &gui::TriggerAction::triggered, this, [this]() { readSelectedRows(); });
+	}
+
+	BackedPoints* BackedPoints::attach(Dataset<Points> points, std::shared_ptr<BackedMatrix> matrix, const std::vector<QString>& columnNames, const std::vector<std::uint64_t>& initialColumns, TRANSFORM::Type transform, std::uint64_t memoryBudget)
+	{
+		if (!points.isValid() || !matrix || !matrix->valid() || (columnNames.size() != matrix->columns()))
+			return nullptr;
+		points->setDataElementType<float>();
+		auto* backedPoints = new BackedPoints(points, std::move(matrix), columnNames, transform, memoryBudget);
+		try
+		{
+			if (backedPoints->showColumns(initialColumns))
+				return backedPoints;
+		}
+		catch (const H5::Exception& e)
+		{
+			std::cout << "Backed points: " << e.getCDetailMsg() << std::endl;
+		}
+		delete backedPoints;
+		return nullptr;
+	}
+
+	std::shared_ptr<BackedMatrix> BackedPoints::matrix() const
+	{
+		return _matrix;
+	}
+
+	std::uint64_t BackedPoints::maxShownColumns() const
+	{
+		// the block cache and the index pointers of the matrix stay next to the shown columns
+		const std::uint64_t matrixBytes = _matrix->cacheLimit() + (_matrix->rows() + 1) * sizeof(std::uint64_t);
+		const std::uint64_t columnBytes = std::max<std::uint64_t>(_matrix->rows(), 1) * sizeof(float);
+		if (_memoryBudget <= matrixBytes)
+			return 0;
+		return std::min(_matrix->columns(), (_memoryBudget - matrixBytes) / columnBytes);
+	}
+
+	void BackedPoints::transform(std::vector<float>& values) const
+	{
+		if (_transform.first == TRANSFORM::NONE)
+			return;
+		#pragma omp parallel for
+		for (std::int64_t i = 0; i < static_cast<std::int64_t>(values.size()); ++i)
+			values[i] = static_cast<float>(transform_value(values[i], _transform));
+	}
+
+	bool BackedPoints::showColumns(std::vector<std::uint64_t> columns)
+	{
+		columns.erase(std::remove_if(columns.begin(), columns.end(), [this](std::uint64_t column) { return column >= _matrix->columns(); }), columns.end());
+		const std::uint64_t maxColumns = maxShownColumns();
+		if (columns.size() > maxColumns)
+		{
+			std::cout << "Backed points: only " << maxColumns << " of the " << columns.size() << " columns fit in the memory budget" << std::endl;
+			columns.resize(maxColumns);
+		}
+		if (columns.empty())
+			return false;
+
+		std::vector<float> values = _matrix->columns(columns);
+		transform(values);
+
+		std::vector<QString> dimensionNames;
+		QStringList selectedOptions;
+		for (const std::uint64_t column : columns)
+		{
+			dimensionNames.push_back(_columnNames[column]);
+			selectedOptions << _columnNames[column];
+		}
+		_shownColumns = columns;
+		_points->setData(std::move(values), columns.size());
+		_points->setDimensionNames(dimensionNames);
+		{
+			// the option follows the columns that were read
+			const QSignalBlocker blocker(&_shownColumnsAction);
+			_shownColumnsAction.setSelectedOptions(selectedOptions);
+		}
+		events().notifyDatasetDataDimensionsChanged(_points);
+		events().notifyDatasetDataChanged(_points);
+		return true;
+	}
+
+	bool BackedPoints::readSelectedRows()
+	{
+		const std::vector<std::uint32_t>& selection = _points->getSelection<Points>()->indices;
+		if (selection.empty())
+			return false;
+		if (selection.size() * _matrix->columns() * sizeof(float) > _memoryBudget)
+		{
+			std::cout << "Backed points: the " << selection.size() << " selected rows do not fit in the memory budget" << std::endl;
+			return false;
+		}
+
+		std::vector<std::uint64_t> rows(selection.cbegin(), selection.cend());
+		std::vector<float> values = _matrix->readRows(rows);
+		transform(values);
+
+		const bool added = !_selectedRows.isValid();
+		if (added)
+			_selectedRows = mv::data().createDataset<Points>("Points", _points->getGuiName() + " (selected rows)", _points);
+		_selectedRows->setDataElementType<float>();
+		_selectedRows->setData(std::move(values), _matrix->columns());
+		_selectedRows->setDimensionNames(_columnNames);
+		_selectedRows->setProperty("Rows", QVariantList(selection.cbegin(), selection.cend()));
+		if (added)
+			events().notifyDatasetAdded(_selectedRows);
+		events().notifyDatasetDataChanged(_selectedRows);
+		return true;
+	}
+}
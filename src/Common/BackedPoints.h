@@ -0,0 +1,65 @@
+#pragma once
+
+#include "BackedMatrix.h"
+#include "TransformType.h"
+
+#include "PointData/PointData.h"
+#include "Dataset.h"
+
+#include <actions/GroupAction.h>
+#include <actions/OptionsAction.h>
+#include <actions/TriggerAction.h>
+
+#include <QObject>
+#include <QString>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace H5Utils
+{
+	/*
+	* Publishes a BackedMatrix as a Points dataset without loading the matrix (LoadStrategy::Backed). The points hold
+	* all rows but only the columns that are shown, as float; the other columns stay in the file:
+	* - the "Shown columns" option of the dataset reads the columns chosen there from the matrix, e.g. to color by a gene;
+	* - "Read selected rows" reads the rows selected in the points with all columns into a child dataset.
+	* Both go through the block cache of the matrix and are refused when the result does not fit the memory budget.
+	* The adapter is a child of the points, so the matrix, and with it the file, stays open as long as the dataset exists.
+	*/
+	class BackedPoints : public QObject
+	{
+	public:
+		// Shows initialColumns of matrix in points, which are empty, and attaches the adapter to them. The values are
+		// transformed as they are read. Returns nullptr when the initial columns could not be read.
+		static BackedPoints* attach(mv::Dataset<Points> points, std::shared_ptr<BackedMatrix> matrix, const std::vector<QString>& columnNames, const std::vector<std::uint64_t>& initialColumns, TRANSFORM::Type transform, std::uint64_t memoryBudget);
+
+		std::shared_ptr<BackedMatrix> matrix() const;
+
+		// Number of columns the points can show within the memory budget, next to the block cache.
+		std::uint64_t maxShownColumns() const;
+
+		// Replaces the columns of the points by these columns of the matrix, at most maxShownColumns of them.
+		bool showColumns(std::vector<std::uint64_t> columns);
+
+		// Reads the selected rows with all columns into the child dataset, false if nothing is selected or they do not fit.
+		bool readSelectedRows();
+
+	private:
+		BackedPoints(mv::Dataset<Points> points, std::shared_ptr<BackedMatrix> matrix, const std::vector<QString>& columnNames, TRANSFORM::Type transform, std::uint64_t memoryBudget);
+
+		void transform(std::vector<float>& values) const;
+
+		mv::Dataset<Points> _points;
+		std::shared_ptr<BackedMatrix> _matrix;
+		std::vector<QString> _columnNames;
+		TRANSFORM::Type _transform;
+		std::uint64_t _memoryBudget;
+		std::vector<std::uint64_t> _shownColumns;
+		mv::Dataset<Points> _selectedRows; // child dataset of readSelectedRows
+
+		mv::gui::GroupAction _groupAction;
+		mv::gui::OptionsAction _shownColumnsAction;
+		mv::gui::TriggerAction _readSelectedRowsAction;
+	};
+}
@@ -0,0 +1,340 @@
+#include "CoalescingFileDriver.h"
+#include "FileDriverValues.h"
+
+#if H5_VERSION_GE(1, 13, 0)
+#include <H5FDdevelop.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <list>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+namespace H5Utils
+{
+	namespace local
+	{
+		struct CoalescingDriverInfo
+		{
+			CoalescingDriverConfig config;
+			hid_t underlyingFapl = H5I_INVALID_HID;
+		};
+
+		struct CoalescingCounters
+		{
+			std::atomic<std::uint64_t> hits{ 0 };
+			std::atomic<std::uint64_t> misses{ 0 };
+			std::atomic<std::uint64_t> passthroughReads{ 0 };
+			std::atomic<std::uint64_t> underlyingReads{ 0 };
+			std::atomic<std::uint64_t> underlyingBytes{ 0 };
+		};
+
+		CoalescingCounters& coalescing_counters()
+		{
+			static CoalescingCounters counters;
+			return counters;
+		}
+
+		struct CacheBlock
+		{
+			haddr_t index;
+			std::size_t validSize; // bytes below the end of the allocated space when the block was read
+			std::vector<char> data;
+		};
+
+		struct CoalescingFile
+		{
+			H5FD_t pub; // public part, has to be the first member
+			H5FD_t* underlying = nullptr;
+			hid_t underlyingFapl = H5I_INVALID_HID;
+			CoalescingDriverConfig config;
+			std::list<CacheBlock> blocks; // most recently used first
+			std::unordered_map<haddr_t, std::list<CacheBlock>::iterator> blockLookup;
+		};
+
+		CoalescingFile* coalescing_file(H5FD_t* file)
+		{
+			return reinterpret_cast<CoalescingFile*>(file);
+		}
+
+		const CoalescingFile* coalescing_file(const H5FD_t* file)
+		{
+			return reinterpret_cast<const CoalescingFile*>(file);
+		}
+
+		void* coalescing_fapl_copy(const void* info)
+		{
+			auto* result = new (std::nothrow) CoalescingDriverInfo();
+			if (result && info)
+			{
+				const auto* source = static_cast<const CoalescingDriverInfo*>(info);
+				result->config = source->config;
+				result->underlyingFapl = (source->underlyingFapl >= 0) ? H5Pcopy(source->underlyingFapl) : H5I_INVALID_HID;
+			}
+			return result;
+		}
+
+		herr_t coalescing_fapl_free(void* info)
+		{
+			auto* driverInfo = static_cast<CoalescingDriverInfo*>(info);
+			if (driverInfo && (driverInfo->underlyingFapl >= 0))
+				H5Pclose(driverInfo->underlyingFapl);
+			delete driverInfo;
+			return 0;
+		}
+
+		void* coalescing_fapl_get(H5FD_t* h5File)
+		{
+			const CoalescingFile* file = coalescing_file(h5File);
+			CoalescingDriverInfo info;
+			info.config = file->config;
+			info.underlyingFapl = file->underlyingFapl;
+			return coalescing_fapl_copy(&info);
+		}
+
+		H5FD_t* coalescing_open(const char* name, unsigned flags, hid_t fapl, haddr_t maxaddr)
+		{
+			if (flags & (H5F_ACC_RDWR | H5F_ACC_TRUNC | H5F_ACC_CREAT))
+				return nullptr;
+
+			const auto* info = static_cast<const CoalescingDriverInfo*>(H5Pget_driver_info(fapl));
+			const hid_t underlyingFapl = (info && (info->underlyingFapl >= 0)) ? info->underlyingFapl : H5P_FILE_ACCESS_DEFAULT;
+			H5FD_t* underlying = H5FDopen(name, flags, underlyingFapl, maxaddr);
+			if (!underlying)
+				return nullptr;
+
+			CoalescingFile* file = new (std::nothrow) CoalescingFile();
+			if (!file)
+			{
+				H5FDclose(underlying);
+				return nullptr;
+			}
+			file->underlying = underlying;
+			file->underlyingFapl = H5Pcopy(underlyingFapl);
+			if (info)
+				file->config = info->config;
+			file->config.blockSize = std::max<std::size_t>(file->config.blockSize, 512);
+			file->config.windowBlocks = std::max(file->config.windowBlocks, 1u);
+			file->config.cacheBlocks = std::max<std::size_t>(file->config.cacheBlocks, file->config.windowBlocks + 1);
+			return &file->pub;
+		}
+
+		herr_t coalescing_close(H5FD_t* h5File)
+		{
+			CoalescingFile* file = coalescing_file(h5File);
+			const herr_t result = H5FDclose(file->underlying);
+			if (file->underlyingFapl >= 0)
+				H5Pclose(file->underlyingFapl);
+			delete file;
+			return result;
+		}
+
+		int coalescing_cmp(const H5FD_t* file1, const H5FD_t* file2)
+		{
+			return H5FDcmp(coalescing_file(file1)->underlying, coalescing_file(file2)->underlying);
+		}
+
+		herr_t coalescing_query(const H5FD_t* file, unsigned long* flags)
+		{
+			// HDF5 also queries the driver class without a file, answer like sec2 then
+			if (file)
+				return H5FDquery(coalescing_file(file)->underlying, flags);
+			if (flags)
+				*flags = H5FD_FEAT_AGGREGATE_METADATA | H5FD_FEAT_ACCUMULATE_METADATA | H5FD_FEAT_DATA_SIEVE | H5FD_FEAT_AGGREGATE_SMALLDATA;
+			return 0;
+		}
+
+		haddr_t coalescing_get_eoa(const H5FD_t* file, H5FD_mem_t type)
+		{
+			return H5FDget_eoa(coalescing_file(const_cast<H5FD_t*>(file))->underlying, type);
+		}
+
+		herr_t coalescing_set_eoa(H5FD_t* file, H5FD_mem_t type, haddr_t address)
+		{
+			return H5FDset_eoa(coalescing_file(file)->underlying, type, address);
+		}
+
+		haddr_t coalescing_get_eof(const H5FD_t* file, H5FD_mem_t type)
+		{
+			return H5FDget_eof(coalescing_file(const_cast<H5FD_t*>(file))->underlying, type);
+		}
+
+		herr_t coalescing_get_handle(H5FD_t* file, hid_t fapl, void** fileHandle)
+		{
+			return H5FDget_vfd_handle(coalescing_file(file)->underlying, fapl, fileHandle);
+		}
+
+		herr_t coalescing_read(H5FD_t* h5File, H5FD_mem_t type, hid_t dxpl, haddr_t address, size_t size, void* buffer)
+		{
+			CoalescingFile* file = coalescing_file(h5File);
+			CoalescingCounters& counters = coalescing_counters();
+			const std::size_t blockSize = file->config.blockSize;
+
+			if (size >= blockSize)
+			{
+				++counters.passthroughReads;
+				++counters.underlyingReads;
+				counters.underlyingBytes += size;
+				return H5FDread(file->underlying, type, dxpl, address, size, buffer);
+			}
+			if (size == 0)
+				return 0;
+
+			const haddr_t eoa = H5FDget_eoa(file->underlying, type);
+			if ((address == HADDR_UNDEF) || (address + size < address) || (address + size > eoa))
+				return -1;
+
+			const haddr_t firstBlock = address / blockSize;
+			const haddr_t lastBlock = (address + size - 1) / blockSize;
+
+			// the end of the allocated space grows while the superblock is read, so a block only counts if it was read up to what is needed
+			auto cached = [file, blockSize, address, size](haddr_t index)
+			{
+				const auto block = file->blockLookup.find(index);
+				return (block != file->blockLookup.end()) && (index * blockSize + block->second->validSize >= std::min<haddr_t>(address + size, (index + 1) * blockSize));
+			};
+
+			bool hit = true;
+			for (haddr_t index = firstBlock; index <= lastBlock; ++index)
+			{
+				if (cached(index))
+					continue;
+				hit = false;
+
+				// fetch a window of uncached blocks with one read, clamped to the end of the allocated space
+				haddr_t endBlock = index + 1;
+				while ((endBlock < index + std::max<haddr_t>(file->config.windowBlocks, lastBlock - index + 1)) && (endBlock * blockSize < eoa) && !file->blockLookup.count(endBlock))
+					++endBlock;
+				const haddr_t windowAddress = index * blockSize;
+				const std::size_t windowSize = static_cast<std::size_t>(std::min<haddr_t>(endBlock * blockSize, eoa) - windowAddress);
+				std::vector<char> window(static_cast<std::size_t>(endBlock - index) * blockSize, 0);
+				++counters.underlyingReads;
+				counters.underlyingBytes += windowSize;
+				if (H5FDread(file->underlying, type, dxpl, windowAddress, windowSize, window.data()) < 0)
+					return -1;
+
+				for (haddr_t block = index; block < endBlock; ++block)
+				{
+					const auto previous = file->blockLookup.find(block);
+					if (previous != file->blockLookup.end())
+						file->blocks.erase(previous->second);
+					const std::size_t offset = static_cast<std::size_t>(block - index) * blockSize;
+					const char* begin = window.data() + offset;
+					file->blocks.push_front({ block, std::min(blockSize, windowSize - std::min(windowSize, offset)), std::vector<char>(begin, begin + blockSize) });
+					file->blockLookup[block] = file->blocks.begin();
+				}
+				index = endBlock - 1;
+			}
+
+			char* output = static_cast<char*>(buffer);
+			for (haddr_t index = firstBlock; index <= lastBlock; ++index)
+			{
+				auto block = file->blockLookup[index];
+				file->blocks.splice(file->blocks.begin(), file->blocks, block);
+				const haddr_t blockAddress = index * blockSize;
+				const haddr_t begin = std::max(address, blockAddress);
+				const haddr_t end = std::min<haddr_t>(address + size, blockAddress + blockSize);
+				std::memcpy(output + (begin - address), block->data.data() + (begin - blockAddress), static_cast<std::size_t>(end - begin));
+			}
+
+			// evict the least recently used blocks, the ones just used are in front
+			while (file->blocks.size() > file->config.cacheBlocks)
+			{
+				file->blockLookup.erase(file->blocks.back().index);
+				file->blocks.pop_back();
+			}
+
+			if (hit)
+				++counters.hits;
+			else
+				++counters.misses;
+			return 0;
+		}
+
+		herr_t coalescing_write(H5FD_t*, H5FD_mem_t, hid_t, haddr_t, size_t, const void*)
+		{
+			return -1;
+		}
+
+		H5FD_class_t coalescing_class()
+		{
+			H5FD_class_t driverClass;
+			std::memset(&driverClass, 0, sizeof(driverClass));
+#if H5_VERSION_GE(1, 13, 2)
+			driverClass.version = H5FD_CLASS_VERSION;
+			driverClass.value = static_cast<H5FD_class_value_t>(coalescing_driver_value);
+#endif
+			driverClass.name = "mv_coalescing";
+			driverClass.maxaddr = (static_cast<haddr_t>(1) << 62) - 1; // like sec2 with a 64 bit off_t
+			driverClass.fc_degree = H5F_CLOSE_WEAK;
+			driverClass.fapl_size = sizeof(CoalescingDriverInfo);
+			driverClass.fapl_get = coalescing_fapl_get;
+			driverClass.fapl_copy = coalescing_fapl_copy;
+			driverClass.fapl_free = coalescing_fapl_free;
+			driverClass.open = coalescing_open;
+			driverClass.close = coalescing_close;
+			driverClass.cmp = coalescing_cmp;
+			driverClass.query = coalescing_query;
+			driverClass.get_eoa = coalescing_get_eoa;
+			driverClass.set_eoa = coalescing_set_eoa;
+			driverClass.get_eof = coalescing_get_eof;
+			driverClass.get_handle = coalescing_get_handle;
+			driverClass.read = coalescing_read;
+			driverClass.write = coalescing_write;
+			const H5FD_mem_t freeListMap[H5FD_MEM_NTYPES] = H5FD_FLMAP_DICHOTOMY;
+			std::copy(freeListMap, freeListMap + H5FD_MEM_NTYPES, driverClass.fl_map);
+			return driverClass;
+		}
+	}
+
+	hid_t coalescing_driver_id()
+	{
+		static const hid_t driverId = []() -> hid_t
+		{
+			static const H5FD_class_t driverClass = local::coalescing_class();
+			return H5FDregister(&driverClass);
+		}();
+		return (driverId < 0) ? H5I_INVALID_HID : driverId;
+	}
+
+	bool set_coalescing_driver(H5::FileAccPropList& fapl, const CoalescingDriverConfig& config)
+	{
+		const hid_t driverId = coalescing_driver_id();
+		if (driverId == H5I_INVALID_HID)
+			return false;
+		if (H5Pget_driver(fapl.getId()) == driverId)
+			return true;
+
+		local::CoalescingDriverInfo info;
+		info.config = config;
+		info.underlyingFapl = H5Pcopy(fapl.getId());
+		const bool result = (H5Pset_driver(fapl.getId(), driverId, &info) >= 0);
+		H5Pclose(info.underlyingFapl);
+		return result;
+	}
+
+	CoalescingStatistics coalescing_statistics()
+	{
+		const local::CoalescingCounters& counters = local::coalescing_counters();
+		CoalescingStatistics result;
+		result.hits = counters.hits;
+		result.misses = counters.misses;
+		result.passthroughReads = counters.passthroughReads;
+		result.underlyingReads = counters.underlyingReads;
+		result.underlyingBytes = counters.underlyingBytes;
+		return result;
+	}
+
+	void reset_coalescing_statistics()
+	{
+		local::CoalescingCounters& counters = local::coalescing_counters();
+		counters.hits = 0;
+		counters.misses = 0;
+		counters.passthroughReads = 0;
+		counters.underlyingReads = 0;
+		counters.underlyingBytes = 0;
+	}
+}
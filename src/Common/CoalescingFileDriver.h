@@ -0,0 +1,41 @@
+#pragma once
+
+#include "H5Cpp.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace H5Utils
+{
+	struct CoalescingDriverConfig
+	{
+		std::size_t blockSize = 64 * 1024; // cache block size, reads of at least this size bypass the cache
+		unsigned windowBlocks = 4;         // consecutive uncached blocks fetched with one read on a miss
+		std::size_t cacheBlocks = 256;     // blocks kept in the LRU cache per file
+	};
+
+	struct CoalescingStatistics
+	{
+		std::uint64_t hits = 0;              // small reads served from the block cache
+		std::uint64_t misses = 0;            // small reads that needed the underlying driver
+		std::uint64_t passthroughReads = 0;  // large reads forwarded as is
+		std::uint64_t underlyingReads = 0;   // reads issued to the underlying driver
+		std::uint64_t underlyingBytes = 0;   // bytes read from the underlying driver
+	};
+
+	/*
+	* Read-only passthrough HDF5 virtual file driver that serves small reads from an LRU cache of aligned blocks.
+	* A miss fetches a window of consecutive blocks with one read of the underlying driver, so the many tiny,
+	* nearly adjacent reads of obs/var/uns metadata and short raw-data vectors become a few larger aligned ones.
+	* Unlike the HDF5 metadata cache this works on bytes, so it also catches small raw-data reads.
+	*/
+
+	hid_t coalescing_driver_id();
+
+	// Stacks the driver on top of the driver of fapl (sec2, io_uring, ...).
+	bool set_coalescing_driver(H5::FileAccPropList& fapl, const CoalescingDriverConfig& config = CoalescingDriverConfig());
+
+	// Counters summed over all files opened with the driver since the last reset.
+	CoalescingStatistics coalescing_statistics();
+	void reset_coalescing_statistics();
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <vector>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+/*
+* Metadata files hold hundreds of columns that were read, grouped into clusters and added to the dataset strictly one
+* after another. process_columns splits that work into three stages:
+*	read(index, column)		on the calling thread, one column after another since HDF5 calls are serialized;
+*							returns false to skip the column
+*	process(column)			classification, encoding and grouping, on the OpenMP threads with one dynamically
+*							scheduled column at a time, so a few expensive columns do not hold up the rest
+*	finish(index, column)	on the calling thread in column order, for everything that creates or changes datasets
+* The columns go through in batches of a few per thread. While the threads process a batch, the calling thread reads
+* the next one and joins the processing when it is done, so at most two batches of raw columns are held in memory.
+* An exception thrown by read or process is rethrown on the calling thread after the parallel part of the batch.
+*/
+
+namespace H5Utils
+{
+	// Number of columns per thread in a batch of process_columns.
+	constexpr std::size_t ColumnsPerThread = 4;
+
+	template<typename Column, typename Read, typename Process, typename Finish>
+	void process_columns(std::size_t count, Read read, Process process, Finish finish)
+	{
+		if (count == 0)
+			return;
+#if defined(_OPENMP)
+		const std::size_t batchSize = ColumnsPerThread * static_cast<std::size_t>(std::max(1, omp_get_max_threads()));
+#else
+		const std::size_t batchSize = ColumnsPerThread;
+#endif
+
+		struct Batch
+		{
+			std::size_t first = 0;
+			std::vector<Column> columns;
+			std::vector<char> valid;
+		};
+
+		auto readBatch = [count, batchSize, &read](std::size_t first, Batch& batch)
+		{
+			MV_H5_TRACE_SCOPE("process_columns read");
+			const std::size_t size = std::min(batchSize, count - first);
+			batch.first = first;
+			batch.columns.clear();
+			batch.columns.resize(size);
+			batch.valid.assign(size, 0);
+			for (std::size_t c = 0; c < size; ++c)
+				batch.valid[c] = read(first + c, batch.columns[c]) ? 1 : 0;
+		};
+
+		Batch current;
+		Batch next;
+		readBatch(0, current);
+		while (!current.columns.empty())
+		{
+			const std::size_t nextFirst = current.first + current.columns.size();
+			next.columns.clear();
+
+			// exceptions must not leave the parallel region, they are rethrown after it
+			std::exception_ptr readException;
+			std::vector<std::exception_ptr> processExceptions(current.columns.size());
+			const std::int64_t size = static_cast<std::int64_t>(current.columns.size());
+			#pragma omp parallel
+			{
+				#pragma omp master
+				{
+					try
+					{
+						if (nextFirst < count)
+							readBatch(nextFirst, next);
+					}
+					catch (...)
+					{
+						readException = std::current_exception();
+					}
+				}
+				MV_H5_TRACE_SCOPE("process_columns worker");
+				#pragma omp for schedule(dynamic,1) nowait
+				for (std::int64_t c = 0; c < size; ++c)
+				{
+					try
+					{
+						if (current.valid[c])
+							process(current.columns[c]);
+					}
+					catch (...)
+					{
+						processExceptions[c] = std::current_exception();
+					}
+				}
+			}
+			for (const auto& exception : processExceptions)
+			{
+				if (exception)
+					std::rethrow_exception(exception);
+			}
+
+			{
+				MV_H5_TRACE_SCOPE("process_columns finish");
+				for (std::size_t c = 0; c < current.columns.size(); ++c)
+				{
+					if (current.valid[c])
+						finish(current.first + c, current.columns[c]);
+				}
+			}
+			// the batches before the one that could not be read are finished before rethrowing
+			if (readException)
+				std::rethrow_exception(readException);
+			std::swap(current, next);
+		}
+	}
+}
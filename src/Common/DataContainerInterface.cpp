@@ -3,7 +3,12 @@
 #include <DataHierarchyItem.h>
 #include <Plugin.h>
 
+#include "RowBlockReader.h"
 #include "H5Utils.h"
+#include "MatrixDecoder.h"
+#include "ProgressCounter.h"
+#include "SparseKernels.h"
+#include "ValueKernels.h"
 #include "VectorHolder.h"
 
 #include <QInputDialog>
@@ -22,6 +27,8 @@
 #include <numeric>
 #include <algorithm>
 #include <cassert>
+#include <functional>
+#include <memory>
 #include <utility>
 
 #if defined(_OPENMP)
@@ -67,95 +74,68 @@ namespace local
 	class Progress
 	{
 		mv::DataHierarchyItem& dataHierarcyItem;
+		H5Utils::ProgressCounter counter;
 
 	public:
 		Progress(mv::DataHierarchyItem& item, const QString& taskName, std::size_t nrOfSteps)
 			:dataHierarcyItem(item)
+			,counter(nrOfSteps, [&item](float progress) { item.getDataset()->getTask().setProgress(progress); })
 		{
 			auto& task = dataHierarcyItem.getDataset()->getTask();
 			
 			task.setName(taskName);
 			task.setProgressDescription(taskName);
 			task.setRunning();
-			task.setSubtasks(nrOfSteps);
 		}
 
-		void setStep(std::size_t step)
+		// steps more are done, from any thread
+		void step(std::uint64_t steps = 1)
 		{
-#if defined(_OPENMP)
-			if(omp_get_thread_num() == 0)
-				dataHierarcyItem.getDataset()->getTask().setSubtaskFinished(step);
-#endif
+			counter.add(steps);
 		}
 
 		~Progress()
 		{
+			counter.finish();
 			dataHierarcyItem.getDataset()->getTask().setFinished();
 		}
 	};
 
-	template<typename T1, typename T2, typename T3>
-	void set_sparse_row_data_impl(Dataset<Points> m_data, std::vector<T1>& column_index, std::vector<T2>& row_offset, std::vector<T3>& data, TRANSFORM::Type transformType)
+	// Fills the rows of blocks [firstBlock, lastBlock) of a row block reader, the points must hold these rows.
+	void set_row_blocks(Dataset<Points> m_data, const H5Utils::RowBlockReader& reader, const std::vector<std::ptrdiff_t>& columnLUT, TRANSFORM::Type transformType, std::uint64_t firstBlock, std::uint64_t lastBlock, Progress& progress)
 	{
-		static_assert(!std::is_same<T3, std::int64_t>::value, "");
-		static_assert(!std::is_same<T3, std::uint64_t>::value, "");
-
-		std::int64_t lrows = local::safe_numeric_cast<std::int64_t>(m_data->getNumPoints());
-		auto columns = m_data->getNumDimensions();
-
-		local::Progress progress(m_data->getDataHierarchyItem(), "Loading Data", lrows);
-		m_data->visitFromBeginToEnd([&column_index, &row_offset, &data, transformType, lrows, columns, &progress](const auto beginOfData, const auto endOfData)
+		const std::uint64_t columns = m_data->getNumDimensions();
+		m_data->visitFromBeginToEnd([&reader, &columnLUT, transformType, columns, firstBlock, lastBlock, &progress](const auto beginOfData, const auto endOfData)
 			{
-				#pragma omp parallel for schedule(dynamic,1)
-				for (std::int64_t row = 0; row < lrows; ++row)
+				for (std::uint64_t block = firstBlock; block < lastBlock; ++block)
 				{
-					uint64_t start = row_offset[row];
-					uint64_t end = row_offset[row + 1];
-					uint64_t points_offset = row * columns;
-
-					for (uint64_t i = start; i < end; ++i)
-					{
-						
-						uint64_t column = column_index[i];
-						if (column < columns)
+					const H5Utils::RowBlock rowBlock = reader.block(block);
+					const std::int64_t rows = local::safe_numeric_cast<std::int64_t>(rowBlock.rows());
+
+					H5Utils::parallel_for_nnz_ranges(rowBlock.indptr, rows, "set_row_blocks worker", [&](std::int64_t rowBegin, std::int64_t rowEnd)
 						{
-							double value = data[i];
-							if (value != 0)
+							for (std::int64_t row = rowBegin; row < rowEnd; ++row)
 							{
-								switch (transformType.first)
+								const std::uint64_t points_offset = (rowBlock.firstRow + row) * columns;
+								for (std::uint64_t i = rowBlock.indptr[row]; i < rowBlock.indptr[row + 1]; ++i)
 								{
-								case TRANSFORM::NONE: beginOfData[points_offset + column] = value; break;
-								case TRANSFORM::LOG:  beginOfData[points_offset + column] = log2(1 + value); break;
-								case TRANSFORM::ARCSIN5: beginOfData[points_offset + column] = asinh(value / 5.0); break;
-								case TRANSFORM::SQRT: beginOfData[points_offset + column] = sqrt(value); break;
+									std::uint64_t column = rowBlock.indices[i];
+									if (!columnLUT.empty())
+									{
+										if ((column >= columnLUT.size()) || (columnLUT[column] < 0))
+											continue;
+										column = columnLUT[column];
+									}
+									const float value = rowBlock.values[i];
+									if ((column < columns) && (value != 0))
+										beginOfData[points_offset + column] = H5Utils::transform_value(value, transformType);
 								}
 							}
-						}
-					}
-					progress.setStep(row);
-
+						});
+					progress.step();
 				}
 			});
 	}
-
-	template<typename T1, typename T2>
-	void set_sparse_row_data_T2(mv::Dataset<Points> dataset, std::vector<T1>& column_index, std::vector<T2>& row_offset, H5Utils::VectorHolder& data, TRANSFORM::Type transformType)
-	{
-		
-		data.visit([&dataset, &column_index, &row_offset, transformType](auto& vec)
-		{
-			return set_sparse_row_data_impl(dataset, column_index, row_offset, vec, transformType);
-		});
-	}
-
-	template<typename T1>
-	void set_sparse_row_data_T1(mv::Dataset<Points> dataset, std::vector<T1>& column_index, H5Utils::VectorHolder& row_offset, H5Utils::VectorHolder& data, TRANSFORM::Type transformType)
-	{
-		row_offset.visit([dataset, &column_index, &data, transformType](auto& vec)
-		{
-			return set_sparse_row_data_T2(dataset, column_index, vec, data, transformType);
-		});
-	}
 }
 
 
@@ -166,174 +146,148 @@ DataContainerInterface::DataContainerInterface(Dataset<Points> points) :
 	
 }
 
-void DataContainerInterface::resize(RowID rows, ColumnID columns, std::size_t reserveSize /*= 0*/)
+bool DataContainerInterface::resize(RowID rows, ColumnID columns, std::size_t reserveSize /*= 0*/)
 {
 	if (m_data->getNumPoints() ==0)
 	{
 		try
 		{
+			// Points can only allocate zero initialized values, which this thread first touches. Once ManiVault can hand
+			// out uninitialized points the loaders can use the zeroFill mode of the kernels in SparseKernels.h instead.
 			m_data->setData(nullptr, rows, columns);
 		}
 		catch(const std::bad_alloc &)
 		{
 			qDebug() << "Bad Allocation in setData: " << rows << " x " << columns;
+			return false;
 		}
 			
 		qDebug() << "Number of dimensions: " << m_data->getNumDimensions();
 		qDebug() << "Number of data points: " << m_data->getNumPoints();		
+		trackDenseMatrix();
 	}
+	return true;
 }
 
 
-void DataContainerInterface::set_sparse_row_data(std::vector<uint64_t>& column_index, std::vector<uint32_t>& row_offset, std::vector<std::int8_t>& data, TRANSFORM::Type transformType)
-{
-	local::set_sparse_row_data_impl<uint64_t, uint32_t, std::int8_t>(this->m_data, column_index, row_offset, data, transformType);
-}
-void DataContainerInterface::set_sparse_row_data(std::vector<uint64_t>& column_index, std::vector<uint32_t>& row_offset, std::vector<std::int16_t>& data, TRANSFORM::Type transformType)
-{
-	local::set_sparse_row_data_impl<uint64_t, uint32_t, std::int16_t>(this->m_data, column_index, row_offset, data, transformType);
-}
-/*
-void DataContainerInterface::set_sparse_row_data(std::vector<uint64_t>& column_index, std::vector<uint32_t>& row_offset, std::vector<std::int32_t>& data, TRANSFORM::Type transformType)
-{
-	static_assert(false);
-	local::set_sparse_row_data_impl<uint64_t, uint32_t, std::int32_t>(this->m_data, column_index, row_offset, data, transformType);
-}
-*/
-void DataContainerInterface::set_sparse_row_data(std::vector<uint64_t>& column_index, std::vector<uint32_t>& row_offset, std::vector<std::uint8_t>& data, TRANSFORM::Type transformType)
+bool DataContainerInterface::grow(RowID rows, ColumnID columns)
 {
-	local::set_sparse_row_data_impl<uint64_t, uint32_t, std::uint8_t>(this->m_data, column_index, row_offset, data, transformType);
-}
-void DataContainerInterface::set_sparse_row_data(std::vector<uint64_t>& column_index, std::vector<uint32_t>& row_offset, std::vector<std::uint16_t>& data, TRANSFORM::Type transformType)
-{
-	local::set_sparse_row_data_impl<uint64_t, uint32_t, std::uint16_t>(this->m_data, column_index, row_offset, data, transformType);
-}
-/*
-void DataContainerInterface::set_sparse_row_data(std::vector<uint64_t>& column_index, std::vector<uint32_t>& row_offset, std::vector<std::uint32_t>& data, TRANSFORM::Type transformType)
-{
-	static_assert(false);
-	local::set_sparse_row_data_impl<uint64_t, uint32_t, std::uint32_t>(this->m_data, column_index, row_offset, data, transformType);
-}
-*/
-void DataContainerInterface::set_sparse_row_data(std::vector<uint64_t> &column_index, std::vector<uint32_t> &row_offset, std::vector<float> &data, TRANSFORM::Type transformType)
-{
-	local::set_sparse_row_data_impl<uint64_t, uint32_t, float>(this->m_data, column_index, row_offset, data, transformType);
+	const RowID oldRows = m_data->getNumPoints();
+	if (oldRows == 0)
+		return resize(rows, columns);
+	if (rows <= oldRows)
+		return true;
+
+	// Points cannot be resized in place, the values are moved to a larger vector that replaces them
+	bool result = true;
+	std::function<void()> replaceData;
+	m_data->visitFromBeginToEnd([this, rows, columns, &result, &replaceData](const auto beginOfData, const auto endOfData)
+		{
+			typedef std::decay_t<decltype(*beginOfData)> T;
+			auto values = std::make_shared<std::vector<T>>();
+			try
+			{
+				values->reserve(rows * columns);
+				values->assign(beginOfData, endOfData);
+				values->resize(rows * columns);
+			}
+			catch (const std::bad_alloc&)
+			{
+				qDebug() << "Bad Allocation in grow: " << rows << " x " << columns;
+				result = false;
+				return;
+			}
+			replaceData = [this, values, columns]() { m_data->setData(std::move(*values), columns); };
+		});
+	if (result && replaceData)
+	{
+		replaceData();
+		trackDenseMatrix();
+	}
+	return result;
 }
-void DataContainerInterface::set_sparse_row_data(std::vector<uint64_t>& column_index, std::vector<uint32_t>& row_offset, std::vector<biovault::bfloat16_t>& data, TRANSFORM::Type transformType)
+
+void DataContainerInterface::trackDenseMatrix()
 {
-	local::set_sparse_row_data_impl<uint64_t, uint32_t, biovault::bfloat16_t>(this->m_data, column_index, row_offset, data, transformType);
+	m_data->visitFromBeginToEnd([this](const auto beginOfData, const auto endOfData)
+		{
+			m_denseMatrix.setBytes(static_cast<std::uint64_t>(endOfData - beginOfData) * sizeof(*beginOfData));
+		});
 }
 
-
-void DataContainerInterface::set_sparse_row_data(H5Utils::VectorHolder& column_index, H5Utils::VectorHolder& row_offset, H5Utils::VectorHolder& data, TRANSFORM::Type transformType)
+template<typename T>
+bool DataContainerInterface::set_sparse_data(const H5Utils::CompressedMatrix& matrix, const std::vector<T>& values, TRANSFORM::Type transformType, bool accumulate /*= false*/)
 {
-	mv::Dataset<Points> dataset = m_data;
-	column_index.visit([dataset, &row_offset, &data, transformType](auto& vec)
+	if ((matrix.rows != m_data->getNumPoints()) || (matrix.columns != m_data->getNumDimensions()) || (values.size() != matrix.nnz()))
 	{
-		return local::set_sparse_row_data_T1(dataset, vec, row_offset, data, transformType);
-	});
-}
-
+		qDebug() << "Sparse matrix of" << matrix.rows << "x" << matrix.columns << "does not match the points";
+		return false;
+	}
 
-void DataContainerInterface::increase_sparse_row_data(std::vector<uint64_t> &column_index, std::vector<uint32_t> &row_offset, std::vector<float> &data, TRANSFORM::Type transformType)
-{
-	
-	std::int64_t lrows = local::safe_numeric_cast<std::int64_t>(m_data->getNumPoints());
-	auto columns = m_data->getNumDimensions();
-	local::Progress progress(m_data->getDataHierarchyItem(), "Loading Data", lrows);
-	m_data->visitFromBeginToEnd([&column_index, &row_offset, &data, transformType, lrows, columns, &progress](const auto beginOfData, const auto endOfData)
+	local::Progress progress(m_data->getDataHierarchyItem(), "Loading Data", matrix.rows);
+	const auto step = [&progress](std::uint64_t steps) { progress.step(steps); };
+	m_data->visitFromBeginToEnd([&matrix, &values, transformType, accumulate, &step](const auto beginOfData, const auto endOfData)
 		{
-#pragma omp parallel for
-			for (std::int64_t row = 0; row < lrows; ++row)
-			{
-				uint64_t start = row_offset[row];
-				uint64_t end = row_offset[row + 1];
-				uint64_t points_offset = row * columns;
-
-				for (uint64_t i = start; i < end; ++i)
-				{
-					float value = data[i];
-					uint64_t column = column_index[i];
-					if (value != 0)
-					{
-						switch (transformType.first)
-						{
-						case TRANSFORM::NONE: beginOfData[points_offset + column] += value; break;
-						case TRANSFORM::LOG:  beginOfData[points_offset + column] += log2(1 + value); break;
-						case TRANSFORM::ARCSIN5: beginOfData[points_offset + column] += asinh(value / 5.0); break;
-						case TRANSFORM::SQRT: beginOfData[points_offset + column] += sqrt(value); break;
-						}
-					}
-				}
-				progress.setStep(row);
-			}
-			
+			if (accumulate)
+				H5Utils::scatter_compressed_matrix<true>(beginOfData, matrix, values, transformType, step);
+			else
+				H5Utils::scatter_compressed_matrix<false>(beginOfData, matrix, values, transformType, step);
 		});
+	return true;
 }
 
-void DataContainerInterface::set_sparse_column_data(std::vector<uint64_t> &row_index, std::vector<uint32_t> &column_offset, std::vector<float> &data, TRANSFORM::Type transformType /*= TRANSFORM::NONE*/)
+template bool DataContainerInterface::set_sparse_data(const H5Utils::CompressedMatrix&, const std::vector<float>&, TRANSFORM::Type, bool);
+template bool DataContainerInterface::set_sparse_data(const H5Utils::CompressedMatrix&, const std::vector<biovault::bfloat16_t>&, TRANSFORM::Type, bool);
+template bool DataContainerInterface::set_sparse_data(const H5Utils::CompressedMatrix&, const std::vector<std::int16_t>&, TRANSFORM::Type, bool);
+template bool DataContainerInterface::set_sparse_data(const H5Utils::CompressedMatrix&, const std::vector<std::uint16_t>&, TRANSFORM::Type, bool);
+template bool DataContainerInterface::set_sparse_data(const H5Utils::CompressedMatrix&, const std::vector<std::int8_t>&, TRANSFORM::Type, bool);
+template bool DataContainerInterface::set_sparse_data(const H5Utils::CompressedMatrix&, const std::vector<std::uint8_t>&, TRANSFORM::Type, bool);
+
+bool DataContainerInterface::set_sparse_data(const H5Utils::CompressedMatrix& matrix, H5Utils::VectorHolder& values, TRANSFORM::Type transformType, bool accumulate /*= false*/)
 {
-	const std::int64_t columns = local::safe_numeric_cast<std::int64_t>(m_data->getNumDimensions());
-	local::Progress progress(m_data->getDataHierarchyItem(), "Loading Data", columns);
-	m_data->visitFromBeginToEnd([&column_offset, &row_index, &data, transformType, columns, &progress](const auto beginOfData, const auto endOfData)
+	return values.visit<bool>([this, &matrix, transformType, accumulate](const auto& vec)
 		{
-			#pragma  omp parallel for
-			for (std::int64_t column = 0; column < columns; ++column)
-			{
-				const auto start = column_offset[column];
-				const auto end = column_offset[column + 1];
-				for (auto i = start; i < end; ++i)
-				{
-					uint64_t r = row_index[i];
-					float value = data[i];
-					if (value != 0)
-					{
-						switch (transformType.first)
-						{
-						case TRANSFORM::NONE: beginOfData[(r*columns) + column] = value; break;
-						case TRANSFORM::LOG:  beginOfData[(r*columns) + column] = log2(1 + value); break;
-						case TRANSFORM::ARCSIN5:beginOfData[(r*columns) + column] = asinh(value / 5.0); break;
-						case TRANSFORM::SQRT: beginOfData[(r*columns) + column] = sqrt(value); break;
-						}
-					}
-				}
-				progress.setStep(column);
-			}
-			
+			return set_sparse_data(matrix, vec, transformType, accumulate);
 		});
 }
 
-void DataContainerInterface::increase_sparse_column_data(std::vector<uint64_t> &row_index, std::vector<uint32_t> &column_offset, std::vector<float> &data, TRANSFORM::Type transformType /*= TRANSFORM::NONE*/)
-
+bool DataContainerInterface::set_row_block_data(const H5Utils::RowBlockReader& reader, const std::vector<std::ptrdiff_t>& columnLUT, TRANSFORM::Type transformType)
 {
-	const std::int64_t columns = local::safe_numeric_cast<std::int64_t>(m_data->getNumDimensions());
-	local::Progress progress(m_data->getDataHierarchyItem(), "Loading Data", columns);
-	m_data->visitFromBeginToEnd([&row_index, &column_offset, &data, transformType, columns, &progress](const auto beginOfData, const auto endOfData)
-		{
-		    #pragma  omp parallel for
-			for (std::int64_t column = 0; column < columns; ++column)
-			{
-				const auto start = column_offset[column];
-				const auto end = column_offset[column + 1];
-				for (auto i = start; i < end; ++i)
-				{
-					uint64_t r = row_index[i];
-					float value = data[i];
-					if (value != 0)
-					{
-						switch (transformType.first)
-						{
-						case TRANSFORM::NONE: beginOfData[(r*columns) + column] += value; break;
-						case TRANSFORM::LOG:  beginOfData[(r*columns) + column] += log2(1 + value); break;
-						case TRANSFORM::ARCSIN5:beginOfData[(r*columns) + column] += asinh(value / 5.0); break;
-						case TRANSFORM::SQRT: beginOfData[(r*columns) + column] += sqrt(value); break;
+	if (m_data->getNumPoints() != reader.rows())
+		return false;
 
-						}
-					}
-				}
-				progress.setStep(column);
-			}
-		});
+	local::Progress progress(m_data->getDataHierarchyItem(), "Loading Data", reader.blockCount());
+	local::set_row_blocks(m_data, reader, columnLUT, transformType, 0, reader.blockCount(), progress);
+	return true;
+}
+
+bool DataContainerInterface::set_row_block_data_progressively(const H5Utils::RowBlockReader& reader, const std::vector<std::ptrdiff_t>& columnLUT, TRANSFORM::Type transformType, ColumnID columns, const std::function<void(RowID)>& rowsLoaded)
+{
+	const std::uint64_t nrOfBlocks = reader.blockCount();
+	local::Progress progress(m_data->getDataHierarchyItem(), "Loading Data", nrOfBlocks);
+
+	// the steps halve the blocks from all of them down to one, so every growth is to at most twice the rows loaded
+	// so far: the rows are copied at most twice in total, and the old values held during the last growth are at most
+	// half of the matrix (LoadStrategy::Progressive)
+	std::vector<std::uint64_t> steps;
+	for (std::uint64_t blocks = nrOfBlocks; blocks > 1; blocks = (blocks + 1) / 2)
+		steps.push_back(blocks);
+	steps.push_back(1);
+	std::reverse(steps.begin(), steps.end());
+
+	std::uint64_t block = 0;
+	for (const std::uint64_t lastBlock : steps)
+	{
+		if (lastBlock > nrOfBlocks)
+			break;
+		const RowID rows = std::min(reader.rows(), lastBlock * reader.blockRows());
+		if (!grow(rows, columns))
+			return false;
+		local::set_row_blocks(m_data, reader, columnLUT, transformType, block, lastBlock, progress);
+		block = lastBlock;
+		rowsLoaded(rows);
+	}
+	return true;
 }
 
 void DataContainerInterface::applyTransform(TRANSFORM::Type transformType, bool normalized_and_cpm)
@@ -345,31 +299,7 @@ void DataContainerInterface::applyTransform(TRANSFORM::Type transformType, bool
 	local::Progress progress(m_data->getDataHierarchyItem(), "Processing Data", rows);
 	m_data->visitFromBeginToEnd([transformType, rows, columns, &progress](const auto beginOfData, const auto endOfData)
 		{
-#pragma omp parallel for
-			for (std::int64_t row = 0; row < rows; ++row)
-			{
-				uint64_t offset = row * columns;
-				auto *rowdata = &(beginOfData[offset]);
-				double dummy = 0.0;
-				double sum = std::accumulate(rowdata, rowdata + columns, dummy);
-				for (auto *i = rowdata; i != rowdata + columns; ++i)
-				{
-					const DataValue value = *i;
-					if (value != 0)
-					{
-						const DataValue normalized_cpm_value = (sum == 0) ? 0 : 1e6 * (value / sum);
-						switch (transformType.first)
-						{
-						case TRANSFORM::NONE: *i = normalized_cpm_value; break;
-						case TRANSFORM::LOG: *i = log2(1 + normalized_cpm_value); break;
-						case TRANSFORM::ARCSIN5: *i = asinh(normalized_cpm_value / 5.0); break;
-						case TRANSFORM::SQRT: *i = sqrt(normalized_cpm_value); break;
-						}
-					}
-				}
-
-				progress.setStep(row);
-			}
+			H5Utils::normalize_and_transform_rows(beginOfData, rows, columns, transformType, [&progress](std::uint64_t steps) { progress.step(steps); });
 		});
 }
 
@@ -412,7 +342,7 @@ void DataContainerInterface::addRow(RowID row, const std::vector<uint32_t> &colu
 		});
 }
 
-void DataContainerInterface::add(std::vector<uint32_t> *rows, std::vector<uint32_t> *columns, std::vector<float> *data, TRANSFORM::Type transformType)
+void DataContainerInterface::add(std::vector<uint64_t> *rows, std::vector<uint32_t> *columns, std::vector<float> *data, TRANSFORM::Type transformType)
 {
 	auto m_rows = m_data->getNumPoints();
 	if ((m_rows + 1) != rows->size())
@@ -422,34 +352,10 @@ void DataContainerInterface::add(std::vector<uint32_t> *rows, std::vector<uint32
 		
 	}
 	std::int64_t lrows = local::safe_numeric_cast<std::int64_t>(m_rows);
-	#pragma omp parallel for
-	for (std::int64_t row = 0; row < lrows; ++row)
-	{
-		uint32_t start = (*rows)[row];
-		uint32_t end = (*rows)[row + 1];
-		const std::uint64_t points_offset = row * m_data->getNumDimensions();
-
-		m_data->visitFromBeginToEnd([columns, data, transformType, start, end, points_offset](const auto beginOfData, const auto endOfData)
-			{
-				const float* data_ptr = data->data();
-				const float* d = data_ptr + start;
-				const uint32_t* column_ptr = columns->data();
-				for (const uint32_t* i = column_ptr + start; i != column_ptr + end; ++i, ++d)
-				{
-					float value = *d;
-					auto column = *i;
-					if (value != 0)
-					{
-						switch (transformType.first)
-						{
-						case TRANSFORM::NONE: beginOfData[points_offset + column] = value; break;
-						case TRANSFORM::LOG:  beginOfData[points_offset + column] = log2(1 + value); break;
-						case TRANSFORM::ARCSIN5: beginOfData[points_offset + column] = asinh(value / 5.0); break;
-						case TRANSFORM::SQRT: beginOfData[points_offset + column] = sqrt(value); break;
-						}
-					}
-				}
-			});
-	}
+	const std::uint64_t dimensions = m_data->getNumDimensions();
+	m_data->visitFromBeginToEnd([rows, columns, data, transformType, lrows, dimensions](const auto beginOfData, const auto endOfData)
+		{
+			H5Utils::scatter_sparse_rows<false>(beginOfData, lrows, dimensions, *columns, *rows, *data, transformType, [](std::uint64_t) {});
+		});
 }
 
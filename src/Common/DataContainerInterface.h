@@ -4,8 +4,17 @@
 #include "DataTransform.h"
 #include "Dataset.h"
 
+#include "MemoryTracker.h"
 #include "VectorHolder.h"
 
+#include <functional>
+
+namespace H5Utils
+{
+	struct CompressedMatrix;
+	class RowBlockReader;
+}
+
 typedef std::uint64_t DataPointID;
 typedef std::uint64_t MarkerID;
 typedef float DataValue;
@@ -19,6 +28,9 @@ public:
 
 private:
 	mv::Dataset<Points>		m_data;
+	H5Utils::TrackedBuffer	m_denseMatrix{ "dense matrix" }; // size of the values after resize or grow
+
+	void trackDenseMatrix();
 	
 public:
 	void applyTransform(TRANSFORM::Type transformType, bool normalized_and_cpm);
@@ -36,32 +48,34 @@ public:
 // 	void setRow(RowID row, const RowVector &rowVector);
 	
 
- 	void add(std::vector<uint32_t> *rows, std::vector<uint32_t> *columns, std::vector<float> *data, TRANSFORM::Type transformType);
+ 	void add(std::vector<uint64_t> *rows, std::vector<uint32_t> *columns, std::vector<float> *data, TRANSFORM::Type transformType);
 // 	void increase(std::vector<uint32_t> *rows, std::vector<uint32_t> *columns, std::vector<float> *data, TRANSFORM::Type transformType);
 // 
 // 	void addDataPtr(const float * const data, bool normalized_cpm, TRANSFORM::Type transformType);
  	void addRow(RowID row, const std::vector<uint32_t> &columns, const std::vector<float> &data, TRANSFORM::Type transformType);
 
-	void set_sparse_column_data(std::vector<uint64_t> &i, std::vector<uint32_t> &p, std::vector<float> &x, TRANSFORM::Type transformType);
-	void increase_sparse_column_data(std::vector<uint64_t> &i, std::vector<uint32_t> &p, std::vector<float> &x, TRANSFORM::Type transformType);
+	// Scatters the values of a compressed sparse matrix, read by H5Utils::read_compressed_matrix, into the (resized) points,
+	// with the same kernels as H5Utils::decode_matrix. accumulate adds them to the values already there. Returns false if
+	// the shape of the matrix differs from the points.
+	template<typename T>
+	bool set_sparse_data(const H5Utils::CompressedMatrix& matrix, const std::vector<T>& values, TRANSFORM::Type transformType, bool accumulate = false);
+	bool set_sparse_data(const H5Utils::CompressedMatrix& matrix, H5Utils::VectorHolder& values, TRANSFORM::Type transformType, bool accumulate = false);
 
-	void set_sparse_row_data(std::vector<uint64_t>& i, std::vector<uint32_t>& p, std::vector<std::int8_t>& x, TRANSFORM::Type transformType);
-	void set_sparse_row_data(std::vector<uint64_t>& i, std::vector<uint32_t>& p, std::vector<std::int16_t>& x, TRANSFORM::Type transformType);
-	//void set_sparse_row_data(std::vector<uint64_t>& i, std::vector<uint32_t>& p, std::vector<std::int32_t>& x, TRANSFORM::Type transformType);
+	// Fills the (resized) points block by block from a row block reader, so the sparse source is never held as a whole.
+	// columnLUT maps the matrix columns to the points dimensions (negative skips a column), empty keeps all columns.
+	bool set_row_block_data(const H5Utils::RowBlockReader& reader, const std::vector<std::ptrdiff_t>& columnLUT, TRANSFORM::Type transformType);
 
-	void set_sparse_row_data(std::vector<uint64_t>& i, std::vector<uint32_t>& p, std::vector<std::uint8_t>& x, TRANSFORM::Type transformType);
-	void set_sparse_row_data(std::vector<uint64_t>& i, std::vector<uint32_t>& p, std::vector<std::uint16_t>& x, TRANSFORM::Type transformType);
-	//void set_sparse_row_data(std::vector<uint64_t>& i, std::vector<uint32_t>& p, std::vector<std::uint32_t>& x, TRANSFORM::Type transformType);
+	// Like set_row_block_data, but starts from empty points and grows them with the rows loaded so far, to at most
+	// twice the rows every step; the peak is LoadStrategy::Progressive. rowsLoaded is called after every step, so the
+	// loaded rows can be shown while the rest loads.
+	bool set_row_block_data_progressively(const H5Utils::RowBlockReader& reader, const std::vector<std::ptrdiff_t>& columnLUT, TRANSFORM::Type transformType, ColumnID columns, const std::function<void(RowID)>& rowsLoaded);
 
-	void set_sparse_row_data(std::vector<uint64_t> &i, std::vector<uint32_t> &p, std::vector<float> &x, TRANSFORM::Type transformType);
-	void set_sparse_row_data(std::vector<uint64_t>& i, std::vector<uint32_t>& p, std::vector<biovault::bfloat16_t>& x, TRANSFORM::Type transformType);
-	void set_sparse_row_data(H5Utils::VectorHolder& i, H5Utils::VectorHolder& p, H5Utils::VectorHolder& x, TRANSFORM::Type transformType);
-	
 	
-	void increase_sparse_row_data(std::vector<uint64_t> &i, std::vector<uint32_t> &p, std::vector<float> &x, TRANSFORM::Type transformType);
+	// Returns false if the dense matrix could not be allocated.
+	bool resize(RowID rows, ColumnID columns, std::size_t reserveSize = 0);
 
-	
-	void resize(RowID rows, ColumnID columns, std::size_t reserveSize = 0);
+	// Adds zero rows and keeps the values of the existing rows. Returns false if the larger matrix could not be allocated.
+	bool grow(RowID rows, ColumnID columns);
 	
 
 };
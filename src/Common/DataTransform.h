@@ -1,5 +1,7 @@
 #pragma once
 
+#include "TransformType.h"
+
 #include <QObject>
 
 #include <utility>
@@ -13,10 +15,6 @@ class QGridLayout;
 
 namespace TRANSFORM
 {
-	typedef enum { NONE, LOG, SQRT, ARCSIN5} Index;
-	typedef std::pair<Index, double> Type;
-	inline Type None() { return std::make_pair(NONE, 0.0f); }
-
 	class Control : public QObject
 	{
 		Q_OBJECT
@@ -0,0 +1,158 @@
+#include "FileAccess.h"
+
+#include "CoalescingFileDriver.h"
+#include "LoadPlanner.h"
+#include "UringFileDriver.h"
+
+#include <QFileInfo>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+namespace H5Utils
+{
+	namespace local
+	{
+		// initial and maximum size of the metadata cache, the default is 2 MB initial and 32 MB maximum
+		constexpr std::size_t metadata_cache_initial_size = 16 * 1024 * 1024;
+		constexpr std::size_t metadata_cache_max_size = 128 * 1024 * 1024;
+		constexpr std::size_t sieve_buffer_size = 4 * 1024 * 1024;
+		constexpr std::size_t metadata_block_size = 1024 * 1024;
+		constexpr std::size_t page_buffer_size = 64 * 1024 * 1024;
+		constexpr std::size_t core_increment = 64 * 1024 * 1024;
+
+		void set_large_metadata_cache(H5::FileAccPropList& fapl)
+		{
+			H5AC_cache_config_t config;
+			config.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+			if (H5Pget_mdc_config(fapl.getId(), &config) < 0)
+				return;
+			config.set_initial_size = true;
+			config.initial_size = metadata_cache_initial_size;
+			config.max_size = std::max(config.max_size, metadata_cache_max_size);
+			config.min_size = std::min(config.min_size, config.initial_size);
+			H5Pset_mdc_config(fapl.getId(), &config);
+		}
+	}
+
+	QString file_access_profile_name(FileAccessProfile profile)
+	{
+		switch (profile)
+		{
+		case FileAccessProfile::Automatic: return "Automatic";
+		case FileAccessProfile::Default: return "Default";
+		case FileAccessProfile::InMemory: return "In memory";
+		case FileAccessProfile::PageBuffered: return "Page buffered";
+		case FileAccessProfile::ParallelRead: return "Parallel reads (io_uring)";
+		case FileAccessProfile::Coalescing: return "Read coalescing";
+		}
+		return QString();
+	}
+
+	std::vector<FileAccessProfile> available_file_access_profiles()
+	{
+		std::vector<FileAccessProfile> result = { FileAccessProfile::Automatic, FileAccessProfile::Default, FileAccessProfile::Coalescing, FileAccessProfile::InMemory, FileAccessProfile::PageBuffered };
+		if (uring_driver_available())
+			result.push_back(FileAccessProfile::ParallelRead);
+		return result;
+	}
+
+	hsize_t file_space_page_size(const QString& fileName)
+	{
+		hsize_t pageSize = 0;
+#if H5_VERSION_GE(1, 10, 1)
+		try
+		{
+			H5::H5File file(fileName.toLatin1().constData(), H5F_ACC_RDONLY);
+			H5::FileCreatPropList fcpl = file.getCreatePlist();
+			H5F_fspace_strategy_t strategy;
+			hbool_t persist = false;
+			hsize_t threshold = 0;
+			if ((H5Pget_file_space_strategy(fcpl.getId(), &strategy, &persist, &threshold) >= 0) && (strategy == H5F_FSPACE_STRATEGY_PAGE))
+				H5Pget_file_space_page_size(fcpl.getId(), &pageSize);
+		}
+		catch (const H5::Exception&)
+		{
+			pageSize = 0;
+		}
+#endif
+		return pageSize;
+	}
+
+	FileAccessProfile choose_file_access_profile(const QString& fileName, FileAccessProfile profile, std::uint64_t memoryBudget)
+	{
+		if (profile == FileAccessProfile::ParallelRead)
+			return uring_driver_available() ? profile : FileAccessProfile::Coalescing;
+		if (profile != FileAccessProfile::Automatic)
+			return profile;
+
+		// the file image has to fit next to the data that is loaded from it, so only use a quarter of the budget
+		const std::uint64_t fileSize = QFileInfo(fileName).size();
+		if ((fileSize > 0) && (fileSize <= memory_budget(memoryBudget) / 4))
+			return FileAccessProfile::InMemory;
+
+		if (file_space_page_size(fileName))
+			return FileAccessProfile::PageBuffered;
+
+		if (uring_driver_available())
+			return FileAccessProfile::ParallelRead;
+
+		return FileAccessProfile::Coalescing;
+	}
+
+	H5::FileAccPropList file_access_property_list(FileAccessProfile profile, hsize_t pageSize)
+	{
+		H5::FileAccPropList fapl;
+		switch (profile)
+		{
+		case FileAccessProfile::InMemory:
+			fapl.setCore(local::core_increment, false);
+			break;
+		case FileAccessProfile::PageBuffered:
+#if H5_VERSION_GE(1, 10, 1)
+			if (pageSize)
+				H5Pset_page_buffer_size(fapl.getId(), std::max<std::size_t>(pageSize, (local::page_buffer_size / pageSize) * pageSize), 0, 0);
+#endif
+			fapl.setSieveBufSize(local::sieve_buffer_size);
+			{
+				hsize_t metadataBlockSize = local::metadata_block_size;
+				fapl.setMetaBlockSize(metadataBlockSize);
+			}
+			local::set_large_metadata_cache(fapl);
+			break;
+		case FileAccessProfile::ParallelRead:
+		{
+			UringDriverConfig config;
+			if (const char* queueDepth = std::getenv("MV_H5_IO_QUEUE_DEPTH"))
+				config.queueDepth = std::max(1, std::atoi(queueDepth));
+			set_uring_driver(fapl, config);
+			set_coalescing_driver(fapl);
+			break;
+		}
+		case FileAccessProfile::Coalescing:
+			set_coalescing_driver(fapl);
+			break;
+		default:
+			break;
+		}
+		return fapl;
+	}
+
+	std::unique_ptr<H5::H5File> open_file(const QString& fileName, FileAccessProfile profile, std::uint64_t memoryBudget)
+	{
+		profile = choose_file_access_profile(fileName, profile, memoryBudget);
+		try
+		{
+			const hsize_t pageSize = (profile == FileAccessProfile::PageBuffered) ? file_space_page_size(fileName) : 0;
+			std::unique_ptr<H5::H5File> file(new H5::H5File(fileName.toLatin1().constData(), H5F_ACC_RDONLY, H5::FileCreatPropList::DEFAULT, file_access_property_list(profile, pageSize)));
+			std::cout << "Opened " << fileName.toStdString() << " with file access profile: " << file_access_profile_name(profile).toStdString() << std::endl;
+			return file;
+		}
+		catch (const H5::Exception&)
+		{
+			std::cout << "Could not open " << fileName.toStdString() << " with file access profile: " << file_access_profile_name(profile).toStdString() << ", using the sec2 driver" << std::endl;
+		}
+		return std::unique_ptr<H5::H5File>(new H5::H5File(fileName.toLatin1().constData(), H5F_ACC_RDONLY));
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "H5Cpp.h"
+
+#include <QString>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace H5Utils
+{
+	enum class FileAccessProfile
+	{
+		Automatic,    // chosen from the file size, the memory budget and the file space strategy
+		Default,      // plain sec2 driver with the HDF5 defaults, the baseline the other profiles are compared to
+		InMemory,     // core driver: the whole file is read with large sequential reads and accessed from memory
+		PageBuffered, // page buffer for files written with paged aggregation, larger metadata cache and sieve buffer
+		ParallelRead, // io_uring driver with many reads in flight (Linux) and the read-coalescing block cache, see UringFileDriver.h
+		Coalescing    // sec2 driver with the read-coalescing block cache, see CoalescingFileDriver.h
+	};
+
+	QString file_access_profile_name(FileAccessProfile profile);
+
+	// The profiles that can be used on this system, Automatic first.
+	std::vector<FileAccessProfile> available_file_access_profiles();
+
+	// Page size of a file written with the paged file space strategy, 0 otherwise.
+	hsize_t file_space_page_size(const QString& fileName);
+
+	// Resolves Automatic, ParallelRead falls back to Coalescing when io_uring is not available. A memoryBudget of 0 uses the default of LoadPlanner.
+	FileAccessProfile choose_file_access_profile(const QString& fileName, FileAccessProfile profile, std::uint64_t memoryBudget = 0);
+
+	H5::FileAccPropList file_access_property_list(FileAccessProfile profile, hsize_t pageSize = 0);
+
+	// Opens a file read-only with a file access profile, falls back to the plain sec2 driver if that fails. Throws like H5::H5File.
+	std::unique_ptr<H5::H5File> open_file(const QString& fileName, FileAccessProfile profile = FileAccessProfile::Automatic, std::uint64_t memoryBudget = 0);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+namespace H5Utils
+{
+	/*
+	* H5FD_class_value_t identifiers of the virtual file drivers of the loaders. HDF5 keeps 0-255 for its own drivers
+	* and 256-511 for drivers under test or private to an application, values above 511 are handed out by The HDF Group.
+	* The drivers are only registered inside this process and never written to a file, so they use the private range.
+	*/
+	constexpr int uring_driver_value = 400;
+	constexpr int coalescing_driver_value = 401;
+}
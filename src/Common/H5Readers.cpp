@@ -0,0 +1,113 @@
+#include "H5Readers.h"
+
+#include "ValueKernels.h"
+
+#include <iostream>
+
+namespace H5Utils
+{
+	void read_strings(H5::DataSet dataset, std::size_t totalsize, std::vector<std::string>& result)
+	{
+		MV_H5_TRACE_SCOPE("read_strings");
+		try
+		{
+			H5::StrType strType = dataset.getStrType();
+			std::size_t stringSize = strType.getSize();
+			std::vector<char> rData(totalsize * stringSize);
+			dataset.read(rData.data(), strType);
+			decode_fixed_length_strings(rData, totalsize, stringSize, result, [](const char* s) { return std::string(s); });
+		}
+		catch (const H5::Exception &e)
+		{
+			std::cout << e.getDetailMsg() << std::endl;
+			result.clear();
+		}
+	}
+
+	bool read_vector_statistics(const H5::DataSet& dataset, VectorStatistics& statistics)
+	{
+		statistics = VectorStatistics();
+		return read_vector_blocks<double>(dataset, [&statistics](const double* values, std::size_t, std::size_t count)
+			{
+				add_to_statistics(statistics, values, count);
+			});
+	}
+
+	bool read_vector_statistics(H5::Group& group, const std::string& name, VectorStatistics& statistics)
+	{
+		if (!group.exists(name))
+			return false;
+		return read_vector_statistics(group.openDataSet(name), statistics);
+	}
+
+	bool read_vector_string(H5::Group group, const std::string& name, std::vector<std::string>& result)
+	{
+		try
+		{
+			if (!group.exists(name))
+				return false;
+			H5::DataSet dataset = group.openDataSet(name);
+			if (dataset.getSpace().getSimpleExtentNdims() != 1)
+				return false;
+			read_strings(dataset, get_vector_size(dataset), result);
+			dataset.close();
+			return true;
+		}
+		catch (const H5::Exception& e)
+		{
+			std::cout << e.getDetailMsg() << std::endl;
+		}
+		result.clear();
+		return false;
+	}
+
+	bool read_vector_string(H5::DataSet dataset, std::vector<std::string> &result)
+	{
+		try
+		{
+			H5::DataType datatype = dataset.getDataType();
+			if (datatype.isVariableStr())
+			{
+				typedef VarLenStruct<char> StringStruct;
+
+				H5::StrType strType = dataset.getStrType();
+				const std::size_t size = get_vector_size(dataset);
+				if (size)
+				{
+					std::vector<StringStruct> buffer(size);
+					dataset.read(buffer.data(), strType);
+					result.resize(size);
+					for (std::size_t i = 0; i < size; ++i)
+						result[i] = buffer[i].ptr ? buffer[i].ptr : "";
+
+					// H5Dvlen_reclaim works for variable-length strings as well as variable-length arrays
+					H5::DataSet::vlenReclaim(buffer.data(), strType, dataset.getSpace());
+					return true;
+				}
+				return false;
+			}
+			if (dataset.getSpace().getSimpleExtentNdims() != 1)
+				return false;
+			read_strings(dataset, get_vector_size(dataset), result);
+			dataset.close();
+			return true;
+		}
+		catch(const H5::Exception &e)
+		{
+			std::cout << e.getDetailMsg() << std::endl;
+		}
+		result.clear();
+		return false;
+	}
+
+	std::size_t get_vector_size(const H5::DataSet &dataset)
+	{
+		// 0 for datasets that are not 1 dimensional
+		H5::DataSpace dataspace = dataset.getSpace();
+		if (dataspace.getSimpleExtentNdims() != 1)
+			return 0;
+		hsize_t size = 0;
+		dataspace.getSimpleExtentDims(&size, NULL);
+		return static_cast<std::size_t>(size);
+	}
+}
@@ -0,0 +1,319 @@
+#pragma once
+
+#include "H5Cpp.h"
+#include "ShardedReader.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/*
+* Readers of numerical and string datasets, shared by the plugins and the command line tools, so without Qt or
+* ManiVault. Element types without std::is_arithmetic, which is biovault::bfloat16_t for the plugins, are converted
+* from float by read_vector_values and read_multi_dimensional_values, and read as raw 16 bit values by read_vector.
+*/
+
+namespace H5Utils
+{
+	template<typename T>
+	H5::DataType getH5DataType()
+	{
+		if(std::numeric_limits<T>::is_specialized)
+		{
+			if(std::numeric_limits<T>::is_integer)
+			{
+				if(std::numeric_limits<T>::is_signed)
+				{
+					switch(sizeof(T))
+					{
+						case 1: return H5::PredType::NATIVE_INT8;
+						case 2: return H5::PredType::NATIVE_INT16;
+						case 4: return H5::PredType::NATIVE_INT32;
+						case 8: return H5::PredType::NATIVE_INT64;
+					}
+				}
+				else
+				{
+					switch (sizeof(T))
+					{
+						case 1: return H5::PredType::NATIVE_UINT8;
+						case 2: return H5::PredType::NATIVE_UINT16;
+						case 4: return H5::PredType::NATIVE_UINT32;
+						case 8: return H5::PredType::NATIVE_UINT64;
+					}
+				}
+			}
+			else 
+			{
+				assert(std::is_floating_point<T>());
+				switch (sizeof(T))
+				{
+					case 4: return H5::PredType::NATIVE_FLOAT;
+					case 8: return H5::PredType::NATIVE_DOUBLE;
+				}
+			}
+		}
+		else
+		{
+			if(sizeof(T) == 2)
+				return H5::PredType::NATIVE_UINT16; // raw biovault::bfloat16_t bits, used in 10x Loader
+		}
+		return H5::DataType();
+	}
+	
+	template<typename T>
+	class MultiDimensionalData
+	{
+		public:
+			MultiDimensionalData() = default;
+			std::vector<hsize_t> size;
+			std::vector<T> data;
+	};
+
+	template<typename T>
+	bool read_multi_dimensional_data(const H5::DataSet &dataset, MultiDimensionalData<T> &mdd)
+	{
+		MV_H5_TRACE_SCOPE("read_multi_dimensional_data");
+		mdd.data.clear();
+		mdd.size.clear();
+
+		H5::DataSpace dataspace = dataset.getSpace();
+		/*
+		* Get the number of dimensions in the dataspace.
+		*/
+		const int dimensions = dataspace.getSimpleExtentNdims();
+		std::size_t totalSize = 1;
+		if (dimensions > 0)
+		{
+
+			mdd.size.resize(dimensions);
+			dataspace.getSimpleExtentDims(mdd.size.data(), NULL);
+			for (int d = 0; d < dimensions; ++d)
+			{
+				totalSize *= mdd.size[d];
+			}
+		}
+		else
+		{
+			return false;
+		}
+		mdd.data.resize(totalSize);
+		if (!read_sharded(dataset, getH5DataType<T>(), mdd.data.data()))
+			dataset.read(mdd.data.data(), getH5DataType<T>());
+		return true;
+	}
+
+	template<typename T>
+	bool read_vector(H5::Group &group, const std::string &name, std::vector<T>*vector_ptr)
+	{
+		MV_H5_TRACE_SCOPE("read_vector");
+
+		if (!group.exists(name))
+			return false;
+		H5::DataSet dataset = group.openDataSet(name);
+		
+		H5::DataSpace dataspace = dataset.getSpace();
+		
+		/*
+		* Get the number of dimensions in the dataspace.
+		*/
+		const int dimensions = dataspace.getSimpleExtentNdims();
+		std::size_t totalSize = 1;
+		if (dimensions > 0)
+		{
+
+			std::vector<hsize_t> dimensionSize(dimensions);
+			dataspace.getSimpleExtentDims(&(dimensionSize[0]), NULL);
+			for (int d = 0; d < dimensions; ++d)
+			{
+
+				totalSize *= dimensionSize[d];
+			}
+
+		}
+		if (dimensions != 1)
+		{
+			return false;
+		}
+		vector_ptr->resize(totalSize);
+		if (!read_sharded(dataset, getH5DataType<T>(), vector_ptr->data()))
+			dataset.read(vector_ptr->data(), getH5DataType<T>());
+		dataset.close();
+		return true;
+	}
+
+	std::size_t get_vector_size(const H5::DataSet &dataset);
+
+	// Value range of a numerical dataset, gathered in a single pass.
+	struct VectorStatistics
+	{
+		std::size_t size = 0;
+		double min = 0;
+		double max = 0;
+		bool only_integers = true;
+	};
+
+	// Adds count values to statistics, size is the number of values added so far.
+	template<typename S>
+	void add_to_statistics(VectorStatistics& statistics, const S* values, std::size_t count)
+	{
+		if (count == 0)
+			return;
+		double minValue = std::numeric_limits<double>::max();
+		double maxValue = std::numeric_limits<double>::lowest();
+		bool onlyIntegers = true;
+		#pragma omp parallel for reduction(min:minValue) reduction(max:maxValue) reduction(&&:onlyIntegers)
+		for (std::int64_t i = 0; i < static_cast<std::int64_t>(count); ++i)
+		{
+			const double value = static_cast<double>(values[i]);
+			minValue = std::min(minValue, value);
+			maxValue = std::max(maxValue, value);
+			onlyIntegers = onlyIntegers && (value == std::round(value));
+		}
+		statistics.min = (statistics.size == 0) ? minValue : std::min(statistics.min, minValue);
+		statistics.max = (statistics.size == 0) ? maxValue : std::max(statistics.max, maxValue);
+		statistics.only_integers = statistics.only_integers && onlyIntegers;
+		statistics.size += count;
+	}
+
+	// Values per block of read_vector_blocks.
+	constexpr hsize_t vector_block_size = 1 << 22;
+
+	/*
+	* Reads a 1 dimensional dataset in blocks of vector_block_size values converted to S, and calls
+	* blockFunction(const S* values, std::size_t offset, std::size_t count) for each block, so only one block is held.
+	* Returns false if the dataset is not 1 dimensional.
+	*/
+	template<typename S, typename BlockFunction>
+	bool read_vector_blocks(const H5::DataSet& dataset, BlockFunction blockFunction)
+	{
+		H5::DataSpace dataspace = dataset.getSpace();
+		if (dataspace.getSimpleExtentNdims() != 1)
+			return false;
+
+		hsize_t totalSize = 0;
+		dataspace.getSimpleExtentDims(&totalSize, NULL);
+		std::vector<S> buffer(std::min(totalSize, vector_block_size));
+		for (hsize_t offset = 0; offset < totalSize; offset += vector_block_size)
+		{
+			hsize_t count = std::min(vector_block_size, totalSize - offset);
+			H5::DataSpace memspace(1, &count);
+			dataspace.selectHyperslab(H5S_SELECT_SET, &count, &offset);
+			dataset.read(buffer.data(), getH5DataType<S>(), memspace, dataspace);
+			blockFunction(static_cast<const S*>(buffer.data()), static_cast<std::size_t>(offset), static_cast<std::size_t>(count));
+		}
+		return true;
+	}
+
+	/*
+	* Same as read_vector but for biovault::bfloat16_t (or another type without std::is_arithmetic) the values are converted instead of reading the raw bits (data16).
+	* The conversion is done block by block into the vector, so there is no float copy of the whole dataset. With
+	* statistics the range of the values is gathered while they are read, instead of in a pass of its own.
+	*/
+	template<typename T>
+	bool read_vector_values(H5::Group& group, const std::string& name, std::vector<T>* vector_ptr, VectorStatistics* statistics = nullptr)
+	{
+		constexpr bool convert = !std::is_arithmetic_v<T>;
+		if (!convert && !statistics)
+			return read_vector(group, name, vector_ptr);
+
+		MV_H5_TRACE_SCOPE("read_vector_values");
+		if (!group.exists(name))
+			return false;
+		H5::DataSet dataset = group.openDataSet(name);
+		if (statistics)
+			*statistics = VectorStatistics();
+
+		typedef std::conditional_t<convert, float, T> S;
+		vector_ptr->resize(get_vector_size(dataset));
+		const bool result = read_vector_blocks<S>(dataset, [vector_ptr, statistics](const S* values, std::size_t offset, std::size_t count)
+			{
+				if (statistics)
+					add_to_statistics(*statistics, values, count);
+				T* destination = vector_ptr->data() + offset;
+				#pragma omp parallel for
+				for (std::int64_t i = 0; i < static_cast<std::int64_t>(count); ++i)
+					destination[i] = values[i];
+			});
+		if (!result)
+			vector_ptr->clear();
+		return result;
+	}
+
+	// Same as read_multi_dimensional_data but for biovault::bfloat16_t the values are converted block by block of rows
+	// (the first dimension) into mdd.data, so there is no float copy of the whole dataset.
+	template<typename T>
+	bool read_multi_dimensional_values(const H5::DataSet& dataset, MultiDimensionalData<T>& mdd)
+	{
+		if constexpr (std::is_arithmetic_v<T>)
+		{
+			return read_multi_dimensional_data(dataset, mdd);
+		}
+		else
+		{
+			MV_H5_TRACE_SCOPE("read_multi_dimensional_values");
+			mdd.data.clear();
+			mdd.size.clear();
+
+			H5::DataSpace dataspace = dataset.getSpace();
+			const int dimensions = dataspace.getSimpleExtentNdims();
+			if (dimensions <= 0)
+				return false;
+			mdd.size.resize(dimensions);
+			dataspace.getSimpleExtentDims(mdd.size.data(), NULL);
+			hsize_t rowSize = 1;
+			for (int d = 1; d < dimensions; ++d)
+				rowSize *= mdd.size[d];
+			mdd.data.resize(mdd.size[0] * rowSize);
+			if (mdd.data.empty())
+				return true;
+
+			const hsize_t blockRows = std::max<hsize_t>(1, vector_block_size / std::max<hsize_t>(rowSize, 1));
+			std::vector<float> buffer(std::min(mdd.size[0], blockRows) * rowSize);
+			std::vector<hsize_t> offset(dimensions, 0);
+			std::vector<hsize_t> count = mdd.size;
+			for (hsize_t row = 0; row < mdd.size[0]; row += blockRows)
+			{
+				offset[0] = row;
+				count[0] = std::min(blockRows, mdd.size[0] - row);
+				const hsize_t blockSize = count[0] * rowSize;
+				H5::DataSpace memspace(1, &blockSize);
+				dataspace.selectHyperslab(H5S_SELECT_SET, count.data(), offset.data());
+				dataset.read(buffer.data(), H5::PredType::NATIVE_FLOAT, memspace, dataspace);
+
+				T* destination = mdd.data.data() + row * rowSize;
+				#pragma omp parallel for
+				for (std::int64_t i = 0; i < static_cast<std::int64_t>(blockSize); ++i)
+					destination[i] = buffer[i];
+			}
+			return true;
+		}
+	}
+
+	inline bool contains_name(H5::Group& group, const std::string& name)
+	{
+		return group.exists(name);
+	}
+
+	// Streams a 1 dimensional numerical dataset in blocks, so the statistics don't need a copy of the whole dataset in memory.
+	bool read_vector_statistics(const H5::DataSet& dataset, VectorStatistics& statistics);
+	bool read_vector_statistics(H5::Group& group, const std::string& name, VectorStatistics& statistics);
+
+	// Variable length string as HDF5 reads it into memory.
+	template<typename T>
+	struct VarLenStruct
+	{
+		T* ptr;
+
+	};
+
+	bool read_vector_string(H5::Group group, const std::string& name, std::vector<std::string>& result);
+	void read_strings(H5::DataSet dataset, std::size_t totalsize, std::vector<std::string> &result);
+	bool read_vector_string(H5::DataSet dataset, std::vector<std::string> &result);
+}
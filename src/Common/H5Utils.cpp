@@ -1,5 +1,6 @@
 #include "H5Utils.h"
 
+#include "MemoryTracker.h"
 #include "VectorHolder.h"
 
 #include "ClusterData/Cluster.h"
@@ -9,7 +10,12 @@
 
 #include <iostream>
 #include <cstdint>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
+#include <QCoreApplication>
+#include <QFileInfo>
 #include <QInputDialog>
 #include <QMainWindow>
 #include <QtDebug>
@@ -62,13 +68,6 @@ namespace H5Utils
 			}
 		}
 
-		template<typename T>
-		struct VarLenStruct
-		{
-			T* ptr;
-
-		};
-		
 		bool read_var_length_compound_strings(const H5::DataSet &dataset, const std::string &name, std::vector<QVariant> &result)
 		{
 			typedef VarLenStruct<char> StringStruct;
@@ -142,43 +141,6 @@ namespace H5Utils
 		}
 
 	}
-	void read_strings(H5::DataSet dataset, std::size_t totalsize, std::vector<std::string>& result)
-	{
-		try
-		{
-			H5::StrType strType = dataset.getStrType();
-			bool utf8 = false;
-			try
-			{
-				utf8 = (strType.getCset() == H5T_CSET_UTF8);
-			}
-			catch (const H5::DataTypeIException& e)
-			{
-				std::cout << strType.getObjName() << std::endl;
-				qInfo() << e.getDetailMsg().c_str();
-			}
-			std::size_t stringSize = strType.getSize();
-			result.resize(totalsize);
-			std::vector<char> rData(totalsize * stringSize);
-			dataset.read(rData.data(), strType);
-			for (std::size_t d = 0; d < totalsize; ++d)
-			{
-				auto offset = rData.cbegin() + (d * stringSize);
-				if (*offset == '\"')
-					result[d] = std::string(offset + 1, offset + stringSize - 1).c_str();
-				else
-					result[d] = std::string(offset, offset + stringSize).c_str();
-			}
-
-		}
-		catch (const H5::Exception &e)
-		{
-			qCritical() << e.getDetailMsg().c_str();
-			result.clear();
-		}
-		
-	}
-
 	H5::PredType getPredTypeFromDataset(const H5::DataSet& dataset)
 	{
 		auto typeClass = dataset.getTypeClass();
@@ -222,6 +184,7 @@ namespace H5Utils
 
 	bool read_vector(H5::Group& group, const std::string& name, VectorHolder& vectorHolder)
 	{
+		MV_H5_TRACE_SCOPE("read_vector");
 		if (!group.exists(name))
 			return false;
 
@@ -245,56 +208,160 @@ namespace H5Utils
 			return false;
 
 		H5::PredType predType = getPredTypeFromDataset(dataset);
+		vectorHolder.setPredTypeSpecifier(predType); // resets the vector if the type changes, so select the type before resizing
 		vectorHolder.resize(totalSize);
-		vectorHolder.setPredTypeSpecifier(predType);
 
-		dataset.read(vectorHolder.data(), vectorHolder.H5DataType()); // since vector holder doesn't support all H5::PredType types we ask which one it is compatible with
+		// since vector holder doesn't support all H5::PredType types we ask which one it is compatible with
+		if (!read_sharded(dataset, vectorHolder.H5DataType(), vectorHolder.data()))
+			dataset.read(vectorHolder.data(), vectorHolder.H5DataType());
 		dataset.close();
 
 		return true;
 	}
 
-	bool read_vector_string(H5::Group group, const std::string& name, std::vector<std::string>& result)
+	int native_storage_type(const H5::DataSet& dataset)
 	{
-		try
-		{
-			//	std::cout << name << " ";
-			if (!group.exists(name))
-				return false;
-			H5::DataSet dataset = group.openDataSet(name);
+		H5::PredType predType = getPredTypeFromDataset(dataset);
+		if (predType == H5::PredType::NATIVE_UINT8)
+			return (int)PointData::ElementTypeSpecifier::uint8;
+		if (predType == H5::PredType::NATIVE_INT8)
+			return (int)PointData::ElementTypeSpecifier::int8;
+		if (predType == H5::PredType::NATIVE_UINT16)
+			return (int)PointData::ElementTypeSpecifier::uint16;
+		if (predType == H5::PredType::NATIVE_INT16)
+			return (int)PointData::ElementTypeSpecifier::int16;
+		return (int)PointData::ElementTypeSpecifier::float32;
+	}
 
-			H5::DataSpace dataspace = dataset.getSpace();
-			/*
-			* Get the number of dimensions in the dataspace.
-			*/
-			const int dimensions = dataspace.getSimpleExtentNdims();
-			std::size_t totalSize = 1;
-			if (dimensions > 0)
+	int optimized_storage_type(const VectorStatistics& statistics, bool allow_lossy_storage)
+	{
+		if (statistics.size && statistics.only_integers)
+		{
+			if (statistics.min < 0)
 			{
-				//		std::cout << "rank " << dimensions << ", dimensions ";
-				std::vector<hsize_t> dimensionSize(dimensions);
-				int ndims = dataspace.getSimpleExtentDims(&(dimensionSize[0]), NULL);
-				for (std::size_t d = 0; d < dimensions; ++d)
-				{
-					//			std::cout << (unsigned long)dimensionSize[d] << " ";
-					totalSize *= dimensionSize[d];
-				}
-				//		std::cout << std::endl;
+				if (in_range<std::int8_t>(statistics.min, statistics.max))
+					return (int)PointData::ElementTypeSpecifier::int8;
+				if (in_range<std::int16_t>(statistics.min, statistics.max))
+					return (int)PointData::ElementTypeSpecifier::int16;
 			}
-			if (dimensions != 1)
+			else
 			{
-				return false;
+				if (in_range<std::uint8_t>(statistics.min, statistics.max))
+					return (int)PointData::ElementTypeSpecifier::uint8;
+				if (in_range<std::uint16_t>(statistics.min, statistics.max))
+					return (int)PointData::ElementTypeSpecifier::uint16;
 			}
-			H5Utils::read_strings(dataset, totalSize, result);
-			dataset.close();
-			return true;
 		}
-		catch (const H5::Exception& e)
+		if (allow_lossy_storage)
+			return (int)PointData::ElementTypeSpecifier::bfloat16;
+		return (int)PointData::ElementTypeSpecifier::float32;
+	}
+
+	int resolve_storage_type(int storageType, const H5::DataSet& dataset, bool values_transformed)
+	{
+		if (storageType >= 0)
+			return storageType;
+
+		if (storageType == -1)
+			return values_transformed ? (int)PointData::ElementTypeSpecifier::float32 : native_storage_type(dataset);
+
+		VectorStatistics statistics;
+		if (!read_vector_statistics(dataset, statistics))
+			return (int)PointData::ElementTypeSpecifier::float32;
+		if (values_transformed)
+			statistics.only_integers = false;
+		return optimized_storage_type(statistics, storageType == -2);
+	}
+
+	int storage_type_bound(int storageType, const H5::DataSet& dataset, bool values_transformed)
+	{
+		if (storageType >= -1)
+			return resolve_storage_type(storageType, dataset, values_transformed);
+		if (storageType == -2)
+			return (int)PointData::ElementTypeSpecifier::bfloat16;
+		// integers never need a wider type than the one in the file
+		return values_transformed ? (int)PointData::ElementTypeSpecifier::float32 : native_storage_type(dataset);
+	}
+
+	namespace local
+	{
+		// Replaces the first count values in vectorHolder, of storage type fromType (-1 for none), by a vector of size
+		// values of storage type toType that starts with them.
+		void change_storage_type(VectorHolder& vectorHolder, int fromType, int toType, std::size_t count, std::size_t size)
 		{
-			qCritical() << e.getDetailMsg().c_str();
+			visit_storage_type(toType, [&](auto toTypeIdentity)
+				{
+					typedef typename decltype(toTypeIdentity)::type T;
+					std::vector<T> values(size);
+					if (fromType >= 0)
+					{
+						visit_storage_type(fromType, [&](auto fromTypeIdentity)
+							{
+								typedef typename decltype(fromTypeIdentity)::type S;
+								const std::vector<S>& previous = vectorHolder.getConstVector<S>();
+								#pragma omp parallel for
+								for (std::int64_t i = 0; i < static_cast<std::int64_t>(count); ++i)
+									values[i] = static_cast<float>(previous[i]);
+							});
+					}
+					vectorHolder = VectorHolder(std::move(values));
+				});
 		}
-		result.clear();
-		return false;
+	}
+
+	int read_vector_resolved(H5::Group& group, const std::string& name, int storageType, bool values_transformed, VectorHolder& vectorHolder)
+	{
+		MV_H5_TRACE_SCOPE("read_vector_resolved");
+		if (!group.exists(name))
+			return -1;
+		H5::DataSet dataset = group.openDataSet(name);
+
+		if (storageType >= -1) // the type does not depend on the values
+		{
+			const int elementType = resolve_storage_type(storageType, dataset, values_transformed);
+			bool result = false;
+			visit_storage_type(elementType, [&](auto elementTypeIdentity)
+				{
+					typedef typename decltype(elementTypeIdentity)::type T;
+					std::vector<T> values;
+					result = read_vector_values(group, name, &values);
+					vectorHolder = VectorHolder(std::move(values));
+				});
+			return result ? elementType : -1;
+		}
+
+		const std::size_t size = get_vector_size(dataset);
+		VectorStatistics statistics;
+		int elementType = -1; // of the values read so far
+		const bool result = read_vector_blocks<double>(dataset, [&](const double* values, std::size_t offset, std::size_t count)
+			{
+				add_to_statistics(statistics, values, count);
+				VectorStatistics range = statistics;
+				range.only_integers = range.only_integers && !values_transformed;
+				const int blockType = optimized_storage_type(range, storageType == -2);
+				if (blockType != elementType)
+				{
+					// every type optimized_storage_type returns for the wider range holds the values read before
+					local::change_storage_type(vectorHolder, elementType, blockType, offset, size);
+					elementType = blockType;
+				}
+				visit_storage_type(elementType, [&](auto elementTypeIdentity)
+					{
+						typedef typename decltype(elementTypeIdentity)::type T;
+						T* destination = vectorHolder.getVector<T>().data() + offset;
+						#pragma omp parallel for
+						for (std::int64_t i = 0; i < static_cast<std::int64_t>(count); ++i)
+							destination[i] = static_cast<float>(values[i]);
+					});
+			});
+		if (!result)
+			return -1;
+		if (elementType < 0) // empty
+		{
+			elementType = optimized_storage_type(statistics, storageType == -2);
+			local::change_storage_type(vectorHolder, -1, elementType, 0, 0);
+		}
+		return elementType;
 	}
 
 	bool read_vector_string(H5::Group group, const std::string& name, std::vector<QString>& result)
@@ -344,6 +411,7 @@ namespace H5Utils
 
 	void read_strings(H5::DataSet dataset, std::size_t totalsize, std::vector<QString>& result)
 	{
+		MV_H5_TRACE_SCOPE("read_strings");
 		try
 		{
 			H5::StrType strType = dataset.getStrType();
@@ -357,31 +425,12 @@ namespace H5Utils
 				qInfo() << e.getDetailMsg().c_str();
 			}
 			std::size_t stringSize = strType.getSize();
-			result.resize(totalsize);
 			std::vector<char> rData(totalsize * stringSize);
 			dataset.read(rData.data(), strType);
 			if (utf8)
-			{
-				for (std::size_t d = 0; d < totalsize; ++d)
-				{
-					auto offset = rData.cbegin() + (d * stringSize);
-					if (*offset == '\"')
-						result[d] = QString::fromUtf8(std::string(offset + 1, offset + stringSize - 1).c_str());
-					else
-						result[d] = QString::fromUtf8(std::string(offset, offset + stringSize).c_str());
-				}
-			}
+				decode_fixed_length_strings(rData, totalsize, stringSize, result, [](const char* s) { return QString::fromUtf8(s); });
 			else
-			{
-				for (std::size_t d = 0; d < totalsize; ++d)
-				{
-					auto offset = rData.cbegin() + (d * stringSize);
-					if (*offset == '\"')
-						result[d] = std::string(offset + 1, offset + stringSize - 1).c_str();
-					else
-						result[d] = std::string(offset, offset + stringSize).c_str();
-				}
-			}
+				decode_fixed_length_strings(rData, totalsize, stringSize, result, [](const char* s) { return QString(s); });
 		}
 		catch (const H5::Exception &e)
 		{
@@ -391,90 +440,6 @@ namespace H5Utils
 		
 	}
 
-	bool read_vector_string(H5::DataSet dataset, std::vector<std::string> &result)
-	{
-		try
-		{
-			H5::DataSpace dataspace = dataset.getSpace();
-
-
-			H5::DataType datatype = dataset.getDataType();
-			if (datatype.isVariableStr())
-			{
-				typedef local::VarLenStruct<char> StringStruct;
-
-				// create datatypes
-				H5::StrType strType = dataset.getStrType();
-				bool utf8 = false;
-				try
-				{
-					utf8 = (strType.getCset() == H5T_CSET_UTF8);
-				}
-				catch (const H5::DataTypeIException& e)
-				{
-					qInfo() << e.getDetailMsg().c_str();
-				}
-				std::size_t size = get_vector_size(dataset);
-				if (size)
-				{
-					std::vector<StringStruct> buffer(size);
-
-					//read stuff
-					dataset.read(buffer.data(), strType);
-					// copy results
-					result.resize(size);
-					for (auto i = 0; i < size; ++i)
-					{
-						result[i] = (const char*)buffer[i].ptr;
-
-					}
-					/*
-					* Release resources.  Note that H5Dvlen_reclaim works
-					* for variable-length strings as well as variable-length arrays.
-					*/
-					
-					H5::DataSet::vlenReclaim(buffer.data(), strType, dataset.getSpace());
-					buffer.clear();
-					return true;
-				}
-				return false;
-			}
-			else
-			{
-				/*
-				* Get the number of dimensions in the dataspace.
-				*/
-				const int dimensions = dataspace.getSimpleExtentNdims();
-				std::size_t totalSize = 1;
-				if (dimensions > 0)
-				{
-
-					std::vector<hsize_t> dimensionSize(dimensions);
-					int ndims = dataspace.getSimpleExtentDims(&(dimensionSize[0]), NULL);
-					for (std::size_t d = 0; d < dimensions; ++d)
-					{
-						totalSize *= dimensionSize[d];
-					}
-
-				}
-				if (dimensions != 1)
-				{
-					return false;
-				}
-				read_strings(dataset, totalSize, result);
-				dataset.close();
-				return true;
-			}
-		}
-		catch(const H5::Exception &e)
-		{
-			qCritical() << e.getDetailMsg().c_str();
-		}
-		result.clear();
-		return false;
-	}
-
-
 	bool read_vector_string(H5::DataSet dataset, std::vector<QString>& result)
 	{
 		try
@@ -482,7 +447,7 @@ namespace H5Utils
 			H5::DataType datatype = dataset.getDataType();
 			if (datatype.isVariableStr())
 			{
-				typedef local::VarLenStruct<char> StringStruct;
+				typedef VarLenStruct<char> StringStruct;
 
 				// create datatypes
 				H5::StrType strType = dataset.getStrType();
@@ -572,6 +537,7 @@ namespace H5Utils
 
 	bool read_compound_buffer(const H5::DataSet &dataset, std::vector<std::vector<char>> &result)
 	{
+		MV_H5_TRACE_SCOPE("read_compound_buffer");
 		H5::DataSpace dataspace = dataset.getSpace();
 		/*
 		* Get the number of dimensions in the dataspace.
@@ -628,9 +594,11 @@ namespace H5Utils
 	
 	bool read_compound(const H5::DataSet &dataset, std::map<std::string, std::vector<QVariant> > &result)
 	{
+		MV_H5_TRACE_SCOPE("read_compound");
 		std::vector<std::vector<char>> raw_buffer;
 		if (read_compound_buffer(dataset, raw_buffer))
 		{
+			TrackedBuffer trackedBuffer("compound buffer", raw_buffer.empty() ? 0 : raw_buffer.size() * (sizeof(std::vector<char>) + raw_buffer.front().capacity()));
 			H5::CompType compType = dataset.getCompType();
 			auto nrOfComponents = compType.getNmembers();
 			for (int c = 0; c < nrOfComponents; ++c)
@@ -698,33 +666,6 @@ namespace H5Utils
 
 	
 
-	std::size_t get_vector_size(const H5::DataSet &dataset)
-	{
-		H5::DataSpace dataspace = dataset.getSpace();
-		/*
-		* Get the number of dimensions in the dataspace.
-		*/
-		const int dimensions = dataspace.getSimpleExtentNdims();
-		if (dimensions == 0)
-			return 0;
-		std::size_t nrOfItems = 1;
-		if (dimensions == 1)
-		{
-
-			std::vector<hsize_t> dimensionSize(dimensions);
-			int ndims = dataspace.getSimpleExtentDims(&(dimensionSize[0]), NULL);
-			for (std::size_t d = 0; d < dimensions; ++d)
-			{
-				nrOfItems *= dimensionSize[d];
-			}
-			return nrOfItems;
-		}
-		else
-		{
-			return 0;
-		}
-	}
-
 	CompoundExtractor::CompoundExtractor(const H5::DataSet& d)
 	{
 		const auto dtype = d.getDataType();
@@ -1099,6 +1040,7 @@ namespace H5Utils
 
 	void addClusterMetaData(std::map<QString, std::vector<unsigned int>>& indices, QString name, mv::Dataset<Points> parent, std::map<QString, QColor> colors, QString prefix)
 	{
+		MV_H5_TRACE_SCOPE("addClusterMetaData");
 		if (indices.size() <= 1)
 			return; // no point in adding only a single cluster
 		while (name[0] == '/')
@@ -1148,6 +1090,18 @@ namespace H5Utils
 		// Notify others that the clusters have changed
 		events().notifyDatasetDataChanged(clusterDataset);
 	}
-		
 
-}
\ No newline at end of file
+	ReadTask::ReadTask(const QString& fileName)
+		: _task(nullptr, QString("Reading %1").arg(QFileInfo(fileName).fileName()))
+		, _cancellation([]() { QCoreApplication::processEvents(); })
+	{
+		_task.setMayKill(true);
+		QObject::connect(&_task, &mv::Task::requestAbort, &_task, [this]() { _cancellation.cancel(); });
+		_task.setRunning();
+	}
+
+	ReadTask::~ReadTask()
+	{
+		_task.setFinished();
+	}
+}
@@ -4,14 +4,25 @@
 #include <Dataset.h>
 #include <DataHierarchyItem.h>
 #include <CoreInterface.h>
+#include <ForegroundTask.h>
 
 #include "H5Cpp.h"
-
+#include "H5Readers.h"
+#include "IndexVector.h"
+#include "ProgressCounter.h"
+#include "Trace.h"
+#include "ShardedReader.h"
+#include "ValueKernels.h"
+
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <cstdint>
+#include <limits>
 #include <string>
 #include <vector>
 #include <map>
+#include <type_traits>
 
 #include <QVariant>
 #include <QColor>
@@ -105,162 +116,70 @@ namespace H5Utils
 		return compare<IntegerCompareSpecialization<R,T>::value, R, T>::in_range(u_min, u_max);
 	}
 
-	template<typename T>
-	bool is_integer(T value)
-	{
-		return std::is_integral_v<T> || (value == std::round(value));
-	}
+	bool read_vector(H5::Group& group, const std::string& name, VectorHolder& vectorHolder);
 
-	template<typename T>
-	bool contains_only_integers(const std::vector<T>& data)
-	{
-		if (std::is_integral_v<T>)
-			return true;
+	// PointData::ElementTypeSpecifier closest to the type stored in the file, float32 if there is none.
+	int native_storage_type(const H5::DataSet& dataset);
 
-		for (auto i = 0; i < data.size(); ++i)
-		{
-			if (!is_integer(data[i]))
-				return false;
-		}
-		return true;
-	}
+	// Smallest PointData::ElementTypeSpecifier that can hold the values described by statistics.
+	int optimized_storage_type(const VectorStatistics& statistics, bool allow_lossy_storage);
 
-	template<typename T>
-	H5::DataType getH5DataType()
-	{
-		if(std::numeric_limits<T>::is_specialized)
-		{
-			if(std::numeric_limits<T>::is_integer)
-			{
-				if(std::numeric_limits<T>::is_signed)
-				{
-					switch(sizeof(T))
-					{
-						case 1: return H5::PredType::NATIVE_INT8;
-						case 2: return H5::PredType::NATIVE_INT16;
-						case 4: return H5::PredType::NATIVE_INT32;
-						case 8: return H5::PredType::NATIVE_INT64;
-					}
-				}
-				else
-				{
-					switch (sizeof(T))
-					{
-						case 1: return H5::PredType::NATIVE_UINT8;
-						case 2: return H5::PredType::NATIVE_UINT16;
-						case 4: return H5::PredType::NATIVE_UINT32;
-						case 8: return H5::PredType::NATIVE_UINT64;
-					}
-				}
-			}
-			else 
-			{
-				assert(std::is_floating_point<T>());
-				switch (sizeof(T))
-				{
-					case 4: return H5::PredType::NATIVE_FLOAT;
-					case 8: return H5::PredType::NATIVE_DOUBLE;
-				}
-			}
-		}
-		else
-		{
-			if(std::is_same_v<biovault::bfloat16_t,T>)
-				return H5::PredType::NATIVE_UINT16; // use in 10x Loader
-		}
-		return H5::DataType();
-	}
-	
-	template<typename T>
-	class MultiDimensionalData
-	{
-		public:
-			MultiDimensionalData() = default;
-			std::vector<hsize_t> size;
-			std::vector<T> data;
-	};
+	/*
+	* Resolves the "Data Type" selection of the loaders (-3: optimized lossless, -2: optimized incl bfloat16, -1: original,
+	* >= 0: PointData::ElementTypeSpecifier) for a dataset. When the values are changed by a transform the optimized
+	* selections fall back to floating point types.
+	*/
+	int resolve_storage_type(int storageType, const H5::DataSet& dataset, bool values_transformed);
+
+	// Largest type resolve_storage_type can return for the dataset, without reading the values, to plan the memory use
+	// of read_vector_resolved before the values are read.
+	int storage_type_bound(int storageType, const H5::DataSet& dataset, bool values_transformed);
 
+	/*
+	* Reads a 1 dimensional numerical dataset into vectorHolder, in the type resolve_storage_type selects, without
+	* reading the values twice: for the optimized selections the value range is gathered block by block while the
+	* values are stored in the smallest type holding the values read so far, which is widened when a block needs it.
+	* Returns the PointData::ElementTypeSpecifier of the values, -1 if the dataset could not be read.
+	*/
+	int read_vector_resolved(H5::Group& group, const std::string& name, int storageType, bool values_transformed, VectorHolder& vectorHolder);
+
+	// PointData::ElementTypeSpecifier of T, float32 for the types PointData cannot store.
 	template<typename T>
-	bool read_multi_dimensional_data(const H5::DataSet &dataset, MultiDimensionalData<T> &mdd)
+	constexpr int storage_type_of()
 	{
-		mdd.data.clear();
-		mdd.size.clear();
-
-		H5::DataSpace dataspace = dataset.getSpace();
-		/*
-		* Get the number of dimensions in the dataspace.
-		*/
-		const int dimensions = dataspace.getSimpleExtentNdims();
-		std::size_t totalSize = 1;
-		if (dimensions > 0)
-		{
-
-			mdd.size.resize(dimensions);
-			int ndims = dataspace.getSimpleExtentDims(mdd.size.data(), NULL);
-			for (std::size_t d = 0; d < dimensions; ++d)
-			{
-				totalSize *= mdd.size[d];
-			}
-		}
+		if constexpr (std::is_same_v<T, biovault::bfloat16_t>)
+			return (int)PointData::ElementTypeSpecifier::bfloat16;
+		else if constexpr (std::is_same_v<T, std::int16_t>)
+			return (int)PointData::ElementTypeSpecifier::int16;
+		else if constexpr (std::is_same_v<T, std::uint16_t>)
+			return (int)PointData::ElementTypeSpecifier::uint16;
+		else if constexpr (std::is_same_v<T, std::int8_t>)
+			return (int)PointData::ElementTypeSpecifier::int8;
+		else if constexpr (std::is_same_v<T, std::uint8_t>)
+			return (int)PointData::ElementTypeSpecifier::uint8;
 		else
-		{
-			return false;
-		}
-		mdd.data.resize(totalSize);
-		dataset.read(mdd.data.data(), getH5DataType<T>());
-		return true;
+			return (int)PointData::ElementTypeSpecifier::float32;
 	}
 
-	template<typename T>
-	bool read_vector(H5::Group &group, const std::string &name, std::vector<T>*vector_ptr)
+	// Calls functionObject(std::type_identity<T>()) with T the element type of a PointData::ElementTypeSpecifier.
+	template<typename FunctionObject>
+	void visit_storage_type(int storageType, FunctionObject functionObject)
 	{
-
-		if (!group.exists(name))
-			return false;
-		H5::DataSet dataset = group.openDataSet(name);
-		
-		H5::DataSpace dataspace = dataset.getSpace();
-		
-		/*
-		* Get the number of dimensions in the dataspace.
-		*/
-		const int dimensions = dataspace.getSimpleExtentNdims();
-		std::size_t totalSize = 1;
-		if (dimensions > 0)
+		switch (static_cast<PointData::ElementTypeSpecifier>(storageType))
 		{
-
-			std::vector<hsize_t> dimensionSize(dimensions);
-			int ndims = dataspace.getSimpleExtentDims(&(dimensionSize[0]), NULL);
-			for (std::size_t d = 0; d < dimensions; ++d)
-			{
-
-				totalSize *= dimensionSize[d];
-			}
-
-		}
-		if (dimensions != 1)
-		{
-			return false;
+		case PointData::ElementTypeSpecifier::bfloat16: return functionObject(std::type_identity<biovault::bfloat16_t>());
+		case PointData::ElementTypeSpecifier::int16: return functionObject(std::type_identity<std::int16_t>());
+		case PointData::ElementTypeSpecifier::uint16: return functionObject(std::type_identity<std::uint16_t>());
+		case PointData::ElementTypeSpecifier::int8: return functionObject(std::type_identity<std::int8_t>());
+		case PointData::ElementTypeSpecifier::uint8: return functionObject(std::type_identity<std::uint8_t>());
+		case PointData::ElementTypeSpecifier::float32:
+		default: return functionObject(std::type_identity<float>());
 		}
-		vector_ptr->resize(totalSize);
-		dataset.read(vector_ptr->data(), getH5DataType<T>());
-		dataset.close();
-		return true;
-	}
-
-		inline bool contains_name(H5::Group& group, const std::string& name)
-	{
-		return group.exists(name);
 	}
-
-	bool read_vector(H5::Group& group, const std::string& name, VectorHolder& vectorHolder);
 	
-	bool read_vector_string(H5::Group group, const std::string& name, std::vector<std::string>& result);
+	// The std::string versions are in H5Readers.h.
 	bool read_vector_string(H5::Group group, const std::string& name, std::vector<QString>& result);
-	void read_strings(H5::DataSet dataset, std::size_t totalsize, std::vector<std::string> &result);
 	void read_strings(H5::DataSet dataset, std::size_t totalsize, std::vector<QString>& result);
-
-	bool read_vector_string(H5::DataSet dataset, std::vector<std::string> &result);
 	bool read_vector_string(H5::DataSet dataset, std::vector<QString>& result);
 
 	//bool read_vector_string(H5::Group& group, const std::string& name, std::vector<std::string>& result);
@@ -270,43 +189,13 @@ namespace H5Utils
 	template<class RandomIterator>
 	void transpose(RandomIterator first, RandomIterator last, int m, mv::DataHierarchyItem &progressItem)
 	{
-		//https://stackoverflow.com/questions/9227747/in-place-transposition-of-a-matrix
-		const std::ptrdiff_t mn1 = (last - first - 1);
-		const std::ptrdiff_t n = (last - first) / m;
-		RandomIterator cycle = first;
-		std::vector<uint8_t> visited(last - first, 0);
-		std::size_t updateCounter = 0;
-		std::size_t updateFrequency = n;
-		if (updateFrequency > 1000)
-			updateFrequency = 100000;
-		while (++cycle != last) {
-			if (visited[cycle - first])
-				continue;
-			std::ptrdiff_t a = cycle - first;
-			do {
-				a = a == mn1 ? mn1 : n * a % mn1;
-				std::swap(*(first + a), *cycle);
-				visited[a] = 1;
-				++updateCounter;
-				if((updateCounter % updateFrequency) == 10000)
-				{
-					float progress = (1.0 * updateCounter) / (last - first);
-					progressItem.getDataset()->getTask().setProgress(progress);
-					//QGuiApplication::instance()->processEvents();
-				}
-				
-				
-			} while ((first + a) != cycle);
-		}
-		progressItem.getDataset()->getTask().setProgress(100);
-		
+		ProgressCounter progress(last - first, [&progressItem](float fraction) { progressItem.getDataset()->getTask().setProgress(fraction); });
+		transpose_in_place(first, last, m, [&progress](std::uint64_t steps) { progress.add(steps); });
 	}
 
 	bool is_number(const std::string& s);
 	bool is_number(const QString& s);
 
-	bool read_vector_string(H5::Group group, const std::string& name, std::vector<std::string>& result);
-
 	class CompoundExtractor
 	{
 		//based on: https://stackoverflow.com/questions/41782527/c-hdf5-extract-one-member-of-a-compound-data-type
@@ -347,7 +236,6 @@ namespace H5Utils
 
 	//bool read_buffer_vector(H5::DataSet &dataset, std::vector<std::vector<char>> &result);
 
-	std::size_t get_vector_size(const H5::DataSet &dataset);
 
 	
 	mv::Dataset<Points> createPointsDataset(::mv::CoreInterface* core,bool ask=true, QString=QString());
@@ -501,5 +389,24 @@ namespace H5Utils
 
 	void addClusterMetaData(std::map<QString, std::vector<unsigned int>>& indices, QString name, mv::Dataset<Points> parent, std::map<QString, QColor> colors = std::map<QString, QColor>(), QString prefix = QString());
 
+	/*
+	* Foreground task shown while a file is read, for the reads that happen before there is a dataset with a task of
+	* its own. Aborting it cancels the sharded reads of the calling thread, which throw ReadCancelled; while a sharded
+	* read waits for its workers the events are processed, so the abort request comes through.
+	*/
+	class ReadTask
+	{
+	public:
+		explicit ReadTask(const QString& fileName);
+		~ReadTask();
+
+		ReadTask(const ReadTask&) = delete;
+		ReadTask& operator=(const ReadTask&) = delete;
+
+	private:
+		mv::ForegroundTask _task;
+		ShardedReadCancellation _cancellation;
+	};
+
 }
 
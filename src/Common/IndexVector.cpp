@@ -0,0 +1,60 @@
+#include "IndexVector.h"
+
+#include "ShardedReader.h"
+#include "Trace.h"
+
+namespace H5Utils
+{
+	bool read_index_vector(H5::Group& group, const std::string& name, std::uint64_t maxValue, IndexVectorHolder& vectorHolder)
+	{
+		MV_H5_TRACE_SCOPE("read_index_vector");
+		if (!group.exists(name))
+			return false;
+
+		H5::DataSet dataset = group.openDataSet(name);
+		if (dataset.getSpace().getSimpleExtentNdims() != 1)
+			return false;
+
+		vectorHolder.selectType(maxValue);
+		vectorHolder.resize(dataset.getSpace().getSimpleExtentNpoints());
+
+		if (!read_sharded(dataset, vectorHolder.H5DataType(), vectorHolder.data()))
+			dataset.read(vectorHolder.data(), vectorHolder.H5DataType());
+		dataset.close();
+
+		return true;
+	}
+
+	bool read_index_vector(H5::Group& group, const std::string& name, IndexVectorHolder& vectorHolder)
+	{
+		if (!group.exists(name))
+			return false;
+
+		H5::DataSet dataset = group.openDataSet(name);
+		std::uint64_t maxValue = std::numeric_limits<std::uint64_t>::max();
+		if (dataset.getTypeClass() == H5T_INTEGER)
+		{
+			// indices are never negative, so a signed type holds at most its signed maximum: int32 fits in uint32
+			const H5::IntType intType = dataset.getIntType();
+			const std::size_t nrOfBits = 8 * intType.getSize() - ((intType.getSign() == H5T_SGN_2) ? 1 : 0);
+			if (nrOfBits < 64)
+				maxValue = (std::uint64_t(1) << nrOfBits) - 1;
+		}
+		return read_index_vector(group, name, maxValue, vectorHolder);
+	}
+
+	bool validate_index_pointers(const IndexVectorHolder& indptr, std::uint64_t nnz)
+	{
+		return indptr.constVisit<bool>([nnz](const auto& vec)
+			{
+				if (vec.empty() || (vec.front() != 0) || (vec.back() != nnz))
+					return false;
+
+				bool monotonic = true;
+				#pragma omp parallel for reduction(&&:monotonic)
+				for (std::int64_t i = 1; i < static_cast<std::int64_t>(vec.size()); ++i)
+					monotonic = monotonic && (vec[i - 1] <= vec[i]);
+				return monotonic;
+			});
+	}
+}
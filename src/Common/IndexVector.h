@@ -0,0 +1,137 @@
+#pragma once
+
+#include "H5Cpp.h"
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace H5Utils
+{
+	// Holds the indices or the index pointers (offsets) of a sparse matrix in the narrowest unsigned type that fits.
+	class IndexVectorHolder
+	{
+	private:
+		using VariantOfVectors = std::variant <
+			std::vector<std::uint16_t>,
+			std::vector<std::uint32_t>,
+			std::vector<std::uint64_t> >;
+
+		VariantOfVectors _variantOfVectors;
+
+	public:
+		IndexVectorHolder() = default;
+
+		template <typename T>
+		explicit IndexVectorHolder(std::vector<T>&& vec)
+		{
+			_variantOfVectors = std::move(vec);
+		}
+
+		// Selects the narrowest type for which all values up to and including maxValue are smaller than std::numeric_limits<T>::max(),
+		// so the maximum of the type remains available as "invalid index" marker. Resets the content if the type changes.
+		void selectType(std::uint64_t maxValue)
+		{
+			std::size_t index = 2;
+			if (maxValue < std::numeric_limits<std::uint16_t>::max())
+				index = 0;
+			else if (maxValue < std::numeric_limits<std::uint32_t>::max())
+				index = 1;
+
+			if (index != _variantOfVectors.index())
+			{
+				switch (index)
+				{
+				case 0: _variantOfVectors = std::vector<std::uint16_t>(); break;
+				case 1: _variantOfVectors = std::vector<std::uint32_t>(); break;
+				default: _variantOfVectors = std::vector<std::uint64_t>(); break;
+				}
+			}
+		}
+
+		/// Just forwarding to the corresponding member function of the currently selected std::vector.
+		std::size_t size() const
+		{
+			return std::visit([](const auto& vec) { return vec.size(); }, _variantOfVectors);
+		}
+
+		/// Just forwarding to the corresponding member function of the currently selected std::vector.
+		void resize(const std::size_t newSize)
+		{
+			return std::visit([newSize](auto& vec) { return vec.resize(newSize); }, _variantOfVectors);
+		}
+
+		/// Just forwarding to the corresponding member function of the currently selected std::vector.
+		void clear()
+		{
+			return std::visit([](auto& vec) { return vec.clear(); }, _variantOfVectors);
+		}
+
+		template<typename T>
+		std::vector<T> getVectorAs() const {
+			return std::visit([](const auto& vec) -> std::vector<T> {
+				return std::vector<T>(vec.cbegin(), vec.cend());
+				}, _variantOfVectors);
+		}
+
+		std::uint64_t operator[](std::size_t i) const
+		{
+			return std::visit([i](const auto& vec) { return static_cast<std::uint64_t>(vec[i]); }, _variantOfVectors);
+		}
+
+		// Bytes allocated for the indices.
+		std::uint64_t bytes() const
+		{
+			return std::visit([](const auto& vec) { return static_cast<std::uint64_t>(vec.capacity() * sizeof(vec[0])); }, _variantOfVectors);
+		}
+
+		// Similar to C++17 std::visit.
+		template <typename ReturnType = void, typename FunctionObject>
+		ReturnType visit(FunctionObject functionObject)
+		{
+			return std::visit([functionObject](auto& vec) -> ReturnType
+				{
+					return functionObject(vec);
+				},
+				_variantOfVectors);
+		}
+
+		// Similar to C++17 std::visit.
+		template <typename ReturnType = void, typename FunctionObject>
+		ReturnType constVisit(FunctionObject functionObject) const
+		{
+			return std::visit([functionObject](const auto& vec) -> ReturnType
+				{
+					return functionObject(vec);
+				},
+				_variantOfVectors);
+		}
+
+		H5::DataType H5DataType() const
+		{
+			switch (_variantOfVectors.index())
+			{
+			case 0: return H5::PredType::NATIVE_UINT16;
+			case 1: return H5::PredType::NATIVE_UINT32;
+			default: return H5::PredType::NATIVE_UINT64;
+			}
+		}
+
+		void* data()
+		{
+			return std::visit([](auto& vec) { return static_cast<void*>(vec.data()); }, _variantOfVectors);
+		}
+	};
+
+	// Reads sparse matrix indices or index pointers in the narrowest unsigned type that can hold maxValue (see IndexVectorHolder::selectType).
+	bool read_index_vector(H5::Group& group, const std::string& name, std::uint64_t maxValue, IndexVectorHolder& vectorHolder);
+	// Same, for when the largest value is unknown beforehand: the type is selected from the value range of the (integer) type
+	// stored in the file, the non-negative range for signed types. Prefer passing the real bound (columns, nonzeros) when known,
+	// unsigned types in the file are widened since their maximum is reserved as marker.
+	bool read_index_vector(H5::Group& group, const std::string& name, IndexVectorHolder& vectorHolder);
+
+	// Checks that compressed sparse index pointers start at 0, never decrease and end at the number of nonzeros.
+	bool validate_index_pointers(const IndexVectorHolder& indptr, std::uint64_t nnz);
+}
@@ -0,0 +1,319 @@
+#include "LoadPlanner.h"
+
+#include "BackedMatrix.h"
+#include "IndexVector.h"
+#include "RowBlockReader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace H5Utils
+{
+	namespace local
+	{
+		// PointData::ElementTypeSpecifier::bfloat16
+		constexpr int bfloat16_type = 1;
+
+		// bytes per value of a PointData::ElementTypeSpecifier, in the order of element_type_names
+		std::size_t element_size(int elementType)
+		{
+			constexpr std::array<std::size_t, element_type_names.size()> sizes = { 4, 2, 2, 2, 1, 1 };
+			if ((elementType >= 0) && (elementType < static_cast<int>(sizes.size())))
+				return sizes[elementType];
+			return 4;
+		}
+
+		// count with thousands separators
+		std::string grouped(std::uint64_t count)
+		{
+			const std::string digits = std::to_string(count);
+			std::string result;
+			for (std::size_t i = 0; i < digits.size(); ++i)
+			{
+				if ((i > 0) && ((digits.size() - i) % 3 == 0))
+					result += ',';
+				result += digits[i];
+			}
+			return result;
+		}
+
+		// size of the type IndexVectorHolder selects for maxValue
+		std::size_t index_size(std::uint64_t maxValue)
+		{
+			IndexVectorHolder holder;
+			holder.selectType(maxValue);
+			return holder.H5DataType().getSize();
+		}
+
+		std::size_t stored_size(const H5::DataSet& dataset)
+		{
+			return dataset.getDataType().getSize();
+		}
+
+		std::vector<hsize_t> chunk_dimensions(const H5::DataSet& dataset)
+		{
+			std::vector<hsize_t> result;
+			H5::DSetCreatPropList createPropertyList = dataset.getCreatePlist();
+			if (createPropertyList.getLayout() == H5D_CHUNKED)
+			{
+				result.resize(dataset.getSpace().getSimpleExtentNdims());
+				createPropertyList.getChunk(static_cast<int>(result.size()), result.data());
+			}
+			return result;
+		}
+	}
+
+	bool read_sparse_layout(H5::Group& group, std::uint64_t columns, MatrixLayout& layout, const std::string& dataName, const std::string& indicesName, const std::string& indptrName)
+	{
+		if (!group.exists(dataName) || !group.exists(indicesName) || !group.exists(indptrName))
+			return false;
+
+		const H5::DataSet data = group.openDataSet(dataName);
+		const H5::DataSet indices = group.openDataSet(indicesName);
+		const H5::DataSet indptr = group.openDataSet(indptrName);
+
+		layout = MatrixLayout();
+		layout.sparse = true;
+		layout.columns = columns;
+		layout.nnz = data.getSpace().getSimpleExtentNpoints();
+		const std::uint64_t nrOfIndexPointers = indptr.getSpace().getSimpleExtentNpoints();
+		layout.rows = nrOfIndexPointers ? nrOfIndexPointers - 1 : 0;
+		layout.valueSize = local::stored_size(data);
+		layout.indexSize = local::stored_size(indices);
+		layout.indptrSize = local::stored_size(indptr);
+		layout.chunkDimensions = local::chunk_dimensions(data);
+		return true;
+	}
+
+	bool read_dense_layout(const H5::DataSet& dataset, MatrixLayout& layout)
+	{
+		H5::DataSpace dataspace = dataset.getSpace();
+		if (dataspace.getSimpleExtentNdims() != 2)
+			return false;
+
+		hsize_t dimensions[2] = { 0, 0 };
+		dataspace.getSimpleExtentDims(dimensions, NULL);
+
+		layout = MatrixLayout();
+		layout.rows = dimensions[0];
+		layout.columns = dimensions[1];
+		layout.nnz = layout.rows * layout.columns;
+		layout.valueSize = local::stored_size(dataset);
+		layout.chunkDimensions = local::chunk_dimensions(dataset);
+		return true;
+	}
+
+	std::uint64_t available_memory()
+	{
+#if defined(_WIN32)
+		MEMORYSTATUSEX status;
+		status.dwLength = sizeof(status);
+		if (GlobalMemoryStatusEx(&status))
+			return status.ullAvailPhys;
+#else
+		std::ifstream meminfo("/proc/meminfo");
+		std::string line;
+		while (std::getline(meminfo, line))
+		{
+			unsigned long long kiloBytes = 0;
+			if (std::sscanf(line.c_str(), "MemAvailable: %llu kB", &kiloBytes) == 1)
+				return static_cast<std::uint64_t>(kiloBytes) * 1024;
+		}
+#if defined(_SC_AVPHYS_PAGES)
+		const long pages = sysconf(_SC_AVPHYS_PAGES);
+		const long pageSize = sysconf(_SC_PAGESIZE);
+		if ((pages > 0) && (pageSize > 0))
+			return static_cast<std::uint64_t>(pages) * static_cast<std::uint64_t>(pageSize);
+#endif
+#endif
+		return 0;
+	}
+
+	std::uint64_t memory_budget(std::uint64_t budget)
+	{
+		if (budget)
+			return budget;
+		const std::uint64_t available = available_memory();
+		return available ? (available / 5) * 4 : std::numeric_limits<std::uint64_t>::max();
+	}
+
+	std::string human_readable_bytes(std::uint64_t bytes)
+	{
+		const std::array<const char*, 5> units = { "B", "KB", "MB", "GB", "TB" };
+		double value = static_cast<double>(bytes);
+		std::size_t unit = 0;
+		while ((value >= 1024.0) && (unit < units.size() - 1))
+		{
+			value /= 1024.0;
+			++unit;
+		}
+		std::ostringstream result;
+		result << std::fixed << std::setprecision(unit ? 1 : 0) << value << " " << units[unit];
+		return result.str();
+	}
+
+	const char* element_type_name(int elementType)
+	{
+		if ((elementType >= 0) && (elementType < static_cast<int>(element_type_names.size())))
+			return element_type_names[elementType];
+		return "float32";
+	}
+
+	const char* strategy_name(LoadStrategy strategy)
+	{
+		switch (strategy)
+		{
+		case LoadStrategy::Dense: return "Dense";
+		case LoadStrategy::DenseSubset: return "Dense (selected dimensions)";
+		case LoadStrategy::Sparse: return "Sparse";
+		case LoadStrategy::Streaming: return "Dense (streamed)";
+		case LoadStrategy::Progressive: return "Dense (progressive)";
+		case LoadStrategy::Backed: return "Backed (shown columns)";
+		}
+		return "";
+	}
+
+	LoadPlanner::LoadPlanner(const MatrixLayout& layout, std::uint64_t budget)
+		: _layout(layout)
+		, _budget(memory_budget(budget))
+	{
+	}
+
+	const MatrixLayout& LoadPlanner::layout() const
+	{
+		return _layout;
+	}
+
+	std::uint64_t LoadPlanner::budget() const
+	{
+		return _budget;
+	}
+
+	LoadEstimate LoadPlanner::estimate(LoadStrategy strategy, int elementType, std::uint64_t selectedColumns) const
+	{
+		LoadEstimate result;
+		result.strategy = strategy;
+		result.elementType = elementType;
+		const bool subset = (strategy == LoadStrategy::DenseSubset) || (strategy == LoadStrategy::Streaming) || (strategy == LoadStrategy::Progressive);
+		result.columns = (subset && selectedColumns) ? std::min(selectedColumns, _layout.columns) : _layout.columns;
+		if (strategy == LoadStrategy::Backed)
+			result.columns = std::min(selectedColumns ? selectedColumns : backed_shown_columns, _layout.columns);
+
+		const std::uint64_t rows = _layout.rows;
+		const std::uint64_t nnz = _layout.nnz;
+		const std::uint64_t elementSize = local::element_size(elementType);
+		const bool bfloat16 = (elementType == local::bfloat16_type);
+		const std::uint64_t denseBytes = rows * result.columns * elementSize;
+
+		// sparse values, indices and index pointers as the loaders hold them before the scatter
+		const std::uint64_t indexSize = local::index_size(_layout.columns);
+		const std::uint64_t indptrSize = local::index_size(nnz);
+		const std::uint64_t sparseSourceBytes = nnz * (elementSize + indexSize) + (rows + 1) * indptrSize + (bfloat16 ? nnz * 4 : 0);
+
+		switch (strategy)
+		{
+		case LoadStrategy::Dense:
+		case LoadStrategy::DenseSubset:
+			result.finalBytes = denseBytes;
+			result.peakBytes = denseBytes + (_layout.sparse ? sparseSourceBytes : (bfloat16 ? rows * result.columns * 4 : 0));
+			break;
+		case LoadStrategy::Sparse:
+			// values are stored as float, indices and index pointers as size_t, next to the vectors they were read into
+			result.finalBytes = nnz * (sizeof(float) + sizeof(std::size_t)) + (rows + 1) * sizeof(std::size_t);
+			result.peakBytes = result.finalBytes + nnz * (_layout.valueSize + std::max<std::uint64_t>(_layout.indexSize, 2)) + (rows + 1) * indptrSize;
+			break;
+		case LoadStrategy::Streaming:
+		case LoadStrategy::Progressive:
+		{
+			// RowBlockReader: 64 bit index pointers and one block of rows, estimated at the average number of nonzeros per row
+			const std::uint64_t blockNnz = (rows > 0) ? std::min(nnz, (nnz / rows + 1) * default_block_rows) : 0;
+			result.finalBytes = denseBytes;
+			result.peakBytes = denseBytes + (rows + 1) * sizeof(std::uint64_t) + blockNnz * (sizeof(float) + sizeof(std::uint32_t));
+			if (strategy == LoadStrategy::Progressive)
+			{
+				// the matrix grows to all blocks from half of them (rounded up), the copy of the old rows is the peak
+				const std::uint64_t blocks = (rows + default_block_rows - 1) / default_block_rows;
+				const std::uint64_t grownRows = (blocks > 1) ? std::min(rows, ((blocks + 1) / 2) * default_block_rows) : 0;
+				result.peakBytes += grownRows * result.columns * elementSize;
+			}
+			break;
+		}
+		case LoadStrategy::Backed:
+		{
+			// BackedPoints: the shown columns as float, the 64 bit index pointers of a sparse matrix and the block cache;
+			// reading the shown columns holds them twice for a moment
+			const std::uint64_t shownBytes = rows * result.columns * sizeof(float);
+			result.finalBytes = shownBytes + (_layout.sparse ? (rows + 1) * sizeof(std::uint64_t) : 0) + std::min(backed_matrix_cache_limit, nnz * (sizeof(float) + sizeof(std::uint32_t)));
+			result.peakBytes = result.finalBytes + shownBytes;
+			break;
+		}
+		}
+
+		result.fitsBudget = (result.peakBytes <= _budget);
+		return result;
+	}
+
+	LoadEstimate LoadPlanner::choose(int elementType, bool allowSparse) const
+	{
+		const LoadEstimate dense = estimate(LoadStrategy::Dense, elementType);
+		if (dense.fitsBudget || !allowSparse || !_layout.sparse)
+			return dense;
+
+		const LoadEstimate sparse = estimate(LoadStrategy::Sparse, elementType);
+		if (sparse.fitsBudget)
+			return sparse;
+		return (sparse.peakBytes < dense.peakBytes) ? sparse : dense;
+	}
+
+	std::string LoadPlanner::report(int elementType) const
+	{
+		std::ostringstream lines;
+		lines << local::grouped(_layout.rows) << " x " << local::grouped(_layout.columns) << ", " << local::grouped(_layout.nnz)
+			<< (_layout.sparse ? " nonzeros (sparse)" : " values (dense)") << "\n";
+
+		lines << "Stored as " << _layout.valueSize << " byte values";
+		if (_layout.sparse)
+			lines << ", " << _layout.indexSize << " byte indices, " << _layout.indptrSize << " byte index pointers";
+		for (std::size_t d = 0; d < _layout.chunkDimensions.size(); ++d)
+			lines << (d ? " x " : ", chunks of ") << _layout.chunkDimensions[d];
+		lines << "\n";
+
+		const std::uint64_t available = available_memory();
+		lines << "Memory budget: " << (_budget == std::numeric_limits<std::uint64_t>::max() ? std::string("unlimited") : human_readable_bytes(_budget))
+			<< " (available: " << (available ? human_readable_bytes(available) : std::string("unknown")) << ")";
+
+		auto line = [&lines](const std::string& name, const LoadEstimate& estimate, bool selected)
+		{
+			lines << "\n" << name << ": peak " << human_readable_bytes(estimate.peakBytes) << ", result " << human_readable_bytes(estimate.finalBytes)
+				<< (estimate.fitsBudget ? "" : " (exceeds budget)") << (selected ? "  <-" : "");
+		};
+
+		const LoadEstimate chosen = choose(elementType, true);
+		for (int type = 0; type < static_cast<int>(element_type_names.size()); ++type)
+		{
+			const bool selected = (chosen.strategy == LoadStrategy::Dense) && (type == elementType);
+			line(std::string(strategy_name(LoadStrategy::Dense)) + " " + element_type_name(type), estimate(LoadStrategy::Dense, type), selected);
+		}
+		if (_layout.sparse)
+		{
+			line(strategy_name(LoadStrategy::Sparse), estimate(LoadStrategy::Sparse, elementType), chosen.strategy == LoadStrategy::Sparse);
+			line(std::string(strategy_name(LoadStrategy::Streaming)) + " " + element_type_name(elementType), estimate(LoadStrategy::Streaming, elementType), false);
+			line(std::string(strategy_name(LoadStrategy::Progressive)) + " " + element_type_name(elementType), estimate(LoadStrategy::Progressive, elementType), false);
+		}
+		line(strategy_name(LoadStrategy::Backed), estimate(LoadStrategy::Backed, elementType), false);
+		return lines.str();
+	}
+}
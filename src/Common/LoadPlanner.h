@@ -0,0 +1,96 @@
+#pragma once
+
+#include "H5Cpp.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace H5Utils
+{
+	// Shape and storage of a matrix in the file, read from the HDF5 metadata only.
+	struct MatrixLayout
+	{
+		std::uint64_t rows = 0;
+		std::uint64_t columns = 0;
+		std::uint64_t nnz = 0; // rows * columns for dense matrices
+		bool sparse = false;
+		std::size_t valueSize = 4; // bytes per value in the file
+		std::size_t indexSize = 0; // bytes per index in the file, sparse only
+		std::size_t indptrSize = 0; // bytes per index pointer in the file, sparse only
+		std::vector<hsize_t> chunkDimensions; // empty if the values are not chunked
+	};
+
+	// Reads the layout of a compressed sparse group, columns is the size of the minor dimension (not stored in the group).
+	bool read_sparse_layout(H5::Group& group, std::uint64_t columns, MatrixLayout& layout, const std::string& dataName = "data", const std::string& indicesName = "indices", const std::string& indptrName = "indptr");
+	bool read_dense_layout(const H5::DataSet& dataset, MatrixLayout& layout);
+
+	// MemAvailable from /proc/meminfo on Linux, the available physical memory elsewhere, 0 if unknown.
+	std::uint64_t available_memory();
+
+	// Returns budget, or 80% of the available memory for a budget of 0 (unlimited if that is unknown).
+	std::uint64_t memory_budget(std::uint64_t budget);
+
+	std::string human_readable_bytes(std::uint64_t bytes);
+
+	enum class LoadStrategy
+	{
+		Dense,       // dense matrix of the selected element type
+		DenseSubset, // dense matrix with only the selected columns
+		Sparse,      // Points::Experimental sparse storage (float values, size_t indices)
+		Streaming,   // dense matrix filled from blocks of rows of a RowBlockReader, no full copy of the sparse data
+		Progressive, // Streaming into a dense matrix that grows with the rows loaded so far, the last growth holds the first half next to the whole
+		Backed       // BackedMatrix left in the file, the points only hold the shown columns (BackedPoints)
+	};
+
+	// Columns a backed matrix shows when none are selected.
+	constexpr std::uint64_t backed_shown_columns = 16;
+
+	const char* strategy_name(LoadStrategy strategy);
+
+	// Names of the PointData::ElementTypeSpecifier values in their order, so the planner does not need PointData.
+	constexpr std::array<const char*, 6> element_type_names = { "float32", "bfloat16", "int16", "uint16", "int8", "uint8" };
+
+	// Name of a PointData::ElementTypeSpecifier, float32 for unknown values.
+	const char* element_type_name(int elementType);
+
+	struct LoadEstimate
+	{
+		LoadStrategy strategy = LoadStrategy::Dense;
+		int elementType = 0; // PointData::ElementTypeSpecifier of the dense strategies
+		std::uint64_t columns = 0;
+		std::uint64_t peakBytes = 0;
+		std::uint64_t finalBytes = 0;
+		bool fitsBudget = false;
+	};
+
+	/*
+	* Estimates peak and final memory of the ways a matrix can be loaded and compares them against a budget.
+	* The estimates follow what the loaders keep in memory: the values in the element type (plus a float staging copy
+	* for bfloat16), indices and index pointers in the narrowest IndexVectorHolder type, and the result.
+	*/
+	class LoadPlanner
+	{
+	public:
+		// A budget of 0 uses 80% of the available memory.
+		explicit LoadPlanner(const MatrixLayout& layout, std::uint64_t budget = 0);
+
+		const MatrixLayout& layout() const;
+		std::uint64_t budget() const;
+
+		// selectedColumns is only used by DenseSubset, Streaming and Progressive, 0 selects all columns. For Backed they are
+		// the shown columns, backed_shown_columns for 0.
+		LoadEstimate estimate(LoadStrategy strategy, int elementType, std::uint64_t selectedColumns = 0) const;
+
+		// Dense in elementType if it fits the budget, otherwise sparse if allowed and possible, otherwise the estimate with the smallest peak.
+		LoadEstimate choose(int elementType, bool allowSparse) const;
+
+		// Dry-run report of the layout, the budget and the estimate of every strategy, one line each.
+		std::string report(int elementType) const;
+
+	private:
+		MatrixLayout _layout;
+		std::uint64_t _budget;
+	};
+}
@@ -0,0 +1,255 @@
+#include "LoadReport.h"
+
+#include "CoalescingFileDriver.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+namespace H5Utils
+{
+	namespace local
+	{
+		std::mutex load_report_mutex;
+		QString load_report_directory;
+
+		double seconds_since(std::chrono::steady_clock::time_point start)
+		{
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		// Limit in bytes from an environment variable in MB, 0 if not set.
+		std::uint64_t environment_limit(const char* variable)
+		{
+			const char* value = std::getenv(variable);
+			return value ? std::strtoull(value, nullptr, 10) * 1024 * 1024 : 0;
+		}
+	}
+
+	void set_load_report_directory(const QString& directory)
+	{
+		std::lock_guard<std::mutex> lock(local::load_report_mutex);
+		local::load_report_directory = directory;
+	}
+
+	QString load_report_directory()
+	{
+		std::lock_guard<std::mutex> lock(local::load_report_mutex);
+		return local::load_report_directory;
+	}
+
+	std::uint64_t process_bytes_read()
+	{
+		std::ifstream io("/proc/self/io");
+		std::string name;
+		std::uint64_t value = 0;
+		while (io >> name >> value)
+		{
+			if (name == "rchar:")
+				return value;
+		}
+		return 0;
+	}
+
+	LoadReport::Phase::Phase(LoadReport* report, const QString& name)
+		: _report(report)
+		, _name(name)
+		, _start(std::chrono::steady_clock::now())
+		, _memory(report ? std::make_unique<MemoryHighWater>() : nullptr)
+	{
+	}
+
+	LoadReport::Phase::~Phase()
+	{
+		end();
+	}
+
+	void LoadReport::Phase::next(const QString& name)
+	{
+		end();
+		_name = name;
+		_start = std::chrono::steady_clock::now();
+		_memory = _report ? std::make_unique<MemoryHighWater>() : nullptr;
+	}
+
+	void LoadReport::Phase::end()
+	{
+		if (!_memory)
+			return;
+		_memory->end();
+		_report->addPhase(_name, local::seconds_since(_start), _memory.get());
+		_memory.reset();
+	}
+
+	LoadReport::LoadReport(const QString& loader, const QString& fileName)
+		: _loader(loader)
+		, _fileName(fileName)
+		, _start(std::chrono::steady_clock::now())
+		, _bytesReadAtStart(process_bytes_read())
+	{
+		reset_coalescing_statistics();
+		reset_tracked_memory_peak();
+	}
+
+	void LoadReport::addPhase(const QString& name, double seconds, const MemoryHighWater* memory)
+	{
+		auto phase = std::find_if(_phases.begin(), _phases.end(), [&name](const PhaseRecord& record) { return record.name == name; });
+		if (phase == _phases.end())
+		{
+			_phases.push_back(PhaseRecord());
+			phase = std::prev(_phases.end());
+			phase->name = name;
+		}
+		phase->seconds += seconds;
+		if (memory)
+		{
+			phase->residentBytes = memory->residentAtEnd();
+			phase->peakResidentBytes = std::max(phase->peakResidentBytes, memory->peakResident());
+			phase->peakTrackedBytes = std::max(phase->peakTrackedBytes, memory->peakTracked());
+		}
+	}
+
+	void LoadReport::set(const QString& key, const QJsonValue& value)
+	{
+		_values[key] = value;
+	}
+
+	void LoadReport::setFileStatistics(const H5::H5File& file)
+	{
+		const hid_t fileId = file.getId();
+		QJsonObject statistics;
+
+		hsize_t fileSize = 0;
+		if (H5Fget_filesize(fileId, &fileSize) >= 0)
+			statistics["fileSize"] = static_cast<double>(fileSize);
+
+		double hitRate = 0;
+		if (H5Fget_mdc_hit_rate(fileId, &hitRate) >= 0)
+			statistics["metadataCacheHitRate"] = hitRate;
+		size_t maxSize = 0, minCleanSize = 0, currentSize = 0;
+		int entries = 0;
+		if (H5Fget_mdc_size(fileId, &maxSize, &minCleanSize, &currentSize, &entries) >= 0)
+		{
+			statistics["metadataCacheBytes"] = static_cast<double>(currentSize);
+			statistics["metadataCacheMaxBytes"] = static_cast<double>(maxSize);
+			statistics["metadataCacheEntries"] = entries;
+		}
+
+		// HDF5 has no public chunk cache counters, so its configuration is reported
+		const H5::FileAccPropList fapl = file.getAccessPlist();
+		int metadataElements = 0;
+		size_t chunkSlots = 0, chunkBytes = 0;
+		double preemption = 0;
+		if (H5Pget_cache(fapl.getId(), &metadataElements, &chunkSlots, &chunkBytes, &preemption) >= 0)
+		{
+			statistics["chunkCacheSlots"] = static_cast<double>(chunkSlots);
+			statistics["chunkCacheBytes"] = static_cast<double>(chunkBytes);
+			statistics["chunkCachePreemption"] = preemption;
+		}
+
+		const CoalescingStatistics coalescing = coalescing_statistics();
+		if (coalescing.hits + coalescing.misses + coalescing.passthroughReads)
+		{
+			QJsonObject driver;
+			driver["hits"] = static_cast<double>(coalescing.hits);
+			driver["misses"] = static_cast<double>(coalescing.misses);
+			driver["passthroughReads"] = static_cast<double>(coalescing.passthroughReads);
+			driver["underlyingReads"] = static_cast<double>(coalescing.underlyingReads);
+			driver["underlyingBytes"] = static_cast<double>(coalescing.underlyingBytes);
+			statistics["coalescingDriver"] = driver;
+		}
+		_fileStatistics = statistics;
+	}
+
+	QJsonObject LoadReport::toJson() const
+	{
+		QJsonObject result;
+		result["loader"] = _loader;
+		result["file"] = _fileName;
+		result["date"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+		result["totalSeconds"] = local::seconds_since(_start);
+
+		QJsonArray phases;
+		std::uint64_t peakResident = 0;
+		for (const auto& phase : _phases)
+		{
+			QJsonObject item;
+			item["name"] = phase.name;
+			item["seconds"] = phase.seconds;
+			item["residentBytes"] = static_cast<double>(phase.residentBytes);
+			item["peakResidentBytes"] = static_cast<double>(phase.peakResidentBytes);
+			item["peakTrackedBytes"] = static_cast<double>(phase.peakTrackedBytes);
+			phases.append(item);
+			peakResident = std::max(peakResident, phase.peakResidentBytes);
+		}
+		result["phases"] = phases;
+
+		const std::uint64_t bytesRead = process_bytes_read();
+		if (bytesRead)
+			result["bytesRead"] = static_cast<double>(bytesRead - _bytesReadAtStart);
+		if (peakResident)
+			result["peakResidentBytes"] = static_cast<double>(peakResident);
+
+		// the buffers that make up the tracked peak, largest first
+		const TrackedMemoryPeak trackedPeak = tracked_memory_peak();
+		result["peakTrackedBytes"] = static_cast<double>(trackedPeak.bytes);
+		QJsonArray buffers;
+		for (std::size_t i = 0; i < std::min<std::size_t>(trackedPeak.buffers.size(), 10); ++i)
+		{
+			QJsonObject item;
+			item["name"] = QString::fromStdString(trackedPeak.buffers[i].first);
+			item["bytes"] = static_cast<double>(trackedPeak.buffers[i].second);
+			buffers.append(item);
+		}
+		result["largestBuffersAtPeak"] = buffers;
+
+		for (auto it = _values.constBegin(); it != _values.constEnd(); ++it)
+			result[it.key()] = it.value();
+		if (!_fileStatistics.isEmpty())
+			result["hdf5"] = _fileStatistics;
+		return result;
+	}
+
+	void LoadReport::finish(mv::Dataset<Points>& points)
+	{
+		const QJsonObject report = toJson();
+		const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+		if (points.isValid())
+			points->setProperty("Load Report", QString::fromUtf8(json));
+
+		const QString directory = load_report_directory();
+		if (!directory.isEmpty())
+		{
+			QDir().mkpath(directory);
+			const QString fileName = QDir(directory).filePath(QString("%1-%2.json").arg(QFileInfo(_fileName).completeBaseName(), QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss")));
+			QFile file(fileName);
+			if (file.open(QIODevice::WriteOnly))
+				file.write(json);
+			else
+				std::cout << "Could not write load report " << fileName.toStdString() << std::endl;
+		}
+
+		// assertion mode for CI runs on standard files
+		const std::uint64_t peakLimit = local::environment_limit("MV_H5_ASSERT_PEAK_MB");
+		const std::uint64_t trackedPeakLimit = local::environment_limit("MV_H5_ASSERT_TRACKED_PEAK_MB");
+		const std::uint64_t peakResident = static_cast<std::uint64_t>(report.value("peakResidentBytes").toDouble());
+		const std::uint64_t peakTracked = static_cast<std::uint64_t>(report.value("peakTrackedBytes").toDouble());
+		if ((peakLimit && (peakResident > peakLimit)) || (trackedPeakLimit && (peakTracked > trackedPeakLimit)))
+		{
+			std::cerr << "Load of " << _fileName.toStdString() << " exceeded its memory limit: peak resident " << peakResident / (1024 * 1024) << " MB (limit " << peakLimit / (1024 * 1024)
+				<< " MB), peak tracked " << peakTracked / (1024 * 1024) << " MB (limit " << trackedPeakLimit / (1024 * 1024) << " MB)" << std::endl;
+			std::cerr << json.toStdString() << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+	}
+}
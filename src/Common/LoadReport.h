@@ -0,0 +1,101 @@
+#pragma once
+
+#include "H5Cpp.h"
+
+#include "MemoryTracker.h"
+
+#include "PointData/PointData.h"
+#include "Dataset.h"
+
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QString>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace H5Utils
+{
+	// Directory every load report is also written to as a JSON file, empty (the default) only stores it on the dataset.
+	void set_load_report_directory(const QString& directory);
+	QString load_report_directory();
+
+	// Bytes the process read with read system calls so far (Linux /proc/self/io), 0 if unknown.
+	std::uint64_t process_bytes_read();
+
+	/*
+	* Structured report of one load: the time and memory high-water marks of each phase, what was loaded and how, bytes
+	* read, the largest tracked buffers at the peak and the HDF5 metadata and chunk cache statistics of the file. The
+	* loaders create it in open() and finish it on the points dataset, where it is stored as the "Load Report" property
+	* (JSON text).
+	*
+	* For CI, the MV_H5_ASSERT_PEAK_MB and MV_H5_ASSERT_TRACKED_PEAK_MB environment variables set a limit on the peak
+	* resident and the peak tracked memory of a load. finish() exits the process with EXIT_FAILURE when one is exceeded.
+	*/
+	class LoadReport
+	{
+	public:
+		// Adds the time and memory high-water marks from its construction to its destruction to a phase, does nothing
+		// for a null report. Phases must nest, use next() to go from one phase to the following one.
+		class Phase
+		{
+		public:
+			Phase(LoadReport* report, const QString& name);
+			~Phase();
+
+			Phase(const Phase&) = delete;
+			Phase& operator=(const Phase&) = delete;
+
+			// Ends this phase and starts the next one.
+			void next(const QString& name);
+
+			// Ends the phase before its destruction.
+			void end();
+
+		private:
+			LoadReport* _report;
+			QString _name;
+			std::chrono::steady_clock::time_point _start;
+			std::unique_ptr<MemoryHighWater> _memory;
+		};
+
+		LoadReport(const QString& loader, const QString& fileName);
+
+		// Phases are reported in the order they were first timed, time of a repeated phase is summed and its peaks are the maximum.
+		// Common phases: open, structure scan, read (includes decompression), convert, scatter, transform, metadata, dataset creation.
+		void addPhase(const QString& name, double seconds, const MemoryHighWater* memory = nullptr);
+
+		// Values like nnz, storageType and strategy.
+		void set(const QString& key, const QJsonValue& value);
+
+		// Metadata cache hit rate and size, chunk cache configuration and file size of an open file, and the
+		// statistics of the read-coalescing driver since the construction of the report.
+		void setFileStatistics(const H5::H5File& file);
+
+		QJsonObject toJson() const;
+
+		// Stores the report on points and writes it to the report directory, if any.
+		void finish(mv::Dataset<Points>& points);
+
+	private:
+		QString _loader;
+		QString _fileName;
+		std::chrono::steady_clock::time_point _start;
+		std::uint64_t _bytesReadAtStart = 0;
+		struct PhaseRecord
+		{
+			QString name;
+			double seconds = 0;
+			std::uint64_t residentBytes = 0; // at the end of the last time it ran
+			std::uint64_t peakResidentBytes = 0;
+			std::uint64_t peakTrackedBytes = 0;
+		};
+
+		std::vector<PhaseRecord> _phases;
+		QJsonObject _values;
+		QJsonObject _fileStatistics;
+	};
+}
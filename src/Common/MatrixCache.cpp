@@ -0,0 +1,453 @@
+#include "MatrixCache.h"
+
+#include "H5Utils.h"
+#include "SparseKernels.h"
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QVariant>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+
+namespace H5Utils
+{
+	namespace local
+	{
+		std::atomic<std::uint64_t> matrix_cache_limit{ 0 };
+
+		constexpr char cache_magic[8] = { 'M', 'V', 'H', '5', 'M', 'C', '0', '1' };
+		constexpr std::uint64_t cache_alignment = 64;
+
+		enum class CacheLayout : std::uint32_t { Dense = 0, CSR = 1 };
+
+		// Sections start at multiples of cache_alignment so the mapped values can be accessed in place.
+		struct CacheHeader
+		{
+			char magic[8];
+			std::uint32_t layout;
+			std::int32_t storageType;    // PointData::ElementTypeSpecifier
+			std::uint64_t rows;
+			std::uint64_t columns;
+			std::uint64_t nnz;           // number of stored values
+			std::uint64_t namesOffset;   // dimension names then sample names, each a uint64 count followed by (uint32 size, UTF-8) items
+			std::uint64_t namesSize;
+			std::uint64_t indptrOffset;  // CSR: rows + 1 uint64 row offsets
+			std::uint64_t indicesOffset; // CSR: nnz uint32 column indices
+			std::uint64_t valuesOffset;  // nnz values of the storage type
+			std::uint64_t fileSize;
+		};
+
+		std::uint64_t aligned(std::uint64_t offset)
+		{
+			return ((offset + cache_alignment - 1) / cache_alignment) * cache_alignment;
+		}
+
+		QString entry_path(const QString& key)
+		{
+			return QDir(matrix_cache_directory()).filePath(key + ".mvcache");
+		}
+
+		void append_names(QByteArray& bytes, const std::vector<QString>& names)
+		{
+			const std::uint64_t count = names.size();
+			bytes.append(reinterpret_cast<const char*>(&count), sizeof(count));
+			for (const auto& name : names)
+			{
+				const QByteArray utf8 = name.toUtf8();
+				const std::uint32_t size = static_cast<std::uint32_t>(utf8.size());
+				bytes.append(reinterpret_cast<const char*>(&size), sizeof(size));
+				bytes.append(utf8);
+			}
+		}
+
+		bool read_names(const char*& position, const char* end, std::vector<QString>& names)
+		{
+			std::uint64_t count = 0;
+			if ((end - position) < static_cast<std::ptrdiff_t>(sizeof(count)))
+				return false;
+			std::memcpy(&count, position, sizeof(count));
+			position += sizeof(count);
+			if (count > static_cast<std::uint64_t>(end - position) / sizeof(std::uint32_t))
+				return false;
+
+			names.resize(count);
+			for (auto& name : names)
+			{
+				std::uint32_t size = 0;
+				if ((end - position) < static_cast<std::ptrdiff_t>(sizeof(size)))
+					return false;
+				std::memcpy(&size, position, sizeof(size));
+				position += sizeof(size);
+				if (size > static_cast<std::uint64_t>(end - position))
+					return false;
+				name = QString::fromUtf8(position, size);
+				position += size;
+			}
+			return true;
+		}
+
+		template<typename T>
+		bool is_nonzero(const T& value)
+		{
+			return static_cast<float>(value) != 0.0f;
+		}
+
+		bool write_bytes(QSaveFile& file, const void* data, std::uint64_t size)
+		{
+			const char* bytes = static_cast<const char*>(data);
+			constexpr std::uint64_t maxWrite = 1ull << 30;
+			while (size)
+			{
+				const qint64 written = file.write(bytes, static_cast<qint64>(std::min(size, maxWrite)));
+				if (written <= 0)
+					return false;
+				bytes += written;
+				size -= written;
+			}
+			return true;
+		}
+
+		bool write_padding(QSaveFile& file, std::uint64_t offset)
+		{
+			const std::uint64_t padding = aligned(offset) - offset;
+			if (padding == 0)
+				return true;
+			const char zeros[cache_alignment] = {};
+			return write_bytes(file, zeros, padding);
+		}
+
+		// Newest entries are kept, older entries are removed once the total exceeds limit.
+		void evict_entries(std::uint64_t limit)
+		{
+			const QFileInfoList entries = QDir(matrix_cache_directory()).entryInfoList(QStringList("*.mvcache"), QDir::Files, QDir::Time);
+			std::uint64_t total = 0;
+			for (const auto& entry : entries)
+			{
+				total += entry.size();
+				if (total > limit)
+					QFile::remove(entry.absoluteFilePath());
+			}
+		}
+	}
+
+	void set_matrix_cache_limit(std::uint64_t bytes)
+	{
+		local::matrix_cache_limit = bytes;
+	}
+
+	std::uint64_t matrix_cache_limit()
+	{
+		return local::matrix_cache_limit;
+	}
+
+	QString matrix_cache_directory()
+	{
+		return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("matrix_cache");
+	}
+
+	QString matrix_cache_key(const QString& fileName, const QString& options)
+	{
+		const QFileInfo info(fileName);
+		if (!info.exists())
+			return QString();
+
+		QCryptographicHash hash(QCryptographicHash::Sha1);
+		hash.addData(info.canonicalFilePath().toUtf8());
+		hash.addData(QByteArray::number(info.size()));
+		hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+		hash.addData(options.toUtf8());
+		return QString::fromLatin1(hash.result().toHex());
+	}
+
+	bool has_cached_matrix(const QString& key)
+	{
+		return (matrix_cache_limit() != 0) && !key.isEmpty() && QFileInfo(local::entry_path(key)).exists();
+	}
+
+	bool load_cached_matrix(const QString& key, mv::Dataset<Points>& points)
+	{
+		if ((matrix_cache_limit() == 0) || key.isEmpty())
+			return false;
+
+		QFile file(local::entry_path(key));
+		if (!file.open(QIODevice::ReadOnly))
+			return false;
+
+		const std::uint64_t fileSize = file.size();
+		if (fileSize < sizeof(local::CacheHeader))
+			return false;
+		const uchar* mapped = file.map(0, fileSize);
+		if (!mapped)
+			return false;
+		const char* begin = reinterpret_cast<const char*>(mapped);
+
+		local::CacheHeader header;
+		std::memcpy(&header, begin, sizeof(header));
+		const bool csr = (header.layout == static_cast<std::uint32_t>(local::CacheLayout::CSR));
+		bool valid = (std::memcmp(header.magic, local::cache_magic, sizeof(header.magic)) == 0) && (header.fileSize == fileSize);
+		valid &= (header.namesOffset + header.namesSize <= fileSize);
+		if (csr)
+		{
+			valid &= (header.rows < fileSize) && (header.indptrOffset + (header.rows + 1) * sizeof(std::uint64_t) <= fileSize);
+			valid &= (header.nnz < fileSize) && (header.indicesOffset + header.nnz * sizeof(std::uint32_t) <= fileSize);
+		}
+		else
+		{
+			valid &= (header.layout == static_cast<std::uint32_t>(local::CacheLayout::Dense)) && (header.nnz == header.rows * header.columns);
+		}
+
+		std::vector<QString> dimensionNames;
+		std::vector<QString> sampleNames;
+		if (valid)
+		{
+			const char* position = begin + header.namesOffset;
+			const char* end = position + header.namesSize;
+			valid = local::read_names(position, end, dimensionNames) && local::read_names(position, end, sampleNames);
+		}
+
+		if (valid)
+		{
+			visit_storage_type(header.storageType, [&](auto elementTypeIdentity)
+				{
+					typedef typename decltype(elementTypeIdentity)::type T;
+
+					if ((storage_type_of<T>() != header.storageType) || (header.valuesOffset + header.nnz * sizeof(T) > fileSize))
+					{
+						valid = false;
+						return;
+					}
+
+					std::vector<T> data;
+					try
+					{
+						data.resize(header.rows * header.columns);
+					}
+					catch (const std::bad_alloc&)
+					{
+						valid = false;
+						return;
+					}
+
+					const T* values = reinterpret_cast<const T*>(begin + header.valuesOffset);
+					if (csr)
+					{
+						const std::uint64_t* indptr = reinterpret_cast<const std::uint64_t*>(begin + header.indptrOffset);
+						const std::uint32_t* indices = reinterpret_cast<const std::uint32_t*>(begin + header.indicesOffset);
+						if ((indptr[0] != 0) || (indptr[header.rows] != header.nnz))
+						{
+							valid = false;
+							return;
+						}
+						std::atomic<bool> indicesValid = true;
+						parallel_for_nnz_ranges(indptr, static_cast<std::int64_t>(header.rows), "MatrixCache CSR worker", [&](std::int64_t rowBegin, std::int64_t rowEnd)
+							{
+								bool rangeValid = true;
+								for (std::int64_t row = rowBegin; row < rowEnd; ++row)
+								{
+									const std::uint64_t first = indptr[row];
+									const std::uint64_t last = std::min(indptr[row + 1], header.nnz);
+									T* rowData = data.data() + row * header.columns;
+									for (std::uint64_t k = first; k < last; ++k)
+									{
+										if (indices[k] < header.columns)
+											rowData[indices[k]] = values[k];
+										else
+											rangeValid = false;
+									}
+								}
+								if (!rangeValid)
+									indicesValid = false;
+							});
+						valid = indicesValid;
+					}
+					else
+					{
+						constexpr std::int64_t blockSize = 4 * 1024 * 1024;
+						const std::int64_t nrOfBlocks = static_cast<std::int64_t>((data.size() + blockSize - 1) / blockSize);
+						#pragma omp parallel for
+						for (std::int64_t block = 0; block < nrOfBlocks; ++block)
+						{
+							const std::uint64_t first = block * blockSize;
+							std::memcpy(data.data() + first, values + first, std::min<std::uint64_t>(blockSize, data.size() - first) * sizeof(T));
+						}
+					}
+
+					if (valid)
+					{
+						points->setDataElementType<T>();
+						points->setData(std::move(data), header.columns);
+					}
+				});
+		}
+
+		file.unmap(const_cast<uchar*>(mapped));
+		if (!valid)
+		{
+			std::cout << "Removing invalid matrix cache entry " << key.toStdString() << std::endl;
+			file.close();
+			file.remove();
+			return false;
+		}
+
+		points->setDimensionNames(dimensionNames);
+		if (!sampleNames.empty())
+			points->setProperty("Sample Names", QVariantList(sampleNames.cbegin(), sampleNames.cend()));
+
+		// the modification time orders the entries for eviction
+		file.close();
+		if (file.open(QIODevice::ReadWrite))
+			file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+		std::cout << "Loaded " << header.rows << " x " << header.columns << " values from the matrix cache" << std::endl;
+		return true;
+	}
+
+	bool store_cached_matrix(const QString& key, mv::Dataset<Points>& points)
+	{
+		const std::uint64_t limit = matrix_cache_limit();
+		if ((limit == 0) || key.isEmpty() || !points.isValid())
+			return false;
+
+		const std::uint64_t rows = points->getNumPoints();
+		const std::uint64_t columns = points->getNumDimensions();
+		if ((rows == 0) || (columns == 0))
+			return false;
+
+		QByteArray names;
+		local::append_names(names, points->getDimensionNames());
+		std::vector<QString> sampleNames;
+		for (const auto& sampleName : points->getProperty("Sample Names").toList())
+			sampleNames.push_back(sampleName.toString());
+		local::append_names(names, sampleNames);
+
+		if (!QDir().mkpath(matrix_cache_directory()))
+			return false;
+
+		bool stored = false;
+		points->visitFromBeginToEnd([&](auto beginOfData, auto endOfData)
+			{
+				typedef std::decay_t<decltype(*beginOfData)> T;
+
+				if (static_cast<std::uint64_t>(endOfData - beginOfData) != rows * columns)
+					return;
+				const T* values = &(*beginOfData);
+
+				// rows + 1 offsets of the nonzeros, only stored when CSR is smaller than the dense matrix
+				std::vector<std::uint64_t> indptr(rows + 1, 0);
+				#pragma omp parallel for schedule(dynamic, 256)
+				for (std::int64_t row = 0; row < static_cast<std::int64_t>(rows); ++row)
+				{
+					const T* rowData = values + row * columns;
+					indptr[row + 1] = std::count_if(rowData, rowData + columns, [](const T& value) { return local::is_nonzero(value); });
+				}
+				std::partial_sum(indptr.cbegin(), indptr.cend(), indptr.begin());
+				const std::uint64_t nonzeros = indptr.back();
+
+				const std::uint64_t denseBytes = rows * columns * sizeof(T);
+				const std::uint64_t csrBytes = (rows + 1) * sizeof(std::uint64_t) + nonzeros * (sizeof(std::uint32_t) + sizeof(T));
+				const bool csr = (columns <= std::numeric_limits<std::uint32_t>::max()) && (csrBytes < denseBytes);
+
+				local::CacheHeader header = {};
+				std::memcpy(header.magic, local::cache_magic, sizeof(header.magic));
+				header.layout = static_cast<std::uint32_t>(csr ? local::CacheLayout::CSR : local::CacheLayout::Dense);
+				header.storageType = storage_type_of<T>();
+				header.rows = rows;
+				header.columns = columns;
+				header.nnz = csr ? nonzeros : rows * columns;
+				header.namesOffset = local::aligned(sizeof(header));
+				header.namesSize = names.size();
+				std::uint64_t offset = local::aligned(header.namesOffset + header.namesSize);
+				if (csr)
+				{
+					header.indptrOffset = offset;
+					header.indicesOffset = local::aligned(header.indptrOffset + (rows + 1) * sizeof(std::uint64_t));
+					offset = local::aligned(header.indicesOffset + nonzeros * sizeof(std::uint32_t));
+				}
+				header.valuesOffset = offset;
+				header.fileSize = header.valuesOffset + header.nnz * sizeof(T);
+
+				if (header.fileSize > limit)
+					return;
+
+				// the entry only appears once it is complete
+				QSaveFile file(local::entry_path(key));
+				if (!file.open(QIODevice::WriteOnly))
+					return;
+
+				bool ok = local::write_bytes(file, &header, sizeof(header)) && local::write_padding(file, sizeof(header));
+				ok = ok && local::write_bytes(file, names.constData(), names.size()) && local::write_padding(file, header.namesOffset + header.namesSize);
+				if (ok && csr)
+				{
+					ok = local::write_bytes(file, indptr.data(), indptr.size() * sizeof(std::uint64_t));
+					ok = ok && local::write_padding(file, header.indptrOffset + indptr.size() * sizeof(std::uint64_t));
+
+					// indices and values are gathered in blocks of rows so the matrix is never copied as a whole
+					constexpr std::uint64_t blockValues = 4 * 1024 * 1024;
+					std::vector<std::uint32_t> indexBuffer;
+					std::vector<T> valueBuffer;
+					for (int pass = 0; ok && (pass < 2); ++pass)
+					{
+						for (std::uint64_t row = 0; ok && (row < rows); ++row)
+						{
+							const T* rowData = values + row * columns;
+							for (std::uint64_t column = 0; column < columns; ++column)
+							{
+								if (local::is_nonzero(rowData[column]))
+								{
+									if (pass == 0)
+										indexBuffer.push_back(static_cast<std::uint32_t>(column));
+									else
+										valueBuffer.push_back(rowData[column]);
+								}
+							}
+							if ((indexBuffer.size() >= blockValues) || ((row + 1) == rows))
+							{
+								ok = local::write_bytes(file, indexBuffer.data(), indexBuffer.size() * sizeof(std::uint32_t));
+								indexBuffer.clear();
+							}
+							if ((valueBuffer.size() >= blockValues) || ((row + 1) == rows))
+							{
+								ok = ok && local::write_bytes(file, valueBuffer.data(), valueBuffer.size() * sizeof(T));
+								valueBuffer.clear();
+							}
+						}
+						if (pass == 0)
+							ok = ok && local::write_padding(file, header.indicesOffset + nonzeros * sizeof(std::uint32_t));
+					}
+				}
+				else if (ok)
+				{
+					ok = local::write_bytes(file, values, denseBytes);
+				}
+
+				stored = ok && file.commit();
+				if (!stored)
+					file.cancelWriting();
+			});
+
+		if (stored)
+		{
+			std::cout << "Stored " << rows << " x " << columns << " values in the matrix cache" << std::endl;
+			local::evict_entries(limit);
+		}
+		return stored;
+	}
+
+	void clear_matrix_cache()
+	{
+		QDir(matrix_cache_directory()).removeRecursively();
+	}
+}
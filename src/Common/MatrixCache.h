@@ -0,0 +1,39 @@
+#pragma once
+
+#include "PointData/PointData.h"
+#include "Dataset.h"
+
+#include <QString>
+
+#include <cstdint>
+
+namespace H5Utils
+{
+	/*
+	* Opt-in on-disk cache of loaded matrices. An entry holds the final typed matrix of a load (dense, or CSR when
+	* that is smaller) with its dimension and sample names in a flat binary layout that is memory mapped on a hit, so
+	* reloading a file skips decompression, type optimization, dimension filtering and transforms. Entries are keyed
+	* by the file (path, size and modification time) and the load options, the least recently used entries are
+	* removed when the cache exceeds its size limit.
+	*/
+
+	// Size limit of the cache in bytes, 0 (the default) disables the cache.
+	void set_matrix_cache_limit(std::uint64_t bytes);
+	std::uint64_t matrix_cache_limit();
+
+	QString matrix_cache_directory();
+
+	// Key for loading fileName with options (storage type, transform, selected dimensions, ...), empty if the file does not exist.
+	QString matrix_cache_key(const QString& fileName, const QString& options);
+
+	// Whether an entry exists for key, so a loader can skip reading what it only needs to decode the matrix.
+	bool has_cached_matrix(const QString& key);
+
+	// Sets the element type, values, dimension names and "Sample Names" of points from the cache, false on a miss.
+	bool load_cached_matrix(const QString& key, mv::Dataset<Points>& points);
+
+	// Stores the matrix of points and removes the least recently used entries that no longer fit.
+	bool store_cached_matrix(const QString& key, mv::Dataset<Points>& points);
+
+	void clear_matrix_cache();
+}
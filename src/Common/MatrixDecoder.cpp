@@ -0,0 +1,466 @@
+#include "MatrixDecoder.h"
+
+#include "H5Readers.h"
+#include "MemoryTracker.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+namespace H5Utils
+{
+	namespace local
+	{
+		bool read_strings(H5::Group& group, const std::string& name, std::vector<std::string>& result)
+		{
+			if (!group.exists(name) || (group.childObjType(name) != H5O_TYPE_DATASET))
+				return false;
+			return read_vector_string(group.openDataSet(name), result);
+		}
+
+		std::string string_attribute(const H5::H5Object& object, const std::string& name)
+		{
+			std::string value;
+			if (object.attrExists(name))
+			{
+				H5::Attribute attribute = object.openAttribute(name);
+				if (attribute.getTypeClass() == H5T_STRING)
+					attribute.read(attribute.getDataType(), value);
+			}
+			return value;
+		}
+
+		void transform_values(float* matrix, std::uint64_t size, TRANSFORM::Type transform)
+		{
+			if (transform.first == TRANSFORM::NONE)
+				return;
+			#pragma omp parallel for
+			for (std::int64_t i = 0; i < static_cast<std::int64_t>(size); ++i)
+			{
+				if (matrix[i] != 0)
+					matrix[i] = static_cast<float>(transform_value(matrix[i], transform));
+			}
+		}
+
+		void no_progress(std::uint64_t)
+		{
+		}
+
+		struct Matrix
+		{
+			float* data = nullptr;
+			bool zeroed = true; // false when the sink handed out uninitialized memory that the scatter has to zero fill
+		};
+
+		Matrix allocate(MatrixSink& sink, std::uint64_t rows, std::uint64_t columns)
+		{
+			Matrix matrix;
+			try
+			{
+				matrix.data = sink.allocateUninitialized(rows, columns);
+				matrix.zeroed = (matrix.data == nullptr);
+				if (matrix.data == nullptr)
+					matrix.data = sink.allocate(rows, columns);
+			}
+			catch (const std::bad_alloc&)
+			{
+				matrix.data = nullptr;
+			}
+			if (matrix.data == nullptr)
+				std::cout << "not enough memory for " << rows << " x " << columns << " values\n";
+			return matrix;
+		}
+
+		template<bool accumulate = false>
+		void scatter(const Matrix& matrix, const CompressedMatrix& compressed, const std::vector<float>& values, TRANSFORM::Type transform)
+		{
+			MV_H5_TRACE_SCOPE("decode scatter");
+			if (matrix.zeroed)
+				scatter_compressed_matrix<accumulate>(matrix.data, compressed, values, transform, no_progress);
+			else
+				scatter_compressed_matrix<accumulate, true>(matrix.data, compressed, values, transform, no_progress);
+		}
+
+		// data, or data16 (bfloat16 bits), as float
+		bool read_10x_values(H5::Group& group, std::vector<float>& values)
+		{
+			if (group.exists("data"))
+				return read_vector_values(group, "data", &values);
+
+			std::vector<std::uint16_t> bits;
+			if (!read_vector(group, "data16", &bits))
+				return false;
+			values.resize(bits.size());
+			#pragma omp parallel for
+			for (std::int64_t i = 0; i < static_cast<std::int64_t>(bits.size()); ++i)
+			{
+				const std::uint32_t raw = static_cast<std::uint32_t>(bits[i]) << 16;
+				std::memcpy(&values[i], &raw, sizeof(float));
+			}
+			return true;
+		}
+
+		bool decode_10x(H5::H5File& file, MatrixSink& sink, const DecodeOptions& options, DecodeResult& result)
+		{
+			H5::Group group = file.openGroup(file.getObjnameByIdx(0));
+
+			std::vector<std::string> barcodes;
+			std::vector<std::string> genes;
+			read_strings(group, "barcodes", barcodes);
+			if (!read_strings(group, "genes", genes) && group.exists("features"))
+			{
+				H5::Group features = group.openGroup("features");
+				if (!read_strings(features, "name", genes))
+					read_strings(features, "id", genes);
+			}
+
+			const std::uint64_t rows = barcodes.size();
+			const std::uint64_t columns = genes.size();
+			const std::string valuesName = group.exists("data") ? "data" : "data16";
+			CompressedMatrix compressed;
+			std::vector<float> values;
+			{
+				MV_H5_TRACE_SCOPE("decode read");
+				if (!read_compressed_matrix(group, rows, columns, false, compressed, valuesName) || !read_10x_values(group, values))
+				{
+					std::cout << "indptr, indices or data missing, or they do not match " << rows << " barcodes and " << columns << " genes\n";
+					return false;
+				}
+			}
+			const TrackedBuffer trackedIndices("indices and indptr", compressed.bytes());
+			const TrackedBuffer trackedValues("data", values);
+
+			const Matrix matrix = allocate(sink, rows, columns);
+			if (matrix.data == nullptr)
+				return false;
+			scatter(matrix, compressed, values, options.transform);
+			result.rows = rows;
+			result.columns = columns;
+			result.nnz = values.size();
+			sink.setRowNames(std::move(barcodes));
+			sink.setColumnNames(std::move(genes));
+
+			if (options.metadata && group.exists("meta"))
+			{
+				H5::Group meta = group.openGroup("meta");
+				for (hsize_t m = 0; m < meta.getNumObjs(); ++m)
+				{
+					const std::string name = meta.getObjnameByIdx(m);
+					if (meta.getObjTypeByIdx(m) != H5G_GROUP)
+						continue;
+					H5::Group labelGroup = meta.openGroup(name);
+					std::vector<std::string> labels;
+					if (read_strings(labelGroup, "l", labels) && (labels.size() == rows))
+						sink.addRowLabels(name, std::move(labels));
+				}
+			}
+			return true;
+		}
+
+		// t_exon/t_intron are row compressed per sample, exon/intron column compressed per gene. The result is their sum.
+		bool decode_tome(H5::H5File& file, MatrixSink& sink, const DecodeOptions& options, DecodeResult& result)
+		{
+			H5::Group data = file.openGroup("data");
+			const bool transposed = data.exists("t_exon") && data.exists("t_intron");
+			if (!transposed && !(data.exists("exon") && data.exists("intron")))
+			{
+				std::cout << "data has no exon and intron counts\n";
+				return false;
+			}
+
+			Matrix matrix;
+			std::uint64_t rows = 0;
+			std::uint64_t columns = 0;
+			for (int step = 0; step < 2; ++step)
+			{
+				const std::string name = transposed ? ((step == 0) ? "t_exon" : "t_intron") : ((step == 0) ? "exon" : "intron");
+				H5::Group group = data.openGroup(name);
+
+				// dims are (inner, outer)
+				std::vector<std::uint64_t> dims;
+				read_vector(group, "dims", &dims);
+				if (dims.size() != 2)
+				{
+					std::cout << "invalid sparse matrix in " << name << "\n";
+					return false;
+				}
+				if (step == 0)
+				{
+					rows = transposed ? dims[1] : dims[0];
+					columns = transposed ? dims[0] : dims[1];
+				}
+				else if ((rows != (transposed ? dims[1] : dims[0])) || (columns != (transposed ? dims[0] : dims[1])))
+				{
+					std::cout << "exon and intron counts differ in shape\n";
+					return false;
+				}
+
+				CompressedMatrix compressed;
+				std::vector<float> values;
+				{
+					MV_H5_TRACE_SCOPE("decode read");
+					if (!read_compressed_matrix(group, rows, columns, !transposed, compressed, "x", "i", "p") || !read_vector_values(group, "x", &values))
+					{
+						std::cout << "invalid sparse matrix in " << name << "\n";
+						return false;
+					}
+				}
+				const TrackedBuffer trackedIndices("indices and indptr", compressed.bytes());
+				const TrackedBuffer trackedValues("values", values);
+
+				if (step == 0)
+				{
+					matrix = allocate(sink, rows, columns);
+					if (matrix.data == nullptr)
+						return false;
+					scatter(matrix, compressed, values, TRANSFORM::None());
+					matrix.zeroed = true;
+				}
+				else
+				{
+					// the intron counts add to the exon counts
+					scatter<true>(matrix, compressed, values, TRANSFORM::None());
+				}
+				result.nnz += values.size();
+			}
+			transform_values(matrix.data, rows * columns, options.transform);
+			result.rows = rows;
+			result.columns = columns;
+
+			H5::Group root = file.openGroup("/");
+			std::vector<std::string> names;
+			if (read_strings(root, "sample_names", names) && (names.size() == rows))
+				sink.setRowNames(std::move(names));
+			if (read_strings(root, "gene_names", names) && (names.size() == columns))
+				sink.setColumnNames(std::move(names));
+
+			if (options.metadata && file.exists("sample_meta") && file.openGroup("sample_meta").exists("anno"))
+			{
+				H5::Group anno = file.openGroup("sample_meta").openGroup("anno");
+				const std::string suffix = "_label";
+				for (hsize_t a = 0; a < anno.getNumObjs(); ++a)
+				{
+					const std::string name = anno.getObjnameByIdx(a);
+					if ((name.size() <= suffix.size()) || (name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0))
+						continue;
+					std::vector<std::string> labels;
+					if (read_strings(anno, name, labels) && (labels.size() == rows))
+						sink.addRowLabels(name.substr(0, name.size() - suffix.size()), std::move(labels));
+				}
+			}
+			return true;
+		}
+
+		// Index of an h5ad dataframe: the dataset named by the _index attribute, or _index, or index.
+		bool read_dataframe_index(H5::H5File& file, const std::string& name, std::vector<std::string>& result)
+		{
+			if (!file.exists(name) || (file.childObjType(name) != H5O_TYPE_GROUP))
+				return false;
+			H5::Group group = file.openGroup(name);
+			const std::string indexName = string_attribute(group, "_index");
+			for (const std::string& candidate : { indexName, std::string("_index"), std::string("index") })
+			{
+				if (!candidate.empty() && read_strings(group, candidate, result))
+					return true;
+			}
+			return false;
+		}
+
+		bool decode_h5ad(H5::H5File& file, MatrixSink& sink, const DecodeOptions& options, DecodeResult& result)
+		{
+			std::vector<std::string> obsNames;
+			std::vector<std::string> varNames;
+			read_dataframe_index(file, "obs", obsNames);
+			read_dataframe_index(file, "var", varNames);
+
+			std::uint64_t rows = obsNames.size();
+			std::uint64_t columns = varNames.size();
+			if (file.childObjType("X") == H5O_TYPE_DATASET)
+			{
+				H5::DataSet dataset = file.openDataSet("X");
+				H5::DataSpace space = dataset.getSpace();
+				if (space.getSimpleExtentNdims() != 2)
+				{
+					std::cout << "X is not a matrix\n";
+					return false;
+				}
+				hsize_t dimensions[2];
+				space.getSimpleExtentDims(dimensions);
+				rows = dimensions[0];
+				columns = dimensions[1];
+				const Matrix matrix = allocate(sink, rows, columns);
+				if (matrix.data == nullptr)
+					return false;
+				if (!matrix.zeroed)
+					parallel_zero_fill(matrix.data, static_cast<std::int64_t>(rows), columns);
+				{
+					MV_H5_TRACE_SCOPE("decode read");
+					if (((rows * columns) > 0) && !read_sharded(dataset, H5::PredType::NATIVE_FLOAT, matrix.data))
+						dataset.read(matrix.data, H5::PredType::NATIVE_FLOAT);
+				}
+				transform_values(matrix.data, rows * columns, options.transform);
+				result.nnz = rows * columns;
+			}
+			else
+			{
+				H5::Group group = file.openGroup("X");
+				const bool csc = (string_attribute(group, "encoding-type") == "csc_matrix") || (string_attribute(group, "h5sparse_format") == "csc");
+				if (group.attrExists("shape"))
+				{
+					H5::Attribute attribute = group.openAttribute("shape");
+					std::int64_t shape[2] = { 0, 0 };
+					if (attribute.getSpace().getSimpleExtentNpoints() == 2)
+					{
+						attribute.read(H5::PredType::NATIVE_INT64, shape);
+						rows = static_cast<std::uint64_t>(shape[0]);
+						columns = static_cast<std::uint64_t>(shape[1]);
+					}
+				}
+
+				CompressedMatrix compressed;
+				std::vector<float> values;
+				{
+					MV_H5_TRACE_SCOPE("decode read");
+					if (!read_compressed_matrix(group, rows, columns, csc, compressed) || !read_vector_values(group, "data", &values))
+					{
+						std::cout << "X has no indptr, indices or data, or they do not match its shape " << rows << " x " << columns << "\n";
+						return false;
+					}
+				}
+				const TrackedBuffer trackedIndices("indices and indptr", compressed.bytes());
+				const TrackedBuffer trackedValues("data", values);
+
+				const Matrix matrix = allocate(sink, rows, columns);
+				if (matrix.data == nullptr)
+					return false;
+				scatter(matrix, compressed, values, options.transform);
+				result.nnz = values.size();
+			}
+			result.rows = rows;
+			result.columns = columns;
+			if (obsNames.size() == rows)
+				sink.setRowNames(std::move(obsNames));
+			if (varNames.size() == columns)
+				sink.setColumnNames(std::move(varNames));
+
+			// categorical obs columns, groups with categories and codes
+			if (options.metadata && file.exists("obs") && (file.childObjType("obs") == H5O_TYPE_GROUP))
+			{
+				H5::Group obs = file.openGroup("obs");
+				for (hsize_t o = 0; o < obs.getNumObjs(); ++o)
+				{
+					const std::string name = obs.getObjnameByIdx(o);
+					if (obs.getObjTypeByIdx(o) != H5G_GROUP)
+						continue;
+					H5::Group column = obs.openGroup(name);
+					std::vector<std::string> categories;
+					std::vector<std::int32_t> codes;
+					if (!read_strings(column, "categories", categories) || !column.exists("codes") || !read_vector(column, "codes", &codes) || (codes.size() != rows))
+						continue;
+					std::vector<std::string> labels(rows);
+					for (std::uint64_t row = 0; row < rows; ++row)
+					{
+						// -1 is a missing value
+						if ((codes[row] >= 0) && (static_cast<std::size_t>(codes[row]) < categories.size()))
+							labels[row] = categories[codes[row]];
+					}
+					sink.addRowLabels(name, std::move(labels));
+				}
+			}
+			return true;
+		}
+	}
+
+	bool read_compressed_matrix(H5::Group& group, std::uint64_t rows, std::uint64_t columns, bool columnCompressed, CompressedMatrix& matrix, const std::string& valuesName, const std::string& indicesName, const std::string& indptrName)
+	{
+		matrix = CompressedMatrix();
+		matrix.rows = rows;
+		matrix.columns = columns;
+		matrix.columnCompressed = columnCompressed;
+		if (!group.exists(valuesName) || !group.exists(indicesName) || !group.exists(indptrName))
+			return false;
+
+		const std::uint64_t nnz = get_vector_size(group.openDataSet(valuesName));
+		const std::uint64_t outer = columnCompressed ? columns : rows;
+		const std::uint64_t inner = columnCompressed ? rows : columns;
+		if (!read_index_vector(group, indptrName, nnz, matrix.indptr))
+			return false;
+		if (inner > 0)
+		{
+			if (!read_index_vector(group, indicesName, inner, matrix.indices))
+				return false;
+		}
+		else
+		{
+			// the indices are read in the type of the file, their largest one gives the inner dimension
+			if (!read_index_vector(group, indicesName, matrix.indices))
+				return false;
+			const std::uint64_t size = matrix.indices.constVisit<std::uint64_t>([](const auto& indices) { return indices.empty() ? 0 : static_cast<std::uint64_t>(*std::max_element(indices.cbegin(), indices.cend())) + 1; });
+			(columnCompressed ? matrix.rows : matrix.columns) = size;
+		}
+		return (matrix.indices.size() == nnz) && (matrix.indptr.size() == outer + 1) && validate_index_pointers(matrix.indptr, nnz);
+	}
+
+	const char* file_format_name(FileFormat format)
+	{
+		switch (format)
+		{
+		case FileFormat::TenX: return "10X";
+		case FileFormat::TOME: return "TOME";
+		case FileFormat::H5AD: return "h5ad";
+		default: return "unknown";
+		}
+	}
+
+	FileFormat detect_file_format(H5::H5File& file)
+	{
+		if (file.exists("X") && (file.exists("obs") || file.exists("var")))
+			return FileFormat::H5AD;
+		if (file.exists("data") && (file.childObjType("data") == H5O_TYPE_GROUP))
+		{
+			H5::Group data = file.openGroup("data");
+			if (data.exists("t_exon") || data.exists("exon"))
+				return FileFormat::TOME;
+		}
+		if ((file.getNumObjs() > 0) && (file.getObjTypeByIdx(0) == H5G_GROUP))
+		{
+			H5::Group group = file.openGroup(file.getObjnameByIdx(0));
+			if (group.exists("barcodes") && group.exists("indptr"))
+				return FileFormat::TenX;
+		}
+		return FileFormat::Unknown;
+	}
+
+	bool decode_matrix(const std::string& fileName, MatrixSink& sink, const DecodeOptions& options, DecodeResult* result)
+	{
+		MV_H5_TRACE_SCOPE("decode_matrix");
+		DecodeResult localResult;
+		DecodeResult& fileResult = result ? *result : localResult;
+		fileResult = DecodeResult();
+		try
+		{
+			H5::H5File file(fileName, H5F_ACC_RDONLY);
+			fileResult.format = detect_file_format(file);
+			switch (fileResult.format)
+			{
+			case FileFormat::TenX: return local::decode_10x(file, sink, options, fileResult);
+			case FileFormat::TOME: return local::decode_tome(file, sink, options, fileResult);
+			case FileFormat::H5AD: return local::decode_h5ad(file, sink, options, fileResult);
+			default:
+				std::cout << fileName << " is not a 10X, TOME or h5ad file\n";
+				return false;
+			}
+		}
+		catch (const H5::Exception& e)
+		{
+			std::cout << "Could not read " << fileName << ": " << e.getDetailMsg() << std::endl;
+		}
+		catch (const std::bad_alloc&)
+		{
+			std::cout << "Not enough memory to read " << fileName << std::endl;
+		}
+		return false;
+	}
+}
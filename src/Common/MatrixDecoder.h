@@ -0,0 +1,99 @@
+#pragma once
+
+#include "H5Cpp.h"
+#include "IndexVector.h"
+#include "MatrixSink.h"
+#include "SparseKernels.h"
+#include "TransformType.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+* The decode path shared by the loader plugins and the command line tools, without Qt or ManiVault: the indices and
+* index pointers of a compressed sparse matrix are read and checked by read_compressed_matrix, and its values are
+* scattered into a dense matrix by scatter_compressed_matrix, into the points of the plugins (DataContainerInterface)
+* or into a MatrixSink (decode_matrix).
+*/
+
+namespace H5Utils
+{
+	// Indices and index pointers of a compressed sparse matrix, the values are read by the caller in the type it stores.
+	struct CompressedMatrix
+	{
+		std::uint64_t rows = 0;
+		std::uint64_t columns = 0;
+		bool columnCompressed = false; // index pointers per column and row indices (csc), otherwise per row (csr)
+		IndexVectorHolder indices;
+		IndexVectorHolder indptr;
+
+		std::uint64_t nnz() const { return indices.size(); }
+
+		// Bytes held by the indices and the index pointers.
+		std::uint64_t bytes() const { return indices.bytes() + indptr.bytes(); }
+	};
+
+	/*
+	* Reads the indices and the index pointers of a rows x columns matrix in group in the narrowest types, see
+	* read_index_vector, and checks them against the shape and the number of values of valuesName (which is not read).
+	* An inner dimension (columns for csr, rows for csc) of 0 is not known: it is set to the largest index + 1.
+	* Returns false if one of them is missing or they do not match.
+	*/
+	bool read_compressed_matrix(H5::Group& group, std::uint64_t rows, std::uint64_t columns, bool columnCompressed, CompressedMatrix& matrix, const std::string& valuesName = "data", const std::string& indicesName = "indices", const std::string& indptrName = "indptr");
+
+	/*
+	* Scatters values, matrix.nnz() of them, into the row major matrix.rows x matrix.columns matrix at beginOfData,
+	* transformed as they are stored. accumulate adds them to the values already there, zeroFill zero fills the rows
+	* (uninitialized memory) from the threads that scatter into them. progress(steps) is called with the rows done.
+	*/
+	template<bool accumulate = false, bool zeroFill = false, typename OutputIterator, typename T, typename ProgressFunction>
+	void scatter_compressed_matrix(OutputIterator beginOfData, const CompressedMatrix& matrix, const std::vector<T>& values, TRANSFORM::Type transformType, ProgressFunction progress)
+	{
+		const auto rows = static_cast<std::int64_t>(matrix.rows);
+		matrix.indices.constVisit([&](const auto& indices)
+			{
+				matrix.indptr.constVisit([&](const auto& indptr)
+					{
+						if (matrix.columnCompressed)
+							scatter_sparse_columns<accumulate, zeroFill>(beginOfData, rows, static_cast<std::int64_t>(matrix.columns), indices, indptr, values, transformType, progress);
+						else
+							scatter_sparse_rows<accumulate, zeroFill>(beginOfData, rows, matrix.columns, indices, indptr, values, transformType, progress);
+					});
+			});
+	}
+
+	enum class FileFormat
+	{
+		Unknown,
+		TenX,	// <group>/barcodes, genes, indptr, indices, data or data16
+		TOME,	// data/{t_exon,t_intron} or data/{exon,intron}
+		H5AD	// X, obs, var
+	};
+
+	const char* file_format_name(FileFormat format);
+
+	FileFormat detect_file_format(H5::H5File& file);
+
+	struct DecodeOptions
+	{
+		TRANSFORM::Type transform = TRANSFORM::None();
+		bool metadata = true; // categorical row metadata
+	};
+
+	struct DecodeResult
+	{
+		FileFormat format = FileFormat::Unknown;
+		std::uint64_t rows = 0;
+		std::uint64_t columns = 0;
+		std::uint64_t nnz = 0; // nonzeros read, rows x columns for a dense matrix
+	};
+
+	/*
+	* Decodes the matrix, names and categorical metadata of a 10X, TOME or h5ad file into sink as float, with the
+	* readers and the scatter the plugins use, but without their dialogs: all genes, the "Original" data type with the
+	* transform applied, exon and intron counts summed without normalization, and of the h5ad metadata only the
+	* categorical obs columns. Returns false, after printing why, when the file cannot be read.
+	*/
+	bool decode_matrix(const std::string& fileName, MatrixSink& sink, const DecodeOptions& options = DecodeOptions(), DecodeResult* result = nullptr);
+}
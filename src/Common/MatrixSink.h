@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace H5Utils
+{
+	/*
+	* Receives what decode_matrix (MatrixDecoder.h) decodes from a file: a dense row major matrix (rows are cells or
+	* samples, columns are genes), the row and column names and per row labels of categorical metadata. The sink owns
+	* the matrix memory, so an adapter can hand out the storage of its own data structure.
+	*/
+	class MatrixSink
+	{
+	public:
+		virtual ~MatrixSink() = default;
+
+		// Returns a zero initialized rows x columns matrix to fill, nullptr when it cannot be allocated.
+		virtual float* allocate(std::uint64_t rows, std::uint64_t columns) = 0;
+
+		// Returns an uninitialized rows x columns matrix, or nullptr to have the decoder use allocate. The decoder then zero
+		// fills each part of the matrix from the thread that scatters into it, so the memory is written once and its
+		// pages end up on the NUMA node of the thread that wrote them, rather than all on the node of the allocating one.
+		virtual float* allocateUninitialized(std::uint64_t /*rows*/, std::uint64_t /*columns*/) { return nullptr; }
+
+		virtual void setRowNames(std::vector<std::string> /*names*/) {}
+		virtual void setColumnNames(std::vector<std::string> /*names*/) {}
+
+		// Label of every row for the categorical metadata column name.
+		virtual void addRowLabels(const std::string& /*name*/, std::vector<std::string> /*labels*/) {}
+	};
+}
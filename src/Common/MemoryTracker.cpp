@@ -0,0 +1,220 @@
+#include "MemoryTracker.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace H5Utils
+{
+	namespace local
+	{
+		struct MemoryTrackerState
+		{
+			std::mutex mutex;
+			std::map<const TrackedBuffer*, std::pair<const char*, std::uint64_t>> buffers;
+			std::uint64_t current = 0;
+			TrackedMemoryPeak peak;
+			std::uint64_t scopePeak = 0; // tracked peak since the innermost MemoryHighWater began
+			std::uint64_t residentFloor = 0; // resident peaks of ended scopes that a reset of the high-water mark hid
+		};
+
+		MemoryTrackerState& memory_tracker_state()
+		{
+			static MemoryTrackerState state;
+			return state;
+		}
+
+		// Requires the state mutex.
+		void update_tracked_buffer(MemoryTrackerState& state, const TrackedBuffer* buffer, const char* name, std::uint64_t oldBytes, std::uint64_t newBytes)
+		{
+			state.current = state.current - oldBytes + newBytes;
+			if (newBytes)
+				state.buffers[buffer] = { name, newBytes };
+			else
+				state.buffers.erase(buffer);
+
+			state.scopePeak = std::max(state.scopePeak, state.current);
+			if (state.current > state.peak.bytes)
+			{
+				state.peak.bytes = state.current;
+				state.peak.buffers.clear();
+				for (const auto& item : state.buffers)
+					state.peak.buffers.emplace_back(item.second.first, item.second.second);
+				std::sort(state.peak.buffers.begin(), state.peak.buffers.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+			}
+		}
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+		// Value in kB of a field like "VmHWM:" in /proc/self/status.
+		std::uint64_t proc_status_kilobytes(const std::string& field)
+		{
+			std::ifstream status("/proc/self/status");
+			std::string name;
+			while (status >> name)
+			{
+				if (name == field)
+				{
+					std::uint64_t value = 0;
+					status >> value;
+					return value;
+				}
+				status.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+			}
+			return 0;
+		}
+#endif
+	}
+
+	std::uint64_t current_resident_memory()
+	{
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return counters.WorkingSetSize;
+		return 0;
+#elif defined(__APPLE__)
+		mach_task_basic_info_data_t info;
+		mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+		if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) == KERN_SUCCESS)
+			return info.resident_size;
+		return 0;
+#else
+		std::ifstream statm("/proc/self/statm");
+		std::uint64_t size = 0, resident = 0;
+		if (statm >> size >> resident)
+			return resident * static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+		return 0;
+#endif
+	}
+
+	std::uint64_t peak_resident_memory()
+	{
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return counters.PeakWorkingSetSize;
+		return 0;
+#elif defined(__APPLE__)
+		mach_task_basic_info_data_t info;
+		mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+		if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) == KERN_SUCCESS)
+			return info.resident_size_max;
+		return 0;
+#else
+		// unlike ru_maxrss, VmHWM follows reset_peak_resident_memory
+		const std::uint64_t highWaterMark = local::proc_status_kilobytes("VmHWM:");
+		if (highWaterMark)
+			return highWaterMark * 1024;
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0;
+		return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024; // kilobytes
+#endif
+	}
+
+	bool reset_peak_resident_memory()
+	{
+#if defined(_WIN32) || defined(__APPLE__)
+		return false;
+#else
+		std::ofstream clearRefs("/proc/self/clear_refs");
+		return static_cast<bool>(clearRefs << "5" << std::flush);
+#endif
+	}
+
+	std::uint64_t tracked_memory()
+	{
+		local::MemoryTrackerState& state = local::memory_tracker_state();
+		std::lock_guard<std::mutex> lock(state.mutex);
+		return state.current;
+	}
+
+	TrackedMemoryPeak tracked_memory_peak()
+	{
+		local::MemoryTrackerState& state = local::memory_tracker_state();
+		std::lock_guard<std::mutex> lock(state.mutex);
+		return state.peak;
+	}
+
+	void reset_tracked_memory_peak()
+	{
+		local::MemoryTrackerState& state = local::memory_tracker_state();
+		std::lock_guard<std::mutex> lock(state.mutex);
+		state.peak = TrackedMemoryPeak();
+		state.peak.bytes = state.current;
+		for (const auto& item : state.buffers)
+			state.peak.buffers.emplace_back(item.second.first, item.second.second);
+		std::sort(state.peak.buffers.begin(), state.peak.buffers.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+	}
+
+	TrackedBuffer::TrackedBuffer(const char* name, std::uint64_t bytes)
+		: _name(name)
+	{
+		setBytes(bytes);
+	}
+
+	TrackedBuffer::~TrackedBuffer()
+	{
+		setBytes(0);
+	}
+
+	void TrackedBuffer::setBytes(std::uint64_t bytes)
+	{
+		if (bytes == _bytes)
+			return;
+		local::MemoryTrackerState& state = local::memory_tracker_state();
+		std::lock_guard<std::mutex> lock(state.mutex);
+		local::update_tracked_buffer(state, this, _name, _bytes, bytes);
+		_bytes = bytes;
+	}
+
+	MemoryHighWater::MemoryHighWater(bool active)
+		: _active(active)
+	{
+		if (!_active)
+			return;
+		local::MemoryTrackerState& state = local::memory_tracker_state();
+		const std::uint64_t residentPeak = peak_resident_memory();
+		std::lock_guard<std::mutex> lock(state.mutex);
+		_savedResidentPeak = std::max(state.residentFloor, residentPeak);
+		state.residentFloor = 0;
+		reset_peak_resident_memory();
+		_savedTrackedPeak = state.scopePeak;
+		state.scopePeak = state.current;
+	}
+
+	MemoryHighWater::~MemoryHighWater()
+	{
+		end();
+	}
+
+	void MemoryHighWater::end()
+	{
+		if (!_active)
+			return;
+		_active = false;
+		local::MemoryTrackerState& state = local::memory_tracker_state();
+		_residentAtEnd = current_resident_memory();
+		const std::uint64_t residentPeak = peak_resident_memory();
+		std::lock_guard<std::mutex> lock(state.mutex);
+		_peakResident = std::max({ residentPeak, state.residentFloor, _residentAtEnd });
+		state.residentFloor = std::max(_savedResidentPeak, _peakResident);
+		_peakTracked = state.scopePeak;
+		state.scopePeak = std::max(_savedTrackedPeak, state.scopePeak);
+	}
+}
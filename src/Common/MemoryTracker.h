@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace H5Utils
+{
+	// Resident memory of the process in bytes, 0 if unknown.
+	std::uint64_t current_resident_memory();
+
+	// Highest resident memory of the process in bytes since the last reset_peak_resident_memory, 0 if unknown.
+	std::uint64_t peak_resident_memory();
+
+	// Starts a new resident high-water mark (Linux, /proc/self/clear_refs). Returns false where it cannot be reset,
+	// peak_resident_memory then keeps reporting the peak of the whole process.
+	bool reset_peak_resident_memory();
+
+	// Bytes in the TrackedBuffers that are alive.
+	std::uint64_t tracked_memory();
+
+	struct TrackedMemoryPeak
+	{
+		std::uint64_t bytes = 0;
+		std::vector<std::pair<std::string, std::uint64_t>> buffers; // alive at the peak, largest first
+	};
+
+	// Peak of tracked_memory since reset_tracked_memory_peak, with the buffers alive at that moment.
+	TrackedMemoryPeak tracked_memory_peak();
+	void reset_tracked_memory_peak();
+
+	/*
+	* Registers the size of a large buffer owned by the loaders (read buffers, index vectors, conversion copies, the
+	* dense matrix) with the memory tracker for as long as it lives, so a load report can tell which buffers make up the
+	* peak. Register a buffer after it has been filled, the sizes are not updated automatically.
+	*/
+	class TrackedBuffer
+	{
+	public:
+		explicit TrackedBuffer(const char* name, std::uint64_t bytes = 0);
+
+		template<typename Container> requires requires(const Container& container) { container.capacity(); }
+		TrackedBuffer(const char* name, const Container& container)
+			: TrackedBuffer(name, container_bytes(container))
+		{
+		}
+
+		~TrackedBuffer();
+
+		TrackedBuffer(const TrackedBuffer&) = delete;
+		TrackedBuffer& operator=(const TrackedBuffer&) = delete;
+
+		void setBytes(std::uint64_t bytes);
+
+		template<typename Container>
+		static std::uint64_t container_bytes(const Container& container)
+		{
+			return static_cast<std::uint64_t>(container.capacity()) * sizeof(typename Container::value_type);
+		}
+
+	private:
+		const char* _name;
+		std::uint64_t _bytes = 0;
+	};
+
+	/*
+	* Peak resident and tracked memory between its construction and end(). Scopes must nest, an enclosing scope includes
+	* the peaks of the scopes it contains. An inactive scope measures nothing.
+	*/
+	class MemoryHighWater
+	{
+	public:
+		explicit MemoryHighWater(bool active = true);
+		~MemoryHighWater();
+
+		MemoryHighWater(const MemoryHighWater&) = delete;
+		MemoryHighWater& operator=(const MemoryHighWater&) = delete;
+
+		// Ends the scope, only the first call has an effect.
+		void end();
+
+		std::uint64_t residentAtEnd() const { return _residentAtEnd; }
+		std::uint64_t peakResident() const { return _peakResident; }
+		std::uint64_t peakTracked() const { return _peakTracked; }
+
+	private:
+		bool _active;
+		std::uint64_t _savedResidentPeak = 0;
+		std::uint64_t _savedTrackedPeak = 0;
+		std::uint64_t _residentAtEnd = 0;
+		std::uint64_t _peakResident = 0;
+		std::uint64_t _peakTracked = 0;
+	};
+}
@@ -0,0 +1,222 @@
+#include "Prefetcher.h"
+
+#include "LoadPlanner.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace H5Utils
+{
+	namespace local
+	{
+		constexpr std::size_t prefetch_buffer_size = 4 * 1024 * 1024;
+
+		void add_extent(std::vector<FileExtent>& extents, haddr_t address, hsize_t size)
+		{
+			if ((address != HADDR_UNDEF) && (size > 0))
+				extents.push_back({ static_cast<std::uint64_t>(address), static_cast<std::uint64_t>(size) });
+		}
+
+#if H5_VERSION_GE(1,14,0)
+		int add_chunk_extent(const hsize_t* /*offset*/, unsigned /*filterMask*/, haddr_t address, hsize_t size, void* extents)
+		{
+			add_extent(*static_cast<std::vector<FileExtent>*>(extents), address, size);
+			return H5_ITER_CONT;
+		}
+#endif
+
+		void add_object_extents(std::vector<FileExtent>& extents, const H5::Group& parent, const std::string& name)
+		{
+			if (parent.childObjType(name) == H5O_TYPE_GROUP)
+			{
+				const H5::Group group = parent.openGroup(name);
+				const hsize_t nrOfObjects = group.getNumObjs();
+				for (hsize_t o = 0; o < nrOfObjects; ++o)
+					add_object_extents(extents, group, group.getObjnameByIdx(o));
+			}
+			else if (parent.childObjType(name) == H5O_TYPE_DATASET)
+			{
+				const auto datasetExtents = dataset_file_extents(parent.openDataSet(name));
+				extents.insert(extents.end(), datasetExtents.cbegin(), datasetExtents.cend());
+			}
+		}
+
+		std::uint64_t prefetch_limit(std::uint64_t memoryBudget)
+		{
+			std::uint64_t limit = memory_budget(memoryBudget);
+			const std::uint64_t available = available_memory();
+			if (available)
+				limit = std::min(limit, available / 2);
+			return limit;
+		}
+	}
+
+	std::vector<FileExtent> dataset_file_extents(const H5::DataSet& dataset)
+	{
+		std::vector<FileExtent> extents;
+		const H5::DSetCreatPropList plist = dataset.getCreatePlist();
+		switch (plist.getLayout())
+		{
+		case H5D_CONTIGUOUS:
+			local::add_extent(extents, H5Dget_offset(dataset.getId()), dataset.getStorageSize());
+			break;
+		case H5D_CHUNKED:
+		{
+#if H5_VERSION_GE(1,14,0)
+			H5Dchunk_iter(dataset.getId(), H5P_DEFAULT, local::add_chunk_extent, &extents);
+#else
+			const H5::DataSpace dataspace = dataset.getSpace();
+			hsize_t nrOfChunks = 0;
+			if ((H5Dget_num_chunks(dataset.getId(), dataspace.getId(), &nrOfChunks) < 0) || (nrOfChunks == 0))
+				break;
+			// looking up a chunk by index is linear in the number of chunks, so only the first and the last chunk are used
+			haddr_t firstAddress = HADDR_UNDEF, lastAddress = HADDR_UNDEF;
+			hsize_t firstSize = 0, lastSize = 0;
+			unsigned filterMask = 0;
+			if ((H5Dget_chunk_info(dataset.getId(), dataspace.getId(), 0, NULL, &filterMask, &firstAddress, &firstSize) < 0) ||
+				(H5Dget_chunk_info(dataset.getId(), dataspace.getId(), nrOfChunks - 1, NULL, &filterMask, &lastAddress, &lastSize) < 0))
+				break;
+			if ((firstAddress == HADDR_UNDEF) || (lastAddress == HADDR_UNDEF))
+				break;
+			const haddr_t begin = std::min(firstAddress, lastAddress);
+			const haddr_t end = std::max(firstAddress + firstSize, lastAddress + lastSize);
+			local::add_extent(extents, begin, end - begin);
+#endif
+			break;
+		}
+		default:
+			break;
+		}
+
+		std::sort(extents.begin(), extents.end(), [](const FileExtent& a, const FileExtent& b) { return a.offset < b.offset; });
+		std::vector<FileExtent> merged;
+		for (const auto& extent : extents)
+		{
+			if (!merged.empty() && (extent.offset <= merged.back().offset + merged.back().size))
+				merged.back().size = std::max(merged.back().size, extent.offset + extent.size - merged.back().offset);
+			else
+				merged.push_back(extent);
+		}
+		return merged;
+	}
+
+	Prefetcher::Prefetcher(const std::string& fileName, std::vector<FileExtent> extents, std::uint64_t limit)
+	{
+		_thread = std::thread(&Prefetcher::run, this, fileName, std::move(extents), limit);
+	}
+
+	Prefetcher::~Prefetcher()
+	{
+		cancel();
+	}
+
+	void Prefetcher::cancel()
+	{
+		_cancelled = true;
+		if (_thread.joinable())
+			_thread.join();
+	}
+
+	bool Prefetcher::finished() const
+	{
+		return _finished;
+	}
+
+	std::uint64_t Prefetcher::bytesRead() const
+	{
+		return _bytesRead;
+	}
+
+	void Prefetcher::run(std::string fileName, std::vector<FileExtent> extents, std::uint64_t limit)
+	{
+		std::ifstream file(fileName, std::ios::binary);
+		std::vector<char> buffer(local::prefetch_buffer_size);
+		for (const auto& extent : extents)
+		{
+			if (!file)
+				break;
+			file.seekg(static_cast<std::streamoff>(extent.offset));
+			std::uint64_t remaining = extent.size;
+			while ((remaining > 0) && !_cancelled && (_bytesRead < limit))
+			{
+				const std::uint64_t size = std::min<std::uint64_t>({ remaining, buffer.size(), limit - _bytesRead });
+				if (!file.read(buffer.data(), static_cast<std::streamsize>(size)))
+					break;
+				remaining -= size;
+				_bytesRead += size;
+			}
+			if (_cancelled || (_bytesRead >= limit))
+				break;
+		}
+		_finished = true;
+	}
+
+	std::unique_ptr<Prefetcher> prefetch_matrix(H5::H5File& file, const std::string& name, std::uint64_t memoryBudget)
+	{
+		try
+		{
+			// the core driver already holds the whole file in memory
+			if (H5Pget_driver(file.getAccessPlist().getId()) == H5FD_CORE)
+				return nullptr;
+
+			std::vector<FileExtent> extents;
+			auto append = [&extents](const H5::DataSet& dataset)
+			{
+				const auto datasetExtents = dataset_file_extents(dataset);
+				extents.insert(extents.end(), datasetExtents.cbegin(), datasetExtents.cend());
+			};
+
+			// in the order the loaders read them
+			if (file.childObjType(name) == H5O_TYPE_GROUP)
+			{
+				H5::Group group = file.openGroup(name);
+				for (const char* datasetName : { "indptr", "indices", "data", "data16" })
+				{
+					if (group.exists(datasetName))
+						append(group.openDataSet(datasetName));
+				}
+			}
+			else
+			{
+				append(file.openDataSet(name));
+			}
+			if (extents.empty())
+				return nullptr;
+
+			return std::make_unique<Prefetcher>(file.getFileName(), std::move(extents), local::prefetch_limit(memoryBudget));
+		}
+		catch (const H5::Exception& e)
+		{
+			std::cout << "Prefetch of " << name << ": " << e.getCDetailMsg() << std::endl;
+			return nullptr;
+		}
+	}
+
+	std::unique_ptr<Prefetcher> prefetch_objects(H5::H5File& file, const std::vector<std::string>& names, std::uint64_t memoryBudget)
+	{
+		try
+		{
+			if (H5Pget_driver(file.getAccessPlist().getId()) == H5FD_CORE)
+				return nullptr;
+
+			std::vector<FileExtent> extents;
+			for (const auto& name : names)
+			{
+				if (file.exists(name))
+					local::add_object_extents(extents, file, name);
+			}
+			if (extents.empty())
+				return nullptr;
+
+			// the many small datasets of a data frame are read in one pass over the file
+			std::sort(extents.begin(), extents.end(), [](const FileExtent& a, const FileExtent& b) { return a.offset < b.offset; });
+			return std::make_unique<Prefetcher>(file.getFileName(), std::move(extents), local::prefetch_limit(memoryBudget));
+		}
+		catch (const H5::Exception& e)
+		{
+			std::cout << "Prefetch of metadata: " << e.getCDetailMsg() << std::endl;
+			return nullptr;
+		}
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "H5Cpp.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace H5Utils
+{
+	// A byte range of the file that holds (part of) the raw data of a dataset.
+	struct FileExtent
+	{
+		std::uint64_t offset = 0;
+		std::uint64_t size = 0;
+	};
+
+	// Where the raw data of a contiguous or chunked dataset is in the file, sorted by offset with adjacent ranges merged.
+	// Chunked datasets read before HDF5 1.14 give the span from the first to the last chunk. Empty for compact or unallocated data.
+	std::vector<FileExtent> dataset_file_extents(const H5::DataSet& dataset);
+
+	/*
+	* Reads file extents on a background thread into a small staging buffer that is reused, so the data ends up in
+	* the page cache of the operating system and a later HDF5 read of it does not wait for the disk. The thread only
+	* uses plain file reads, never the HDF5 library, which may not be thread-safe. Reading stops at limit bytes, on
+	* cancel() and when the prefetcher is destroyed.
+	*/
+	class Prefetcher
+	{
+	public:
+		Prefetcher(const std::string& fileName, std::vector<FileExtent> extents, std::uint64_t limit);
+		~Prefetcher();
+
+		Prefetcher(const Prefetcher&) = delete;
+		Prefetcher& operator=(const Prefetcher&) = delete;
+
+		// Stops reading and waits for the thread.
+		void cancel();
+
+		bool finished() const;
+		std::uint64_t bytesRead() const;
+
+	private:
+		void run(std::string fileName, std::vector<FileExtent> extents, std::uint64_t limit);
+
+		std::atomic<bool> _cancelled = false;
+		std::atomic<bool> _finished = false;
+		std::atomic<std::uint64_t> _bytesRead = 0;
+		std::thread _thread;
+	};
+
+	// Starts prefetching the matrix object name of file: the index pointers, indices and values of a sparse group,
+	// or a dense dataset. Limited to the memory budget and half of the available memory. Returns null when there is
+	// nothing to prefetch, for instance when the file is already held in memory by the core driver.
+	std::unique_ptr<Prefetcher> prefetch_matrix(H5::H5File& file, const std::string& name, std::uint64_t memoryBudget = 0);
+
+	// Starts prefetching every dataset in the objects names of file and the groups below them, in file order, so metadata
+	// such as obs and var can come from the disk while the matrix is decoded. Objects that do not exist are skipped.
+	// Limited and null like prefetch_matrix.
+	std::unique_ptr<Prefetcher> prefetch_objects(H5::H5File& file, const std::vector<std::string>& names, std::uint64_t memoryBudget = 0);
+}
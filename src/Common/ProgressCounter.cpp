@@ -0,0 +1,51 @@
+#include "ProgressCounter.h"
+
+#include <algorithm>
+
+namespace H5Utils
+{
+	ProgressCounter::ProgressCounter(std::uint64_t total, std::function<void(float)> report, std::chrono::milliseconds interval)
+		: _total(total)
+		, _report(std::move(report))
+		, _interval(interval)
+		, _nextReport(std::chrono::steady_clock::now() + interval)
+		, _reporter(std::this_thread::get_id())
+		, _checkShift((total >= (1 << 16)) ? 6 : 0)
+#if defined(_OPENMP)
+		, _nrOfSlots(static_cast<std::size_t>(std::max(omp_get_max_threads(), 1)))
+#else
+		, _nrOfSlots(1)
+#endif
+		, _slots(new Slot[_nrOfSlots])
+	{
+	}
+
+	ProgressCounter::~ProgressCounter()
+	{
+		finish();
+	}
+
+	void ProgressCounter::finish()
+	{
+		if (_report && _total)
+			_report(static_cast<float>(std::min(count(), _total)) / static_cast<float>(_total));
+		_report = nullptr;
+	}
+
+	std::uint64_t ProgressCounter::count() const
+	{
+		std::uint64_t result = 0;
+		for (std::size_t slot = 0; slot < _nrOfSlots; ++slot)
+			result += _slots[slot].count.load(std::memory_order_relaxed);
+		return result;
+	}
+
+	void ProgressCounter::reportIfDue()
+	{
+		const auto now = std::chrono::steady_clock::now();
+		if ((now < _nextReport) || !_report || (_total == 0))
+			return;
+		_nextReport = now + _interval;
+		_report(static_cast<float>(std::min(count(), _total)) / static_cast<float>(_total));
+	}
+}
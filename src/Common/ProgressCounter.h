@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+namespace H5Utils
+{
+	// Minimum time between two progress reports, 10 updates per second.
+	constexpr std::chrono::milliseconds progress_update_interval(100);
+
+	/*
+	* Progress of a parallel loop counted in per-thread counters on separate cache lines, so workers only do a relaxed
+	* increment of their own counter, which is uncontended. Threads of nested OpenMP teams can share a counter. The
+	* thread that created the counter (the main thread, thread 0 of the OpenMP teams it starts) sums the counters and
+	* reports, at most once per interval. For loops of many small steps it checks the clock only every 64 steps. The
+	* final count is reported when the counter is destroyed.
+	*/
+	class ProgressCounter
+	{
+	public:
+		// report receives the fraction of total steps done, from the creating thread only.
+		ProgressCounter(std::uint64_t total, std::function<void(float)> report, std::chrono::milliseconds interval = progress_update_interval);
+		~ProgressCounter();
+
+		ProgressCounter(const ProgressCounter&) = delete;
+		ProgressCounter& operator=(const ProgressCounter&) = delete;
+
+		// Called from any thread when steps more are done.
+		void add(std::uint64_t steps = 1)
+		{
+			// threads of nested teams can share a counter, so the increment must be atomic; it is uncontended otherwise
+			const std::uint64_t count = _slots[thread_slot()].count.fetch_add(steps, std::memory_order_relaxed) + steps;
+			if (((count >> _checkShift) != ((count - steps) >> _checkShift)) && (std::this_thread::get_id() == _reporter))
+				reportIfDue();
+		}
+
+		// Reports the final count now instead of on destruction, nothing is reported after it.
+		void finish();
+
+		// Sum of all counters.
+		std::uint64_t count() const;
+
+	private:
+		struct alignas(64) Slot
+		{
+			std::atomic<std::uint64_t> count = 0;
+		};
+
+		std::size_t thread_slot() const
+		{
+#if defined(_OPENMP)
+			return static_cast<std::size_t>(omp_get_thread_num()) % _nrOfSlots;
+#else
+			return 0;
+#endif
+		}
+
+		void reportIfDue();
+
+		std::uint64_t _total;
+		std::function<void(float)> _report;
+		std::chrono::steady_clock::duration _interval;
+		std::chrono::steady_clock::time_point _nextReport;
+		std::thread::id _reporter;
+		unsigned _checkShift; // the clock is checked when the reporter's count passes a multiple of 2^_checkShift
+		std::size_t _nrOfSlots;
+		std::unique_ptr<Slot[]> _slots;
+	};
+}
@@ -0,0 +1,131 @@
+#include "RowBlockReader.h"
+
+#include "Trace.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace H5Utils
+{
+	namespace local
+	{
+		std::uint64_t dataset_size(const H5::DataSet& dataset)
+		{
+			H5::DataSpace dataspace = dataset.getSpace();
+			if (dataspace.getSimpleExtentNdims() != 1)
+				return 0;
+			hsize_t size = 0;
+			dataspace.getSimpleExtentDims(&size, NULL);
+			return size;
+		}
+
+		// Reads count elements from offset of a one dimensional dataset.
+		void read_range(const H5::DataSet& dataset, const H5::PredType& memoryType, hsize_t offset, hsize_t count, void* buffer)
+		{
+			if (count == 0)
+				return;
+			H5::DataSpace fileSpace = dataset.getSpace();
+			fileSpace.selectHyperslab(H5S_SELECT_SET, &count, &offset);
+			H5::DataSpace memorySpace(1, &count);
+			dataset.read(buffer, memoryType, memorySpace, fileSpace);
+		}
+	}
+
+	std::uint64_t RowBlock::rows() const
+	{
+		return indptr.empty() ? 0 : indptr.size() - 1;
+	}
+
+	std::uint64_t RowBlock::bytes() const
+	{
+		return indptr.size() * sizeof(std::uint64_t) + indices.size() * sizeof(std::uint32_t) + values.size() * sizeof(float);
+	}
+
+	RowBlockReader::RowBlockReader(const H5::Group& group, std::uint64_t columns, const std::string& dataName, const std::string& indicesName, const std::string& indptrName)
+		: _columns(columns)
+	{
+		try
+		{
+			if (!group.exists(indptrName))
+				return;
+			H5::DataSet indptr = group.openDataSet(indptrName);
+			_indptr.resize(local::dataset_size(indptr));
+			if (_indptr.empty())
+				return;
+			indptr.read(_indptr.data(), H5::PredType::NATIVE_UINT64);
+			_indptrMemory.setBytes(TrackedBuffer::container_bytes(_indptr));
+			_data = group.openDataSet(dataName);
+			_indices = group.openDataSet(indicesName);
+
+			const std::uint64_t nnz = local::dataset_size(_data);
+			if ((_indptr.front() != 0) || (_indptr.back() != nnz) || (local::dataset_size(_indices) != nnz) || !std::is_sorted(_indptr.cbegin(), _indptr.cend()))
+			{
+				std::cout << "Row block reader: " << indptrName << " does not match the number of nonzeros" << std::endl;
+				_indptr.clear();
+				return;
+			}
+			_rows = _indptr.size() - 1;
+		}
+		catch (const H5::Exception& e)
+		{
+			std::cout << "Row block reader: " << e.getCDetailMsg() << std::endl;
+			_indptr.clear();
+			_rows = 0;
+		}
+	}
+
+	bool RowBlockReader::valid() const
+	{
+		return (_rows > 0) && (_columns > 0);
+	}
+
+	std::uint64_t RowBlockReader::rows() const
+	{
+		return _rows;
+	}
+
+	std::uint64_t RowBlockReader::columns() const
+	{
+		return _columns;
+	}
+
+	void RowBlockReader::setBlockRows(std::uint64_t rows)
+	{
+		_blockRows = std::max<std::uint64_t>(rows, 1);
+	}
+
+	std::uint64_t RowBlockReader::blockRows() const
+	{
+		return _blockRows;
+	}
+
+	std::uint64_t RowBlockReader::blockCount() const
+	{
+		return (_rows + _blockRows - 1) / _blockRows;
+	}
+
+	RowBlock RowBlockReader::block(std::uint64_t index) const
+	{
+		return readRows(index * _blockRows, _blockRows);
+	}
+
+	RowBlock RowBlockReader::readRows(std::uint64_t firstRow, std::uint64_t count) const
+	{
+		MV_H5_TRACE_SCOPE("RowBlockReader::readRows");
+		RowBlock result;
+		firstRow = std::min(_rows, firstRow);
+		const std::uint64_t lastRow = firstRow + std::min(count, _rows - firstRow);
+		result.firstRow = firstRow;
+		result.indptr.resize(lastRow - firstRow + 1, 0);
+
+		const std::uint64_t begin = _indptr[firstRow];
+		const std::uint64_t end = _indptr[lastRow];
+		for (std::uint64_t row = firstRow; row <= lastRow; ++row)
+			result.indptr[row - firstRow] = _indptr[row] - begin;
+		result.indices.resize(end - begin);
+		result.values.resize(end - begin);
+		local::read_range(_indices, H5::PredType::NATIVE_UINT32, begin, end - begin, result.indices.data());
+		local::read_range(_data, H5::PredType::NATIVE_FLOAT, begin, end - begin, result.values.data());
+		return result;
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "H5Cpp.h"
+
+#include "MemoryTracker.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace H5Utils
+{
+	// Default number of rows of a block of a RowBlockReader.
+	constexpr std::uint64_t default_block_rows = 4096;
+
+	// Rows [firstRow, firstRow + rows()) of a matrix as compressed sparse rows, indptr is relative to the block.
+	struct RowBlock
+	{
+		std::uint64_t firstRow = 0;
+		std::vector<std::uint64_t> indptr;
+		std::vector<std::uint32_t> indices;
+		std::vector<float> values;
+
+		std::uint64_t rows() const;
+		std::uint64_t bytes() const;
+	};
+
+	/*
+	* Streams the compressed sparse rows of a group in blocks, for sparse data that does not fit in memory next to the
+	* dense matrix it is scattered into. Only indptr is held in memory; a block is read with hyperslab reads of data
+	* and indices at the offsets in indptr and is not kept after the caller drops it.
+	*/
+	class RowBlockReader
+	{
+	public:
+		// columns is the size of the minor dimension (not stored in the group).
+		RowBlockReader(const H5::Group& group, std::uint64_t columns, const std::string& dataName = "data", const std::string& indicesName = "indices", const std::string& indptrName = "indptr");
+
+		// False if the datasets could not be opened or indptr is inconsistent.
+		bool valid() const;
+
+		std::uint64_t rows() const;
+		std::uint64_t columns() const;
+
+		void setBlockRows(std::uint64_t rows);
+		std::uint64_t blockRows() const;
+		std::uint64_t blockCount() const;
+
+		// Reads block index (not row) from the file. Throws like H5::DataSet::read.
+		RowBlock block(std::uint64_t index) const;
+
+		// Reads rows [firstRow, firstRow + count), clamped to the matrix. Throws like H5::DataSet::read.
+		RowBlock readRows(std::uint64_t firstRow, std::uint64_t count) const;
+
+	private:
+		H5::DataSet _data;
+		H5::DataSet _indices;
+		std::vector<std::uint64_t> _indptr;
+		TrackedBuffer _indptrMemory{ "RowBlockReader indptr" };
+		std::uint64_t _rows = 0;
+		std::uint64_t _columns = 0;
+		std::uint64_t _blockRows = default_block_rows;
+	};
+}
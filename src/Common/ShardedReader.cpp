@@ -0,0 +1,486 @@
+#include "ShardedReader.h"
+#include "Trace.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MV_H5_HAVE_SPAWN
+#endif
+
+#ifdef MV_H5_HAVE_SPAWN
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/prctl.h>
+#endif
+extern char** environ;
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace H5Utils
+{
+	namespace local
+	{
+		std::atomic<unsigned> sharded_read_workers{ 0 };
+		std::atomic<std::uint64_t> sharded_read_min_bytes{ H5Utils::sharded_read_min_bytes };
+		std::atomic<std::uint64_t> sharded_read_shard_bytes{ H5Utils::sharded_read_shard_bytes };
+
+		std::mutex sharded_read_worker_path_mutex;
+		std::string sharded_read_worker_path;
+
+		thread_local ShardedReadCancellation* current_cancellation = nullptr;
+
+		// The worker finds the shared memory at this descriptor.
+		constexpr int worker_region_fd = 3;
+
+		// Memory types are passed to the worker by name, only the native numeric types are supported.
+		struct NativeType
+		{
+			const char* name;
+			hid_t type;
+		};
+
+		std::vector<NativeType> native_types()
+		{
+			return {
+				{ "i1", H5T_NATIVE_INT8 }, { "u1", H5T_NATIVE_UINT8 }, { "i2", H5T_NATIVE_INT16 }, { "u2", H5T_NATIVE_UINT16 },
+				{ "i4", H5T_NATIVE_INT32 }, { "u4", H5T_NATIVE_UINT32 }, { "i8", H5T_NATIVE_INT64 }, { "u8", H5T_NATIVE_UINT64 },
+				{ "f4", H5T_NATIVE_FLOAT }, { "f8", H5T_NATIVE_DOUBLE }
+			};
+		}
+
+		// Empty when memoryType is not a native numeric type.
+		std::string native_type_name(hid_t memoryType)
+		{
+			for (const auto& nativeType : native_types())
+				if (H5Tequal(memoryType, nativeType.type) > 0)
+					return nativeType.name;
+			return {};
+		}
+
+		hid_t native_type(const std::string& name)
+		{
+			for (const auto& nativeType : native_types())
+				if (name == nativeType.name)
+					return nativeType.type;
+			return -1;
+		}
+
+		// Reads rows [rowBegin, rowEnd) of the dataset at path with a sec2 file handle, returns the exit code of the worker.
+		int read_rows(const std::string& fileName, const std::string& path, hid_t memoryType, hsize_t rowBegin, hsize_t rowEnd, char* destination)
+		{
+			H5Eset_auto(H5E_DEFAULT, nullptr, nullptr);
+
+			const hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+			H5Pset_fapl_sec2(fapl);
+			const hid_t file = H5Fopen(fileName.c_str(), H5F_ACC_RDONLY, fapl);
+			H5Pclose(fapl);
+			if (file < 0)
+				return 1;
+			const hid_t dataset = H5Dopen2(file, path.c_str(), H5P_DEFAULT);
+			if (dataset < 0)
+			{
+				H5Fclose(file);
+				return 1;
+			}
+
+			herr_t status = -1;
+			const hid_t fileSpace = H5Dget_space(dataset);
+			const int rank = H5Sget_simple_extent_ndims(fileSpace);
+			if (rank >= 1)
+			{
+				std::vector<hsize_t> count(rank);
+				std::vector<hsize_t> start(rank, 0);
+				H5Sget_simple_extent_dims(fileSpace, count.data(), nullptr);
+				start[0] = rowBegin;
+				count[0] = rowEnd - rowBegin;
+				H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, start.data(), nullptr, count.data(), nullptr);
+
+				hsize_t nrOfElements = 1;
+				for (const auto size : count)
+					nrOfElements *= size;
+				const hid_t memorySpace = H5Screate_simple(1, &nrOfElements, nullptr);
+				status = H5Dread(dataset, memoryType, memorySpace, fileSpace, H5P_DEFAULT, destination);
+				H5Sclose(memorySpace);
+			}
+			H5Sclose(fileSpace);
+			H5Dclose(dataset);
+			H5Fclose(file);
+			return (status < 0) ? 1 : 0;
+		}
+
+#ifdef MV_H5_HAVE_SPAWN
+		// Shared memory the workers write into, a memfd on Linux and an unlinked POSIX shared memory object elsewhere.
+		// The descriptor is close-on-exec, so only the workers it is passed to explicitly inherit it.
+		class SharedRegion
+		{
+		public:
+			explicit SharedRegion(std::size_t size)
+				: _size(size)
+			{
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+				_fd = memfd_create("mv_h5_shard", MFD_CLOEXEC);
+#endif
+				if (_fd < 0)
+				{
+					static std::atomic<unsigned> counter{ 0 };
+					const std::string name = "/mv_h5_" + std::to_string(getpid()) + "_" + std::to_string(counter++);
+					_fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+					if (_fd >= 0)
+					{
+						shm_unlink(name.c_str());
+						fcntl(_fd, F_SETFD, FD_CLOEXEC);
+					}
+				}
+				// the descriptor is duplicated to worker_region_fd in the worker, which only clears close-on-exec when it is a different one
+				if (_fd == worker_region_fd)
+				{
+					const int moved = fcntl(_fd, F_DUPFD_CLOEXEC, worker_region_fd + 1);
+					close(_fd);
+					_fd = moved;
+				}
+				if ((_fd < 0) || (ftruncate(_fd, static_cast<off_t>(size)) != 0))
+					return;
+				void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+				_data = (data == MAP_FAILED) ? nullptr : static_cast<char*>(data);
+			}
+
+			~SharedRegion()
+			{
+				if (_data)
+					munmap(_data, _size);
+				if (_fd >= 0)
+					close(_fd);
+			}
+
+			char* data() const
+			{
+				return _data;
+			}
+
+			int fd() const
+			{
+				return _fd;
+			}
+
+		private:
+			std::size_t _size = 0;
+			char* _data = nullptr;
+			int _fd = -1;
+		};
+
+		// Starts a worker for rows [rowBegin, rowEnd) that writes to the region at offset, returns its pid or -1.
+		pid_t spawn_worker(const std::string& workerPath, const SharedRegion& region, const std::string& fileName, const std::string& path,
+			const std::string& typeName, hsize_t rowBegin, hsize_t rowEnd, std::uint64_t offset, std::uint64_t size)
+		{
+			std::vector<std::string> arguments = { workerPath, std::to_string(getpid()), fileName, path, typeName,
+				std::to_string(rowBegin), std::to_string(rowEnd), std::to_string(offset), std::to_string(size) };
+			std::vector<char*> argv;
+			for (auto& argument : arguments)
+				argv.push_back(argument.data());
+			argv.push_back(nullptr);
+
+			posix_spawn_file_actions_t actions;
+			if (posix_spawn_file_actions_init(&actions) != 0)
+				return -1;
+			pid_t pid = -1;
+			if (posix_spawn_file_actions_adddup2(&actions, region.fd(), worker_region_fd) == 0)
+			{
+				if (posix_spawn(&pid, workerPath.c_str(), &actions, nullptr, argv.data(), environ) != 0)
+					pid = -1;
+			}
+			posix_spawn_file_actions_destroy(&actions);
+			return pid;
+		}
+
+		// Directory of the plugin or executable this code is linked into.
+		std::filesystem::path module_directory()
+		{
+			Dl_info info;
+			if ((dladdr(reinterpret_cast<void*>(&read_sharded), &info) == 0) || !info.dli_fname)
+				return {};
+			return std::filesystem::path(info.dli_fname).parent_path();
+		}
+#endif
+	}
+
+	void set_sharded_read_workers(unsigned workers)
+	{
+		local::sharded_read_workers = workers;
+	}
+
+	unsigned sharded_read_workers()
+	{
+		return local::sharded_read_workers;
+	}
+
+	void set_sharded_read_sizes(std::uint64_t minBytes, std::uint64_t shardBytes)
+	{
+		local::sharded_read_min_bytes = minBytes;
+		local::sharded_read_shard_bytes = shardBytes;
+	}
+
+	void set_sharded_read_worker_path(const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(local::sharded_read_worker_path_mutex);
+		local::sharded_read_worker_path = path;
+	}
+
+	std::string sharded_read_worker_path()
+	{
+		{
+			std::lock_guard<std::mutex> lock(local::sharded_read_worker_path_mutex);
+			if (!local::sharded_read_worker_path.empty())
+				return local::sharded_read_worker_path;
+		}
+#ifdef MV_H5_HAVE_SPAWN
+		const std::filesystem::path directory = local::module_directory();
+		if (!directory.empty())
+			return (directory / "H5ShardWorker").string();
+#endif
+		return {};
+	}
+
+	ShardedReadCancellation::ShardedReadCancellation(std::function<void()> poll)
+		: _poll(std::move(poll))
+		, _outer(local::current_cancellation)
+	{
+		local::current_cancellation = this;
+	}
+
+	ShardedReadCancellation::~ShardedReadCancellation()
+	{
+		local::current_cancellation = _outer;
+	}
+
+	void ShardedReadCancellation::cancel()
+	{
+		_cancelled = true;
+	}
+
+	bool ShardedReadCancellation::cancelled() const
+	{
+		return _cancelled;
+	}
+
+	ShardedReadCancellation* ShardedReadCancellation::current()
+	{
+		return local::current_cancellation;
+	}
+
+	void ShardedReadCancellation::poll() const
+	{
+		if (_poll)
+			_poll();
+	}
+
+	bool read_sharded(const H5::DataSet& dataset, const H5::DataType& memoryType, void* buffer)
+	{
+		MV_H5_TRACE_SCOPE("read_sharded");
+		ShardedReadCancellation* cancellation = ShardedReadCancellation::current();
+		if (cancellation && cancellation->cancelled())
+			throw ReadCancelled();
+
+		const unsigned workers = sharded_read_workers();
+		if (workers == 0)
+			return false;
+#ifndef MV_H5_HAVE_SPAWN
+		return false;
+#else
+		H5::DataSpace dataspace = dataset.getSpace();
+		const int rank = dataspace.getSimpleExtentNdims();
+		if (rank < 1)
+			return false;
+		std::vector<hsize_t> dimensions(rank);
+		dataspace.getSimpleExtentDims(dimensions.data(), NULL);
+
+		const hsize_t rows = dimensions[0];
+		std::uint64_t rowBytes = memoryType.getSize();
+		for (int d = 1; d < rank; ++d)
+			rowBytes *= dimensions[d];
+		const std::uint64_t totalBytes = rows * rowBytes;
+		if ((rows < 2) || (rowBytes == 0) || (totalBytes < local::sharded_read_min_bytes))
+			return false;
+
+		const std::string typeName = local::native_type_name(memoryType.getId());
+		const std::string workerPath = sharded_read_worker_path();
+		if (typeName.empty() || workerPath.empty() || (access(workerPath.c_str(), X_OK) != 0))
+			return false;
+
+		const std::string fileName = dataset.getFileName();
+		const std::string path = dataset.getObjName();
+
+		// shards of whole rows, at least one per worker
+		const hsize_t rowsPerShard = std::clamp<hsize_t>(local::sharded_read_shard_bytes / rowBytes, 1, (rows + workers - 1) / workers);
+		const hsize_t nrOfShards = (rows + rowsPerShard - 1) / rowsPerShard;
+
+		struct Shard
+		{
+			hsize_t rowBegin = 0;
+			hsize_t rowEnd = 0;
+			std::unique_ptr<local::SharedRegion> region;
+			pid_t pid = -1;
+		};
+		std::vector<Shard> running;
+		hsize_t nextShard = 0;
+
+		const auto deadline = std::chrono::steady_clock::now() + sharded_read_base_timeout + std::chrono::seconds(totalBytes / sharded_read_min_rate);
+		bool failed = false;
+		bool timedOut = false;
+		bool cancelled = false;
+		bool stopped = false;
+		char* destination = static_cast<char*>(buffer);
+		while (!running.empty() || (!stopped && (nextShard < nrOfShards)))
+		{
+			for (auto shard = running.begin(); shard != running.end();)
+			{
+				int status = 0;
+				const pid_t result = waitpid(shard->pid, &status, WNOHANG);
+				if ((result == 0) || ((result < 0) && (errno == EINTR)))
+				{
+					++shard;
+					continue;
+				}
+				if ((result != shard->pid) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+					failed = true;
+				else if (!stopped)
+				{
+					// copy in blocks so the copy is spread over the cores
+					constexpr std::int64_t blockSize = 16 * 1024 * 1024;
+					const std::uint64_t shardBytes = (shard->rowEnd - shard->rowBegin) * rowBytes;
+					const std::int64_t nrOfBlocks = static_cast<std::int64_t>((shardBytes + blockSize - 1) / blockSize);
+					char* shardDestination = destination + shard->rowBegin * rowBytes;
+					const char* source = shard->region->data();
+					#pragma omp parallel for
+					for (std::int64_t block = 0; block < nrOfBlocks; ++block)
+					{
+						const std::uint64_t begin = block * blockSize;
+						std::memcpy(shardDestination + begin, source + begin, std::min<std::uint64_t>(blockSize, shardBytes - begin));
+					}
+				}
+				// frees the shared memory of the shard
+				shard = running.erase(shard);
+			}
+
+			cancelled = cancelled || (cancellation && cancellation->cancelled());
+			timedOut = timedOut || (std::chrono::steady_clock::now() > deadline);
+			stopped = failed || timedOut || cancelled;
+			if (stopped)
+			{
+				for (const auto& shard : running)
+					kill(shard.pid, SIGKILL);
+			}
+			else
+			{
+				while ((running.size() < workers) && (nextShard < nrOfShards))
+				{
+					Shard shard;
+					shard.rowBegin = nextShard * rowsPerShard;
+					shard.rowEnd = std::min(rows, shard.rowBegin + rowsPerShard);
+					const std::uint64_t shardBytes = (shard.rowEnd - shard.rowBegin) * rowBytes;
+					shard.region = std::make_unique<local::SharedRegion>(shardBytes);
+					if (shard.region->data())
+						shard.pid = local::spawn_worker(workerPath, *shard.region, fileName, path, typeName, shard.rowBegin, shard.rowEnd, 0, shardBytes);
+					if (shard.pid < 0)
+					{
+						failed = true;
+						break;
+					}
+					running.push_back(std::move(shard));
+					++nextShard;
+				}
+			}
+
+			if (!running.empty())
+			{
+				if (cancellation)
+					cancellation->poll();
+				std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			}
+		}
+
+		if (cancelled || (cancellation && cancellation->cancelled()))
+		{
+			std::cout << "Sharded read of " << path << " was cancelled" << std::endl;
+			throw ReadCancelled();
+		}
+		if (timedOut)
+		{
+			std::cout << "Sharded read of " << path << " timed out, reading in-process" << std::endl;
+			return false;
+		}
+		if (failed)
+		{
+			std::cout << "Sharded read of " << path << " failed, reading in-process" << std::endl;
+			return false;
+		}
+		return true;
+#endif
+	}
+
+	int sharded_read_worker_main(int argc, char* argv[])
+	{
+#ifndef MV_H5_HAVE_SPAWN
+		return 1;
+#else
+		if (argc != 9)
+		{
+			std::cerr << "H5ShardWorker is started by the HDF5 loaders for sharded reads:" << std::endl;
+			std::cerr << "  H5ShardWorker parent-pid file dataset type row-begin row-end region-offset region-size" << std::endl;
+			return 2;
+		}
+		const pid_t parent = static_cast<pid_t>(std::strtoll(argv[1], nullptr, 10));
+		const std::string fileName = argv[2];
+		const std::string path = argv[3];
+		const hid_t memoryType = local::native_type(argv[4]);
+		const hsize_t rowBegin = std::strtoull(argv[5], nullptr, 10);
+		const hsize_t rowEnd = std::strtoull(argv[6], nullptr, 10);
+		const std::uint64_t offset = std::strtoull(argv[7], nullptr, 10);
+		const std::uint64_t size = std::strtoull(argv[8], nullptr, 10);
+		if ((memoryType < 0) || (rowEnd <= rowBegin))
+			return 2;
+
+		// the worker must not outlive the parent, on Linux it is killed with it, elsewhere a watchdog polls for it
+#if defined(__linux__)
+		prctl(PR_SET_PDEATHSIG, SIGKILL);
+#else
+		std::thread([parent]()
+			{
+				while (getppid() == parent)
+					std::this_thread::sleep_for(std::chrono::milliseconds(200));
+				_exit(1);
+			}).detach();
+#endif
+		if (getppid() != parent)
+			return 1;
+
+		// mmap offsets are page aligned
+		const std::uint64_t pageSize = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+		const std::uint64_t mapOffset = offset - (offset % pageSize);
+		const std::size_t mapSize = static_cast<std::size_t>(size + (offset - mapOffset));
+		void* mapped = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, local::worker_region_fd, static_cast<off_t>(mapOffset));
+		if (mapped == MAP_FAILED)
+			return 1;
+
+		const int result = local::read_rows(fileName, path, memoryType, rowBegin, rowEnd, static_cast<char*>(mapped) + (offset - mapOffset));
+		munmap(mapped, mapSize);
+		return result;
+#endif
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "H5Cpp.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+namespace H5Utils
+{
+	/*
+	* Optional multi-process reads. The rows (first dimension) of a large dataset are split over worker processes,
+	* instances of the H5ShardWorker executable started with posix_spawn, that each open the file with their own HDF5
+	* library state, so decompression is not serialized by the HDF5 global lock. The rows are read in shards, each by a
+	* worker of its own into a shared memory region that the parent copies into the caller's buffer and frees as soon as
+	* the worker is done, so next to the buffer at most one shard per running worker is held. Workers die with the
+	* parent, and are killed when the read takes longer than its deadline; a failed or timed out read leaves the caller
+	* to read in-process. A cancelled read throws ReadCancelled. Only available on POSIX systems, disabled by default.
+	*/
+
+	// Number of worker processes, 0 disables sharded reads.
+	void set_sharded_read_workers(unsigned workers);
+	unsigned sharded_read_workers();
+
+	// Path of the worker executable. By default H5ShardWorker next to the module (plugin) holding this code.
+	void set_sharded_read_worker_path(const std::string& path);
+	std::string sharded_read_worker_path();
+
+	// Datasets smaller than this (in memory) are read in-process.
+	constexpr std::uint64_t sharded_read_min_bytes = 64 * 1024 * 1024;
+
+	// Largest shard (in memory) of a worker, at least one row. Smaller datasets get a shard per worker.
+	constexpr std::uint64_t sharded_read_shard_bytes = 64 * 1024 * 1024;
+
+	// Replaces sharded_read_min_bytes and sharded_read_shard_bytes, e.g. to shard small datasets in tests.
+	void set_sharded_read_sizes(std::uint64_t minBytes, std::uint64_t shardBytes);
+
+	// A sharded read is killed after a fixed allowance plus the time to read its size at a slow rate.
+	constexpr std::chrono::seconds sharded_read_base_timeout(60);
+	constexpr std::uint64_t sharded_read_min_rate = 16 * 1024 * 1024; // bytes per second
+
+	// Thrown from a sharded read whose ShardedReadCancellation was cancelled.
+	class ReadCancelled : public std::runtime_error
+	{
+	public:
+		ReadCancelled()
+			: std::runtime_error("reading was cancelled")
+		{
+		}
+	};
+
+	/*
+	* Cancellation of the sharded reads done by the thread that created it, while it lives (nested scopes hide the
+	* outer one). cancel() may be called from any thread. The optional poll function is called by the waiting thread
+	* every few milliseconds, for instance to process the events that deliver an abort request.
+	*/
+	class ShardedReadCancellation
+	{
+	public:
+		explicit ShardedReadCancellation(std::function<void()> poll = {});
+		~ShardedReadCancellation();
+
+		ShardedReadCancellation(const ShardedReadCancellation&) = delete;
+		ShardedReadCancellation& operator=(const ShardedReadCancellation&) = delete;
+
+		void cancel();
+		bool cancelled() const;
+
+		// The innermost cancellation of the calling thread, null when there is none.
+		static ShardedReadCancellation* current();
+
+	private:
+		friend bool read_sharded(const H5::DataSet&, const H5::DataType&, void*);
+
+		void poll() const;
+
+		std::atomic<bool> _cancelled = false;
+		std::function<void()> _poll;
+		ShardedReadCancellation* _outer;
+	};
+
+	// Reads the whole dataset converted to memoryType into buffer. Returns false when sharded reads are disabled, not
+	// supported or not worth it, or when a worker failed or timed out; buffer may then hold the shards read before.
+	// Throws ReadCancelled when the current ShardedReadCancellation of the calling thread was cancelled.
+	bool read_sharded(const H5::DataSet& dataset, const H5::DataType& memoryType, void* buffer);
+
+	// Entry point of the worker executable: reads the rows given on the command line into the shared memory passed
+	// as file descriptor 3. Returns the exit code.
+	int sharded_read_worker_main(int argc, char* argv[]);
+}
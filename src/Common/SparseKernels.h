@@ -0,0 +1,313 @@
+#pragma once
+
+#include "Trace.h"
+#include "TransformType.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+/*
+* The sparse to dense kernels of DataContainerInterface on a plain output iterator over a row major rows x columns
+* matrix, so they do not depend on a ManiVault dataset and can be run and timed in isolation. progress(steps) is
+* called from any thread with the number of rows done.
+*/
+
+namespace H5Utils
+{
+	template<typename T>
+	double transform_value(T value, TRANSFORM::Type transformType)
+	{
+		const double v = value;
+		switch (transformType.first)
+		{
+		case TRANSFORM::LOG: return log2(1 + v);
+		case TRANSFORM::ARCSIN5: return asinh(v / 5.0);
+		case TRANSFORM::SQRT: return sqrt(v);
+		default: return v;
+		}
+	}
+
+	/*
+	* Splits rows [0, rows) of a compressed sparse matrix into nrOfParts contiguous ranges of about equal work, where a
+	* row costs rowCost units plus one per nonzero (the merge path of the offsets and the nonzeros, at row granularity).
+	* Splitting by row count alone leaves one thread with all the work when a few rows hold most of the nonzeros.
+	* Returns nrOfParts + 1 row boundaries; a single very long row is never split, so parts can be empty.
+	*/
+	template<typename T>
+	std::vector<std::int64_t> partition_by_nnz(const T* offsets, std::int64_t rows, std::int64_t nrOfParts, std::uint64_t rowCost = 1)
+	{
+		nrOfParts = std::max<std::int64_t>(1, nrOfParts);
+		std::vector<std::int64_t> boundaries(nrOfParts + 1, rows);
+		boundaries[0] = 0;
+		if (rows <= 0)
+		{
+			std::fill(boundaries.begin(), boundaries.end(), 0);
+			return boundaries;
+		}
+
+		const std::uint64_t first = offsets[0];
+		auto work = [offsets, first, rowCost](std::int64_t row) { return static_cast<std::uint64_t>(row) * rowCost + (static_cast<std::uint64_t>(offsets[row]) - first); };
+		const std::uint64_t total = work(rows);
+
+		for (std::int64_t part = 1; part < nrOfParts; ++part)
+		{
+			const std::uint64_t target = static_cast<std::uint64_t>((static_cast<double>(total) * part) / nrOfParts);
+			// first row at or after the previous boundary whose prefix work reaches the target
+			std::int64_t low = boundaries[part - 1];
+			std::int64_t high = rows;
+			while (low < high)
+			{
+				const std::int64_t middle = low + (high - low) / 2;
+				if (work(middle) < target)
+					low = middle + 1;
+				else
+					high = middle;
+			}
+			boundaries[part] = low;
+		}
+		return boundaries;
+	}
+
+	template<typename T>
+	std::vector<std::int64_t> partition_by_nnz(const std::vector<T>& offsets, std::int64_t rows, std::int64_t nrOfParts, std::uint64_t rowCost = 1)
+	{
+		assert(offsets.size() >= static_cast<std::size_t>(rows + 1));
+		return partition_by_nnz(offsets.data(), rows, nrOfParts, rowCost);
+	}
+
+	// Number of nnz balanced parts per thread in parallel_for_nnz_ranges, the spare parts are taken by whichever
+	// thread finishes first, which absorbs the cost differences the nonzero count does not predict (cache misses,
+	// skipped columns, time slices lost to other processes).
+	constexpr std::int64_t NnzPartsPerThread = 4;
+
+	// Calls f(rowBegin, rowEnd) in parallel for nnz balanced ranges covering rows [0, rows), see partition_by_nnz.
+	template<typename T, typename Function>
+	void parallel_for_nnz_ranges(const T* offsets, std::int64_t rows, const char* traceName, Function f, std::uint64_t rowCost = 1)
+	{
+		(void)traceName; // unused without MV_H5_ENABLE_TRACING
+		if (rows <= 0)
+			return;
+#if defined(_OPENMP)
+		const std::int64_t nrOfThreads = omp_get_max_threads();
+#else
+		const std::int64_t nrOfThreads = 1;
+#endif
+		const std::int64_t nrOfParts = std::min<std::int64_t>(rows, nrOfThreads * NnzPartsPerThread);
+		if (nrOfParts <= 1)
+		{
+			MV_H5_TRACE_SCOPE(traceName);
+			f(std::int64_t(0), rows);
+			return;
+		}
+
+		const std::vector<std::int64_t> boundaries = partition_by_nnz(offsets, rows, nrOfParts, rowCost);
+		#pragma omp parallel
+		{
+			MV_H5_TRACE_SCOPE(traceName);
+			#pragma omp for schedule(dynamic,1) nowait
+			for (std::int64_t part = 0; part < nrOfParts; ++part)
+			{
+				if (boundaries[part] < boundaries[part + 1])
+					f(boundaries[part], boundaries[part + 1]);
+			}
+		}
+	}
+
+	template<typename T, typename Function>
+	void parallel_for_nnz_ranges(const std::vector<T>& offsets, std::int64_t rows, const char* traceName, Function f, std::uint64_t rowCost = 1)
+	{
+		assert(offsets.size() >= static_cast<std::size_t>(rows + 1));
+		parallel_for_nnz_ranges(offsets.data(), rows, traceName, f, rowCost);
+	}
+
+	/*
+	* Zero fills the rows x columns output with the rows spread statically over the threads, for an uninitialized
+	* buffer that is then filled by a single threaded read: its pages are first touched, and so placed on the NUMA
+	* nodes, of all threads instead of the reading one.
+	*/
+	template<typename OutputIterator>
+	void parallel_zero_fill(OutputIterator beginOfData, std::int64_t rows, std::uint64_t columns)
+	{
+		typedef std::remove_cv_t<std::remove_reference_t<decltype(*beginOfData)>> OutputType;
+		#pragma omp parallel for schedule(static)
+		for (std::int64_t row = 0; row < rows; ++row)
+			std::fill(beginOfData + row * columns, beginOfData + (row + 1) * columns, OutputType(0));
+	}
+
+	/*
+	* CSR -> row major dense, zeros and columns outside [0, columns) are skipped. The rows are split into ranges of
+	* about equal numbers of nonzeros since the number of nonzeros per row varies a lot.
+	* With zeroFill the output may be uninitialized: every worker zero fills its own rows right before scattering into
+	* them, so the memory is written once and first touched by the thread that fills it (on its NUMA node) instead of
+	* being zeroed by the allocating thread up front.
+	* column_index and data are indexed with the 64 bit offsets of row_offset, any container with an operator[] will
+	* do, for instance a window on the nonzeros of a slice of rows that start past 2^32.
+	*/
+	template<bool accumulate, bool zeroFill = false, typename OutputIterator, typename IndexContainer, typename T2, typename DataContainer, typename ProgressFunction>
+	void scatter_sparse_rows(OutputIterator beginOfData, std::int64_t rows, std::uint64_t columns, const IndexContainer& column_index, const std::vector<T2>& row_offset, const DataContainer& data, TRANSFORM::Type transformType, ProgressFunction progress)
+	{
+		typedef std::remove_cv_t<std::remove_reference_t<decltype(*beginOfData)>> OutputType;
+
+		// zero filling a row costs a write per column, which outweighs its nonzeros unless the matrix is nearly dense
+		const std::uint64_t rowCost = zeroFill ? std::max<std::uint64_t>(1, columns) : 1;
+		parallel_for_nnz_ranges(row_offset, rows, "scatter_sparse_rows worker", [&](std::int64_t rowBegin, std::int64_t rowEnd)
+			{
+				if constexpr (zeroFill)
+					std::fill(beginOfData + rowBegin * columns, beginOfData + rowEnd * columns, OutputType(0));
+				for (std::int64_t row = rowBegin; row < rowEnd; ++row)
+				{
+					const std::uint64_t start = row_offset[row];
+					const std::uint64_t end = row_offset[row + 1];
+					const std::uint64_t points_offset = row * columns;
+
+					for (std::uint64_t i = start; i < end; ++i)
+					{
+						const std::uint64_t column = column_index[i];
+						if (column < columns)
+						{
+							const double value = data[i];
+							if (value != 0)
+							{
+								if constexpr (accumulate)
+									beginOfData[points_offset + column] += transform_value(value, transformType);
+								else
+									beginOfData[points_offset + column] = transform_value(value, transformType);
+							}
+						}
+					}
+				}
+				progress(static_cast<std::uint64_t>(rowEnd - rowBegin));
+			}, rowCost);
+	}
+
+	// Target size of one block of output rows in scatter_sparse_columns.
+	constexpr std::size_t L2BlockSizeInBytes = 256 * 1024;
+	// Upper bound on the number of (row block, thread) buckets, keeps the counting tables small for very wide rows.
+	constexpr std::int64_t MaxNrOfBuckets = 1ll << 22;
+
+	/*
+	* CSC -> row major dense. Scattering column by column writes every nonzero into a different row of the output,
+	* which is a cache and TLB miss per nonzero and makes the threads fight over the same cache lines.
+	* Instead the output rows are partitioned into blocks of roughly L2 size and the nonzeros are first bucketized per
+	* row block (a counting sort using per-thread counts, no atomics). Each row block is then filled by a single thread
+	* from one contiguous bucket, so all writes stay within a small, cache resident part of the output.
+	* With zeroFill the output may be uninitialized and every row block is zero filled by the thread that fills it, as
+	* in scatter_sparse_rows.
+	*/
+	template<bool accumulate, bool zeroFill = false, typename OutputIterator, typename T1, typename T2, typename T3, typename ProgressFunction>
+	void scatter_sparse_columns(OutputIterator beginOfData, std::int64_t rows, std::int64_t columns, const std::vector<T1>& row_index, const std::vector<T2>& column_offset, const std::vector<T3>& data, TRANSFORM::Type transformType, ProgressFunction progress)
+	{
+		struct Entry
+		{
+			std::uint32_t row; // relative to the first row of the block
+			std::uint32_t column;
+			T3 value;
+		};
+		typedef std::remove_cv_t<std::remove_reference_t<decltype(*beginOfData)>> OutputType;
+
+		if ((rows == 0) || (columns == 0))
+			return;
+		assert(columns <= std::numeric_limits<std::uint32_t>::max());
+		assert(column_offset.size() >= static_cast<std::size_t>(columns + 1));
+
+#if defined(_OPENMP)
+		const std::int64_t nrOfThreads = omp_get_max_threads();
+#else
+		const std::int64_t nrOfThreads = 1;
+#endif
+
+		const std::int64_t bytesPerRow = columns * static_cast<std::int64_t>(sizeof(OutputType));
+		std::int64_t rowsPerBlock = std::max<std::int64_t>(1, L2BlockSizeInBytes / bytesPerRow);
+		std::int64_t nrOfBlocks = (rows + rowsPerBlock - 1) / rowsPerBlock;
+		if (nrOfBlocks * nrOfThreads > MaxNrOfBuckets)
+		{
+			nrOfBlocks = std::max<std::int64_t>(1, MaxNrOfBuckets / nrOfThreads);
+			rowsPerBlock = (rows + nrOfBlocks - 1) / nrOfBlocks;
+			nrOfBlocks = (rows + rowsPerBlock - 1) / rowsPerBlock;
+		}
+		assert(rowsPerBlock <= std::numeric_limits<std::uint32_t>::max());
+
+		// bucket (block, thread) lives at index block * nrOfThreads + thread so that all buckets of a block are adjacent
+		std::vector<std::uint64_t> bucketOffset(nrOfBlocks * nrOfThreads + 1, 0);
+
+		// the counting and bucketize passes give every thread one range of columns with about the same number of nonzeros,
+		// exactly one per thread since the buckets are per thread
+		const std::vector<std::int64_t> columnBoundaries = partition_by_nnz(column_offset, columns, nrOfThreads);
+		auto columnRange = [&columnBoundaries](std::int64_t thread)
+		{
+			return std::make_pair(columnBoundaries[thread], columnBoundaries[thread + 1]);
+		};
+
+		// 1. count the nonzeros per (block, thread)
+		#pragma omp parallel for schedule(static,1) num_threads(nrOfThreads)
+		for (std::int64_t thread = 0; thread < nrOfThreads; ++thread)
+		{
+			const auto [firstColumn, lastColumn] = columnRange(thread);
+			for (std::int64_t column = firstColumn; column < lastColumn; ++column)
+			{
+				for (std::uint64_t i = column_offset[column]; i < column_offset[column + 1]; ++i)
+				{
+					const std::uint64_t r = row_index[i];
+					if ((r < static_cast<std::uint64_t>(rows)) && (data[i] != 0))
+						++bucketOffset[(r / rowsPerBlock) * nrOfThreads + thread + 1];
+				}
+			}
+		}
+		std::partial_sum(bucketOffset.begin(), bucketOffset.end(), bucketOffset.begin());
+
+		// 2. bucketize, every thread only advances the write positions of its own buckets
+		std::vector<Entry> entries(bucketOffset.back());
+		{
+			std::vector<std::uint64_t> writePosition(bucketOffset.cbegin(), bucketOffset.cend() - 1);
+			#pragma omp parallel for schedule(static,1) num_threads(nrOfThreads)
+			for (std::int64_t thread = 0; thread < nrOfThreads; ++thread)
+			{
+				const auto [firstColumn, lastColumn] = columnRange(thread);
+				for (std::int64_t column = firstColumn; column < lastColumn; ++column)
+				{
+					for (std::uint64_t i = column_offset[column]; i < column_offset[column + 1]; ++i)
+					{
+						const std::uint64_t r = row_index[i];
+						if ((r < static_cast<std::uint64_t>(rows)) && (data[i] != 0))
+						{
+							const std::uint64_t block = r / rowsPerBlock;
+							entries[writePosition[block * nrOfThreads + thread]++] = { static_cast<std::uint32_t>(r - block * rowsPerBlock), static_cast<std::uint32_t>(column), data[i] };
+						}
+					}
+				}
+			}
+		}
+
+		// 3. fill the row blocks, each one from its own contiguous range of entries
+		#pragma omp parallel for schedule(dynamic,1) num_threads(nrOfThreads)
+		for (std::int64_t block = 0; block < nrOfBlocks; ++block)
+		{
+			auto blockData = beginOfData + (block * rowsPerBlock * columns);
+			const std::int64_t blockRows = std::min(rowsPerBlock, rows - block * rowsPerBlock);
+			if constexpr (zeroFill)
+				std::fill(blockData, blockData + blockRows * columns, OutputType(0));
+			const std::uint64_t end = bucketOffset[(block + 1) * nrOfThreads];
+			for (std::uint64_t e = bucketOffset[block * nrOfThreads]; e < end; ++e)
+			{
+				const Entry& entry = entries[e];
+				const std::uint64_t offset = static_cast<std::uint64_t>(entry.row) * columns + entry.column;
+				if constexpr (accumulate)
+					blockData[offset] += transform_value(entry.value, transformType);
+				else
+					blockData[offset] = transform_value(entry.value, transformType);
+			}
+			progress(static_cast<std::uint64_t>(blockRows));
+		}
+	}
+}
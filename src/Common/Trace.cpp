@@ -0,0 +1,191 @@
+#include "Trace.h"
+
+#if defined(MV_H5_ENABLE_TRACING)
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#endif
+
+namespace H5Utils
+{
+#if defined(MV_H5_ENABLE_TRACING)
+	namespace local
+	{
+		struct TraceEvent
+		{
+			const char* name;
+			std::int64_t start; // nanoseconds since the trace epoch
+			std::int64_t end;
+		};
+
+		// Ring of the spans of one thread. Only its thread writes the events and the count, the export reads them.
+		struct TraceBuffer
+		{
+			explicit TraceBuffer(std::uint32_t id)
+				: threadId(id)
+				, events(trace_buffer_size)
+			{
+			}
+
+			std::uint32_t threadId;
+			std::vector<TraceEvent> events;
+			std::atomic<std::uint64_t> count = 0; // spans recorded, the ring holds the last trace_buffer_size of them
+			std::uint64_t exported = 0; // spans written by previous exports, guarded by the state mutex
+		};
+
+		struct TraceState
+		{
+			TraceState()
+			{
+				setFileName(std::string());
+			}
+
+			// an empty name falls back to the MV_H5_TRACE environment variable
+			void setFileName(const std::string& name)
+			{
+				fileName = name;
+				if (fileName.empty())
+				{
+					if (const char* variable = std::getenv("MV_H5_TRACE"))
+						fileName = variable;
+				}
+				enabled = !fileName.empty();
+			}
+
+			std::mutex mutex;
+			std::string fileName;
+			std::vector<std::shared_ptr<TraceBuffer>> buffers;
+			std::atomic<bool> enabled = false;
+			const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+		};
+
+		TraceState& trace_state()
+		{
+			static TraceState state;
+			return state;
+		}
+
+		std::int64_t trace_now()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - trace_state().epoch).count();
+		}
+
+		TraceBuffer& thread_buffer()
+		{
+			// shared with the state, so the spans of a thread that ended can still be exported
+			thread_local std::shared_ptr<TraceBuffer> buffer;
+			if (!buffer)
+			{
+				TraceState& state = trace_state();
+				std::lock_guard<std::mutex> lock(state.mutex);
+				buffer = std::make_shared<TraceBuffer>(static_cast<std::uint32_t>(state.buffers.size()));
+				state.buffers.push_back(buffer);
+			}
+			return *buffer;
+		}
+
+		void write_json_string(std::ostream& out, const char* text)
+		{
+			out << '"';
+			for (const char* c = text; *c; ++c)
+			{
+				if ((*c == '"') || (*c == '\\'))
+					out << '\\';
+				out << *c;
+			}
+			out << '"';
+		}
+	}
+
+	bool tracing_enabled()
+	{
+		return local::trace_state().enabled.load(std::memory_order_relaxed);
+	}
+
+	TraceSpan::TraceSpan(const char* name)
+		: _name(tracing_enabled() ? name : nullptr)
+		, _start(_name ? local::trace_now() : 0)
+	{
+	}
+
+	TraceSpan::~TraceSpan()
+	{
+		if (_name == nullptr)
+			return;
+		const std::int64_t end = local::trace_now();
+		local::TraceBuffer& buffer = local::thread_buffer();
+		const std::uint64_t count = buffer.count.load(std::memory_order_relaxed);
+		buffer.events[count % trace_buffer_size] = { _name, _start, end };
+		buffer.count.store(count + 1, std::memory_order_release);
+	}
+
+	void set_trace_file(const std::string& fileName)
+	{
+		local::TraceState& state = local::trace_state();
+		std::lock_guard<std::mutex> lock(state.mutex);
+		state.setFileName(fileName);
+	}
+
+	void export_trace()
+	{
+		local::TraceState& state = local::trace_state();
+		std::lock_guard<std::mutex> lock(state.mutex);
+		if (!state.enabled)
+			return;
+
+		std::ostringstream file;
+		file << std::fixed << std::setprecision(3);
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		bool first = true;
+		std::uint64_t nrOfEvents = 0;
+		for (const auto& buffer : state.buffers)
+		{
+			const std::uint64_t count = buffer->count.load(std::memory_order_acquire);
+			std::uint64_t begin = buffer->exported;
+			if (count - begin > trace_buffer_size)
+				begin = count - trace_buffer_size;
+			buffer->exported = count;
+			if (begin == count)
+				continue;
+
+			file << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":\"thread " << buffer->threadId << "\"}}";
+			first = false;
+			for (std::uint64_t i = begin; i < count; ++i)
+			{
+				const local::TraceEvent& event = buffer->events[i % trace_buffer_size];
+				file << ",\n{\"name\":";
+				local::write_json_string(file, event.name);
+				// Chrome traces use microseconds
+				file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"ts\":" << (event.start / 1000.0) << ",\"dur\":" << ((event.end - event.start) / 1000.0) << "}";
+			}
+			nrOfEvents += count - begin;
+		}
+		file << "\n]}\n";
+		if (nrOfEvents == 0)
+			return;
+
+		std::ofstream out(state.fileName, std::ios::trunc);
+		if (!(out << file.str()))
+		{
+			std::cout << "Could not write trace " << state.fileName << std::endl;
+			return;
+		}
+		std::cout << "Wrote " << nrOfEvents << " trace spans to " << state.fileName << std::endl;
+	}
+#else
+	void set_trace_file(const std::string& /*fileName*/)
+	{
+	}
+
+	void export_trace()
+	{
+	}
+#endif
+}
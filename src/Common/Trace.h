@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/*
+* Scoped trace spans, exported as a Chrome trace (chrome://tracing, ui.perfetto.dev) to see how the work of a load
+* is spread over the threads. Spans are only compiled in when the project is configured with MV_H5_ENABLE_TRACING,
+* otherwise MV_H5_TRACE_SCOPE expands to nothing. When compiled in, spans are recorded once a trace file is set,
+* with the MV_H5_TRACE environment variable or the traceFile setting of the loaders.
+*
+* Usage: MV_H5_TRACE_SCOPE("read indices"); records the time until the end of the enclosing scope. The name must be a
+* string literal (or otherwise outlive the export). To see the load balance of an OpenMP loop, record a span per thread:
+*
+*	#pragma omp parallel
+*	{
+*		MV_H5_TRACE_SCOPE("scatter worker");
+*		#pragma omp for nowait
+*		for (...)
+*	}
+*/
+
+namespace H5Utils
+{
+	// File the trace is written to by export_trace, the MV_H5_TRACE environment variable is used when it is never set.
+	// An empty name disables recording. Does nothing when tracing is not compiled in.
+	void set_trace_file(const std::string& fileName);
+
+	// Writes the spans recorded since the previous export to the trace file, replacing it, if there are any.
+	// Does nothing when tracing is not compiled in or disabled.
+	void export_trace();
+
+#if defined(MV_H5_ENABLE_TRACING)
+	// Number of spans kept per thread, the oldest are overwritten when a thread records more between two exports.
+	constexpr std::size_t trace_buffer_size = 1 << 16;
+
+	bool tracing_enabled();
+
+	class TraceSpan
+	{
+	public:
+		explicit TraceSpan(const char* name);
+		~TraceSpan();
+
+		TraceSpan(const TraceSpan&) = delete;
+		TraceSpan& operator=(const TraceSpan&) = delete;
+
+	private:
+		const char* _name; // nullptr when tracing is disabled
+		std::int64_t _start;
+	};
+#endif
+}
+
+#if defined(MV_H5_ENABLE_TRACING)
+#define MV_H5_TRACE_CONCAT_IMPL(a, b) a##b
+#define MV_H5_TRACE_CONCAT(a, b) MV_H5_TRACE_CONCAT_IMPL(a, b)
+#define MV_H5_TRACE_SCOPE(name) H5Utils::TraceSpan MV_H5_TRACE_CONCAT(traceSpan, __LINE__)(name)
+#else
+#define MV_H5_TRACE_SCOPE(name)
+#endif
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <utility>
+
+// The value transforms of the loaders, without the Qt control of DataTransform.h so the GUI-free code can use them.
+namespace TRANSFORM
+{
+	typedef enum { NONE, LOG, SQRT, ARCSIN5} Index;
+	typedef std::pair<Index, double> Type;
+	inline Type None() { return std::make_pair(NONE, 0.0f); }
+}
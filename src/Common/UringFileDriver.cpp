@@ -0,0 +1,478 @@
+#include "UringFileDriver.h"
+#include "FileDriverValues.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define MV_H5_HAVE_IO_URING
+#endif
+#endif
+
+#ifdef MV_H5_HAVE_IO_URING
+#if H5_VERSION_GE(1, 13, 0)
+#include <H5FDdevelop.h>
+#endif
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <new>
+#include <vector>
+#endif
+
+namespace H5Utils
+{
+#ifdef MV_H5_HAVE_IO_URING
+	namespace local
+	{
+		// Minimal io_uring submission and completion ring, see io_uring(7). Only used from the thread that calls into HDF5.
+		class Ring
+		{
+		public:
+			~Ring()
+			{
+				destroy();
+			}
+
+			bool init(unsigned entries)
+			{
+				io_uring_params params;
+				std::memset(&params, 0, sizeof(params));
+				_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+				if (_fd < 0)
+					return false;
+
+				_entries = params.sq_entries;
+				_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+				_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+				_singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+				if (_singleMap)
+					_sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+
+				_sqRing = map(_sqRingSize, IORING_OFF_SQ_RING);
+				_cqRing = _singleMap ? _sqRing : map(_cqRingSize, IORING_OFF_CQ_RING);
+				_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+				_sqes = static_cast<io_uring_sqe*>(map(_sqesSize, IORING_OFF_SQES));
+				if (!_sqRing || !_cqRing || !_sqes)
+				{
+					destroy();
+					return false;
+				}
+
+				char* sq = static_cast<char*>(_sqRing);
+				_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+				_sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+				_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+				char* cq = static_cast<char*>(_cqRing);
+				_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+				_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+				_cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+				_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+				return true;
+			}
+
+			void destroy()
+			{
+				if (_sqes)
+					munmap(_sqes, _sqesSize);
+				if (_cqRing && !_singleMap)
+					munmap(_cqRing, _cqRingSize);
+				if (_sqRing)
+					munmap(_sqRing, _sqRingSize);
+				if (_fd >= 0)
+					close(_fd);
+				_sqes = nullptr;
+				_cqRing = nullptr;
+				_sqRing = nullptr;
+				_fd = -1;
+			}
+
+			bool valid() const
+			{
+				return _fd >= 0;
+			}
+
+			// Reads size bytes at offset in blocks of blockSize with up to the ring size in flight, zero fills beyond the end of the file.
+			bool read(int fd, std::uint64_t offset, std::size_t size, char* buffer, std::size_t blockSize)
+			{
+				struct Piece
+				{
+					char* buffer;
+					std::uint64_t offset;
+					std::size_t size;
+				};
+
+				std::deque<Piece> pending;
+				for (std::size_t done = 0; done < size; done += blockSize)
+					pending.push_back({ buffer + done, offset + done, std::min(blockSize, size - done) });
+
+				std::vector<Piece> pieces(_entries);
+				std::vector<iovec> iovecs(_entries);
+				std::vector<unsigned> freeSlots(_entries);
+				for (unsigned slot = 0; slot < _entries; ++slot)
+					freeSlots[slot] = _entries - 1 - slot;
+
+				unsigned inFlight = 0;
+				unsigned unsubmitted = 0;
+				bool ok = true;
+				while ((ok && !pending.empty()) || inFlight)
+				{
+					unsigned tail = *_sqTail;
+					while (ok && !pending.empty() && !freeSlots.empty())
+					{
+						const unsigned slot = freeSlots.back();
+						freeSlots.pop_back();
+						pieces[slot] = pending.front();
+						pending.pop_front();
+						iovecs[slot].iov_base = pieces[slot].buffer;
+						iovecs[slot].iov_len = pieces[slot].size;
+
+						const unsigned index = tail & *_sqMask;
+						io_uring_sqe* sqe = &_sqes[index];
+						std::memset(sqe, 0, sizeof(*sqe));
+						sqe->opcode = IORING_OP_READV;
+						sqe->fd = fd;
+						sqe->off = pieces[slot].offset;
+						sqe->addr = reinterpret_cast<std::uint64_t>(&iovecs[slot]);
+						sqe->len = 1;
+						sqe->user_data = slot;
+						_sqArray[index] = index;
+						++tail;
+						++unsubmitted;
+						++inFlight;
+					}
+					__atomic_store_n(_sqTail, tail, __ATOMIC_RELEASE);
+
+					const int submitted = static_cast<int>(syscall(__NR_io_uring_enter, _fd, unsubmitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+					if (submitted < 0)
+					{
+						if ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY))
+							continue;
+						// the kernel cancels what is still in flight when the ring is closed
+						destroy();
+						return false;
+					}
+					unsubmitted -= std::min<unsigned>(unsubmitted, submitted);
+
+					unsigned head = *_cqHead;
+					const unsigned cqTail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+					while (head != cqTail)
+					{
+						const io_uring_cqe& cqe = _cqes[head & *_cqMask];
+						const unsigned slot = static_cast<unsigned>(cqe.user_data);
+						const int result = cqe.res;
+						++head;
+						--inFlight;
+						freeSlots.push_back(slot);
+
+						const Piece& piece = pieces[slot];
+						if (result < 0)
+						{
+							if ((result == -EINTR) || (result == -EAGAIN))
+								pending.push_back(piece);
+							else
+								ok = false;
+						}
+						else if (result == 0)
+							std::memset(piece.buffer, 0, piece.size);
+						else if (static_cast<std::size_t>(result) < piece.size)
+							pending.push_back({ piece.buffer + result, piece.offset + result, piece.size - result });
+					}
+					__atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+				}
+				return ok;
+			}
+
+		private:
+			void* map(std::size_t size, off_t offset)
+			{
+				void* result = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, offset);
+				return (result == MAP_FAILED) ? nullptr : result;
+			}
+
+			int _fd = -1;
+			unsigned _entries = 0;
+			bool _singleMap = false;
+			void* _sqRing = nullptr;
+			std::size_t _sqRingSize = 0;
+			void* _cqRing = nullptr;
+			std::size_t _cqRingSize = 0;
+			io_uring_sqe* _sqes = nullptr;
+			std::size_t _sqesSize = 0;
+			unsigned* _sqTail = nullptr;
+			unsigned* _sqMask = nullptr;
+			unsigned* _sqArray = nullptr;
+			unsigned* _cqHead = nullptr;
+			unsigned* _cqTail = nullptr;
+			unsigned* _cqMask = nullptr;
+			io_uring_cqe* _cqes = nullptr;
+		};
+
+		// Blocking reads like the sec2 driver, zero fills beyond the end of the file.
+		bool pread_all(int fd, std::uint64_t offset, std::size_t size, char* buffer)
+		{
+			while (size)
+			{
+				const ssize_t result = pread(fd, buffer, size, static_cast<off_t>(offset));
+				if (result < 0)
+				{
+					if ((errno == EINTR) || (errno == EAGAIN))
+						continue;
+					return false;
+				}
+				if (result == 0)
+				{
+					std::memset(buffer, 0, size);
+					break;
+				}
+				buffer += result;
+				offset += result;
+				size -= result;
+			}
+			return true;
+		}
+
+		struct UringFile
+		{
+			H5FD_t pub; // public part, has to be the first member
+			int fd = -1;
+			haddr_t eoa = 0;
+			haddr_t eof = 0;
+			dev_t device = 0;
+			ino_t inode = 0;
+			UringDriverConfig config;
+			Ring ring;
+
+			std::vector<char> readAheadBuffer;
+			haddr_t readAheadAddress = 0;
+			std::size_t readAheadSize = 0;
+			haddr_t lastReadEnd = HADDR_UNDEF;
+			unsigned sequentialReads = 0;
+		};
+
+		UringFile* uring_file(H5FD_t* file)
+		{
+			return reinterpret_cast<UringFile*>(file);
+		}
+
+		const UringFile* uring_file(const H5FD_t* file)
+		{
+			return reinterpret_cast<const UringFile*>(file);
+		}
+
+		H5FD_t* uring_open(const char* name, unsigned flags, hid_t fapl, haddr_t /*maxaddr*/)
+		{
+			// read-only driver
+			if (!name || !*name || (flags & (H5F_ACC_RDWR | H5F_ACC_TRUNC | H5F_ACC_CREAT)))
+				return nullptr;
+
+			const int fd = open(name, O_RDONLY | O_CLOEXEC);
+			if (fd < 0)
+				return nullptr;
+
+			struct stat fileStatus;
+			UringFile* file = (fstat(fd, &fileStatus) == 0) ? new (std::nothrow) UringFile() : nullptr;
+			if (!file)
+			{
+				close(fd);
+				return nullptr;
+			}
+
+			file->fd = fd;
+			file->eof = static_cast<haddr_t>(fileStatus.st_size);
+			file->device = fileStatus.st_dev;
+			file->inode = fileStatus.st_ino;
+			if (const auto* config = static_cast<const UringDriverConfig*>(H5Pget_driver_info(fapl)))
+				file->config = *config;
+			file->config.queueDepth = std::clamp(file->config.queueDepth, 1u, 4096u);
+			file->config.blockSize = std::max<std::size_t>(file->config.blockSize, 4096);
+
+			// without a ring every read is a blocking pread, like sec2
+			file->ring.init(file->config.queueDepth);
+			return &file->pub;
+		}
+
+		herr_t uring_close(H5FD_t* h5File)
+		{
+			UringFile* file = uring_file(h5File);
+			const bool closed = (close(file->fd) == 0);
+			delete file;
+			return closed ? 0 : -1;
+		}
+
+		int uring_cmp(const H5FD_t* h5File1, const H5FD_t* h5File2)
+		{
+			const UringFile* file1 = uring_file(h5File1);
+			const UringFile* file2 = uring_file(h5File2);
+			if (file1->device != file2->device)
+				return (file1->device < file2->device) ? -1 : 1;
+			if (file1->inode != file2->inode)
+				return (file1->inode < file2->inode) ? -1 : 1;
+			return 0;
+		}
+
+		herr_t uring_query(const H5FD_t*, unsigned long* flags)
+		{
+			if (flags)
+			{
+				*flags = H5FD_FEAT_AGGREGATE_METADATA | H5FD_FEAT_ACCUMULATE_METADATA | H5FD_FEAT_DATA_SIEVE | H5FD_FEAT_AGGREGATE_SMALLDATA | H5FD_FEAT_POSIX_COMPAT_HANDLE;
+#ifdef H5FD_FEAT_DEFAULT_VFD_COMPATIBLE
+				*flags |= H5FD_FEAT_DEFAULT_VFD_COMPATIBLE;
+#endif
+			}
+			return 0;
+		}
+
+		haddr_t uring_get_eoa(const H5FD_t* file, H5FD_mem_t)
+		{
+			return uring_file(file)->eoa;
+		}
+
+		herr_t uring_set_eoa(H5FD_t* file, H5FD_mem_t, haddr_t address)
+		{
+			uring_file(file)->eoa = address;
+			return 0;
+		}
+
+		haddr_t uring_get_eof(const H5FD_t* file, H5FD_mem_t)
+		{
+			return uring_file(file)->eof;
+		}
+
+		herr_t uring_get_handle(H5FD_t* file, hid_t, void** fileHandle)
+		{
+			if (!fileHandle)
+				return -1;
+			*fileHandle = &uring_file(file)->fd;
+			return 0;
+		}
+
+		herr_t uring_read(H5FD_t* h5File, H5FD_mem_t, hid_t, haddr_t address, size_t size, void* buffer)
+		{
+			UringFile* file = uring_file(h5File);
+			if ((address == HADDR_UNDEF) || (address + size < address) || (address + size > file->eoa))
+				return -1;
+
+			char* output = static_cast<char*>(buffer);
+			if (file->readAheadSize && (address >= file->readAheadAddress) && (address + size <= file->readAheadAddress + file->readAheadSize))
+			{
+				std::memcpy(output, file->readAheadBuffer.data() + (address - file->readAheadAddress), size);
+				file->lastReadEnd = address + size;
+				return 0;
+			}
+
+			file->sequentialReads = (address == file->lastReadEnd) ? file->sequentialReads + 1 : 0;
+			file->lastReadEnd = address + size;
+
+			const UringDriverConfig& config = file->config;
+			if (file->ring.valid())
+			{
+				// large reads: all blocks in flight at once
+				if (size >= 2 * config.blockSize)
+				{
+					if (file->ring.read(file->fd, address, size, output, config.blockSize))
+						return 0;
+					file->ring.destroy();
+				}
+				// a run of small sequential reads: fill the read-ahead buffer
+				else if ((file->sequentialReads >= 2) && (config.readAhead > size) && (file->eof > address) && (file->eof - address >= size))
+				{
+					const std::size_t readAheadSize = static_cast<std::size_t>(std::min<haddr_t>(config.readAhead, file->eof - address));
+					file->readAheadBuffer.resize(config.readAhead);
+					file->readAheadSize = 0;
+					if (file->ring.read(file->fd, address, readAheadSize, file->readAheadBuffer.data(), config.blockSize))
+					{
+						file->readAheadAddress = address;
+						file->readAheadSize = readAheadSize;
+						std::memcpy(output, file->readAheadBuffer.data(), size);
+						return 0;
+					}
+					file->ring.destroy();
+				}
+			}
+
+			return pread_all(file->fd, address, size, output) ? 0 : -1;
+		}
+
+		herr_t uring_write(H5FD_t*, H5FD_mem_t, hid_t, haddr_t, size_t, const void*)
+		{
+			return -1;
+		}
+
+		H5FD_class_t uring_class()
+		{
+			H5FD_class_t driverClass;
+			std::memset(&driverClass, 0, sizeof(driverClass));
+#if H5_VERSION_GE(1, 13, 2)
+			driverClass.version = H5FD_CLASS_VERSION;
+			driverClass.value = static_cast<H5FD_class_value_t>(uring_driver_value);
+#endif
+			driverClass.name = "mv_io_uring";
+			driverClass.maxaddr = static_cast<haddr_t>(std::numeric_limits<off_t>::max());
+			driverClass.fc_degree = H5F_CLOSE_WEAK;
+			driverClass.fapl_size = sizeof(UringDriverConfig);
+			driverClass.open = uring_open;
+			driverClass.close = uring_close;
+			driverClass.cmp = uring_cmp;
+			driverClass.query = uring_query;
+			driverClass.get_eoa = uring_get_eoa;
+			driverClass.set_eoa = uring_set_eoa;
+			driverClass.get_eof = uring_get_eof;
+			driverClass.get_handle = uring_get_handle;
+			driverClass.read = uring_read;
+			driverClass.write = uring_write;
+			const H5FD_mem_t freeListMap[H5FD_MEM_NTYPES] = H5FD_FLMAP_DICHOTOMY;
+			std::copy(freeListMap, freeListMap + H5FD_MEM_NTYPES, driverClass.fl_map);
+			return driverClass;
+		}
+	}
+#endif
+
+	bool uring_driver_available()
+	{
+#ifdef MV_H5_HAVE_IO_URING
+		static const bool available = []()
+		{
+			local::Ring ring;
+			return ring.init(1);
+		}();
+		return available;
+#else
+		return false;
+#endif
+	}
+
+	hid_t uring_driver_id()
+	{
+#ifdef MV_H5_HAVE_IO_URING
+		static const hid_t driverId = []() -> hid_t
+		{
+			if (!uring_driver_available())
+				return H5I_INVALID_HID;
+			static const H5FD_class_t driverClass = local::uring_class();
+			return H5FDregister(&driverClass);
+		}();
+		return (driverId < 0) ? H5I_INVALID_HID : driverId;
+#else
+		return H5I_INVALID_HID;
+#endif
+	}
+
+	bool set_uring_driver(H5::FileAccPropList& fapl, const UringDriverConfig& config)
+	{
+		const hid_t driverId = uring_driver_id();
+		if (driverId == H5I_INVALID_HID)
+			return false;
+		return H5Pset_driver(fapl.getId(), driverId, &config) >= 0;
+	}
+}
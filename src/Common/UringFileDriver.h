@@ -0,0 +1,31 @@
+#pragma once
+
+#include "H5Cpp.h"
+
+#include <cstddef>
+
+namespace H5Utils
+{
+	struct UringDriverConfig
+	{
+		unsigned queueDepth = 32;              // reads in flight per file
+		std::size_t blockSize = 1024 * 1024;   // large reads are split in blocks of this size and issued in parallel
+		std::size_t readAhead = 8 * 1024 * 1024; // bytes read ahead once small reads are sequential, 0 disables read ahead
+	};
+
+	/*
+	* Read-only HDF5 virtual file driver that issues reads through io_uring (Linux only).
+	* Large reads, like the contiguous data/indices/indptr scans of the loaders, are split in blocks that are all
+	* in flight at once, and sequential runs of small reads are served from a read-ahead buffer. Files are
+	* compatible with the default sec2 driver.
+	*/
+
+	// False if the driver is not compiled in or the kernel (or a seccomp profile) does not allow io_uring.
+	bool uring_driver_available();
+
+	// Registers the driver once, returns H5I_INVALID_HID if it is not available.
+	hid_t uring_driver_id();
+
+	// Sets the driver on a file access property list, leaves it unchanged (sec2) and returns false if the driver is not available.
+	bool set_uring_driver(H5::FileAccPropList& fapl, const UringDriverConfig& config = UringDriverConfig());
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "Trace.h"
+#include "TransformType.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+* The dense and per-value kernels of the loaders (post-processing, conversion, transposition, string decoding) on
+* plain containers and iterators, so they do not depend on a ManiVault dataset or Qt and can be run and timed in
+* isolation, as the sparse ones in SparseKernels.h. progress(steps) is called from any thread with the steps done.
+*/
+
+namespace H5Utils
+{
+	template<typename T>
+	bool is_integer(T value)
+	{
+		return std::is_integral_v<T> || (value == std::round(value));
+	}
+
+	template<typename T>
+	bool contains_only_integers(const std::vector<T>& data)
+	{
+		if (std::is_integral_v<T>)
+			return true;
+
+		for (std::size_t i = 0; i < data.size(); ++i)
+		{
+			if (!is_integer(data[i]))
+				return false;
+		}
+		return true;
+	}
+
+	// Converts every value of source to the element type of target, for instance float to bfloat16.
+	template<typename T, typename S>
+	void convert_values(const std::vector<S>& source, std::vector<T>& target)
+	{
+		target.resize(source.size());
+		#pragma omp parallel
+		{
+			MV_H5_TRACE_SCOPE("convert_values worker");
+			#pragma omp for nowait
+			for (std::ptrdiff_t i = 0; i < static_cast<std::ptrdiff_t>(source.size()); ++i)
+				target[i] = source[i];
+		}
+	}
+
+	/*
+	* Keeps the values whose entry in dimensionIndices is not negative, at the position it gives. An empty
+	* dimensionIndices keeps all values.
+	*/
+	template<typename T>
+	void filter_values(T& values, const std::vector<std::ptrdiff_t>& dimensionIndices)
+	{
+		if (dimensionIndices.empty())
+			return;
+		assert(values.size() == dimensionIndices.size());
+		const auto nrOfSelectedIdices = std::count_if(dimensionIndices.cbegin(), dimensionIndices.cend(), [](std::ptrdiff_t i) { return (i >= 0); });
+		T selectedValues(nrOfSelectedIdices);
+		#pragma omp parallel
+		{
+			MV_H5_TRACE_SCOPE("filter_values worker");
+			#pragma omp for nowait
+			for (std::ptrdiff_t i = 0; i < static_cast<std::ptrdiff_t>(dimensionIndices.size()); ++i)
+			{
+				auto index = dimensionIndices[i];
+				if (index >= 0)
+				{
+					auto value = values[i];
+					assert(index < nrOfSelectedIdices);
+					selectedValues[index] = value;
+				}
+			}
+		}
+		values = std::move(selectedValues);
+	}
+
+	/*
+	* Scales every row of the row major rows x columns output to counts per million and applies the transform to its
+	* nonzeros, the post-processing of DataContainerInterface::applyTransform.
+	*/
+	template<typename OutputIterator, typename ProgressFunction>
+	void normalize_and_transform_rows(OutputIterator beginOfData, std::int64_t rows, std::int64_t columns, TRANSFORM::Type transformType, ProgressFunction progress)
+	{
+		#pragma omp parallel for
+		for (std::int64_t row = 0; row < rows; ++row)
+		{
+			uint64_t offset = row * columns;
+			auto *rowdata = &(beginOfData[offset]);
+			double dummy = 0.0;
+			double sum = std::accumulate(rowdata, rowdata + columns, dummy);
+			for (auto *i = rowdata; i != rowdata + columns; ++i)
+			{
+				const float value = *i;
+				if (value != 0)
+				{
+					const float normalized_cpm_value = (sum == 0) ? 0 : 1e6 * (value / sum);
+					switch (transformType.first)
+					{
+					case TRANSFORM::NONE: *i = normalized_cpm_value; break;
+					case TRANSFORM::LOG: *i = log2(1 + normalized_cpm_value); break;
+					case TRANSFORM::ARCSIN5: *i = asinh(normalized_cpm_value / 5.0); break;
+					case TRANSFORM::SQRT: *i = sqrt(normalized_cpm_value); break;
+					}
+				}
+			}
+
+			progress(std::uint64_t(1));
+		}
+	}
+
+	// In place transposition of the row major matrix [first, last) with m rows, following the permutation cycles.
+	template<class RandomIterator, typename ProgressFunction>
+	void transpose_in_place(RandomIterator first, RandomIterator last, std::ptrdiff_t m, ProgressFunction progress)
+	{
+		//https://stackoverflow.com/questions/9227747/in-place-transposition-of-a-matrix
+		const std::ptrdiff_t mn1 = (last - first - 1);
+		const std::ptrdiff_t n = (last - first) / m;
+		RandomIterator cycle = first;
+		std::vector<uint8_t> visited(last - first, 0);
+		while (++cycle != last) {
+			if (visited[cycle - first])
+				continue;
+			std::ptrdiff_t a = cycle - first;
+			do {
+				a = a == mn1 ? mn1 : n * a % mn1;
+				std::swap(*(first + a), *cycle);
+				visited[a] = 1;
+				progress(std::uint64_t(1));
+			} while ((first + a) != cycle);
+		}
+	}
+
+	/*
+	* Decodes count fixed length strings of stringSize bytes as read from an HDF5 string dataset. Surrounding quotes
+	* are removed and a string ends at its first null byte. toString converts a null terminated char array to the
+	* string type of result.
+	*/
+	template<typename StringType, typename ToString>
+	void decode_fixed_length_strings(const std::vector<char>& raw, std::size_t count, std::size_t stringSize, std::vector<StringType>& result, ToString toString)
+	{
+		assert(raw.size() >= count * stringSize);
+		result.resize(count);
+		for (std::size_t d = 0; d < count; ++d)
+		{
+			auto offset = raw.cbegin() + (d * stringSize);
+			if (*offset == '\"')
+				result[d] = toString(std::string(offset + 1, offset + stringSize - 1).c_str());
+			else
+				result[d] = toString(std::string(offset, offset + stringSize).c_str());
+		}
+	}
+}
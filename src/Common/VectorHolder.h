@@ -3,15 +3,17 @@
 #include <array>
 #include <cstdint>
 #include <cassert>
+#include <limits>
 #include <variant>
 #include <vector>
 #include <type_traits>
 
 #include "H5Cpp.h"
+#include "IndexVector.h"
 
 namespace H5Utils
 {
-	class VectorHolder // copied form PointData for now, and added double
+	class VectorHolder // copied form PointData for now, and added the 32/64 bit integer types and double
 	{
 	private:
 		using VariantOfVectors = std::variant <
@@ -20,7 +22,12 @@ namespace H5Utils
 			std::vector<std::int16_t>,
 			std::vector<std::uint16_t>,
 			std::vector<std::int8_t>,
-			std::vector<std::uint8_t> >;
+			std::vector<std::uint8_t>,
+			std::vector<std::uint32_t>,
+			std::vector<std::int32_t>,
+			std::vector<std::uint64_t>,
+			std::vector<std::int64_t>,
+			std::vector<double> >;
 
 		typedef std::variant_alternative_t<0, VariantOfVectors> fallback_type;
 		VariantOfVectors _variantOfVectors;
@@ -33,6 +40,11 @@ namespace H5Utils
 			uint16,
 			int8,
 			uint8,
+			uint32,
+			int32,
+			uint64,
+			int64,
+			float64,
 
 			fallback = float32
 		};
@@ -46,7 +58,12 @@ namespace H5Utils
 				"int16",
 				"uint16",
 				"int8",
-				"uint8"
+				"uint8",
+				"uint32",
+				"int32",
+				"uint64",
+				"int64",
+				"float64"
 			} };
 		}
 
@@ -131,13 +148,18 @@ namespace H5Utils
 			std::is_same<T, std::int16_t>,
 			std::is_same<T, std::uint16_t>,
 			std::is_same<T, std::int8_t>,
-			std::is_same<T, std::uint8_t>
+			std::is_same<T, std::uint8_t>,
+			std::is_same<T, std::uint32_t>,
+			std::is_same<T, std::int32_t>,
+			std::is_same<T, std::uint64_t>,
+			std::is_same<T, std::int64_t>,
+			std::is_same<T, double>
 		>;
 
 		template <typename T, typename = std::enable_if_t<is_allowed_type<T>::value>>
 		explicit VectorHolder(const std::vector<T>& vec)
 		{
-			std::get<std::vector<T>>(_variantOfVectors) = vec;
+			_variantOfVectors = vec;
 		}
 
 		/// Explicit constructor that efficiently "moves" the specified vector
@@ -146,7 +168,7 @@ namespace H5Utils
 		template <typename T>
 		explicit VectorHolder(std::vector<T>&& vec)
 		{
-			std::get<std::vector<T>>(_variantOfVectors) = std::move(vec);
+			_variantOfVectors = std::move(vec);
 		}
 
 
@@ -254,6 +276,11 @@ namespace H5Utils
 				case ElementTypeSpecifier::uint16: return H5::PredType::NATIVE_UINT16;
 				case ElementTypeSpecifier::int8: return H5::PredType::NATIVE_INT8;
 				case ElementTypeSpecifier::uint8: return H5::PredType::NATIVE_UINT8;
+				case ElementTypeSpecifier::uint32: return H5::PredType::NATIVE_UINT32;
+				case ElementTypeSpecifier::int32: return H5::PredType::NATIVE_INT32;
+				case ElementTypeSpecifier::uint64: return H5::PredType::NATIVE_UINT64;
+				case ElementTypeSpecifier::int64: return H5::PredType::NATIVE_INT64;
+				case ElementTypeSpecifier::float64: return H5::PredType::NATIVE_DOUBLE;
 				default: throw std::bad_variant_access();
 			}
 		}
@@ -271,6 +298,16 @@ namespace H5Utils
 				setElementTypeSpecifier(ElementTypeSpecifier::int16);
 			else if (predType == H5::PredType::NATIVE_FLOAT)
 				setElementTypeSpecifier(ElementTypeSpecifier::float32);
+			else if (predType == H5::PredType::NATIVE_UINT32)
+				setElementTypeSpecifier(ElementTypeSpecifier::uint32);
+			else if (predType == H5::PredType::NATIVE_INT32)
+				setElementTypeSpecifier(ElementTypeSpecifier::int32);
+			else if (predType == H5::PredType::NATIVE_UINT64)
+				setElementTypeSpecifier(ElementTypeSpecifier::uint64);
+			else if (predType == H5::PredType::NATIVE_INT64)
+				setElementTypeSpecifier(ElementTypeSpecifier::int64);
+			else if (predType == H5::PredType::NATIVE_DOUBLE)
+				setElementTypeSpecifier(ElementTypeSpecifier::float64);
 			else
 				setElementTypeSpecifier(ElementTypeSpecifier::fallback);
 		}
@@ -2,6 +2,8 @@
 
 #include "DataTransform.h"
 #include "HDF5_10X_Loader.h"
+#include "MatrixCache.h"
+#include "Trace.h"
 
 #include "PointData/PointData.h"
 
@@ -16,6 +18,8 @@
 #include <QStringList>
 #include <QMessageBox>
 
+#include <algorithm>
+
 Q_PLUGIN_METADATA(IID "nl.lumc.H510XLoader")
 
 using namespace mv;
@@ -49,9 +53,16 @@ namespace
 		const QString conversionIndexKey("conversionIndex");
 		const QString transformValueKey("transformValue");
 		const QString storageValueKey("storageValue");
+		const QString fileAccessKey("fileAccess");
 		const QString fileNameKey("fileName");
+		const QString loadReportDirectoryKey("loadReportDirectory"); // every load report is also written here as JSON, empty disables it
+		const QString matrixCacheLimitKey("matrixCacheLimitMB"); // size limit of the matrix cache, 0 disables it
+		const QString memoryBudgetKey("memoryBudgetMB"); // 0 uses 80% of the available memory
 		const QString normalizeKey("normalize");
+		const QString progressiveLoadingKey("progressiveLoading"); // show the first rows while the rest loads
 		const QString selectedNameFilterKey("selectedNameFilter");
+		const QString shardedReadWorkersKey("shardedReadWorkers"); // worker processes for large reads, 0 reads in-process
+		const QString traceFileKey("traceFile"); // Chrome trace of the last load, only recorded in builds with MV_H5_ENABLE_TRACING
 	}
 
 }	// Unnamed namespace
@@ -119,6 +130,15 @@ void H510XLoader::loadData()
 	fileDialogLayout->addWidget(storageTypeLabel, rowCount, 0);
 	fileDialogLayout->addWidget(storageTypeComboBox, rowCount, 1);
 
+	QComboBox* fileAccessComboBox = new QComboBox;
+	QLabel* fileAccessLabel = new QLabel("File Access");
+	for (auto profile : H5Utils::available_file_access_profiles())
+		fileAccessComboBox->addItem(H5Utils::file_access_profile_name(profile), static_cast<int>(profile));
+	fileAccessComboBox->setCurrentIndex(std::min(getSetting(Keys::fileAccessKey, 0).toInt(), fileAccessComboBox->count() - 1));
+
+	fileDialogLayout->addWidget(fileAccessLabel, rowCount + 1, 0);
+	fileDialogLayout->addWidget(fileAccessComboBox, rowCount + 1, 1);
+
 	TRANSFORM::Control transform(fileDialogLayout);
 
 	const auto conversionIndexSetting = getSetting(Keys::conversionIndexKey, QVariant());
@@ -154,10 +174,6 @@ void H510XLoader::loadData()
 	if (fileNameSetting.isValid())
 		_fileDialog.selectFile(fileNameSetting.toString());
 
-	// keeping storageTypeComboBox for now since we probably should implement this functionality
-	storageTypeComboBox->setVisible(false);
-	storageTypeLabel->setVisible(false);
-
 	transform.setVisible(true);
 	transform.setTransform(0);
 
@@ -176,6 +192,7 @@ void H510XLoader::loadData()
 		
 		setSetting(Keys::conversionIndexKey, transform_setting.first);
 		setSetting(Keys::storageValueKey, storageTypeComboBox->currentIndex());
+		setSetting(Keys::fileAccessKey, fileAccessComboBox->currentIndex());
 		setSetting(Keys::transformValueKey, transform_setting.second);
 		setSetting(Keys::fileNameKey, firstFileName);
 		setSetting(Keys::selectedNameFilterKey, selectedNameFilter);
@@ -183,9 +200,17 @@ void H510XLoader::loadData()
 		for (const auto& fileName : fileNames)
 		{
 			HDF5_10X_Loader loader(_core);
+			H5Utils::set_sharded_read_workers(getSetting(Keys::shardedReadWorkersKey, 0).toUInt());
+			H5Utils::set_matrix_cache_limit(getSetting(Keys::matrixCacheLimitKey, 0).toULongLong() * 1024 * 1024);
+			H5Utils::set_load_report_directory(getSetting(Keys::loadReportDirectoryKey, QString()).toString());
+			H5Utils::set_trace_file(getSetting(Keys::traceFileKey, QString()).toString().toStdString());
+			loader.setMemoryBudget(getSetting(Keys::memoryBudgetKey, 0).toULongLong() * 1024 * 1024);
+			loader.setFileAccessProfile(static_cast<H5Utils::FileAccessProfile>(fileAccessComboBox->currentData().toInt()));
+			loader.setProgressive(getSetting(Keys::progressiveLoadingKey, false).toBool());
 			if (loader.open(fileName))
 			{
-				loader.load(transform_setting, 0);
+				loader.load(transform_setting, storageTypeComboBox->currentData().toInt());
+				H5Utils::export_trace();
 			}
 			else
 			{
@@ -9,11 +9,23 @@
 #include <QLabel>
 #include <QLineEdit>
 #include <QSlider>
+#include <QMessageBox>
+#include <QElapsedTimer>
 
 #include "H5Utils.h"
+#include "BackedMatrix.h"
+#include "BackedPoints.h"
 #include "DataContainerInterface.h"
+#include "RowBlockReader.h"
+#include "ColumnPipeline.h"
+#include "LoadPlanner.h"
+#include "LoadReport.h"
+#include "MatrixCache.h"
+#include "MatrixDecoder.h"
+#include "VectorHolder.h"
 
 #include <iostream>
+#include <numeric>
 
 #include "ClusterData/Cluster.h"
 #include "ClusterData/ClusterData.h"
@@ -58,8 +70,7 @@ shape	uint64	Tuple of (n_rows, n_columns)
 				H5::Group group = file.openGroup(objectName1);
 				std::vector<float> data;
 				std::vector<biovault::bfloat16_t> data16;
-				std::vector<uint32_t> indptr;
-				std::vector<uint64_t> indices;
+				H5Utils::CompressedMatrix matrix;
 				std::vector<std::string> barcodes;
 				std::vector<std::string> genes;
 
@@ -83,25 +94,9 @@ shape	uint64	Tuple of (n_rows, n_columns)
 				else
 					result = false;
 
-				
-				if (result && group.exists("indptr"))
-				{
-					if (!H5Utils::read_vector(group, "indptr", &indptr))
-						result = false;
-				}
-				else
-					result = false;
-
-				if (result && group.exists("indices"))
-				{
-					if (!H5Utils::read_vector(group, "indices", &indices))
-						result = false;
-				}
-				else
+				if (result && !H5Utils::read_compressed_matrix(group, barcodes.size(), genes.size(), false, matrix, group.exists("data") ? "data" : "data16"))
 					result = false;
 
-				
-
 				if (result && group.exists("data"))
 				{
 					if (!H5Utils::read_vector(group, "data", &data))
@@ -120,15 +115,23 @@ shape	uint64	Tuple of (n_rows, n_columns)
 						task.setRunning();
 
 						data.resize(data16.size());
-						#pragma omp parallel for
-						for(std::int64_t i=0; i < data16.size(); ++i)
 						{
-							data[i] = biovault::bfloat16_t(data16[i], true);
-
-							if (i % 100000 == 0) {
-								task.setProgress(static_cast<float>(i) / static_cast<float>(data16.size()));
+							// progress is counted per block of values, the conversion itself is too cheap to count every value
+							const std::int64_t blockSize = 1 << 16;
+							const std::int64_t size = data16.size();
+							H5Utils::ProgressCounter progress(size, [&task](float fraction) { task.setProgress(fraction); });
+							#pragma omp parallel
+							{
+								MV_H5_TRACE_SCOPE("bfloat16 conversion worker");
+								#pragma omp for nowait
+								for (std::int64_t block = 0; block < size; block += blockSize)
+								{
+									const std::int64_t end = std::min(block + blockSize, size);
+									for (std::int64_t i = block; i < end; ++i)
+										data[i] = biovault::bfloat16_t(data16[i], true);
+									progress.add(end - block);
+								}
 							}
-								
 						}
 
 						task.setFinished();
@@ -143,7 +146,6 @@ shape	uint64	Tuple of (n_rows, n_columns)
 
 				
 				std::size_t rows = barcodes.size();
-				assert(indptr.size() == (rows + 1));
 				std::size_t columns = genes.size();
 
 				Dataset<Points> pointsDataset = rawData->points();
@@ -154,13 +156,13 @@ shape	uint64	Tuple of (n_rows, n_columns)
 				{
 					pointsDataset->setDataElementType<biovault::bfloat16_t>();
 					rawData->resize(rows, columns);
-					rawData->set_sparse_row_data(indices, indptr, data16, transform_settings);
+					rawData->set_sparse_data(matrix, data16, transform_settings);
 				}
 				else
 				{
 					pointsDataset->setDataElementType<float>();
 					rawData->resize(rows, columns);
-					rawData->set_sparse_row_data(indices, indptr, data, transform_settings);
+					rawData->set_sparse_data(matrix, data, transform_settings);
 				}
 				
 				
@@ -328,6 +330,59 @@ shape	uint64	Tuple of (n_rows, n_columns)
 		}
 		return false;
 	}
+
+	// One meta/<label> group: the labels with their colors, numerical when all labels are numbers.
+	struct MetaDataColumn
+	{
+		std::string label;
+		std::vector<QString> items;
+		std::vector<std::uint8_t> colors;	// rgb per item
+
+		bool numerical = true;
+		std::vector<float> values;
+		std::map<QString, std::vector<unsigned>> indices;
+		std::map<QString, QColor> qcolors;
+	};
+
+	bool ReadMetaDataColumn(H5::Group& metaDataSuperGroup, hsize_t m, MetaDataColumn& column)
+	{
+		column.label = metaDataSuperGroup.getObjnameByIdx(m).c_str();
+		auto metaDataGroup = metaDataSuperGroup.openGroup(column.label);
+		bool ok = H5Utils::read_vector_string(metaDataGroup, "l", column.items);
+		ok &= H5Utils::read_vector(metaDataGroup, "c", &column.colors);
+		ok &= ((3 * column.items.size()) == column.colors.size());
+		return ok;
+	}
+
+	// Thread safe, does not touch any dataset.
+	void ClassifyMetaDataColumn(MetaDataColumn& column)
+	{
+		const auto& items = column.items;
+		column.values.reserve(items.size());
+		for (std::size_t l = 0; l < items.size(); ++l)
+		{
+			if (!H5Utils::is_number(items[l]))
+			{
+				column.numerical = false;
+				column.values.clear();
+				break;
+			}
+			column.values.push_back(items[l].toDouble());
+		}
+		if (column.numerical)
+			return;
+
+		for (std::size_t l = 0; l < items.size(); ++l)
+		{
+			const QString& item = items[l];
+			column.indices[item].push_back(l);
+			if (column.qcolors.find(item) == column.qcolors.end())
+			{
+				const auto colorOffset = l * 3;
+				column.qcolors[item] = QColor(column.colors[colorOffset], column.colors[colorOffset + 1], column.colors[colorOffset + 2]);
+			}
+		}
+	}
 	
 }
 
@@ -340,10 +395,16 @@ HDF5_10X_Loader::HDF5_10X_Loader(mv::CoreInterface *core)
 
 bool HDF5_10X_Loader::open(const QString& fileName)
 {
+	MV_H5_TRACE_SCOPE("HDF5_10X_Loader::open");
 	bool result = false;
 	try
 	{
-		_file.reset(new H5::H5File(fileName.toLatin1().constData(), H5F_ACC_RDONLY));
+		_report = std::make_unique<H5Utils::LoadReport>("10X", fileName);
+		{
+			H5Utils::LoadReport::Phase phase(_report.get(), "open");
+			_file = H5Utils::open_file(fileName, _fileAccessProfile, _memoryBudget);
+		}
+		H5Utils::LoadReport::Phase phase(_report.get(), "structure scan");
 		H5G_obj_t baseObjectType = _file->getObjTypeByIdx(0);
 
 		if (baseObjectType == H5G_GROUP)
@@ -390,7 +451,7 @@ bool HDF5_10X_Loader::open(const QString& fileName)
 	catch (...)
 	{
 		_file->close();
-		_file.release();
+		_file.reset();
 	}
 	return result;
 }
@@ -400,8 +461,24 @@ const std::vector<QString>& HDF5_10X_Loader::getDimensionNames() const
 	return _dimensionNames;
 }
 
-bool HDF5_10X_Loader::load(TRANSFORM::Type transform_settings, int speedIndex)
+void HDF5_10X_Loader::setProgressive(bool progressive)
+{
+	_progressive = progressive;
+}
+
+void HDF5_10X_Loader::setMemoryBudget(std::uint64_t bytes)
+{
+	_memoryBudget = bytes;
+}
+
+void HDF5_10X_Loader::setFileAccessProfile(H5Utils::FileAccessProfile profile)
+{
+	_fileAccessProfile = profile;
+}
+
+bool HDF5_10X_Loader::load(TRANSFORM::Type transform_settings, int storageType)
 {
+	MV_H5_TRACE_SCOPE("HDF5_10X_Loader::load");
 	/*
 Column	Type	Description
 barcodes	string	Barcode sequences and their corresponding gem groups (e.g. AAACGGGCAGCTCGAC-1)
@@ -417,6 +494,8 @@ shape	uint64	Tuple of (n_rows, n_columns)
 	if (_file == nullptr)
 		return false;
 	bool result = false;
+	H5Utils::ReadTask readTask(_fileName);
+	Dataset<Points> pointsDataset;
 	try
 	{
 		auto nrOfObjects = _file->getNumObjs();
@@ -425,56 +504,214 @@ shape	uint64	Tuple of (n_rows, n_columns)
 		if (objectType1 == H5G_GROUP)
 		{
 			H5::Group group = _file->openGroup(objectName1);
-			std::vector<float> data;
-			std::vector<biovault::bfloat16_t> data16;
-			std::vector<uint32_t> indptr;
-			std::vector<uint64_t> indices;
+			H5Utils::CompressedMatrix matrix;
+			H5Utils::TrackedBuffer trackedMatrix("X indices and indptr");
 			
 
 			// dataset existance already checked when opening file so now directly open them
 
 			bool result = !(_dimensionNames.empty());
 			result &= !(_sampleNames.empty());
-			if (result)
-				result &= H5Utils::read_vector(group, "indptr", &indptr);
-			if (result)
-				result &= H5Utils::read_vector(group, "indices", &indices);
-			if (result && group.exists("data"))
+
+			// on a matrix cache hit only the names and the metadata are read from the file
+			const QString cacheKey = H5Utils::matrix_cache_key(_fileName, QString("10x storageType=%1 transform=%2,%3").arg(storageType).arg(transform_settings.first).arg(transform_settings.second));
+			if (result && H5Utils::has_cached_matrix(cacheKey))
+			{
+				H5Utils::LoadReport::Phase phase(_report.get(), "matrix cache");
+				pointsDataset = H5Utils::createPointsDataset(_core, true, QFileInfo(_fileName).baseName());
+				if (!H5Utils::load_cached_matrix(cacheKey, pointsDataset))
+				{
+					mv::data().removeDataset(pointsDataset);
+					pointsDataset = Dataset<Points>();
+				}
+			}
+			const bool cacheHit = pointsDataset.isValid();
+			_report->set("cacheHit", cacheHit);
+
+			// data16 holds raw bfloat16 bits, for data the element type follows the storage type selection so integer counts can stay integers;
+			// the optimized types are chosen while data is read, so the plan uses the largest type the selection can give
+			const bool hasData16 = !group.exists("data") && group.exists("data16");
+			const bool valuesTransformed = transform_settings.first != TRANSFORM::NONE;
+			int elementType = (int)PointData::ElementTypeSpecifier::bfloat16;
+			if (result && !hasData16 && !cacheHit)
+				elementType = H5Utils::storage_type_bound(storageType, group.openDataSet("data"), valuesTransformed);
+
+			// when reading the sparse data whole does not fit the memory budget, but the result does, the rows are read in blocks;
+			// when the result does not fit either, the matrix stays in the file and the points only hold the shown columns
+			std::unique_ptr<H5Utils::RowBlockReader> blockReader;
+			std::shared_ptr<H5Utils::BackedMatrix> backedMatrix;
+			bool progressive = false;
+			if (result && !cacheHit)
+			{
+				H5Utils::LoadReport::Phase phase(_report.get(), "structure scan");
+				H5Utils::MatrixLayout layout;
+				H5Utils::read_sparse_layout(group, _dimensionNames.size(), layout, hasData16 ? "data16" : "data");
+				_report->set("nnz", static_cast<double>(layout.nnz));
+				const H5Utils::LoadPlanner planner(layout, _memoryBudget);
+				const QString report = QString::fromStdString(planner.report(elementType));
+				std::cout << report.toStdString() << std::endl;
+				if (!planner.estimate(H5Utils::LoadStrategy::Dense, elementType).fitsBudget)
+				{
+					if (!hasData16 && planner.estimate(H5Utils::LoadStrategy::Streaming, elementType).fitsBudget)
+					{
+						blockReader = std::make_unique<H5Utils::RowBlockReader>(group, _dimensionNames.size());
+						if (!blockReader->valid() || (blockReader->rows() != _sampleNames.size()))
+							blockReader.reset();
+					}
+					else if (!hasData16 && planner.estimate(H5Utils::LoadStrategy::Backed, elementType).fitsBudget)
+					{
+						backedMatrix = std::make_shared<H5Utils::BackedMatrix>(_file, group, _dimensionNames.size());
+						if (!backedMatrix->valid() || (backedMatrix->rows() != _sampleNames.size()))
+							backedMatrix.reset();
+					}
+					if (blockReader)
+						std::cout << "The data does not fit in the memory budget, reading it in blocks of " << blockReader->blockRows() << " rows" << std::endl;
+					else if (backedMatrix)
+						std::cout << "The data does not fit in the memory budget, it stays in the file and only the shown genes are read" << std::endl;
+					else if (QMessageBox::question(nullptr, QFileInfo(_fileName).fileName(), report + "\n\nThe data does not fit in the memory budget. Continue loading?") != QMessageBox::Yes)
+						return false;
+				}
+
+				// progressive loading reads the rows in blocks as well, to show the first rows while the rest loads; growing
+				// the matrix holds the rows loaded so far next to the larger matrix, so it needs its own budget check
+				if (_progressive && !hasData16 && !backedMatrix)
+				{
+					progressive = planner.estimate(H5Utils::LoadStrategy::Progressive, elementType).fitsBudget;
+					if (!progressive)
+						std::cout << "Growing the data progressively does not fit in the memory budget, showing it when it is loaded" << std::endl;
+					else if (!blockReader)
+					{
+						blockReader = std::make_unique<H5Utils::RowBlockReader>(group, _dimensionNames.size());
+						if (!blockReader->valid() || (blockReader->rows() != _sampleNames.size()))
+							blockReader.reset();
+					}
+					progressive = progressive && blockReader;
+				}
+
+				// blocks are scattered into points of the final type, which needs the value range before the first block
+				if (blockReader && !hasData16)
+					elementType = H5Utils::resolve_storage_type(storageType, group.openDataSet("data"), valuesTransformed);
+			}
+			if (!cacheHit)
 			{
-				result &= H5Utils::read_vector(group, "data", &data);
+				_report->set("storageType", H5Utils::element_type_name(backedMatrix ? (int)PointData::ElementTypeSpecifier::float32 : elementType));
+				_report->set("strategy", H5Utils::strategy_name(backedMatrix ? H5Utils::LoadStrategy::Backed : (progressive ? H5Utils::LoadStrategy::Progressive : (blockReader ? H5Utils::LoadStrategy::Streaming : H5Utils::LoadStrategy::Dense))));
 			}
-			else if (result && group.exists("data16"))
+
+			if (result && !cacheHit && backedMatrix)
 			{
-				result &= H5Utils::read_vector(group, "data16", &data16);
+				H5Utils::LoadReport::Phase phase(_report.get(), "read shown columns");
+				std::vector<std::uint64_t> shownColumns(std::min<std::uint64_t>(H5Utils::backed_shown_columns, _dimensionNames.size()));
+				std::iota(shownColumns.begin(), shownColumns.end(), 0);
+				pointsDataset = H5Utils::createPointsDataset(_core, true, QFileInfo(_fileName).baseName());
+				if (!H5Utils::BackedPoints::attach(pointsDataset, backedMatrix, _dimensionNames, shownColumns, transform_settings, _memoryBudget))
+				{
+					std::cout << "Error Reading File " << _fileName.toStdString() << ": the shown genes could not be read" << std::endl;
+					mv::data().removeDataset(pointsDataset);
+					result = false;
+				}
 			}
 
-			if (result)
+			if (result && !cacheHit && !blockReader && !backedMatrix)
+			{
+				H5Utils::LoadReport::Phase phase(_report.get(), "read");
+				if (!H5Utils::read_compressed_matrix(group, _sampleNames.size(), _dimensionNames.size(), false, matrix, hasData16 ? "data16" : "data"))
+				{
+					std::cout << "Error Reading File " << _fileName.toStdString() << ": indptr and indices do not match the barcodes, the genes and the number of nonzeros" << std::endl;
+					result = false;
+				}
+				trackedMatrix.setBytes(matrix.bytes());
+			}
+
+			// data is read once, in the type the storage type selection resolves to
+			H5Utils::VectorHolder values;
+			if (result && !cacheHit && !backedMatrix && !hasData16 && !blockReader)
+			{
+				H5Utils::LoadReport::Phase phase(_report.get(), "read");
+				elementType = H5Utils::read_vector_resolved(group, "data", storageType, valuesTransformed, values);
+				result &= (elementType >= 0);
+				_report->set("storageType", H5Utils::element_type_name(elementType));
+			}
+
+			if (result && !cacheHit && !backedMatrix)
 			{
 				std::size_t rows = _sampleNames.size();
-				assert(indptr.size() == (rows + 1));
 				std::size_t columns = _dimensionNames.size();
 
-				
-				Dataset<Points> pointsDataset = H5Utils::createPointsDataset(_core, true, QFileInfo(_fileName).baseName());
-				std::unique_ptr<DataContainerInterface> rawData(new DataContainerInterface(pointsDataset));
+				H5Utils::visit_storage_type(elementType, [&](auto elementTypeIdentity)
+					{
+						typedef typename decltype(elementTypeIdentity)::type T;
 
-				if (data16.size())
-				{
-					pointsDataset->setDataElementType<biovault::bfloat16_t>();
-					rawData->resize(rows, columns);
-					rawData->set_sparse_row_data(indices, indptr, data16, transform_settings);
-				}
-				else
+						std::vector<T> data;
+						H5Utils::TrackedBuffer trackedData("X data");
+						{
+							H5Utils::LoadReport::Phase phase(_report.get(), "read");
+							if (hasData16)
+								result &= H5Utils::read_vector(group, "data16", &data);
+							else if (!blockReader) // read block by block below
+								data = std::move(values.getVector<T>());
+							trackedData.setBytes(H5Utils::TrackedBuffer::container_bytes(data));
+						}
+						if (!result)
+							return;
+
+						H5Utils::LoadReport::Phase phase(_report.get(), "dataset creation");
+						pointsDataset = H5Utils::createPointsDataset(_core, true, QFileInfo(_fileName).baseName());
+						std::unique_ptr<DataContainerInterface> rawData(new DataContainerInterface(pointsDataset));
+
+						pointsDataset->setDataElementType<T>();
+						if (progressive)
+						{
+							phase.next("read and scatter");
+							QElapsedTimer sinceUpdate;
+							result = rawData->set_row_block_data_progressively(*blockReader, {}, transform_settings, columns, [&](std::uint64_t loadedRows)
+								{
+									// the last update follows when the metadata has been added
+									if ((loadedRows == rows) || (sinceUpdate.isValid() && (sinceUpdate.elapsed() < progressive_update_interval)))
+										return;
+									pointsDataset->setDimensionNames(_dimensionNames);
+									events().notifyDatasetDataChanged(pointsDataset);
+									QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+									sinceUpdate.start();
+								});
+							if (!result)
+							{
+								std::cout << "Error Reading File " << _fileName.toStdString() << ": not enough memory for " << rows << " x " << columns << " values" << std::endl;
+								mv::data().removeDataset(pointsDataset);
+							}
+							return;
+						}
+						if (!rawData->resize(rows, columns))
+						{
+							std::cout << "Error Reading File " << _fileName.toStdString() << ": not enough memory for " << rows << " x " << columns << " values" << std::endl;
+							mv::data().removeDataset(pointsDataset);
+							result = false;
+							return;
+						}
+						// the transform is applied while scattering, reading is part of it for blocks
+						phase.next(blockReader ? "read and scatter" : "scatter");
+						if (blockReader)
+							rawData->set_row_block_data(*blockReader, {}, transform_settings);
+						else
+							rawData->set_sparse_data(matrix, data, transform_settings);
+					});
+			}
+
+			if (result)
+			{
+				std::size_t rows = _sampleNames.size();
+
+				if (!backedMatrix) // the backed points name their shown columns
+					pointsDataset->setDimensionNames(_dimensionNames);
+				pointsDataset->setProperty("Sample Names", QList<QVariant>(_sampleNames.cbegin(), _sampleNames.cend()));
+				if (!cacheHit && !backedMatrix)
 				{
-					pointsDataset->setDataElementType<float>();
-					rawData->resize(rows, columns);
-					rawData->set_sparse_row_data(indices, indptr, data, transform_settings);
+					H5Utils::LoadReport::Phase phase(_report.get(), "matrix cache");
+					H5Utils::store_cached_matrix(cacheKey, pointsDataset);
 				}
-				pointsDataset->setDimensionNames(_dimensionNames);
-				pointsDataset->setProperty("Sample Names", QList<QVariant>(_sampleNames.cbegin(), _sampleNames.cend()));
 				
 			
-
+				H5Utils::LoadReport::Phase metadataPhase(_report.get(), "metadata");
 				if (group.exists("meta"))
 				{
 
@@ -491,100 +728,24 @@ shape	uint64	Tuple of (n_rows, n_columns)
 					task.setProgressDescription(QString("Loading %1 metadata items").arg(util::getIntegerCountHumanReadable(nrOfMetaData)));
 					task.setRunning();
 					
-					for (hsize_t m = 0; m < nrOfMetaData; ++m)
-					{
-						std::string metaDataLabel = metaDataSuperGroup.getObjnameByIdx(m).c_str();
-						auto metaDataGroup = metaDataSuperGroup.openGroup(metaDataLabel);
-						std::vector<QString> items;
-						std::vector<std::uint8_t> colors;
-						bool ok = H5Utils::read_vector_string(metaDataGroup, "l", items);
-						ok &= H5Utils::read_vector(metaDataGroup, "c", &colors);
-						ok &= ((3 * items.size()) == colors.size());
-
-						if (ok)
+					// the label groups are read one after the other, classified and grouped in parallel and added in order
+					H5Utils::process_columns<HDF5_10X::MetaDataColumn>(nrOfMetaData,
+						[&metaDataSuperGroup](std::size_t m, HDF5_10X::MetaDataColumn& column) { return HDF5_10X::ReadMetaDataColumn(metaDataSuperGroup, m, column); },
+						[](HDF5_10X::MetaDataColumn& column) { HDF5_10X::ClassifyMetaDataColumn(column); },
+						[&](std::size_t m, HDF5_10X::MetaDataColumn& column)
 						{
-
-							std::map<QString, std::vector<unsigned>> indices;
-							std::map<QString, QColor> qcolors;
-
-							typedef float numericMetaDataType;
-							double minValue = std::numeric_limits<numericMetaDataType>::max();
-							double maxValue = std::numeric_limits<numericMetaDataType>::lowest();
-							double sumValue = 0;
-							bool currentMetaDataIsNumerical = true; // we start assuming it's a numerical value
-
-							for (std::size_t l = 0; l < items.size(); ++l)
-							{
-								QString item = items[l];
-								if (currentMetaDataIsNumerical)
-								{
-									
-									if (H5Utils::is_number(item))
-									{
-										double value = item.toDouble();
-										if (std::isfinite(value))
-										{
-											if ((value >= std::numeric_limits<numericMetaDataType>::lowest()) && (value <= std::numeric_limits<numericMetaDataType>::max()))
-											{
-												sumValue += value;
-												if (value < minValue)
-													minValue = static_cast<numericMetaDataType>(value);
-												if (value > maxValue)
-													maxValue = static_cast<numericMetaDataType>(value);
-											}
-										}
-										numericalMetaData.push_back(value);
-									}
-									else
-									{
-										numericalMetaData.resize(nrOfNumericalMetaData * rows);
-										currentMetaDataIsNumerical = false;
-										minValue = 0;
-										maxValue = 0;
-										sumValue = 0;
-										// add former labels as caterogical as well.
-										for (std::size_t i = 0; i <= l; ++i)
-										{
-											QString value = items[i];
-											indices[value].push_back(i);
-											if (qcolors.find(value) == qcolors.end())
-											{
-												const auto colorOffset = i * 3;
-												const auto red = colors[colorOffset];
-												const auto green = colors[colorOffset + 1];
-												const auto blue = colors[colorOffset + 2];
-												qcolors[value] = QColor(red, green, blue);
-											}
-										}
-									}
-								}
-								else
-								{
-									indices[item].push_back(l);
-									if (qcolors.find(item) == qcolors.end())
-									{
-										const auto colorOffset = l * 3;
-										const auto red = colors[colorOffset];
-										const auto green = colors[colorOffset + 1];
-										const auto blue = colors[colorOffset + 2];
-										qcolors[item] = QColor(red, green, blue);
-									}
-								}
-							}
-							if (currentMetaDataIsNumerical)
+							if (column.numerical)
 							{
+								numericalMetaData.insert(numericalMetaData.end(), column.values.cbegin(), column.values.cend());
 								nrOfNumericalMetaData++;
-								numericalMetaDataDimensionNames.push_back(metaDataLabel.c_str());
+								numericalMetaDataDimensionNames.push_back(column.label.c_str());
 							}
 							else // it was categorical data
 							{
-								H5Utils::addClusterMetaData(indices, metaDataLabel.c_str(), pointsDataset, qcolors);
+								H5Utils::addClusterMetaData(column.indices, column.label.c_str(), pointsDataset, column.qcolors);
 							}
-
-						} // if(ok)
-						task.setProgress(static_cast<float>(m) / static_cast<float>(nrOfMetaData));
-
-					} // for nrOfMetaData
+							task.setProgress(static_cast<float>(m) / static_cast<float>(nrOfMetaData));
+						});
 					task.setFinished();
 					H5Utils::addNumericalMetaData(numericalMetaData, numericalMetaDataDimensionNames, true, pointsDataset);
 					
@@ -592,11 +753,18 @@ shape	uint64	Tuple of (n_rows, n_columns)
 				events().notifyDatasetDataChanged(pointsDataset);
 			}
 
+			_report->set("rows", static_cast<double>(_sampleNames.size()));
+			_report->set("columns", static_cast<double>(_dimensionNames.size()));
+			_report->setFileStatistics(*_file);
+			_report->finish(pointsDataset);
 		}
 	}
 	catch (const std::exception& e)
 	{
 		std::cout << "Error Reading File: " << e.what() << std::endl;
+		if (pointsDataset.isValid())
+			mv::data().removeDataset(pointsDataset);
+		result = false;
 	}
 	catch (const H5::FileIException& e)
 	{
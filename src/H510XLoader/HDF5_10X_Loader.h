@@ -1,12 +1,15 @@
 #pragma  once
 
 #include "H5Utils.h"
+#include "FileAccess.h"
+#include "LoadReport.h"
 #include "DataTransform.h"
 
 #include "Dataset.h"
 
 #include <QString>
 
+#include <cstdint>
 #include <memory>
 
  namespace mv
@@ -16,19 +19,37 @@
 
 class Points;
 
+// Minimum time in milliseconds between the updates of a progressive load.
+constexpr std::int64_t progressive_update_interval = 500;
+
 class HDF5_10X_Loader 
 {
 	mv::CoreInterface *_core;
-	std::unique_ptr<H5::H5File> _file;
+	std::shared_ptr<H5::H5File> _file; // shared with the backed matrix of a dataset that does not fit in memory
 	std::vector<QString> _dimensionNames;
 	std::vector<QString> _sampleNames;
 	QString _fileName;
+	std::uint64_t _memoryBudget = 0;
+	H5Utils::FileAccessProfile _fileAccessProfile = H5Utils::FileAccessProfile::Automatic;
+	bool _progressive = false;
+	std::unique_ptr<H5Utils::LoadReport> _report; // created by open(), finished on the dataset by load()
 
 public:
 	HDF5_10X_Loader(mv::CoreInterface *core);
 
 	bool open(const QString& fileName);
 	const std::vector<QString>& getDimensionNames() const;
-	bool load(TRANSFORM::Type conversionIndex, int speedIndex);
+	bool load(TRANSFORM::Type conversionIndex, int storageType);
+
+	// Memory budget in bytes, 0 uses the default of H5Utils::LoadPlanner.
+	void setMemoryBudget(std::uint64_t bytes);
+
+	// How open() accesses the file, see H5Utils::FileAccessProfile.
+	void setFileAccessProfile(H5Utils::FileAccessProfile profile);
+
+	// Shows the first rows of the matrix as soon as they are read and keeps the application responsive while the
+	// rest is added, updating the points at most every progressive_update_interval milliseconds. Not used for data16
+	// files, or when growing the matrix (LoadStrategy::Progressive) does not fit the memory budget.
+	void setProgressive(bool progressive);
 
 };
@@ -1,6 +1,8 @@
 #include "H5ADLoader.h"
 
 #include "HDF5_AD_Loader.h"
+#include "MatrixCache.h"
+#include "Trace.h"
 
 #include "PointData/PointData.h"
 
@@ -15,6 +17,8 @@
 #include <QStringList>
 #include <QMessageBox>
 
+#include <algorithm>
+
 Q_PLUGIN_METADATA(IID "nl.lumc.H5ADLoader")
 
 // =============================================================================
@@ -50,8 +54,14 @@ namespace
 	namespace Keys
 	{
 		const QString storageValueKey("storageValue");
+		const QString fileAccessKey("fileAccess");
 		const QString fileNameKey("fileName");
+		const QString loadReportDirectoryKey("loadReportDirectory"); // every load report is also written here as JSON, empty disables it
+		const QString matrixCacheLimitKey("matrixCacheLimitMB"); // size limit of the matrix cache, 0 disables it
+		const QString memoryBudgetKey("memoryBudgetMB"); // 0 uses 80% of the available memory
 		const QString selectedNameFilterKey("selectedNameFilter");
+		const QString shardedReadWorkersKey("shardedReadWorkers"); // worker processes for large reads, 0 reads in-process
+		const QString traceFileKey("traceFile"); // Chrome trace of the last load, only recorded in builds with MV_H5_ENABLE_TRACING
 	}
 
 }	// Unnamed namespace
@@ -112,6 +122,15 @@ void H5ADLoader::loadData()
 	fileDialogLayout->addWidget(storageTypeLabel, rowCount, 0);
 	fileDialogLayout->addWidget(storageTypeComboBox, rowCount, 1);
 
+	QComboBox* fileAccessComboBox = new QComboBox;
+	QLabel* fileAccessLabel = new QLabel("File Access");
+	for (auto profile : H5Utils::available_file_access_profiles())
+		fileAccessComboBox->addItem(H5Utils::file_access_profile_name(profile), static_cast<int>(profile));
+	fileAccessComboBox->setCurrentIndex(std::min(getSetting(Keys::fileAccessKey, 0).toInt(), fileAccessComboBox->count() - 1));
+
+	fileDialogLayout->addWidget(fileAccessLabel, rowCount + 1, 0);
+	fileDialogLayout->addWidget(fileAccessComboBox, rowCount + 1, 1);
+
 	const auto selectedNameFilterSetting = getSetting(Keys::selectedNameFilterKey, QVariant());
 	if (selectedNameFilterSetting.isValid())
 		_fileDialog.selectNameFilter(selectedNameFilterSetting.toString());
@@ -137,14 +156,24 @@ void H5ADLoader::loadData()
 		QString selectedNameFilter = _fileDialog.selectedNameFilter();
 		
 		setSetting(Keys::storageValueKey, storageTypeComboBox->currentIndex());
+		setSetting(Keys::fileAccessKey, fileAccessComboBox->currentIndex());
 		setSetting(Keys::fileNameKey, firstFileName);
 		setSetting(Keys::selectedNameFilterKey, selectedNameFilter);
 		
 		HDF5_AD_Loader loader(_core);
+		H5Utils::set_sharded_read_workers(getSetting(Keys::shardedReadWorkersKey, 0).toUInt());
+		H5Utils::set_matrix_cache_limit(getSetting(Keys::matrixCacheLimitKey, 0).toULongLong() * 1024 * 1024);
+		H5Utils::set_load_report_directory(getSetting(Keys::loadReportDirectoryKey, QString()).toString());
+		H5Utils::set_trace_file(getSetting(Keys::traceFileKey, QString()).toString().toStdString());
+		loader.setMemoryBudget(getSetting(Keys::memoryBudgetKey, 0).toULongLong() * 1024 * 1024);
+		loader.setFileAccessProfile(static_cast<H5Utils::FileAccessProfile>(fileAccessComboBox->currentData().toInt()));
 		for (const auto& fileName : fileNames)
 		{
 			if (loader.open(fileName))
+			{
 				loader.load(storageTypeComboBox->currentData().toInt());
+				H5Utils::export_trace();
+			}
 			else
 			{
 				QString mesg = "Could not open " + fileName + ". Make sure the file has the correct file extension and is not corrupted.";
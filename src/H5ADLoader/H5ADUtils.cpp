@@ -1,6 +1,12 @@
 #include "H5ADUtils.h"
 
+#include "BackedPoints.h"
+#include "RowBlockReader.h"
+#include "ColumnPipeline.h"
 #include "DataContainerInterface.h"
+#include "LoadPlanner.h"
+#include "MatrixCache.h"
+#include "MatrixDecoder.h"
 
 #include <QDialogButtonBox>
 #include <QMainWindow>
@@ -9,6 +15,7 @@
 
 #include <filesystem>
 #include <set>
+#include <utility>
 
 namespace H5AD
 {
@@ -63,28 +70,12 @@ namespace H5AD
 	{
 		static_assert(sizeof(T) <= 4);
 		H5Utils::MultiDimensionalData<T> mdd;
+		H5Utils::TrackedBuffer trackedData("X dense buffer");
+		H5Utils::LoadReport::Phase phase(loaderInfo._report, "read");
 		
-		if(!std::numeric_limits<T>::is_specialized)
-		{
-			// bfloat16
-			H5Utils::MultiDimensionalData<float> mdd_float;
-			
-			H5Utils::read_multi_dimensional_data(dataset, mdd_float);
-			{
-				if (mdd_float.size.size() == 2)
-				{
-					mdd.size = mdd_float.size;
-					mdd.data.resize(mdd_float.data.size());
-					#pragma omp parallel for
-					for (std::ptrdiff_t i = 0; i < mdd.data.size(); ++i)
-						mdd.data[i] = mdd_float.data[i];
-				}
-			}
-		}
-		else
-		{
-			H5Utils::read_multi_dimensional_data(dataset, mdd);
-		}
+		// bfloat16 is converted block by block while reading
+		H5Utils::read_multi_dimensional_values(dataset, mdd);
+		trackedData.setBytes(H5Utils::TrackedBuffer::container_bytes(mdd.data));
 
 		if (mdd.size.size() == 2)
 			
@@ -195,7 +186,7 @@ namespace H5AD
 		
 		if (mdd.size.size() == 2)
 		{
-			
+			phase.next("dataset creation");
 			loaderInfo._pointsDataset->setDataElementType<T>(); // not sure this is needed since we move data below but it shouldn't hurt either
 			loaderInfo._pointsDataset->setData(std::move(mdd.data), mdd.size[1]);
 			loaderInfo._pointsDataset->setDimensionNames(loaderInfo._originalDimensionNames);
@@ -254,273 +245,276 @@ namespace H5AD
 		}
 	}
 
+	// Asks which dimensions of the sparse X to load before any of it is read, so the selection can be part of the matrix cache key.
+	// Sets _enabledDimensions, and _selectedDimensionsLUT when not all dimensions are selected. Returns false if nothing is selected.
+	static bool PickDimensions(LoaderInfo& datasetInfo)
+	{
+		const auto& originalDimensionNames = datasetInfo._originalDimensionNames;
+		const std::size_t nrOfOriginalDimensions = originalDimensionNames.size();
+		std::size_t nrOfSelectedDimensions = 0;
+		std::vector<bool>& enabledDimensions = datasetInfo._enabledDimensions;
+		{
+			Dataset<Points> tempDataset = mv::data().createDataset("Points", "temp");
+			tempDataset->getDataHierarchyItem().setVisible(false);
+			tempDataset->setData(std::vector<int8_t>(originalDimensionNames.size()), originalDimensionNames.size());
+			tempDataset->setDimensionNames(originalDimensionNames);
+
+			QDialog dialog(Application::getMainWindow());
+			QGridLayout* layout = new QGridLayout;
+
+			DimensionsPickerAction &dimensionPickerAction = tempDataset->getDimensionsPickerAction();;
+			layout->addWidget(new QLabel("Select Dimensions:"));
+			layout->addWidget(dimensionPickerAction.createWidget(Application::getMainWindow()));
+			auto* buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok);
+			buttonBox->connect(buttonBox, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+			layout->addWidget(buttonBox, 3, 0, 1, 2);
+			dialog.setLayout(layout);
+			auto result = dialog.exec();
+			if (result == 0)
+			{
+				mv::data().removeDataset(tempDataset);
+				return false;
+			}
+			nrOfSelectedDimensions = dimensionPickerAction.getSelectedDimensions().size();
+			enabledDimensions = dimensionPickerAction.getEnabledDimensions();
+			mv::data().removeDataset(tempDataset);
+		}
+
+		if (nrOfSelectedDimensions == 0)
+			return false; // nothing is selected
+
+		if (nrOfSelectedDimensions < nrOfOriginalDimensions)
+		{
+			std::vector<std::ptrdiff_t>& dimensionIndices = datasetInfo._selectedDimensionsLUT;
+			dimensionIndices.assign(nrOfOriginalDimensions, -1);
+			std::ptrdiff_t newIndex = 0;
+			for (std::ptrdiff_t i = 0; i < nrOfOriginalDimensions; ++i)
+			{
+				if (enabledDimensions[i])
+				{
+					dimensionIndices[i] = newIndex;
+					++newIndex;
+				}
+			}
+		}
+		return true;
+	}
+
+	// The load options that change the loaded matrix, they are part of the matrix cache key.
+	static QString MatrixCacheOptions(const LoaderInfo& loaderInfo, int storageType)
+	{
+		QString options = QString("h5ad X storageType=%1 dimensions=").arg(storageType);
+		for (bool enabled : loaderInfo._enabledDimensions)
+			options += enabled ? '1' : '0';
+		return options;
+	}
+
+	// Scatters the sparse X in group, with data its values as read by read_vector_resolved, into the points.
 	template<typename T>
-	void LoadDataAs(H5::Group& group, LoaderInfo &datasetInfo, bool optimize_storage_size = false, bool allow_lossy_storage = false)
+	void LoadDataAs(H5::Group& group, LoaderInfo &datasetInfo, std::vector<T>&& data)
 	{
 		static_assert(sizeof(T) <= 4);
 		bool result = true;
 		
-		std::vector<T> data;
-		std::vector<std::uint64_t> indices;
-		std::vector<std::uint32_t> indptr;
-		std::vector<biovault::bfloat16_t> bf16data;
-		
-		if(!std::numeric_limits<T>::is_specialized)
-		{
-			// bfloat16
-			std::vector<float> float_data;
-			result &= H5Utils::read_vector(group, "data", &float_data);
-			data.resize(float_data.size());
-			#pragma omp parallel for
-			for (std::ptrdiff_t i = 0; i < data.size(); ++i)
-				data[i] = float_data[i];
-		}
-		else 
+		H5Utils::CompressedMatrix matrix;
+		H5Utils::TrackedBuffer trackedData("X data", data), trackedMatrix("X indices and indptr");
+		H5Utils::LoadReport::Phase phase(datasetInfo._report, "read");
+
+		const std::uint64_t nnz = data.size();
+		if (datasetInfo._report)
+			datasetInfo._report->set("nnz", static_cast<double>(nnz));
+		const std::uint64_t rows = group.exists("indptr") ? std::max<std::uint64_t>(H5Utils::get_vector_size(group.openDataSet("indptr")), 1) - 1 : 0;
+		if (!H5Utils::read_compressed_matrix(group, rows, datasetInfo._originalDimensionNames.size(), false, matrix))
 		{
-			H5Utils::read_vector(group, "data", &data);
+			qDebug() << "H5AD loader: indptr and indices of" << group.getObjName().c_str() << "do not match the number of nonzeros";
+			result = false;
 		}
-		
-		int sizeOfT = sizeof(T);
-		if(result && optimize_storage_size && (sizeOfT > 1))
+		trackedMatrix.setBytes(matrix.bytes());
+
+
+		phase.next("scatter");
+		Dataset<Points> pointsDataset = datasetInfo._pointsDataset;
+		auto selectedDimensionNames = datasetInfo._originalDimensionNames;
+		const std::vector<std::ptrdiff_t>& dimensionIndices = datasetInfo._selectedDimensionsLUT;
+		if (!dimensionIndices.empty())
 		{
-			auto minmax_pair = std::minmax_element(data.cbegin(), data.cend());
-			T minVal = *(minmax_pair.first);
-			T maxVal = *(minmax_pair.second);
-			if( *(minmax_pair.first) < 0)
+			selectedDimensionNames.clear();
+			for (std::size_t i = 0; i < dimensionIndices.size(); ++i)
 			{
-				//signed
-				if(H5Utils::in_range<std::int8_t>(minVal,maxVal))
-				{
-					if(H5Utils::is_integer(minVal) && H5Utils::is_integer(maxVal) && H5Utils::contains_only_integers(data))
-					{
-						data.clear();
-						return LoadDataAs<std::int8_t>(group, datasetInfo);
-						
-					}
-					
-					
-				}
-				else if(sizeOfT > 2)
+				if (dimensionIndices[i] >= 0)
+					selectedDimensionNames.push_back(datasetInfo._originalDimensionNames[i]);
+			}
+
+			// update indices so data can be ignored later on, the index type was selected such that its maximum is never a valid column
+			matrix.indices.visit([&dimensionIndices](auto& vec)
 				{
-					if (H5Utils::in_range<std::int16_t>(minVal,maxVal))
+					typedef typename std::decay_t<decltype(vec)>::value_type IndexType;
+					#pragma omp parallel for
+					for (std::ptrdiff_t i = 0; i < vec.size(); ++i)
 					{
-						if (H5Utils::is_integer(minVal) && H5Utils::is_integer(maxVal) && H5Utils::contains_only_integers(data))
+						auto oldColumnIndex = vec[i];
+						auto newColumnIndex = dimensionIndices[oldColumnIndex];
+						if(newColumnIndex < 0)
 						{
-							data.clear();
-							return LoadDataAs<std::int16_t>(group, datasetInfo);
+							vec[i] = std::numeric_limits<IndexType>::max();
 						}
-							
-					}
-
-					
-				}
-			}
-			else
-			{
-				//unsigned
-				if (H5Utils::in_range<std::uint8_t>(minVal,maxVal))
-				{
-					if (H5Utils::is_integer(minVal) && H5Utils::is_integer(maxVal) && H5Utils::contains_only_integers(data))
-					{
-						data.clear();
-						return LoadDataAs<std::uint8_t>(group, datasetInfo);
-					}
-					
-				}
-				else if (sizeOfT > 2)
-				{
-					if (H5Utils::in_range<std::uint16_t>(minVal,maxVal))
-					{
-						if (H5Utils::is_integer(minVal) && H5Utils::is_integer(maxVal) && H5Utils::contains_only_integers(data))
+						else
 						{
-							data.clear();
-							return LoadDataAs<std::uint16_t>(group, datasetInfo);
+							vec[i] = static_cast<IndexType>(newColumnIndex);
 						}
 						
 					}
-				}
-			}
-			if (allow_lossy_storage)
-			{
-				bf16data.resize(data.size());
-				#pragma omp parallel for
-				for (std::ptrdiff_t i = 0; i < data.size(); ++i)
-					bf16data[i] = data[i];
-				data.clear();
-			}
+				});
 		}
 
 		if (result)
-			result &= H5Utils::read_vector(group, "indices", &indices);
-		if (result)
-			result &= H5Utils::read_vector(group, "indptr", &indptr);
-
-
-		Dataset<Points> pointsDataset = datasetInfo._pointsDataset;
-		auto selectedDimensionNames = datasetInfo._originalDimensionNames;
-		std::vector<std::ptrdiff_t>& dimensionIndices = datasetInfo._selectedDimensionsLUT;
-		std::vector<bool>& enabledDimensions = datasetInfo._enabledDimensions;
 		{
-			
-			auto originalDimensionNames = datasetInfo._originalDimensionNames;
-			const std::size_t nrOfOriginalDimensions = originalDimensionNames.size();
-			std::size_t nrOfSelectedDimensions = 0;
-			
+			pointsDataset->setDataElementType<T>();
+			DataContainerInterface dci(pointsDataset);
+			std::uint64_t xsize = matrix.rows;
+			std::uint64_t ysize = selectedDimensionNames.size();
+			if (!dci.resize(xsize, ysize))
 			{
-				Dataset<Points> tempDataset = mv::data().createDataset("Points", "temp");
-				tempDataset->getDataHierarchyItem().setVisible(false);
-				tempDataset->setData(std::vector<int8_t>(originalDimensionNames.size()), originalDimensionNames.size());
-				tempDataset->setDimensionNames(originalDimensionNames);
-
-				QDialog dialog(Application::getMainWindow());
-				QGridLayout* layout = new QGridLayout;
-
-				DimensionsPickerAction &dimensionPickerAction = tempDataset->getDimensionsPickerAction();;
-				layout->addWidget(new QLabel("Select Dimensions:"));
-				layout->addWidget(dimensionPickerAction.createWidget(Application::getMainWindow()));
-				auto* buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok);
-				buttonBox->connect(buttonBox, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
-				layout->addWidget(buttonBox, 3, 0, 1, 2);
-				dialog.setLayout(layout);
-				auto result = dialog.exec();
-				if (result == 0)
-				{
-					datasetInfo = {};
-					mv::data().removeDataset(tempDataset);
-					mv::data().removeDataset(pointsDataset);
-					return;
-				}
-				nrOfSelectedDimensions = dimensionPickerAction.getSelectedDimensions().size();
-				enabledDimensions = dimensionPickerAction.getEnabledDimensions();
-				mv::data().removeDataset(tempDataset);
+				qDebug() << "H5AD loader: not enough memory for" << xsize << "x" << ysize << "values";
+				return;
 			}
-			
-
-			if (nrOfSelectedDimensions == 0)
+			matrix.columns = ysize; // the indices of the columns that are not selected are past the last one
+			// all HDF5 reads of X are done, the metadata is read on its lane while the cores scatter
+			MetaDataLane* lane = datasetInfo._metadataLane;
+			if (lane)
+				lane->start(xsize);
+			try
 			{
-				// nothing is selected
-				datasetInfo = {};
-				mv::data().removeDataset(pointsDataset);
-				return;;
-			} 
-			
-			
-			if(nrOfSelectedDimensions < nrOfOriginalDimensions)
+				dci.set_sparse_data(matrix, data, TRANSFORM::None());
+			}
+			catch (...)
 			{
-				dimensionIndices.assign(nrOfOriginalDimensions, -1);
-				std::vector<std::uint64_t> newDimensionIndex(nrOfOriginalDimensions,  std::numeric_limits<std::uint64_t>::max());
-				selectedDimensionNames.resize(nrOfSelectedDimensions);
-				std::ptrdiff_t newIndex = 0;
-				for (std::ptrdiff_t i = 0; i < nrOfOriginalDimensions; ++i)
-				{
-					if (enabledDimensions[i])
-					{
-						selectedDimensionNames[newIndex] = originalDimensionNames[i];
-						newDimensionIndex[i] = newIndex;
-						dimensionIndices[i] = newIndex;
-						++newIndex;
-					}
-				}
+				if (lane)
+					lane->wait();
+				throw;
+			}
+			if (lane)
+				lane->wait();
+			pointsDataset->setDimensionNames(selectedDimensionNames);
+		}
 
-				// update data & indices so data can be ignored later on
-				assert(data.size() == indices.size());
-				#pragma omp parallel for
-				for (std::ptrdiff_t i = 0; i < indices.size(); ++i)
-				{
-					auto oldColumnIndex = indices[i];
-					auto newColumnIndex = dimensionIndices[oldColumnIndex];
-					if(newColumnIndex < 0)
-					{
-						indices[i] = std::numeric_limits<std::uint64_t>::max();
-						data[i] = 0;
-					}
-					else
-					{
-						indices[i] = static_cast<std::uint64_t>(newColumnIndex);
-					}
-					
-				}
-			} 	
+		
+	}
+
+	enum class StreamedLoad { NotUsed, Loaded, Failed };
+
+	// Columns shown by backed points: the selected dimensions, or the first backed_shown_columns when all are selected.
+	static std::vector<std::uint64_t> BackedShownColumns(const LoaderInfo& loaderInfo)
+	{
+		std::vector<std::uint64_t> columns;
+		const std::size_t nrOfColumns = loaderInfo._originalDimensionNames.size();
+		for (std::size_t i = 0; i < nrOfColumns; ++i)
+		{
+			if (loaderInfo._selectedDimensionsLUT.empty() ? (i < H5Utils::backed_shown_columns) : (loaderInfo._selectedDimensionsLUT[i] >= 0))
+				columns.push_back(i);
 		}
+		return columns;
+	}
 
+	// Leaves X in the file and publishes it as backed points that only hold the shown columns, for an X whose dense
+	// result does not fit the memory budget (LoadStrategy::Backed). The matrix keeps the file open.
+	static StreamedLoad LoadBacked(std::shared_ptr<H5Utils::BackedMatrix> matrix, LoaderInfo& loaderInfo)
+	{
+		if (!matrix->valid() || (matrix->columns() != loaderInfo._originalDimensionNames.size()))
+			return StreamedLoad::NotUsed;
+		qDebug() << "H5AD loader: X does not fit in the memory budget, it stays in the file and only the shown dimensions are read";
+		if (loaderInfo._report)
+			loaderInfo._report->set("strategy", H5Utils::strategy_name(H5Utils::LoadStrategy::Backed));
+		H5Utils::LoadReport::Phase phase(loaderInfo._report, "read shown columns");
+		if (!H5Utils::BackedPoints::attach(loaderInfo._pointsDataset, matrix, loaderInfo._originalDimensionNames, BackedShownColumns(loaderInfo), TRANSFORM::None(), loaderInfo._memoryBudget))
+		{
+			qDebug() << "H5AD loader: the shown dimensions of X could not be read";
+			return StreamedLoad::Failed;
+		}
+		loaderInfo._backedMatrix = matrix;
+		return StreamedLoad::Loaded;
+	}
 
+	// Loads a sparse X that only fits the memory budget when the sparse data is not read as a whole, block by block
+	// from a RowBlockReader, or that does not fit at all and is left in the file (LoadBacked). Returns NotUsed, without
+	// loading anything, when the regular load fits or neither helps, and Failed when the points could not be filled.
+	static StreamedLoad LoadStreamed(const std::shared_ptr<H5::H5File>& file, H5::Group& group, LoaderInfo& loaderInfo, int storageType)
+	{
+		H5Utils::MatrixLayout layout;
+		if (!H5Utils::read_sparse_layout(group, loaderInfo._originalDimensionNames.size(), layout))
+			return StreamedLoad::NotUsed;
 
+		std::vector<QString> selectedDimensionNames;
+		for (std::size_t i = 0; i < loaderInfo._originalDimensionNames.size(); ++i)
+		{
+			if (loaderInfo._selectedDimensionsLUT.empty() || (loaderInfo._selectedDimensionsLUT[i] >= 0))
+				selectedDimensionNames.push_back(loaderInfo._originalDimensionNames[i]);
+		}
 
-		if (result)
+		// the optimized types are chosen while data is read, so the plan uses the largest type the selection can give
+		const int typeBound = H5Utils::storage_type_bound(storageType, group.openDataSet("data"), false);
+		const H5Utils::LoadPlanner planner(layout, loaderInfo._memoryBudget);
+		if (planner.estimate(H5Utils::LoadStrategy::DenseSubset, typeBound, selectedDimensionNames.size()).fitsBudget)
+			return StreamedLoad::NotUsed;
+		if (!planner.estimate(H5Utils::LoadStrategy::Streaming, typeBound, selectedDimensionNames.size()).fitsBudget)
 		{
-			if(data.empty() && bf16data.size())
-				pointsDataset->setDataElementType<biovault::bfloat16_t>();
-			else
-				pointsDataset->setDataElementType<T>();
-			DataContainerInterface dci(pointsDataset);
-			std::uint64_t xsize = indptr.size() > 0 ? indptr.size() - 1 : 0;
-			std::uint64_t ysize = selectedDimensionNames.size();
-			dci.resize(xsize, ysize);
-			if (data.empty() && bf16data.size())
-				dci.set_sparse_row_data(indices, indptr, bf16data, TRANSFORM::None());
-			else
-				dci.set_sparse_row_data(indices, indptr, data, TRANSFORM::None());
-			pointsDataset->setDimensionNames(selectedDimensionNames);
+			if (!planner.estimate(H5Utils::LoadStrategy::Backed, typeBound, BackedShownColumns(loaderInfo).size()).fitsBudget)
+				return StreamedLoad::NotUsed;
+			if (loaderInfo._report)
+				loaderInfo._report->set("nnz", static_cast<double>(layout.nnz));
+			return LoadBacked(std::make_shared<H5Utils::BackedMatrix>(file, group, loaderInfo._originalDimensionNames.size()), loaderInfo);
 		}
 
-		
+		const H5Utils::RowBlockReader blockReader(group, loaderInfo._originalDimensionNames.size());
+		if (!blockReader.valid())
+			return StreamedLoad::NotUsed;
+		qDebug() << "H5AD loader: X does not fit in the memory budget, reading it in blocks of" << blockReader.blockRows() << "rows";
+		if (loaderInfo._report)
+		{
+			loaderInfo._report->set("nnz", static_cast<double>(layout.nnz));
+			loaderInfo._report->set("strategy", H5Utils::strategy_name(H5Utils::LoadStrategy::Streaming));
+		}
+		H5Utils::LoadReport::Phase phase(loaderInfo._report, "structure scan");
+		// blocks are scattered into points of the final type, which needs the value range before the first block
+		const int elementType = H5Utils::resolve_storage_type(storageType, group.openDataSet("data"), false);
+		phase.next("read and scatter");
+
+		Dataset<Points> pointsDataset = loaderInfo._pointsDataset;
+		H5Utils::visit_storage_type(elementType, [&pointsDataset](auto type) {
+			pointsDataset->setDataElementType<typename decltype(type)::type>();
+			});
+		DataContainerInterface dci(pointsDataset);
+		if (!dci.resize(blockReader.rows(), selectedDimensionNames.size()))
+		{
+			qDebug() << "H5AD loader: not enough memory for" << blockReader.rows() << "x" << selectedDimensionNames.size() << "values";
+			return StreamedLoad::Failed;
+		}
+		dci.set_row_block_data(blockReader, loaderInfo._selectedDimensionsLUT, TRANSFORM::None());
+		pointsDataset->setDimensionNames(selectedDimensionNames);
+		return StreamedLoad::Loaded;
 	}
 
 	void LoadData(H5::Group& group, LoaderInfo &datasetInfo, int storageType)
 	{
-		
-		if (storageType < 0) // use native or optimized storage type		
+		// data is read once, in the type the storage type selection resolves to
+		H5Utils::VectorHolder values;
+		int elementType = -1;
 		{
-
-			H5::DataSet dataset = group.openDataSet("data");
-			H5::DataType datatype = dataset.getDataType();
-			H5T_class_t class_type = datatype.getClass();
-			dataset.close();
-
-			if (class_type == H5T_FLOAT)
-			{
-				LoadDataAs<float>(group, datasetInfo, storageType <= -2, storageType == -2);
-			}
-			else if ((class_type == H5T_INTEGER) || (class_type == H5T_ENUM))
-			{
-				if (H5Tget_sign(class_type))
-				{
-					// signed
-					switch (datatype.getSize())
-					{
-					case 1: return LoadDataAs<std::int8_t>(group, datasetInfo, storageType <= -2, storageType == -2);
-					case 2:return LoadDataAs<std::int16_t>(group, datasetInfo,  storageType <= -2, storageType <= -2);
-				//	case 4: return LoadDataAs<std::int32_t>(group, datasetInfo, storageType <= -2, storageType <= -2);
-					default: return LoadDataAs<float>(group, datasetInfo, storageType <= -2, storageType <= -2);
-					}
-				}
-				else
-				{
-					// unsigned
-					switch (datatype.getSize())
-					{
-					case 1: return LoadDataAs<std::uint8_t>(group, datasetInfo, storageType <= -2, storageType == -2);
-					case 2: return LoadDataAs<std::uint16_t>(group, datasetInfo, storageType <= -2, storageType == -2);
-				//	case 4: return LoadDataAs<std::uint32_t>(group, datasetInfo, storageType <= -2, storageType == -2);
-					default: return LoadDataAs<float>(group, datasetInfo, storageType <= -2, storageType == -2);
-					}
-				}
-			}
+			H5Utils::LoadReport::Phase phase(datasetInfo._report, "read");
+			elementType = H5Utils::read_vector_resolved(group, "data", storageType, false, values);
 		}
-		else
+		if (elementType < 0)
 		{
-			PointData::ElementTypeSpecifier newTargetType = (PointData::ElementTypeSpecifier)storageType;
-			switch (newTargetType)
-			{
-			case PointData::ElementTypeSpecifier::float32: return LoadDataAs<float>(group, datasetInfo);
-			case PointData::ElementTypeSpecifier::bfloat16: return LoadDataAs<biovault::bfloat16_t>(group, datasetInfo);
-			case PointData::ElementTypeSpecifier::int16: return LoadDataAs<std::int16_t>(group, datasetInfo);
-			case PointData::ElementTypeSpecifier::uint16: return LoadDataAs<std::uint16_t>(group, datasetInfo);
-			case PointData::ElementTypeSpecifier::int8: return LoadDataAs<std::int8_t>(group, datasetInfo);
-			case PointData::ElementTypeSpecifier::uint8: return LoadDataAs<std::uint8_t>(group, datasetInfo);
-			}
+			qDebug() << "H5AD loader: could not read the data of" << group.getObjName().c_str();
+			return;
 		}
-		
+		if (datasetInfo._report)
+			datasetInfo._report->set("storageType", H5Utils::element_type_name(elementType));
+		H5Utils::visit_storage_type(elementType, [&](auto elementTypeIdentity)
+			{
+				typedef typename decltype(elementTypeIdentity)::type T;
+				LoadDataAs<T>(group, datasetInfo, std::move(values.getVector<T>()));
+			});
 	}
 
 	std::string LoadIndexStrings(H5::DataSet& dataset, std::vector<QString>& result)
@@ -601,36 +595,43 @@ namespace H5AD
 		return hasData && hasIndices && hasIndicesPtr;
 	}
 
-	bool LoadSparseMatrix(H5::Group& group, LoaderInfo &loaderInfo)
+	// Size of the dimension the indices of a csr_matrix group address, from the shape attribute anndata writes. 0 when absent.
+	std::uint64_t SparseIndexBound(H5::Group& group)
 	{
-		bool loadSuccess = false;
-
-		auto nrOfObjects = group.getNumObjs();
-		auto h5groupName = group.getObjName();
+		if (!group.attrExists("shape"))
+			return 0;
+		H5::Attribute attribute = group.openAttribute("shape");
+		if ((attribute.getTypeClass() != H5T_INTEGER) || (attribute.getSpace().getSimpleExtentNpoints() != 2))
+			return 0;
+		std::int64_t shape[2] = { 0, 0 };
+		attribute.read(H5::PredType::NATIVE_INT64, shape);
+		return (shape[1] > 0) ? static_cast<std::uint64_t>(shape[1]) : 0;
+	}
 
-		if (nrOfObjects <= 2)
-			return loadSuccess;
+	// Reads the sparse matrix of an obsm like group with a row per point, false if the group does not hold one.
+	static bool ReadSparseMatrix(H5::Group& group, std::size_t nrOfRows, H5Utils::VectorHolder& data, H5Utils::CompressedMatrix& matrix, H5Utils::MatrixLayout& layout)
+	{
+		if (group.getNumObjs() <= 2)
+			return false;
 
 		if (!ContainsSparseMatrix(group))
-			return loadSuccess;
-
-		H5Utils::VectorHolder data;
-		H5Utils::VectorHolder indices;
-		H5Utils::VectorHolder indptr;
-
-		bool readDataSuccess = H5Utils::read_vector(group, "data", data);
-		bool readIndicesSuccess = H5Utils::read_vector(group, "indices", indices);
-		bool readIndicesPtrSuccess = H5Utils::read_vector(group, "indptr", indptr);
-
-		if(!(readDataSuccess && readIndicesSuccess && readIndicesPtrSuccess))
-			return loadSuccess;
-
-		std::uint64_t xsize = indptr.size() > 0 ? indptr.size() - 1 : 0;
+			return false;
 
-		if(xsize != loaderInfo._pointsDataset->getNumPoints())
-			return loadSuccess;
+		// without a shape the columns follow from the largest index
+		if (!H5Utils::read_vector(group, "data", data) || !H5Utils::read_compressed_matrix(group, nrOfRows, SparseIndexBound(group), false, matrix))
+		{
+			qDebug() << "H5AD loader: indptr and indices of" << group.getObjName().c_str() << "do not match the points and the number of nonzeros";
+			return false;
+		}
+		H5Utils::read_sparse_layout(group, matrix.columns, layout);
+		return true;
+	}
 
-		std::uint64_t ysize = indices.visit<std::uint64_t>([](auto& vec) { return *std::max_element(vec.cbegin(), vec.cend()); }) + 1;
+	// Adds the matrix read by ReadSparseMatrix from the group h5groupName as points derived from the points.
+	static bool AddSparseMatrix(const std::string& h5groupName, H5Utils::VectorHolder& data, const H5Utils::CompressedMatrix& matrix, const H5Utils::MatrixLayout& layout, LoaderInfo& loaderInfo)
+	{
+		const std::uint64_t xsize = matrix.rows;
+		const std::uint64_t ysize = matrix.columns;
 
 		// Data name
 		QString numericalDatasetName = QString(h5groupName.c_str()) /* + " (numerical)" */;
@@ -643,36 +644,28 @@ namespace H5AD
 		Dataset<Points> numericalDataset = mv::data().createDerivedDataset(numericalDatasetName, loaderInfo._pointsDataset); // core->addDataset("Points", numericalDatasetName, parent);
 		numericalDataset->setProperty("Sample Names", loaderInfo._sampleNames);
 
-		data.visit([&numericalDataset](auto& vec) {
-			typedef typename std::decay_t<decltype(vec)> v;
-			numericalDataset->setDataElementType<typename v::value_type>();
+		int elementType = 0;
+		data.visit([&elementType](auto& vec) {
+			typedef typename std::decay_t<decltype(vec)>::value_type T;
+			// PointData has no 32/64 bit integer or double element types, these are stored as float
+			elementType = H5Utils::storage_type_of<T>();
+			});
+		H5Utils::visit_storage_type(elementType, [&numericalDataset](auto type) {
+			numericalDataset->setDataElementType<typename decltype(type)::type>();
 			});
 
-		auto exceedsXGigabytes = [](size_t length, size_t gigabytes = 4) -> bool{
-			constexpr size_t BYTES_PER_GB = 1024ll * 1024 * 1024;
-			const size_t maxBytes = gigabytes * BYTES_PER_GB;
-
-			// Get size of the type
-			const size_t elementSize = sizeof(float);
-
-			// Check for multiplication overflow
-			if (length > std::numeric_limits<size_t>::max() / elementSize) {
-				return true;
-			}
-
-			// Calculate total size and compare
-			const size_t totalBytes = length * elementSize;
-			return totalBytes > maxBytes;
-		};
+		const H5Utils::LoadPlanner planner(layout, loaderInfo._memoryBudget);
+		const H5Utils::LoadEstimate loadEstimate = planner.choose(elementType, true);
+		qDebug() << "H5AD loader:" << QString::fromStdString(planner.report(elementType));
 
-		if (exceedsXGigabytes(xsize * ysize, 4))
+		if (loadEstimate.strategy == H5Utils::LoadStrategy::Sparse)
 		{
 			qDebug() << "H5AD loader: Store sparse data as sparse";
 
 			// Store sparse data as sparse
 			std::vector<float> data_float = data.getVectorAs<float>();
-			std::vector<size_t> column_index = indices.getVectorAs<size_t>();
-			std::vector<size_t> row_offset = indptr.getVectorAs<size_t>();
+			std::vector<size_t> column_index = matrix.indices.getVectorAs<size_t>();
+			std::vector<size_t> row_offset = matrix.indptr.getVectorAs<size_t>();
 
 			auto numericalDataset_p = static_cast<Points*>(numericalDataset.getDataset());
 
@@ -687,8 +680,13 @@ namespace H5AD
 
 			// Store sparse data as dense
 			DataContainerInterface dci(numericalDataset);
-			dci.resize(xsize, ysize);
-			dci.set_sparse_row_data(indices, indptr, data, TRANSFORM::None());
+			if (!dci.resize(xsize, ysize))
+			{
+				qDebug() << "H5AD loader: not enough memory to store" << numericalDatasetName << "as dense";
+				mv::data().removeDataset(numericalDataset);
+				return false;
+			}
+			dci.set_sparse_data(matrix, data, TRANSFORM::None());
 		}
 
 		events().notifyDatasetDataChanged(numericalDataset);
@@ -702,7 +700,17 @@ namespace H5AD
 
 		events().notifyDatasetDataChanged(numericalDataset);
 		
-		return loadSuccess;
+		return true;
+	}
+
+	bool LoadSparseMatrix(H5::Group& group, LoaderInfo &loaderInfo)
+	{
+		H5Utils::VectorHolder data;
+		H5Utils::CompressedMatrix matrix;
+		H5Utils::MatrixLayout layout;
+		if (!ReadSparseMatrix(group, loaderInfo._pointsDataset->getNumPoints(), data, matrix, layout))
+			return false;
+		return AddSparseMatrix(group.getObjName(), data, matrix, layout, loaderInfo);
 	}
 
 	bool LoadCategories(H5::Group& group, std::map<std::string, std::vector<QString>>& categories)
@@ -765,54 +773,64 @@ namespace H5AD
 		return nullptr;
 	}
 
-	bool LoadCodedCategories(H5::Group& group, std::map<QString, std::vector<unsigned>>& result)
+	// Reads the categories and integer codes of a categorical group of anndata >= 0.8, false if it is not one.
+	bool ReadCodedCategories(H5::Group& group, std::vector<QString>& catValues, std::vector<std::int64_t>& codes)
 	{
 		auto nrOfObjects = group.getNumObjs();
 		if ((nrOfObjects == 2) && (group.getObjnameByIdx(0) == "categories") && (group.getObjnameByIdx(1) == "codes"))
 		{
-			H5G_obj_t objectTypeCategories = group.getObjTypeByIdx(0);
-			H5G_obj_t objectTypeCodes = group.getObjTypeByIdx(1);
 			H5::DataSet catDataset = group.openDataSet("categories");
-			std::vector<QString> catValues;
 			H5Utils::read_vector_string(catDataset, catValues);
 
 			H5::DataSet codesDataset = group.openDataSet("codes");
-			auto datasetClass = codesDataset.getDataType().getClass();
+			if (codesDataset.getDataType().getClass() == H5T_INTEGER)
+				return H5Utils::read_vector(group, "codes", &codes);
+		}
+		return false;
+	}
 
-			std::vector<QString> categories;
-			if (datasetClass == H5T_INTEGER)
+	// Groups the rows by category, false if a code is out of range. Thread safe.
+	bool GroupCodedCategories(const std::vector<QString>& catValues, const std::vector<std::int64_t>& codes, std::map<QString, std::vector<unsigned>>& result)
+	{
+		for (unsigned i = 0; i < codes.size(); ++i)
+		{
+			std::int64_t value = codes[i];
+			if (value < catValues.size())
+				result[catValues[value]].push_back(i);
+			else
 			{
-				std::vector<std::int64_t> values;
-
-				if (H5Utils::read_vector(group, "codes", &values))
-				{
-
-					for (unsigned i = 0; i < values.size(); ++i)
-					{
-						std::int64_t value = values[i];
-						if (value < catValues.size())
-							result[catValues[value]].push_back(i);
-						else
-						{
-							result.clear();
-							return  false;
-						}
-					}
-					return  true;
-				}
+				result.clear();
+				return  false;
 			}
 		}
+		return  true;
+	}
+
+	bool LoadCodedCategories(H5::Group& group, std::map<QString, std::vector<unsigned>>& result)
+	{
+		std::vector<QString> catValues;
+		std::vector<std::int64_t> codes;
+		if (ReadCodedCategories(group, catValues, codes))
+			return GroupCodedCategories(catValues, codes, result);
 		result.clear();
 		return false;
 	}
 
 
 
-	bool load_X(std::unique_ptr<H5::H5File>& h5fILE, LoaderInfo &loaderInfo, int storageType)
+	bool load_X(std::shared_ptr<H5::H5File>& h5fILE, LoaderInfo &loaderInfo, int storageType)
 	{
+		MV_H5_TRACE_SCOPE("load_X");
+		QString fileName;
+		QString cacheKey;
+		bool cacheHit = false;
 		try
 		{
 			auto nrOfObjects = h5fILE->getNumObjs();
+			fileName = QString::fromStdString(h5fILE->getFileName());
+			// replaced by the type the optimized selections resolve to when the sparse data is read
+			if (loaderInfo._report)
+				loaderInfo._report->set("storageType", (storageType >= 0) ? QString(H5Utils::element_type_name(storageType)) : QString((storageType < -1) ? "optimized" : "native"));
 
 			std::size_t rows = 0;
 			std::size_t columns = 0;
@@ -826,7 +844,30 @@ namespace H5AD
 					if (objectName1 == "X")
 					{
 						H5::DataSet dataset = h5fILE->openDataSet(objectName1);
-						H5AD::LoadData(dataset, loaderInfo, storageType);
+						if (loaderInfo._dimensionsPicked)
+							loaderInfo._dimensionsPicked(); // a dense X has no dimension selection
+						{
+							H5Utils::LoadReport::Phase phase(loaderInfo._report, "matrix cache");
+							cacheKey = H5Utils::matrix_cache_key(fileName, MatrixCacheOptions(loaderInfo, storageType));
+							cacheHit = H5Utils::load_cached_matrix(cacheKey, loaderInfo._pointsDataset);
+						}
+						if (!cacheHit)
+						{
+							// a dense X whose result does not fit the memory budget is left in the file
+							H5Utils::MatrixLayout layout;
+							StreamedLoad backed = StreamedLoad::NotUsed;
+							if (H5Utils::read_dense_layout(dataset, layout))
+							{
+								const int elementType = (storageType >= 0) ? storageType : H5Utils::native_storage_type(dataset);
+								const H5Utils::LoadPlanner planner(layout, loaderInfo._memoryBudget);
+								if (!planner.estimate(H5Utils::LoadStrategy::Dense, elementType).fitsBudget && planner.estimate(H5Utils::LoadStrategy::Backed, elementType).fitsBudget)
+									backed = LoadBacked(std::make_shared<H5Utils::BackedMatrix>(h5fILE, dataset), loaderInfo);
+							}
+							if (backed == StreamedLoad::Failed)
+								return false; // the caller removes the points dataset
+							if (backed == StreamedLoad::NotUsed)
+								H5AD::LoadData(dataset, loaderInfo, storageType);
+						}
 						break;
 
 					}
@@ -836,7 +877,27 @@ namespace H5AD
 					if (objectName1 == "X")
 					{
 						H5::Group group = h5fILE->openGroup(objectName1);
-						H5AD::LoadData(group, loaderInfo, storageType);
+						{
+							H5Utils::LoadReport::Phase phase(loaderInfo._report, "dimension selection");
+							if (!PickDimensions(loaderInfo))
+								return false;
+						}
+						if (loaderInfo._dimensionsPicked)
+							loaderInfo._dimensionsPicked();
+						{
+							H5Utils::LoadReport::Phase phase(loaderInfo._report, "matrix cache");
+							cacheKey = H5Utils::matrix_cache_key(fileName, MatrixCacheOptions(loaderInfo, storageType));
+							cacheHit = H5Utils::load_cached_matrix(cacheKey, loaderInfo._pointsDataset);
+						}
+						const StreamedLoad streamed = cacheHit ? StreamedLoad::NotUsed : LoadStreamed(h5fILE, group, loaderInfo, storageType);
+						if (streamed == StreamedLoad::Failed)
+							return false; // the caller removes the points dataset
+						if (!cacheHit && (streamed == StreamedLoad::NotUsed))
+						{
+							if (loaderInfo._report)
+								loaderInfo._report->set("strategy", H5Utils::strategy_name(H5Utils::LoadStrategy::Sparse));
+							H5AD::LoadData(group, loaderInfo, storageType);
+						}
 						break;
 					}
 				}
@@ -862,539 +923,666 @@ namespace H5AD
 		{
 			loaderInfo._pointsDataset->setDimensionNames(loaderInfo._originalDimensionNames);
 		}
+		if (!cacheHit && !loaderInfo._backedMatrix)
+		{
+			H5Utils::LoadReport::Phase phase(loaderInfo._report, "matrix cache");
+			H5Utils::store_cached_matrix(cacheKey, loaderInfo._pointsDataset);
+		}
+		if (loaderInfo._report)
+		{
+			loaderInfo._report->set("cacheHit", cacheHit);
+			loaderInfo._report->set("rows", static_cast<double>(loaderInfo._pointsDataset->getNumPoints()));
+			loaderInfo._report->set("columns", static_cast<double>(loaderInfo._pointsDataset->getNumDimensions()));
+		}
 		return true;
 	}
 
 
-	template<typename numericMetaDataType>
-	void LoadSampleNamesAndMetaData(H5::DataSet& dataset, LoaderInfo &loaderInfo)
+	// Sets the colors of the clusters of the group (or of <group>_label) from the color names in codedCategories, or adds them as clusters when they are not colors.
+	void AddCodedCategories(std::map<QString, std::vector<unsigned>>& codedCategories, const std::string& h5GroupName, LoaderInfo& loaderInfo)
 	{
-		static_assert(std::is_same<numericMetaDataType, float>::value, "");
-		std::string h5datasetName = dataset.getObjName();
-		if (h5datasetName[0] == '/')
-			h5datasetName.erase(h5datasetName.begin());
-		std::map<std::string, std::vector<QVariant> > compoundMap;
-
-		if (H5Utils::read_compound(dataset, compoundMap))
+		const std::size_t nrOfRows = loaderInfo._pointsDataset->getNumPoints();
+		std::size_t count = 0;
+		for (auto it = codedCategories.cbegin(); it != codedCategories.cend(); ++it)
+			count += it->second.size();
+		if (count != nrOfRows)
+			std::cout << "WARNING: " << "not all datapoints are accounted for" << std::endl;
+
+		std::size_t posFound = h5GroupName.find("_color");
+		if (posFound == std::string::npos)
 		{
-			std::size_t nrOfComponents = compoundMap.size();
-			std::vector<numericMetaDataType> numericalMetaData;
-			std::vector<QString> numericalMetaDataDimensionNames;
-
-			for (auto component = compoundMap.cbegin(); component != compoundMap.cend(); ++component)
+			if (count == nrOfRows)
 			{
-				const std::size_t nrOfSamples = component->second.size();
-				if (nrOfSamples == loaderInfo._pointsDataset->getNumPoints())
+				H5Utils::addClusterMetaData(codedCategories, h5GroupName.c_str(), loaderInfo._pointsDataset);
+			}
+		}
+		else
+		{
+			bool itemsAreColors = true;
+			for (auto codedCat = codedCategories.cbegin(); codedCat != codedCategories.cend(); ++codedCat)
+			{
+				if (codedCat->first != "NA")
 				{
-					if (component->first != "index")
+					if (!QColor::isValidColor(codedCat->first))
 					{
-						std::map<QString, std::vector<unsigned>> indices;
 
-
-						bool currentMetaDataIsNumerical = true; // we start assuming it's a numerical value
-						std::vector<numericMetaDataType> values;
-						values.reserve(loaderInfo._pointsDataset->getNumPoints());
-						for (std::size_t s = 0; s < nrOfSamples; ++s)
+						itemsAreColors = false;
+						break;
+					}
+				}
+			}
+			if (itemsAreColors)
+			{
+				int options = 2;
+				for(int option =0; option < options; ++option)
+				{
+					QString datasetNameToFind = h5GroupName.c_str();
+					datasetNameToFind.resize(posFound);
+					if(option ==0)
+						datasetNameToFind += "_label";
+					if (datasetNameToFind[0] == '/')
+						datasetNameToFind.remove(0, 1);
+					DataHierarchyItem* foundDataset = GetDerivedDataset(datasetNameToFind, loaderInfo._pointsDataset);
+					if (foundDataset)
+					{
+						foundDataset->setLocked(true);
+						if (foundDataset->getDataType() == DataType("Clusters"))
 						{
-							QString item = component->second[s].toString();
-							if (currentMetaDataIsNumerical)
+							//std::cout << " --- " << datasetNameToFind.toStdString() << " --- " << std::endl;
+							auto& clusters = foundDataset->getDataset<Clusters>()->getClusters();
+							int unchangedClusterColors = 0;
+							//#pragma  omp parallel for schedule(dynamic,1)
+							for (long long i = 0; i < clusters.size(); ++i)
 							{
-								if (H5Utils::is_number(item))
+								const auto& clusterIndices = clusters[i].getIndices();
+								std::set<uint32_t> clusterIndicesSet(clusterIndices.cbegin(), clusterIndices.cend());
+								bool clusterColorChanged = false;
+								for (auto codedCat = codedCategories.cbegin(); codedCat != codedCategories.cend(); ++codedCat)
 								{
-									values.push_back(component->second[s].toFloat());
-								}
-								else
-								{
-									values.clear();
-									currentMetaDataIsNumerical = false;
-									// add former labels as caterogical as well.
-									for (std::size_t i = 0; i <= s; ++i)
+									const auto& indices = codedCat->second;
+									if (indices.size() == clusterIndices.size())
 									{
-										QString value = component->second[i].toString();
-										indices[value].push_back(i);
-									}
-								}
+
+										std::set<uint32_t> indicesSet(indices.cbegin(), indices.cend());
+										if (indicesSet == clusterIndicesSet)
+										{
+											bool subset = (indices.size() > clusterIndices.size());
+											QString newColor = QColor::isValidColor(codedCat->first) ? codedCat->first : "#000000";
+
+											clusters[i].setColor(newColor);
+											clusterColorChanged = true;
+											break;
+										}
+									}
+								}
+								if (!clusterColorChanged)
+								{
+									for (auto codedCat = codedCategories.cbegin(); codedCat != codedCategories.cend(); ++codedCat)
+									{
+										const auto& indices = codedCat->second;
+										if (indices.size() > clusterIndices.size())
+										{
+											std::set<uint32_t> indicesSet(indices.cbegin(), indices.cend());
+											if (std::includes(indicesSet.cbegin(), indicesSet.cend(), clusterIndicesSet.cbegin(), clusterIndicesSet.cend()))
+											{
+												bool subset = (indices.size() > clusterIndices.size());
+												QString newColor = QColor::isValidColor(codedCat->first) ? codedCat->first : "#000000";
+												clusters[i].setColor(newColor);
+												clusterColorChanged = true;
+												break;
+											}
+										}
+									}
+								}
+								if (!clusterColorChanged)
+								{
+									++unchangedClusterColors;
+									clusters[i].setColor("#000000");
+									//	std::cout << "cluster " << clusters[i].getName().toStdString() << " color " << clusters[i].getColor().name().toStdString() << " was not changed" << std::endl;
+								}
 							}
-							else
+							if (unchangedClusterColors < clusters.size())
 							{
-								indices[item].push_back(s);
+								events().notifyDatasetDataChanged(foundDataset->getDataset());
 							}
-						}
-						if (currentMetaDataIsNumerical)
-						{
-							numericalMetaData.insert(numericalMetaData.end(), values.cbegin(), values.cend());
-							numericalMetaDataDimensionNames.push_back(component->first.c_str());
-						}
-						else
-						{
-							QString prefix = h5datasetName.c_str() + QString("\\");
-							H5Utils::addClusterMetaData(indices, component->first.c_str(), loaderInfo._pointsDataset, std::map<QString, QColor>(), prefix);
-						}
 
+							if (unchangedClusterColors)
+							{
+								// if not all cluster colors where changed, we will add the color as well so at least it's visible.
+								std::map<QString, QColor> colors;
+								for (auto it = codedCategories.cbegin(); it != codedCategories.cend(); ++it)
+									colors[it->first] = QColor(it->first);
+
+
+								H5Utils::addClusterMetaData(codedCategories, h5GroupName.c_str(), loaderInfo._pointsDataset, colors);
+								option = options;
+							}
+						}
+						foundDataset->setLocked(false);
 					}
 				}
 
+				
+			}
+			else
+			{
+				H5Utils::addClusterMetaData(codedCategories, h5GroupName.c_str(), loaderInfo._pointsDataset);
 			}
-
-			Dataset<Points> numericalMetaDataset = H5Utils::addNumericalMetaData(numericalMetaData, numericalMetaDataDimensionNames, true, loaderInfo._pointsDataset, h5datasetName.c_str());
-			numericalMetaDataset->setProperty("Sample Names", loaderInfo._sampleNames);
 		}
 	}
 
-
-	template<typename numericalMetaDataType>
-	void LoadSampleNamesAndMetaData(H5::Group& group, LoaderInfo& loaderInfo)
+	// Sets the colors of the clusters of <objectName>_label (or <objectName>) that the first pass loaded from the categorical <objectName>_color column.
+	void MatchCategoricalColors(std::map<QString, std::vector<unsigned>>& indices, const std::vector<QString>& items, const std::string& objectName1, const std::string& h5GroupName, const std::string& dataSetName, LoaderInfo& loaderInfo)
 	{
-		static_assert(std::is_same<numericalMetaDataType, float>::value, "");
-		auto nrOfObjects = group.getNumObjs();
-
-		std::filesystem::path path(group.getObjName());
-		std::string h5GroupName = path.filename().string();
-
-		if (ContainsSparseMatrix(group))
+		bool itemsAreColors = true;
+		for (std::size_t i = 0; i < items.size(); ++i)
 		{
-			bool loadSparseSuccess = LoadSparseMatrix(group, loaderInfo);
-			return;
-		}
-			
-		std::vector<numericalMetaDataType> numericalMetaData;
-		std::size_t nrOfNumericalMetaData = 0;
-		std::vector<QString> numericalMetaDataDimensionNames;
-		std::size_t nrOfRows = loaderInfo._pointsDataset->getNumPoints();
-		std::map<std::string, std::vector<QString>> categories;
-
-		bool categoriesLoaded = LoadCategories(group, categories);
-
-		std::map<QString, std::vector<unsigned>> codedCategories;
-		if (LoadCodedCategories(group, codedCategories))
-		{
-			std::size_t count = 0;
-			for (auto it = codedCategories.cbegin(); it != codedCategories.cend(); ++it)
-				count += it->second.size();
-			if (count != nrOfRows)
-				std::cout << "WARNING: " << "not all datapoints are accounted for" << std::endl;
-
-			std::size_t posFound = h5GroupName.find("_color");
-			if (posFound == std::string::npos)
+			if (items[i] != "NA")
 			{
-				if (count == nrOfRows)
+				if (!QColor::isValidColor(items[i]))
 				{
-					H5Utils::addClusterMetaData(codedCategories, h5GroupName.c_str(), loaderInfo._pointsDataset);
+
+					itemsAreColors = false;
+					break;
 				}
 			}
-			else
+		}
+		if (itemsAreColors)
+		{
+			std::size_t posFound = objectName1.find("_color");
+			QString datasetNameToFind = h5GroupName.c_str();
+			datasetNameToFind += "/";
+			
+
+			const int options = 2;
+			for(int option=0; option < options; ++option)
 			{
-				bool itemsAreColors = true;
-				for (auto codedCat = codedCategories.cbegin(); codedCat != codedCategories.cend(); ++codedCat)
+				QString temp = objectName1.c_str();
+
+				temp.resize(posFound);
+				if(option==0)
+					temp += "_label";
+				datasetNameToFind += temp;
+				if (datasetNameToFind[0] == '/')
+					datasetNameToFind.remove(0, 1);
+				std::cout << "matching colors for " << datasetNameToFind.toStdString() << "  " << std::endl;
+				DataHierarchyItem* foundDataset = GetDerivedDataset(datasetNameToFind, loaderInfo._pointsDataset);
+				if (foundDataset)
 				{
-					if (codedCat->first != "NA")
+					foundDataset->setLocked(true);
+					if (foundDataset->getDataType() == DataType("Clusters"))
 					{
-						if (!QColor::isValidColor(codedCat->first))
-						{
 
-							itemsAreColors = false;
-							break;
-						}
-					}
-				}
-				if (itemsAreColors)
-				{
-					int options = 2;
-					for(int option =0; option < options; ++option)
-					{
-						QString datasetNameToFind = h5GroupName.c_str();
-						datasetNameToFind.resize(posFound);
-						if(option ==0)
-							datasetNameToFind += "_label";
-						if (datasetNameToFind[0] == '/')
-							datasetNameToFind.remove(0, 1);
-						DataHierarchyItem* foundDataset = GetDerivedDataset(datasetNameToFind, loaderInfo._pointsDataset);
-						if (foundDataset)
+						auto& clusters = foundDataset->getDataset<Clusters>()->getClusters();
+						int unchangedClusterColors = 0;
+						//#pragma omp parallel for schedule(dynamic,1)
+						for (long long i = 0; i < clusters.size(); ++i)
 						{
-							foundDataset->setLocked(true);
-							if (foundDataset->getDataType() == DataType("Clusters"))
+							const auto& clusterIndices = clusters[i].getIndices();
+							assert(std::is_sorted(clusterIndices.cbegin(), clusterIndices.cend()));
+							bool clusterColorChanged = false;
+							for (auto indices_iterator = indices.cbegin(); indices_iterator != indices.cend(); ++indices_iterator)
 							{
-								//std::cout << " --- " << datasetNameToFind.toStdString() << " --- " << std::endl;
-								auto& clusters = foundDataset->getDataset<Clusters>()->getClusters();
-								int unchangedClusterColors = 0;
-								//#pragma  omp parallel for schedule(dynamic,1)
-								for (long long i = 0; i < clusters.size(); ++i)
+								const auto& colorIndices = indices_iterator->second;
+								assert(std::is_sorted(colorIndices.cbegin(), colorIndices.cend()));
+								if (clusterIndices == colorIndices)
 								{
-									const auto& clusterIndices = clusters[i].getIndices();
-									std::set<uint32_t> clusterIndicesSet(clusterIndices.cbegin(), clusterIndices.cend());
-									bool clusterColorChanged = false;
-									for (auto codedCat = codedCategories.cbegin(); codedCat != codedCategories.cend(); ++codedCat)
-									{
-										const auto& indices = codedCat->second;
-										if (indices.size() == clusterIndices.size())
-										{
+									QString newColor = QColor::isValidColor(indices_iterator->first) ? indices_iterator->first : "#000000";
+									clusters[i].setColor(newColor);
 
-											std::set<uint32_t> indicesSet(indices.cbegin(), indices.cend());
-											if (indicesSet == clusterIndicesSet)
-											{
-												bool subset = (indices.size() > clusterIndices.size());
-												QString newColor = QColor::isValidColor(codedCat->first) ? codedCat->first : "#000000";
-
-												clusters[i].setColor(newColor);
-												clusterColorChanged = true;
-												break;
-											}
-										}
-									}
-									if (!clusterColorChanged)
+									clusterColorChanged = true;
+									break;
+								}
+							}
+							if (!clusterColorChanged)
+							{
+								std::cout << "no exact match found for " << clusters[i].getName().toStdString() << std::endl;
+								for (auto indices_iterator = indices.cbegin(); indices_iterator != indices.cend(); ++indices_iterator)
+								{
+									const auto& colorIndices = indices_iterator->second;
+									assert(std::is_sorted(colorIndices.cbegin(), colorIndices.cend()));
+									if (colorIndices.size() > clusterIndices.size())
 									{
-										for (auto codedCat = codedCategories.cbegin(); codedCat != codedCategories.cend(); ++codedCat)
+
+										if (std::includes(colorIndices.cbegin(), colorIndices.cend(), clusterIndices.cbegin(), clusterIndices.cend()))
 										{
-											const auto& indices = codedCat->second;
-											if (indices.size() > clusterIndices.size())
-											{
-												std::set<uint32_t> indicesSet(indices.cbegin(), indices.cend());
-												if (std::includes(indicesSet.cbegin(), indicesSet.cend(), clusterIndicesSet.cbegin(), clusterIndicesSet.cend()))
-												{
-													bool subset = (indices.size() > clusterIndices.size());
-													QString newColor = QColor::isValidColor(codedCat->first) ? codedCat->first : "#000000";
-													clusters[i].setColor(newColor);
-													clusterColorChanged = true;
-													break;
-												}
-											}
+											QString newColor = QColor::isValidColor(indices_iterator->first) ? indices_iterator->first : "#000000";
+											std::cout << "match found for " << clusters[i].getName().toStdString() << " color = " << newColor.toStdString() << " (" << colorIndices.size() << " vs " << clusterIndices.size() << ")" << std::endl;
+											clusters[i].setColor(newColor);
+
+											clusterColorChanged = true;
+											break;
 										}
 									}
-									if (!clusterColorChanged)
-									{
-										++unchangedClusterColors;
-										clusters[i].setColor("#000000");
-										//	std::cout << "cluster " << clusters[i].getName().toStdString() << " color " << clusters[i].getColor().name().toStdString() << " was not changed" << std::endl;
-									}
-								}
-								if (unchangedClusterColors < clusters.size())
-								{
-									events().notifyDatasetDataChanged(foundDataset->getDataset());
 								}
+							}
 
-								if (unchangedClusterColors)
-								{
-									// if not all cluster colors where changed, we will add the color as well so at least it's visible.
-									std::map<QString, QColor> colors;
-									for (auto it = codedCategories.cbegin(); it != codedCategories.cend(); ++it)
-										colors[it->first] = QColor(it->first);
+							if (!clusterColorChanged)
+							{
+								++unchangedClusterColors;
+								std::cout << "no  match found for " << clusters[i].getName().toStdString() << std::endl;
+								clusters[i].setColor("#000000");
+							}
 
+						}
+						if (unchangedClusterColors < clusters.size())
+						{
+							events().notifyDatasetDataChanged(foundDataset->getDataset());
+						}
+							
+
+						if (unchangedClusterColors)
+						{
+							// if not all cluster colors where changed, we will add the color as well so at least it's visible.
+							std::map<QString, QColor> colors;
+							for (auto it = indices.cbegin(); it != indices.cend(); ++it)
+								colors[it->first] = QColor(it->first);
+
+							H5Utils::addClusterMetaData(indices, dataSetName.c_str(), loaderInfo._pointsDataset, colors);
 
-									H5Utils::addClusterMetaData(codedCategories, h5GroupName.c_str(), loaderInfo._pointsDataset, colors);
-									option = options;
-								}
-							}
-							foundDataset->setLocked(false);
 						}
 					}
-
-					
-				}
-				else
-				{
-					H5Utils::addClusterMetaData(codedCategories, h5GroupName.c_str(), loaderInfo._pointsDataset);
+					foundDataset->setLocked(false);
 				}
 			}
+			
+
+		}
+	}
+
+	// A string column with a label per row is added as clusters, a column of color names sets the colors of the clusters of obs/<objectName>.
+	void AddStringMetaData(std::map<QString, std::vector<unsigned>>& indices, const std::vector<QString>& items, const std::string& objectName1, const std::string& dataSetName, LoaderInfo& loaderInfo)
+	{
+		if (items.size() == loaderInfo._pointsDataset->getNumPoints())
+		{
+			H5Utils::addClusterMetaData(indices, dataSetName.c_str(), loaderInfo._pointsDataset);
 		}
 		else
 		{
-			// first do the basics
-			for (int load_colors = 0; load_colors < 2; ++load_colors)
+			bool itemsAreColors = true;
+			for (std::size_t i = 0; i < items.size(); ++i)
 			{
-
-				for (auto go = 0; go < nrOfObjects; ++go)
+				if (items[i] != "NA")
 				{
-					std::string objectName1 = group.getObjnameByIdx(go);
-					std::size_t posFound = objectName1.find("_color");
-					if (load_colors == 0)
-					{
-						if (posFound != std::string::npos)
-							continue;
-					}
-					else
+					if (!QColor::isValidColor(items[i]))
 					{
-						if (posFound == std::string::npos)
-							continue;
+
+						itemsAreColors = false;
+						break;
 					}
-					if (objectName1[0] == '\\')
-						objectName1.erase(objectName1.begin());
-					H5G_obj_t objectType1 = group.getObjTypeByIdx(go);
+				}
+			}
+			if (itemsAreColors)
+			{
+				std::size_t posFound = objectName1.find("_color");
+				if (posFound != std::string::npos)
+				{
+					QString datasetNameToFind;
+					QString temp = objectName1.c_str();
+					temp.resize(posFound);
+					datasetNameToFind = QString("obs/") + temp;
 
-					if (objectType1 == H5G_DATASET)
+					DataHierarchyItem* foundDataset = GetDerivedDataset(datasetNameToFind, loaderInfo._pointsDataset);
+					if (foundDataset)
 					{
-						H5::DataSet dataSet = group.openDataSet(objectName1);
-						if (!((objectName1 == "index") || (objectName1 == "_index")))
+						if (foundDataset->getDataType() == DataType("Clusters"))
 						{
-
-							if (categories.find(objectName1) != categories.end())
+							auto& clusters = foundDataset->getDataset<Clusters>()->getClusters();
+							if (clusters.size() == items.size())
 							{
-								if (dataSet.attrExists("categories"))
-								{
-									std::vector<uint64_t> index;
-									const std::vector<QString>& labels = categories[objectName1];
-									if (H5Utils::read_vector(group, objectName1, &index))
-									{
-										std::map<QString, std::vector<unsigned>> indices;
-										if (index.size() == loaderInfo._pointsDataset->getNumPoints())
-										{
-											for (unsigned i = 0; i < index.size(); ++i)
-											{
-												indices[labels[index[i]]].push_back((i));
-											}
-											for (auto indices_iterator = indices.begin(); indices_iterator != indices.end(); ++indices_iterator)
-											{
-												std::sort(indices_iterator->second.begin(), indices_iterator->second.end());
-												auto ignore = std::unique(indices_iterator->second.begin(), indices_iterator->second.end());
-												assert(indices_iterator->second.size() > 0);
-											}
-											if (load_colors == 0)
-												H5Utils::addClusterMetaData(indices, dataSet.getObjName().c_str(), loaderInfo._pointsDataset);
-											else
-											{
-												const std::vector<QString>& items = categories[objectName1];
-												bool itemsAreColors = true;
-												for (std::size_t i = 0; i < items.size(); ++i)
-												{
-													if (items[i] != "NA")
-													{
-														if (!QColor::isValidColor(items[i]))
-														{
-
-															itemsAreColors = false;
-															break;
-														}
-													}
-												}
-												if (itemsAreColors)
-												{
-													QString datasetNameToFind = h5GroupName.c_str();
-													datasetNameToFind += "/";
-													
-
-													const int options = 2;
-													for(int option=0; option < options; ++option)
-													{
-														QString temp = objectName1.c_str();
-
-														temp.resize(posFound);
-														if(option==0)
-															temp += "_label";
-														datasetNameToFind += temp;
-														if (datasetNameToFind[0] == '/')
-															datasetNameToFind.remove(0, 1);
-														std::cout << "matching colors for " << datasetNameToFind.toStdString() << "  " << std::endl;
-														DataHierarchyItem* foundDataset = GetDerivedDataset(datasetNameToFind, loaderInfo._pointsDataset);
-														if (foundDataset)
-														{
-															foundDataset->setLocked(true);
-															if (foundDataset->getDataType() == DataType("Clusters"))
-															{
-
-																auto& clusters = foundDataset->getDataset<Clusters>()->getClusters();
-																int unchangedClusterColors = 0;
-																//#pragma omp parallel for schedule(dynamic,1)
-																for (long long i = 0; i < clusters.size(); ++i)
-																{
-																	const auto& clusterIndices = clusters[i].getIndices();
-																	assert(std::is_sorted(clusterIndices.cbegin(), clusterIndices.cend()));
-																	bool clusterColorChanged = false;
-																	for (auto indices_iterator = indices.cbegin(); indices_iterator != indices.cend(); ++indices_iterator)
-																	{
-																		const auto& colorIndices = indices_iterator->second;
-																		assert(std::is_sorted(colorIndices.cbegin(), colorIndices.cend()));
-																		if (clusterIndices == colorIndices)
-																		{
-																			QString newColor = QColor::isValidColor(indices_iterator->first) ? indices_iterator->first : "#000000";
-																			clusters[i].setColor(newColor);
-
-																			clusterColorChanged = true;
-																			break;
-																		}
-																	}
-																	if (!clusterColorChanged)
-																	{
-																		std::cout << "no exact match found for " << clusters[i].getName().toStdString() << std::endl;
-																		for (auto indices_iterator = indices.cbegin(); indices_iterator != indices.cend(); ++indices_iterator)
-																		{
-																			const auto& colorIndices = indices_iterator->second;
-																			assert(std::is_sorted(colorIndices.cbegin(), colorIndices.cend()));
-																			if (colorIndices.size() > clusterIndices.size())
-																			{
-
-																				if (std::includes(colorIndices.cbegin(), colorIndices.cend(), clusterIndices.cbegin(), clusterIndices.cend()))
-																				{
-																					QString newColor = QColor::isValidColor(indices_iterator->first) ? indices_iterator->first : "#000000";
-																					std::cout << "match found for " << clusters[i].getName().toStdString() << " color = " << newColor.toStdString() << " (" << colorIndices.size() << " vs " << clusterIndices.size() << ")" << std::endl;
-																					clusters[i].setColor(newColor);
-
-																					clusterColorChanged = true;
-																					break;
-																				}
-																			}
-																		}
-																	}
-
-																	if (!clusterColorChanged)
-																	{
-																		++unchangedClusterColors;
-																		std::cout << "no  match found for " << clusters[i].getName().toStdString() << std::endl;
-																		clusters[i].setColor("#000000");
-																	}
-
-																}
-																if (unchangedClusterColors < clusters.size())
-																{
-																	events().notifyDatasetDataChanged(foundDataset->getDataset());
-																}
-																	
-
-																if (unchangedClusterColors)
-																{
-																	// if not all cluster colors where changed, we will add the color as well so at least it's visible.
-																	std::map<QString, QColor> colors;
-																	for (auto it = indices.cbegin(); it != indices.cend(); ++it)
-																		colors[it->first] = QColor(it->first);
-
-																	H5Utils::addClusterMetaData(indices, dataSet.getObjName().c_str(), loaderInfo._pointsDataset, colors);
-
-																}
-															}
-															foundDataset->setLocked(false);
-														}
-													}
-													
-
-												}
-											}
-										}
-									}
-								}
+								for (std::size_t i = 0; i < clusters.size(); ++i)
+									clusters[i].setColor(items[i]);
 
+								events().notifyDatasetDataChanged(foundDataset->getDataset());
 							}
-							else
-							{
-								auto datasetClass = dataSet.getDataType().getClass();
+						}
+					}
+				}
 
-								if ((datasetClass == H5T_INTEGER) || (datasetClass == H5T_FLOAT) || (datasetClass == H5T_ENUM))
-								{
-									std::vector<float> values;
-									if (H5Utils::read_vector(group, objectName1, &values))
-									{
-										// 1 dimensional
-										if (values.size() == loaderInfo._pointsDataset->getNumPoints())
-										{
-											numericalMetaData.insert(numericalMetaData.end(), values.cbegin(), values.cend());
-											numericalMetaDataDimensionNames.push_back(dataSet.getObjName().c_str());
-										}
-									}
-									else
-									{
-										// multi-dimensional,  only 2 supported for now
-										H5Utils::MultiDimensionalData<float> mdd;
+			}
 
-										if (H5Utils::read_multi_dimensional_data(dataSet, mdd))
-										{
-											if (mdd.size.size() == 2)
-											{
-												if (mdd.size[0] == loaderInfo._pointsDataset->getNumPoints())
-												{
-
-													QString baseString = dataSet.getObjName().c_str();
-													std::vector<QString> dimensionNames(mdd.size[1]);
-													for (std::size_t l = 0; l < mdd.size[1]; ++l)
-													{
-														dimensionNames[l] = QString::number(l + 1);
-													}
-													mv::Dataset<Points> numericalMetaDataset = H5Utils::addNumericalMetaData(mdd.data, dimensionNames, false, loaderInfo._pointsDataset, baseString);
-													numericalMetaDataset->setProperty("Sample Names", loaderInfo._sampleNames);
-												}
-											}
-										}
-									}
+		}
+	}
 
-								}
-								else if (datasetClass == H5T_COMPOUND)
-								{
-									std::map<std::string, std::vector<QVariant> >result;
-									if (H5Utils::read_compound(dataSet, result))
-									{
-										int i = 0;
-										++i;
-									}
+	// One child of an obs like group, passed through the stages of H5Utils::process_columns.
+	struct MetaDataColumn
+	{
+		enum class Kind { Categorical, Numerical, MultiDimensional, Strings, CodedCategories, Group };
+
+		Kind kind = Kind::Group;
+		std::string objectName;
+		std::string objName;							// full path of the dataset or group
+		std::vector<std::uint64_t> index;				// Categorical: the category of every row
+		std::vector<float> values;						// Numerical
+		H5Utils::MultiDimensionalData<float> mdd;		// MultiDimensional
+		std::vector<QString> items;						// Strings, or the categories of CodedCategories
+		std::vector<std::int64_t> codes;				// CodedCategories
+		bool grouped = false;
+		std::map<QString, std::vector<unsigned>> indices;
+		std::shared_ptr<MetaData> group;				// Group, and CodedCategories that could not be grouped
+	};
 
-								}
-								else // try to read as strings for now
-								{
+	bool ReadMetaDataColumn(H5::Group& group, hsize_t go, const std::map<std::string, std::vector<QString>>& categories, MetaDataColumn& column)
+	{
+		std::string objectName1 = group.getObjnameByIdx(go);
+		if (objectName1[0] == '\\')
+			objectName1.erase(objectName1.begin());
+		column.objectName = objectName1;
+		H5G_obj_t objectType1 = group.getObjTypeByIdx(go);
 
-									std::map<QString, std::vector<unsigned>> indices;
-									std::vector<QString> items;
-									H5Utils::read_vector_string(dataSet, items);
-									if (items.size() == loaderInfo._pointsDataset->getNumPoints())
-									{
-										for (unsigned i = 0; i < items.size(); ++i)
-										{
-											indices[items[i]].push_back(i);
-										}
-										H5Utils::addClusterMetaData(indices, dataSet.getObjName().c_str(), loaderInfo._pointsDataset);
-									}
-									else
-									{
-										bool itemsAreColors = true;
-										for (std::size_t i = 0; i < items.size(); ++i)
-										{
-											if (items[i] != "NA")
-											{
-												if (!QColor::isValidColor(items[i]))
-												{
+		if (objectType1 == H5G_DATASET)
+		{
+			H5::DataSet dataSet = group.openDataSet(objectName1);
+			if ((objectName1 == "index") || (objectName1 == "_index"))
+				return false;
+			column.objName = dataSet.getObjName();
 
-													itemsAreColors = false;
-													break;
-												}
-											}
-										}
-										if (itemsAreColors)
-										{
-											std::size_t posFound = posFound = objectName1.find("_color");
-											if (posFound != std::string::npos)
-											{
-												QString datasetNameToFind;
-												QString temp = objectName1.c_str();
-												temp.resize(posFound);
-												datasetNameToFind = QString("obs/") + temp;
-
-												DataHierarchyItem* foundDataset = GetDerivedDataset(datasetNameToFind, loaderInfo._pointsDataset);
-												if (foundDataset)
-												{
-													if (foundDataset->getDataType() == DataType("Clusters"))
-													{
-														auto& clusters = foundDataset->getDataset<Clusters>()->getClusters();
-														if (clusters.size() == items.size())
-														{
-															for (std::size_t i = 0; i < clusters.size(); ++i)
-																clusters[i].setColor(items[i]);
-
-															events().notifyDatasetDataChanged(foundDataset->getDataset());
-														}
-													}
-												}
-											}
+			if (categories.find(objectName1) != categories.end())
+			{
+				column.kind = MetaDataColumn::Kind::Categorical;
+				return dataSet.attrExists("categories") && H5Utils::read_vector(group, objectName1, &column.index);
+			}
 
-										}
+			auto datasetClass = dataSet.getDataType().getClass();
+			if ((datasetClass == H5T_INTEGER) || (datasetClass == H5T_FLOAT) || (datasetClass == H5T_ENUM))
+			{
+				column.kind = MetaDataColumn::Kind::Numerical;
+				if (H5Utils::read_vector(group, objectName1, &column.values))
+					return true;
+				// multi-dimensional,  only 2 supported for now
+				column.kind = MetaDataColumn::Kind::MultiDimensional;
+				return H5Utils::read_multi_dimensional_data(dataSet, column.mdd);
+			}
+			else if (datasetClass == H5T_COMPOUND)
+			{
+				std::map<std::string, std::vector<QVariant> >result;
+				H5Utils::read_compound(dataSet, result);
+				return false;
+			}
+			// try to read as strings for now
+			column.kind = MetaDataColumn::Kind::Strings;
+			H5Utils::read_vector_string(dataSet, column.items);
+			return true;
+		}
+		else if (objectType1 == H5G_GROUP)
+		{
+			H5::Group group2 = group.openGroup(objectName1);
+			column.objName = group2.getObjName();
+			column.kind = ReadCodedCategories(group2, column.items, column.codes) ? MetaDataColumn::Kind::CodedCategories : MetaDataColumn::Kind::Group;
+			return true;
+		}
+		return false;
+	}
 
-									}
+	// Groups the rows by label. Thread safe, does not touch any dataset.
+	void GroupMetaDataColumn(MetaDataColumn& column, const std::map<std::string, std::vector<QString>>& categories, std::size_t nrOfRows)
+	{
+		switch (column.kind)
+		{
+		case MetaDataColumn::Kind::Categorical:
+			if (column.index.size() == nrOfRows)
+			{
+				const std::vector<QString>& labels = categories.at(column.objectName);
+				for (unsigned i = 0; i < column.index.size(); ++i)
+				{
+					column.indices[labels[column.index[i]]].push_back((i));
+				}
+				for (auto indices_iterator = column.indices.begin(); indices_iterator != column.indices.end(); ++indices_iterator)
+				{
+					std::sort(indices_iterator->second.begin(), indices_iterator->second.end());
+					auto ignore = std::unique(indices_iterator->second.begin(), indices_iterator->second.end());
+					assert(indices_iterator->second.size() > 0);
+				}
+				column.grouped = true;
+			}
+			break;
+		case MetaDataColumn::Kind::Strings:
+			if (column.items.size() == nrOfRows)
+			{
+				for (unsigned i = 0; i < column.items.size(); ++i)
+				{
+					column.indices[column.items[i]].push_back(i);
+				}
+				column.grouped = true;
+			}
+			break;
+		case MetaDataColumn::Kind::CodedCategories:
+			column.grouped = GroupCodedCategories(column.items, column.codes, column.indices);
+			break;
+		default:
+			break;
+		}
+	}
+
+	struct MetaData
+	{
+		enum class Kind { None, Compound, SparseMatrix, CodedCategories, Columns };
+
+		Kind kind = Kind::None;
+		std::string objName;							// full path of the dataset or group
+		std::size_t nrOfRows = 0;
+		// Compound: the numerical components, and the rows of every label of the others
+		std::vector<float> numericalMetaData;
+		std::vector<QString> numericalMetaDataDimensionNames;
+		std::vector<std::pair<std::string, std::map<QString, std::vector<unsigned>>>> clusters;
+		// SparseMatrix
+		H5Utils::VectorHolder data;
+		H5Utils::CompressedMatrix matrix;
+		H5Utils::MatrixLayout layout;
+		// CodedCategories
+		std::map<QString, std::vector<unsigned>> codedCategories;
+		// Columns: the columns that are not colors, then the _color columns that color the clusters of the first
+		std::map<std::string, std::vector<QString>> categories;
+		std::vector<MetaDataColumn> columns[2];
+	};
+
+	std::shared_ptr<MetaData> ReadMetaData(H5::DataSet& dataset, std::size_t nrOfRows)
+	{
+		auto metaData = std::make_shared<MetaData>();
+		metaData->objName = dataset.getObjName();
+		metaData->nrOfRows = nrOfRows;
+		std::map<std::string, std::vector<QVariant> > compoundMap;
+
+		if (H5Utils::read_compound(dataset, compoundMap))
+		{
+			metaData->kind = MetaData::Kind::Compound;
+			for (auto component = compoundMap.cbegin(); component != compoundMap.cend(); ++component)
+			{
+				const std::size_t nrOfSamples = component->second.size();
+				if ((nrOfSamples == nrOfRows) && (component->first != "index"))
+				{
+					std::map<QString, std::vector<unsigned>> indices;
+
+					bool currentMetaDataIsNumerical = true; // we start assuming it's a numerical value
+					std::vector<float> values;
+					values.reserve(nrOfRows);
+					for (std::size_t s = 0; s < nrOfSamples; ++s)
+					{
+						QString item = component->second[s].toString();
+						if (currentMetaDataIsNumerical)
+						{
+							if (H5Utils::is_number(item))
+							{
+								values.push_back(component->second[s].toFloat());
+							}
+							else
+							{
+								values.clear();
+								currentMetaDataIsNumerical = false;
+								// add former labels as caterogical as well.
+								for (std::size_t i = 0; i <= s; ++i)
+								{
+									QString value = component->second[i].toString();
+									indices[value].push_back(i);
 								}
 							}
-
+						}
+						else
+						{
+							indices[item].push_back(s);
 						}
 					}
-					else if (objectType1 == H5G_GROUP)
+					if (currentMetaDataIsNumerical)
+					{
+						metaData->numericalMetaData.insert(metaData->numericalMetaData.end(), values.cbegin(), values.cend());
+						metaData->numericalMetaDataDimensionNames.push_back(component->first.c_str());
+					}
+					else
 					{
-						H5::Group group2 = group.openGroup(objectName1);
-						LoadSampleNamesAndMetaData<numericalMetaDataType>(group2, loaderInfo);
+						metaData->clusters.emplace_back(component->first, std::move(indices));
 					}
 				}
+			}
+		}
+		return metaData;
+	}
 
+	std::shared_ptr<MetaData> ReadMetaData(H5::Group& group, std::size_t nrOfRows)
+	{
+		auto metaData = std::make_shared<MetaData>();
+		metaData->objName = group.getObjName();
+		metaData->nrOfRows = nrOfRows;
 
+		if (ContainsSparseMatrix(group))
+		{
+			if (ReadSparseMatrix(group, nrOfRows, metaData->data, metaData->matrix, metaData->layout))
+				metaData->kind = MetaData::Kind::SparseMatrix;
+			return metaData;
+		}
+
+		std::map<std::string, std::vector<QString>>& categories = metaData->categories;
+		LoadCategories(group, categories);
+
+		if (LoadCodedCategories(group, metaData->codedCategories))
+		{
+			metaData->kind = MetaData::Kind::CodedCategories;
+			return metaData;
+		}
+
+		metaData->kind = MetaData::Kind::Columns;
+		auto nrOfObjects = group.getNumObjs();
+		// first do the basics
+		for (int load_colors = 0; load_colors < 2; ++load_colors)
+		{
+			std::vector<hsize_t> objectIndices;
+			for (hsize_t go = 0; go < nrOfObjects; ++go)
+			{
+				std::string objectName1 = group.getObjnameByIdx(go);
+				std::size_t posFound = objectName1.find("_color");
+				if ((load_colors == 0) == (posFound == std::string::npos))
+					objectIndices.push_back(go);
+			}
+
+			// the columns are read one after the other and grouped in parallel, the child groups are read when they come up
+			std::vector<MetaDataColumn>& columns = metaData->columns[load_colors];
+			H5Utils::process_columns<MetaDataColumn>(objectIndices.size(),
+				[&group, &objectIndices, &categories](std::size_t c, MetaDataColumn& column) { return ReadMetaDataColumn(group, objectIndices[c], categories, column); },
+				[&categories, nrOfRows](MetaDataColumn& column) { GroupMetaDataColumn(column, categories, nrOfRows); },
+				[&](std::size_t, MetaDataColumn& column)
+				{
+					if ((column.kind == MetaDataColumn::Kind::Group) || ((column.kind == MetaDataColumn::Kind::CodedCategories) && !column.grouped))
+					{
+						H5::Group group2 = group.openGroup(column.objectName);
+						column.group = ReadMetaData(group2, nrOfRows);
+					}
+					// the grouped rows replace the codes
+					std::vector<std::uint64_t>().swap(column.index);
+					std::vector<std::int64_t>().swap(column.codes);
+					columns.push_back(std::move(column));
+				});
+		}
+		return metaData;
+	}
+
+	void AddMetaData(MetaData& metaData, LoaderInfo& loaderInfo)
+	{
+		const std::size_t nrOfRows = metaData.nrOfRows;
+		switch (metaData.kind)
+		{
+		case MetaData::Kind::None:
+			return;
+		case MetaData::Kind::Compound:
+		{
+			std::string h5datasetName = metaData.objName;
+			if (h5datasetName[0] == '/')
+				h5datasetName.erase(h5datasetName.begin());
+			QString prefix = h5datasetName.c_str() + QString("\\");
+			for (auto& cluster : metaData.clusters)
+				H5Utils::addClusterMetaData(cluster.second, cluster.first.c_str(), loaderInfo._pointsDataset, std::map<QString, QColor>(), prefix);
+
+			Dataset<Points> numericalMetaDataset = H5Utils::addNumericalMetaData(metaData.numericalMetaData, metaData.numericalMetaDataDimensionNames, true, loaderInfo._pointsDataset, h5datasetName.c_str());
+			numericalMetaDataset->setProperty("Sample Names", loaderInfo._sampleNames);
+			return;
+		}
+		case MetaData::Kind::SparseMatrix:
+			AddSparseMatrix(metaData.objName, metaData.data, metaData.matrix, metaData.layout, loaderInfo);
+			return;
+		default:
+			break;
+		}
+
+		std::string h5GroupName = std::filesystem::path(metaData.objName).filename().string();
+		if (metaData.kind == MetaData::Kind::CodedCategories)
+		{
+			AddCodedCategories(metaData.codedCategories, h5GroupName, loaderInfo);
+			return;
+		}
+
+		std::vector<float> numericalMetaData;
+		std::vector<QString> numericalMetaDataDimensionNames;
+		for (int load_colors = 0; load_colors < 2; ++load_colors)
+		{
+			for (MetaDataColumn& column : metaData.columns[load_colors])
+			{
+				switch (column.kind)
+				{
+				case MetaDataColumn::Kind::Categorical:
+					if (column.grouped)
+					{
+						if (load_colors == 0)
+							H5Utils::addClusterMetaData(column.indices, column.objName.c_str(), loaderInfo._pointsDataset);
+						else
+							MatchCategoricalColors(column.indices, metaData.categories[column.objectName], column.objectName, h5GroupName, column.objName, loaderInfo);
+					}
+					break;
+				case MetaDataColumn::Kind::Numerical:
+					// 1 dimensional
+					if (column.values.size() == nrOfRows)
+					{
+						numericalMetaData.insert(numericalMetaData.end(), column.values.cbegin(), column.values.cend());
+						numericalMetaDataDimensionNames.push_back(column.objName.c_str());
+					}
+					break;
+				case MetaDataColumn::Kind::MultiDimensional:
+					if ((column.mdd.size.size() == 2) && (column.mdd.size[0] == nrOfRows))
+					{
+						QString baseString = column.objName.c_str();
+						std::vector<QString> dimensionNames(column.mdd.size[1]);
+						for (std::size_t l = 0; l < column.mdd.size[1]; ++l)
+						{
+							dimensionNames[l] = QString::number(l + 1);
+						}
+						mv::Dataset<Points> numericalMetaDataset = H5Utils::addNumericalMetaData(column.mdd.data, dimensionNames, false, loaderInfo._pointsDataset, baseString);
+						numericalMetaDataset->setProperty("Sample Names", loaderInfo._sampleNames);
+					}
+					break;
+				case MetaDataColumn::Kind::Strings:
+					AddStringMetaData(column.indices, column.items, column.objectName, column.objName, loaderInfo);
+					break;
+				case MetaDataColumn::Kind::CodedCategories:
+					if (column.grouped)
+					{
+						AddCodedCategories(column.indices, std::filesystem::path(column.objName).filename().string(), loaderInfo);
+						break;
+					}
+					[[fallthrough]];
+				case MetaDataColumn::Kind::Group:
+					if (column.group)
+						AddMetaData(*column.group, loaderInfo);
+					break;
+				}
+				// the added column is not needed anymore
+				column = MetaDataColumn();
 			}
 		}
 
@@ -1410,15 +1598,64 @@ namespace H5AD
 		}
 	}
 
+
 	void LoadSampleNamesAndMetaDataFloat(H5::DataSet& dataset, LoaderInfo &loaderInfo)
 	{
-		 H5AD::LoadSampleNamesAndMetaData<float>(dataset, loaderInfo);
+		AddMetaData(*ReadMetaData(dataset, loaderInfo._pointsDataset->getNumPoints()), loaderInfo);
 	}
 
 	void LoadSampleNamesAndMetaDataFloat(H5::Group& group, LoaderInfo& loaderInfo)
 	{
-		 H5AD::LoadSampleNamesAndMetaData<float>(group, loaderInfo);
+		AddMetaData(*ReadMetaData(group, loaderInfo._pointsDataset->getNumPoints()), loaderInfo);
+	}
+
+
+	MetaDataLane::MetaDataLane(std::function<void(std::size_t)> read)
+		: _read(std::move(read))
+	{
+	}
+
+	MetaDataLane::~MetaDataLane()
+	{
+		wait();
+	}
+
+	void MetaDataLane::start(std::size_t nrOfRows)
+	{
+		if (_started)
+			return;
+		_started = true;
+		_thread = std::thread([this, nrOfRows]()
+			{
+				MV_H5_TRACE_SCOPE("metadata lane");
+				try
+				{
+					_read(nrOfRows);
+				}
+				catch (...)
+				{
+					_exception = std::current_exception();
+				}
+			});
+	}
+
+	void MetaDataLane::wait()
+	{
+		if (_thread.joinable())
+			_thread.join();
+	}
+
+	void MetaDataLane::finish(std::size_t nrOfRows)
+	{
+		if (!_started)
+		{
+			_started = true;
+			_read(nrOfRows);
+			return;
+		}
+		wait();
+		if (_exception)
+			std::rethrow_exception(std::exchange(_exception, nullptr));
 	}
-	
 
 }// namespace
@@ -1,13 +1,43 @@
 #pragma once
 
 #include "H5Utils.h"
+#include "BackedMatrix.h"
+#include "LoadReport.h"
 
 #include "PointData/PointData.h"
 #include "ClusterData/Cluster.h"
 #include "ClusterData/ClusterData.h"
 
+#include <exception>
+#include <functional>
+#include <thread>
+
 namespace H5AD
 {
+	// Runs the reads of the metadata on a thread of its own while X is scattered. The scatter only uses the cores and
+	// HDF5 is not thread safe, so between start and wait the caller must not make HDF5 calls.
+	class MetaDataLane
+	{
+	public:
+		explicit MetaDataLane(std::function<void(std::size_t nrOfRows)> read);
+		~MetaDataLane();
+
+		MetaDataLane(const MetaDataLane&) = delete;
+		MetaDataLane& operator=(const MetaDataLane&) = delete;
+
+		void start(std::size_t nrOfRows);
+		// Waits for the reads started by start, an exception they threw is kept for finish.
+		void wait();
+		// Reads on the calling thread if the lane was not started, and rethrows what the reads threw.
+		void finish(std::size_t nrOfRows);
+
+	private:
+		std::function<void(std::size_t)> _read;
+		std::thread _thread;
+		std::exception_ptr _exception;
+		bool _started = false;
+	};
+
 	struct LoaderInfo
 	{
 		Dataset<Points> _pointsDataset;
@@ -15,6 +45,11 @@ namespace H5AD
 		QVariantList _sampleNames;
 		std::vector<bool> _enabledDimensions;
 		std::vector<std::ptrdiff_t> _selectedDimensionsLUT;
+		std::uint64_t _memoryBudget = 0; // bytes, 0 uses the default budget of H5Utils::LoadPlanner
+		H5Utils::LoadReport* _report = nullptr; // phases and choices of loading X are added to it, if set
+		std::shared_ptr<H5Utils::BackedMatrix> _backedMatrix; // set when X stays in the file (LoadStrategy::Backed)
+		std::function<void()> _dimensionsPicked; // called by load_X once the dimensions are picked, before X is read
+		MetaDataLane* _metadataLane = nullptr; // started while the sparse X is scattered, if set
 	};
 
 	void CreateColorVector(std::size_t nrOfColors, std::vector<QColor>& colors);
@@ -29,15 +64,27 @@ namespace H5AD
 
 	bool ContainsSparseMatrix(H5::Group& group);
 
+	std::uint64_t SparseIndexBound(H5::Group& group);
+
 	bool LoadSparseMatrix(H5::Group& group, LoaderInfo& loaderInfo);
 
+	// An obs or obsm like object as read and grouped by ReadMetaData without touching any dataset, so that it can be
+	// read on a MetaDataLane. AddMetaData adds it to the points, on the main thread.
+	struct MetaData;
+
+	std::shared_ptr<MetaData> ReadMetaData(H5::DataSet& dataset, std::size_t nrOfRows);
+
+	std::shared_ptr<MetaData> ReadMetaData(H5::Group& group, std::size_t nrOfRows);
+
+	void AddMetaData(MetaData& metaData, LoaderInfo& loaderInfo);
+
 	bool LoadCategories(H5::Group& group, std::map<std::string, std::vector<QString>>& categories);
 
 	DataHierarchyItem* GetDerivedDataset(const QString& name, Dataset<Points>& pointsDataset);
 
 	bool LoadCodedCategories(H5::Group& group, std::map<QString, std::vector<unsigned>>& result);
 
-	bool load_X(std::unique_ptr<H5::H5File>& h5fILE, LoaderInfo &loaderInfo, int storage_type);
+	bool load_X(std::shared_ptr<H5::H5File>& h5fILE, LoaderInfo &loaderInfo, int storage_type);
 
 	void LoadSampleNamesAndMetaDataFloat(H5::DataSet& dataset, LoaderInfo &loaderInfo);
 	
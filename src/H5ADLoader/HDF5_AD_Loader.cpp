@@ -3,6 +3,9 @@
 #include "H5ADUtils.h"
 
 #include "H5Utils.h"
+#include "FileAccess.h"
+#include "LoadPlanner.h"
+#include "Prefetcher.h"
 
 #include <QGuiApplication>
 #include <QInputDialog>
@@ -15,6 +18,7 @@
 #include <iostream>
 #include <map>
 #include <set>
+#include <vector>
 
 #include <PointData/PointData.h>
 
@@ -27,9 +31,15 @@ HDF5_AD_Loader::HDF5_AD_Loader(mv::CoreInterface *core)
 
 bool HDF5_AD_Loader::open(const QString& fileName)
 {
+	MV_H5_TRACE_SCOPE("HDF5_AD_Loader::open");
 	try
 	{
-		_file.reset(new H5::H5File(fileName.toLatin1().constData(), H5F_ACC_RDONLY));
+		_report = std::make_unique<H5Utils::LoadReport>("H5AD", fileName);
+		{
+			H5Utils::LoadReport::Phase phase(_report.get(), "open");
+			_file = H5Utils::open_file(fileName, _fileAccessProfile, _memoryBudget);
+		}
+		H5Utils::LoadReport::Phase phase(_report.get(), "structure scan");
 		auto nrOfObjects = _file->getNumObjs();
 		bool dataFound = false;
 
@@ -76,6 +86,8 @@ bool HDF5_AD_Loader::open(const QString& fileName)
 		if(dataFound && (!_dimensionNames.empty()))
 		{
 			_fileName = fileName;
+			// read X into the page cache while the user is in the load dialogs
+			_prefetcher = H5Utils::prefetch_matrix(*_file, "X", _memoryBudget);
 			return true;
 		}
 	}
@@ -83,7 +95,7 @@ bool HDF5_AD_Loader::open(const QString& fileName)
 	{
 		_fileName.clear();
 		_file->close();
-		_file.release();
+		_file.reset();
 	}
 	return false;
 }
@@ -93,34 +105,11 @@ bool HDF5_AD_Loader::open(const QString& fileName)
 	return _dimensionNames;
 }
 
- template<typename T>
- void filterValues(T& values, const std::vector<std::ptrdiff_t>& dimensionIndices)
- {
-	if(dimensionIndices.empty())
-		return;
-	assert(values.size() == dimensionIndices.size());
-	const auto nrOfSelectedIdices = std::count_if(dimensionIndices.cbegin(), dimensionIndices.cend(), [](std::ptrdiff_t i) { return (i >= 0); });
-	T selectedValues(nrOfSelectedIdices);
-	#pragma omp parallel for
-	 for (std::ptrdiff_t i = 0; i < dimensionIndices.size(); ++i)
-	 {
-		 auto index = dimensionIndices[i];
-		 if (index >= 0)
-		 {
-			 auto value = values[i];
-			 assert(index < nrOfSelectedIdices);
-			 selectedValues[index] = value;
-		 }
-		 
-	 }
-	 values = std::move(selectedValues);
- }
-
  
-static void LoadProperties(H5::DataSet dataset, H5AD::LoaderInfo &datasetInfo)
+// Reads the var like dataset as the property map of the points, see ReadProperties(H5::Group&, ...). Makes no changes to the points.
+static QString ReadProperties(H5::DataSet dataset, const H5AD::LoaderInfo &datasetInfo, QVariantMap& propertyMap)
  {
 	 auto datasetClass = dataset.getDataType().getClass();
-	 QVariantMap propertyMap;
 	 if (datasetClass == H5T_COMPOUND)
 	 {
 		 
@@ -132,24 +121,25 @@ static void LoadProperties(H5::DataSet dataset, H5AD::LoaderInfo &datasetInfo)
 			 {
 				if(component->second.size())
 				{
-					filterValues(component->second, datasetInfo._selectedDimensionsLUT);
+					H5Utils::filter_values(component->second, datasetInfo._selectedDimensionsLUT);
 					propertyMap[component->first.c_str()] =  QVariantList(component->second.cbegin(), component->second.cend());
 				}
 			 }
 		 }
 	 }
-	 datasetInfo._pointsDataset->setProperty(dataset.getObjName().c_str(), propertyMap);
-	
+	 return dataset.getObjName().c_str();
  }
 
-static void LoadProperties(H5::Group &group, H5AD::LoaderInfo &datasetInfo)
+// Reads the columns of the var like group, filtered by the selected dimensions, into the property map of the points
+// and returns the name of the property, empty when there is none. Makes no changes to the points, so that it can run
+// on the metadata lane.
+static QString ReadProperties(H5::Group &group, const H5AD::LoaderInfo &datasetInfo, QVariantMap& propertyMap)
  {
 	 QString name = group.getObjName().c_str();
 	 if (name.isEmpty())
-		 return;
+		 return name;
 	 if (name[0] == '/')
 		 name.remove(0, 1);
-	 QVariantMap propertyMap;
 
 	 std::map<std::string, std::vector<QString>> categories;
 	 H5AD::LoadCategories(group, categories);
@@ -173,7 +163,7 @@ static void LoadProperties(H5::Group &group, H5AD::LoaderInfo &datasetInfo)
 				 {
 					 if (values.size())
 					 {
-					 	filterValues(values, datasetInfo._selectedDimensionsLUT);
+					 	H5Utils::filter_values(values, datasetInfo._selectedDimensionsLUT);
 					 	propertyMap[objectName1.c_str()] = QVariantList(values.cbegin(), values.cend());
 					 }
 				 }
@@ -212,7 +202,7 @@ static void LoadProperties(H5::Group &group, H5AD::LoaderInfo &datasetInfo)
 						 {
 							 if (values.size())
 							 {
-								 filterValues(values, datasetInfo._selectedDimensionsLUT);
+								 H5Utils::filter_values(values, datasetInfo._selectedDimensionsLUT);
 								 propertyMap[label] = QVariantList(values.cbegin(), values.cend());
 								 if (datasetClass == H5T_ENUM)
 								 {
@@ -237,7 +227,7 @@ static void LoadProperties(H5::Group &group, H5AD::LoaderInfo &datasetInfo)
 						 {
 							 if (values.size())
 							 {
-								 filterValues(values, datasetInfo._selectedDimensionsLUT);
+								 H5Utils::filter_values(values, datasetInfo._selectedDimensionsLUT);
 								 propertyMap[label] = labels;
 							 }
 						 }
@@ -252,7 +242,7 @@ static void LoadProperties(H5::Group &group, H5AD::LoaderInfo &datasetInfo)
 				 H5Utils::read_vector_string(dataSet, values);
 				 if (values.size())
 				 {
-					 filterValues(values, datasetInfo._selectedDimensionsLUT);
+					 H5Utils::filter_values(values, datasetInfo._selectedDimensionsLUT);
 					 propertyMap[objectName1.c_str()] = QVariantList(values.cbegin(), values.cend());
 				 }
 			 }
@@ -293,7 +283,7 @@ static void LoadProperties(H5::Group &group, H5AD::LoaderInfo &datasetInfo)
 					 }
 					 if (values.size())
 					 {
-						 filterValues(values, datasetInfo._selectedDimensionsLUT);
+						 H5Utils::filter_values(values, datasetInfo._selectedDimensionsLUT);
 						 propertyMap[objectName1.c_str()] = values;
 					 }
 				 }
@@ -301,12 +291,52 @@ static void LoadProperties(H5::Group &group, H5AD::LoaderInfo &datasetInfo)
 		 }
 	 }
 	 
-	 datasetInfo._pointsDataset->setProperty(name, propertyMap);
-	
+	 return name;
  }
 
+void HDF5_AD_Loader::setMemoryBudget(std::uint64_t bytes)
+{
+	_memoryBudget = bytes;
+}
+
+void HDF5_AD_Loader::setFileAccessProfile(H5Utils::FileAccessProfile profile)
+{
+	_fileAccessProfile = profile;
+}
+
+QString HDF5_AD_Loader::estimateMemory(int storageType) const
+{
+	try
+	{
+		H5Utils::MatrixLayout layout;
+		int elementType = storageType;
+		if (_file->childObjType("X") == H5O_TYPE_GROUP)
+		{
+			H5::Group group = _file->openGroup("X");
+			if (!H5Utils::read_sparse_layout(group, _dimensionNames.size(), layout))
+				return QString();
+			if (elementType < 0)
+				elementType = H5Utils::native_storage_type(group.openDataSet("data"));
+		}
+		else
+		{
+			H5::DataSet dataset = _file->openDataSet("X");
+			if (!H5Utils::read_dense_layout(dataset, layout))
+				return QString();
+			if (elementType < 0)
+				elementType = H5Utils::native_storage_type(dataset);
+		}
+		return QString::fromStdString(H5Utils::LoadPlanner(layout, _memoryBudget).report(elementType));
+	}
+	catch (const H5::Exception&)
+	{
+		return QString();
+	}
+}
+
 bool HDF5_AD_Loader::load(int storageType)
 {
+	MV_H5_TRACE_SCOPE("HDF5_AD_Loader::load");
 	
 	if (_file == nullptr)
 		return false;
@@ -333,6 +363,7 @@ bool HDF5_AD_Loader::load(int storageType)
 
 		QString pointDatasetLabel;
 		{
+			H5Utils::LoadReport::Phase phase(_report.get(), "dialogs");
 			QDialog dialog(nullptr);
 			QGridLayout* layout = new QGridLayout;
 			QLineEdit* lineEdit = new QLineEdit(QFileInfo(_fileName).baseName());
@@ -343,16 +374,22 @@ bool HDF5_AD_Loader::load(int storageType)
 			listView->setModel(&model);
 			listView->setSelectionMode(QListView::MultiSelection);
 			layout->addWidget(listView, 2, 0, 1, 2);
+			QString memoryReport = estimateMemory(storageType);
+			if (!memoryReport.isEmpty())
+				layout->addWidget(new QLabel(memoryReport), 3, 0, 1, 2);
 			auto* buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok);
 			buttonBox->connect(buttonBox, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
-			layout->addWidget(buttonBox, 3, 0, 1, 2);
+			layout->addWidget(buttonBox, 4, 0, 1, 2);
 
 			dialog.setLayout(layout);
 
 			auto result = dialog.exec();
 
 			if (result == 0)
+			{
+				_prefetcher.reset();
 				return false;
+			}
 
 			pointDatasetLabel = lineEdit->displayText();
 
@@ -364,6 +401,8 @@ bool HDF5_AD_Loader::load(int storageType)
 			}
 		}
 		
+		H5Utils::ReadTask readTask(_fileName);
+
 		// create and setup the pointsDataset here since we have access to _core, _filename and storageType here.
 		
 		Dataset<Points> pointsDataset = H5Utils::createPointsDataset(_core, false,  pointDatasetLabel);
@@ -375,19 +414,37 @@ bool HDF5_AD_Loader::load(int storageType)
 		loaderInfo._pointsDataset = pointsDataset;
 		loaderInfo._originalDimensionNames = _dimensionNames;
 		loaderInfo._sampleNames = QVariantList(_sampleNames.cbegin(), _sampleNames.cend());
+		loaderInfo._memoryBudget = _memoryBudget;
+		loaderInfo._report = _report.get();
 
-		if (!H5AD::load_X(_file, loaderInfo, storageType))
+		// X is prefetched until the dimensions are picked in the dialog of load_X. It is stopped then, so that only one
+		// prefetcher holds the page cache against the memory budget at a time, and the metadata is prefetched while X
+		// is read and scattered
+		auto stopPrefetcher = [](std::unique_ptr<H5Utils::Prefetcher>& prefetcher, const char* what)
 		{
-			mv::data().removeDataset(pointsDataset);
-			_dimensionNames.clear();
-			_sampleNames.clear();
-			return false;
-		}
-		
-		//_dimensionNames = pointsDataset->getDimensionNames();
-		
-		// now we look for nice to have annotation for the observations in the main data matrix
-		try
+			if (!prefetcher)
+				return;
+			const bool finished = prefetcher->finished();
+			prefetcher->cancel();
+			std::cout << "H5AD Loader: " << prefetcher->bytesRead() << " bytes of " << what << " were prefetched" << (finished ? "" : " (cancelled)") << std::endl;
+			prefetcher.reset();
+		};
+		std::vector<std::string> metadataObjects(objectsToProcess.cbegin(), objectsToProcess.cend());
+		if (objectNameIdx.count("var"))
+			metadataObjects.push_back("var");
+		std::unique_ptr<H5Utils::Prefetcher> metadataPrefetcher;
+		loaderInfo._dimensionsPicked = [&]()
+		{
+			stopPrefetcher(_prefetcher, "X");
+			metadataPrefetcher = H5Utils::prefetch_objects(*_file, metadataObjects, _memoryBudget);
+		};
+
+		// obs, obsm and var are read and grouped on the metadata lane while the sparse X is scattered, and added to
+		// the points afterwards. Without a scatter, for a dense, streamed, backed or cached X, they are read after it
+		std::vector<std::shared_ptr<H5AD::MetaData>> metadata;
+		QString varName;
+		QVariantMap varProperties;
+		H5AD::MetaDataLane metadataLane([&](std::size_t nrOfRows)
 		{
 			auto nrOfObjects = _file->getNumObjs();
 			for (hsize_t fo = 0; fo < nrOfObjects; ++fo)
@@ -401,12 +458,12 @@ bool HDF5_AD_Loader::load(int storageType)
 					if (objectType1 == H5G_DATASET)
 					{
 						H5::DataSet h5Dataset = _file->openDataSet(objectName1);
-						H5AD::LoadSampleNamesAndMetaDataFloat(h5Dataset, loaderInfo);
+						metadata.push_back(H5AD::ReadMetaData(h5Dataset, nrOfRows));
 					}
 					else if (objectType1 == H5G_GROUP)
 					{
 						H5::Group h5Group = _file->openGroup(objectName1);
-						H5AD::LoadSampleNamesAndMetaDataFloat(h5Group, loaderInfo);
+						metadata.push_back(H5AD::ReadMetaData(h5Group, nrOfRows));
 					}
 				}
 			}
@@ -419,19 +476,53 @@ bool HDF5_AD_Loader::load(int storageType)
 				if (objectType1 == H5G_DATASET)
 				{
 					H5::DataSet h5Dataset = _file->openDataSet("var");
-					LoadProperties(h5Dataset, loaderInfo);
-
+					varName = ReadProperties(h5Dataset, loaderInfo, varProperties);
 				}
 				else if (objectType1 == H5G_GROUP)
 				{
 					H5::Group h5Group = _file->openGroup("var");
-					LoadProperties(h5Group, loaderInfo);
+					varName = ReadProperties(h5Group, loaderInfo, varProperties);
 				}
 			}
+		});
+		loaderInfo._metadataLane = &metadataLane;
+
+		const bool loaded = H5AD::load_X(_file, loaderInfo, storageType);
+		stopPrefetcher(_prefetcher, "X"); // when load_X did not get to the dimensions
+		if (!loaded)
+		{
+			stopPrefetcher(metadataPrefetcher, "metadata");
+			mv::data().removeDataset(pointsDataset);
+			_dimensionNames.clear();
+			_sampleNames.clear();
+			return false;
+		}
+		
+		//_dimensionNames = pointsDataset->getDimensionNames();
+		
+		// now we look for nice to have annotation for the observations in the main data matrix
+		try
+		{
+			H5Utils::LoadReport::Phase phase(_report.get(), "metadata");
+			metadataLane.finish(pointsDataset->getNumPoints());
+			stopPrefetcher(metadataPrefetcher, "metadata");
+			for (auto& metaData : metadata)
+			{
+				H5AD::AddMetaData(*metaData, loaderInfo);
+				metaData.reset();
+			}
+			if (!varName.isEmpty())
+				pointsDataset->setProperty(varName, varProperties);
 
 			events().notifyDatasetDataChanged(pointsDataset);
 
 			pointsDataset->getDataHierarchyItem().setVisible(true);
+			phase.end();
+			if (_report)
+			{
+				_report->setFileStatistics(*_file);
+				_report->finish(pointsDataset);
+			}
 			return true;
 
 		}
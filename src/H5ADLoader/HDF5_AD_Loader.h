@@ -2,11 +2,15 @@
 
 #include <QString>
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "H5Utils.h"
+#include "FileAccess.h"
+#include "LoadReport.h"
+#include "Prefetcher.h"
 
 namespace mv
 {
@@ -21,10 +25,20 @@ public:
 	bool open(const QString &);
 	const std::vector<QString> &getDimensionNames() const;
 	bool load(int storageType);
+
+	// Memory budget in bytes used to choose how X is stored, 0 uses the default of H5Utils::LoadPlanner.
+	void setMemoryBudget(std::uint64_t bytes);
+
+	// How open() accesses the file, see H5Utils::FileAccessProfile.
+	void setFileAccessProfile(H5Utils::FileAccessProfile profile);
 	
 private:
+	// Dry-run memory estimates for loading X, empty if its layout cannot be read.
+	QString estimateMemory(int storageType) const;
+
+
 	mv::CoreInterface* _core = nullptr;
-	std::unique_ptr<H5::H5File> _file = nullptr;
+	std::shared_ptr<H5::H5File> _file = nullptr; // shared with the backed matrix of an X that does not fit in memory
 	std::vector<QString> _dimensionNames = {};
 	std::vector<QString> _sampleNames = {};
 
@@ -32,4 +46,9 @@ private:
 
 	std::string _var_indexName = {};
 	std::string _obs_indexName = {};
+
+	std::uint64_t _memoryBudget = 0;
+	H5Utils::FileAccessProfile _fileAccessProfile = H5Utils::FileAccessProfile::Automatic;
+	std::unique_ptr<H5Utils::Prefetcher> _prefetcher; // started by open(), stopped when X is about to be loaded or the load is aborted
+	std::unique_ptr<H5Utils::LoadReport> _report; // created by open(), finished on the loaded dataset
 };
\ No newline at end of file
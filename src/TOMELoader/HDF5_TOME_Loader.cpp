@@ -8,14 +8,23 @@
 #include <QCheckBox>
 #include <QLabel>
 #include <QLineEdit>
+#include <QMessageBox>
 
 #include "H5Utils.h"
+#include "ColumnPipeline.h"
 #include "DataContainerInterface.h"
+#include "FileAccess.h"
+#include "LoadPlanner.h"
+#include "LoadReport.h"
+#include "MatrixCache.h"
+#include "MatrixDecoder.h"
 
 #include "ClusterData/Cluster.h"
 #include "ClusterData/ClusterData.h"
 
 #include <iostream>
+#include <algorithm>
+#include <limits>
 
 using namespace mv;
 
@@ -58,7 +67,51 @@ namespace TOME
 	}
 	enum { Exons = 1, Introns = 2, Exons_T, Introns_T };
 
-	static void LoadData(H5::Group &group, std::shared_ptr<DataContainerInterface>&rawData, TRANSFORM::Type transformType, bool normalize_and_cpm, int test)
+	// The loaded values are the sum of the exon and intron counts, so "Original" keeps float and the optimized types are
+	// based on the range of that sum, from the statistics gathered while reading the exon and intron values.
+	static int ResolveStorageType(int storageType, bool values_transformed, const H5Utils::VectorStatistics& exonStatistics, const H5Utils::VectorStatistics& intronStatistics)
+	{
+		if (storageType >= 0)
+			return storageType;
+		if ((storageType == -1) || values_transformed)
+			return (int)PointData::ElementTypeSpecifier::float32;
+
+		H5Utils::VectorStatistics sumStatistics;
+		sumStatistics.size = exonStatistics.size + intronStatistics.size;
+		sumStatistics.min = std::min(exonStatistics.min, 0.0) + std::min(intronStatistics.min, 0.0);
+		sumStatistics.max = std::max(exonStatistics.max, 0.0) + std::max(intronStatistics.max, 0.0);
+		sumStatistics.only_integers = exonStatistics.only_integers && intronStatistics.only_integers;
+		return H5Utils::optimized_storage_type(sumStatistics, storageType == -2);
+	}
+
+	static void SetElementType(std::shared_ptr<DataContainerInterface>& rawData, int elementType)
+	{
+		H5Utils::visit_storage_type(elementType, [&rawData](auto elementTypeIdentity)
+			{
+				rawData->points()->setDataElementType<typename decltype(elementTypeIdentity)::type>();
+			});
+	}
+
+	// Dry-run of the dense matrix against the memory budget, asks whether to continue if it does not fit.
+	static bool ConfirmMemoryBudget(H5::Group& exon, bool transposed, int elementType, std::uint64_t memoryBudget)
+	{
+		std::vector<std::int32_t> dims;
+		H5Utils::read_vector(exon, "dims", &dims);
+		H5Utils::MatrixLayout layout;
+		if ((dims.size() != 2) || !H5Utils::read_sparse_layout(exon, dims[0], layout, "x", "i", "p"))
+			return true;
+		if (!transposed)
+			std::swap(layout.rows, layout.columns); // exon/intron are stored per gene
+
+		const H5Utils::LoadPlanner planner(layout, memoryBudget);
+		const QString report = QString::fromStdString(planner.report(elementType));
+		std::cout << report.toStdString() << std::endl;
+		if (planner.estimate(H5Utils::LoadStrategy::Dense, elementType).fitsBudget)
+			return true;
+		return QMessageBox::question(nullptr, "TOME Loader", report + "\n\nThe data does not fit in the memory budget. Continue loading?") == QMessageBox::Yes;
+	}
+
+	static bool LoadData(H5::Group &group, std::shared_ptr<DataContainerInterface>&rawData, TRANSFORM::Type transformType, bool normalize_and_cpm, int storageType, std::uint64_t memoryBudget, H5Utils::LoadReport* report)
 	{
 #ifndef HIDE_CONSOLE
 		std::cout << "Loading Data" << std::endl;
@@ -87,6 +140,14 @@ namespace TOME
 		}
 
 		bool data_read = true;
+		std::uint64_t nnz = 0; // exon and intron values together
+		const bool values_transformed = (transformType.first != TRANSFORM::NONE) || normalize_and_cpm;
+		// the optimized types need the range of the exon and the intron values before the exon values are scattered, it
+		// is gathered while they are read, so the intron values are read ahead
+		const bool optimized = (storageType < -1) && !values_transformed;
+		H5Utils::VectorStatistics exonStatistics;
+		H5Utils::VectorStatistics intronStatistics;
+		std::vector<float> intron_x;
 		
 		if ((transposed_exon_available < nrOfGroupObjects) && (transposed_intron_available < nrOfGroupObjects))
 		{
@@ -97,22 +158,57 @@ namespace TOME
 				H5::Group exon_or_intron = (step == 0) ? group.openGroup("t_exon") : group.openGroup("t_intron");
 
 				std::vector<std::int32_t> vector_dims;
-				std::vector<uint64_t> vector_i;
-				std::vector<uint32_t> vector_p;
+				H5Utils::CompressedMatrix matrix;
 				std::vector<float> vector_x;
+				H5Utils::LoadReport::Phase phase(report, "read");
 				H5Utils::read_vector(exon_or_intron, "dims", &vector_dims);
-				H5Utils::read_vector(exon_or_intron, "i", &vector_i);
-				H5Utils::read_vector(exon_or_intron, "p", &vector_p);
-				H5Utils::read_vector(exon_or_intron, "x", &vector_x);
+				if ((step == 1) && optimized)
+					vector_x = std::move(intron_x);
+				else
+					H5Utils::read_vector_values(exon_or_intron, "x", &vector_x, optimized ? &exonStatistics : nullptr);
+				// t_exon/t_intron are stored per sample, so i holds gene (dims[0]) indices
+				if ((vector_dims.size() != 2) || !H5Utils::read_compressed_matrix(exon_or_intron, vector_dims[1], vector_dims[0], false, matrix, "x", "i", "p"))
+				{
+					std::cout << "invalid sparse matrix in " << ((step == 0) ? "t_exon" : "t_intron") << "\n";
+					data_read = false;
+					break;
+				}
 
+				nnz += vector_x.size();
 				if (step == 0)
 				{
-					
-					rawData->resize(vector_dims[1], vector_dims[0]);
-					rawData->set_sparse_row_data(vector_i, vector_p, vector_x, TRANSFORM::None());
+					if (optimized)
+					{
+						H5::Group intron = group.openGroup("t_intron");
+						H5Utils::read_vector_values(intron, "x", &intron_x, &intronStatistics);
+					}
+					phase.next("structure scan");
+					const int elementType = ResolveStorageType(storageType, values_transformed, exonStatistics, intronStatistics);
+					if (!ConfirmMemoryBudget(exon_or_intron, true, elementType, memoryBudget))
+					{
+						data_read = false;
+						break;
+					}
+					if (report)
+					{
+						report->set("storageType", H5Utils::element_type_name(elementType));
+						report->set("strategy", H5Utils::strategy_name(H5Utils::LoadStrategy::Dense));
+					}
+					phase.next("scatter");
+					SetElementType(rawData, elementType);
+					if (!rawData->resize(vector_dims[1], vector_dims[0]))
+					{
+						std::cout << "not enough memory for " << vector_dims[0] << " x " << vector_dims[1] << " values\n";
+						data_read = false;
+						break;
+					}
+					rawData->set_sparse_data(matrix, vector_x, TRANSFORM::None());
 				}
 				else
-					rawData->increase_sparse_row_data(vector_i, vector_p, vector_x, TRANSFORM::None());
+				{
+					phase.next("scatter");
+					rawData->set_sparse_data(matrix, vector_x, TRANSFORM::None(), true);
+				}
 			}
 		}
 		else if ((exon_available < nrOfGroupObjects) && (intron_available < nrOfGroupObjects))
@@ -124,32 +220,72 @@ namespace TOME
 				H5::Group exon_or_intron = (step == 0) ? group.openGroup("exon") : group.openGroup("intron");
 
 				std::vector<std::int32_t> vector_dims;
-				std::vector<uint64_t> vector_i;
-				std::vector<uint32_t> vector_p;
+				H5Utils::CompressedMatrix matrix;
 				std::vector<float> vector_x;
+				H5Utils::LoadReport::Phase phase(report, "read");
 				H5Utils::read_vector(exon_or_intron, "dims", &vector_dims);
 				
-				H5Utils::read_vector(exon_or_intron, "i", &vector_i);
-				
-				H5Utils::read_vector(exon_or_intron, "p", &vector_p);
+				if ((step == 1) && optimized)
+					vector_x = std::move(intron_x);
+				else
+					H5Utils::read_vector_values(exon_or_intron, "x", &vector_x, optimized ? &exonStatistics : nullptr);
 				
-				H5Utils::read_vector(exon_or_intron, "x", &vector_x);
+				// exon/intron are stored per gene, so i holds sample (dims[0]) indices
+				if ((vector_dims.size() != 2) || !H5Utils::read_compressed_matrix(exon_or_intron, vector_dims[0], vector_dims[1], true, matrix, "x", "i", "p"))
+				{
+					std::cout << "invalid sparse matrix in " << ((step == 0) ? "exon" : "intron") << "\n";
+					data_read = false;
+					break;
+				}
 				
+				nnz += vector_x.size();
 				if (step == 0)
 				{
-					
-					rawData->resize(vector_dims[0], vector_dims[1]);
-					rawData->set_sparse_column_data(vector_i, vector_p, vector_x, TRANSFORM::None());
+					if (optimized)
+					{
+						H5::Group intron = group.openGroup("intron");
+						H5Utils::read_vector_values(intron, "x", &intron_x, &intronStatistics);
+					}
+					phase.next("structure scan");
+					const int elementType = ResolveStorageType(storageType, values_transformed, exonStatistics, intronStatistics);
+					if (!ConfirmMemoryBudget(exon_or_intron, false, elementType, memoryBudget))
+					{
+						data_read = false;
+						break;
+					}
+					if (report)
+					{
+						report->set("storageType", H5Utils::element_type_name(elementType));
+						report->set("strategy", H5Utils::strategy_name(H5Utils::LoadStrategy::Dense));
+					}
+					phase.next("scatter");
+					SetElementType(rawData, elementType);
+					if (!rawData->resize(vector_dims[0], vector_dims[1]))
+					{
+						std::cout << "not enough memory for " << vector_dims[0] << " x " << vector_dims[1] << " values\n";
+						data_read = false;
+						break;
+					}
+					rawData->set_sparse_data(matrix, vector_x, TRANSFORM::None());
 				}
 				else
-					rawData->increase_sparse_column_data(vector_i, vector_p, vector_x, TRANSFORM::None());
+				{
+					phase.next("scatter");
+					rawData->set_sparse_data(matrix, vector_x, TRANSFORM::None(), true);
+				}
 			}
 		}
 		else
 			data_read = false;
 
+		if (report)
+			report->set("nnz", static_cast<double>(nnz));
 		if (data_read)
+		{
+			H5Utils::LoadReport::Phase phase(report, "transform");
 			rawData->applyTransform(transformType, normalize_and_cpm);
+		}
+		return data_read;
 	}
 
 	void LoadGeneNames(H5::DataSet &dataset, Dataset<Points> pointsDataset)
@@ -178,6 +314,130 @@ namespace TOME
 		
 	}
 
+	// The labels of anno/<label>_color with their colors, grouped into clusters or kept as numerical metadata.
+	struct AnnoColumn
+	{
+		std::string label;
+		std::vector<QString> colorVector;
+		bool numericalLabels = false;
+		std::vector<QString> labelVector;
+		std::vector<double> numericalLabelVector;
+
+		bool clusters = false; // add indices as clusters, otherwise numerical labels are numerical metadata
+		std::map<QString, std::vector<unsigned>> indices;
+		std::map<QString, QColor> colors; // empty for string labels, they get the default cluster colors
+	};
+
+	bool ReadAnnoColumn(H5::Group& anno, const std::string& name, AnnoColumn& column)
+	{
+		const std::size_t found_pos = name.rfind("_color");
+		column.label.assign(name.begin(), name.begin() + found_pos);
+		H5Utils::read_vector_string(anno.openDataSet(name), column.colorVector);
+		std::string labelDatasetString = column.label + "_label";
+		if (!anno.exists(labelDatasetString))
+		{
+			std::cout << labelDatasetString << " expected but not found" << std::endl;
+			if (anno.exists(column.label))
+			{
+				labelDatasetString = column.label;
+				std::cout << labelDatasetString << " found instead" << std::endl;
+			}
+			else
+				labelDatasetString.clear();
+		}
+
+		if (labelDatasetString.empty())
+			return false;
+		H5::DataSet labelDataSet = anno.openDataSet(labelDatasetString);
+		if (labelDataSet.getDataType().getClass() == H5T_STRING)
+			return H5Utils::read_vector_string(labelDataSet, column.labelVector);
+
+		column.numericalLabels = true;
+		return H5Utils::read_vector(anno, column.label + "_label", &column.numericalLabelVector);
+	}
+
+	// Thread safe, does not touch any dataset.
+	void GroupAnnoColumn(AnnoColumn& column)
+	{
+		const auto& colorVector = column.colorVector;
+		if (!column.numericalLabels)
+		{
+			const auto& labelVector = column.labelVector;
+			std::map<QString, QColor> colors;
+			bool all_ok = true;
+			for (std::size_t i = 0; i < labelVector.size(); ++i)
+			{
+				QString current_label = labelVector[i];
+				QColor current_color = colorVector[i];
+				column.indices[current_label].push_back(i);
+				if (colors.find(current_label) == colors.cend())
+				{
+					colors[current_label] = current_color;
+				}
+				else
+				{
+					all_ok = false;
+					assert(colors[current_label] == current_color);
+				}
+			}
+			column.clusters = all_ok;
+			return;
+		}
+
+		const auto& labelVector = column.numericalLabelVector;
+		std::map<double, std::vector<unsigned>> indices;
+		std::map<double, QColor> colors;
+		bool all_ok = true;
+		for (std::size_t i = 0; i < labelVector.size(); ++i)
+		{
+			auto current_label = labelVector[i];
+			indices[current_label].push_back(i);
+			QColor current_color = colorVector[i];
+			if (colors.find(current_label) == colors.cend())
+			{
+				colors[current_label] = current_color;
+			}
+			else
+			{
+				all_ok = false;
+				assert(colors[current_label] == current_color);
+			}
+		}
+		std::size_t threshold = 0.75 * labelVector.size();
+		if (all_ok && (indices.size() < threshold))
+		{
+			int precision = 10;
+			bool precision_ok = true;
+			do
+			{
+				std::map<QString, std::vector<unsigned>> indicesS;
+				std::map<QString, QColor> colorsS;
+				precision_ok = true;
+				for (auto it = indices.cbegin(); it != indices.cend(); ++it)
+				{
+					QString x = QString::number(it->first, 'f', precision);
+					indicesS[x] = it->second;
+					if (colorsS.find(x) == colorsS.cend())
+					{
+						colorsS[x] = colors[it->first];
+					}
+					else
+					{
+						precision_ok = false;
+						++precision;
+						std::cout << "increasing precision to " << precision << std::endl;
+					}
+				}
+				if (precision_ok)
+				{
+					column.indices = std::move(indicesS);
+					column.colors = std::move(colorsS);
+					column.clusters = true;
+				}
+			} while (precision_ok == false);
+		}
+	}
+
 	bool LoadSampleMeta(H5::Group &group, Dataset<Points> points, mv::CoreInterface* _core)
 	{
 #ifndef HIDE_CONSOLE
@@ -203,131 +463,30 @@ namespace TOME
 				{
 					H5::Group anno = group.openGroup(objectName2);
 					hsize_t nrOfAnnoObjects = anno.getNumObjs();
+					std::vector<std::string> colorNames;
 					for (auto ao = 0; ao < nrOfAnnoObjects; ++ao)
 					{
 						std::string name = anno.getObjnameByIdx(ao);
-						std::size_t found_pos = name.rfind("_color");
-						if (found_pos < name.length())
-						{
-							std::string label(name.begin(), name.begin() + found_pos);
-							std::vector<QString> colorVector;
-							H5Utils::read_vector_string(anno.openDataSet(name), colorVector);
-							std::string labelDatasetString = label + "_label";
-							if (!anno.exists(labelDatasetString))
-							{
-								std::cout << labelDatasetString << " expected but not found" << std::endl;
-								if (anno.exists(label))
-								{
-									labelDatasetString = label;
-									std::cout << labelDatasetString << " found instead" << std::endl;
-								}
-								else
-									labelDatasetString.clear();
-							}
-
-							if (labelDatasetString.empty())
-								continue;
-							H5::DataSet labelDataSet = anno.openDataSet(labelDatasetString);
-							std::vector<QString> labelVector;
+						if (name.rfind("_color") < name.length())
+							colorNames.push_back(name);
+					}
 
-							auto labelDataSetDataType = labelDataSet.getDataType();
-							bool numericalValues = false;
-							if (labelDataSetDataType.getClass() == H5T_STRING)
+					// the label datasets are read one after the other, grouped in parallel and added in order
+					H5Utils::process_columns<AnnoColumn>(colorNames.size(),
+						[&anno, &colorNames](std::size_t c, AnnoColumn& column) { return ReadAnnoColumn(anno, colorNames[c], column); },
+						[](AnnoColumn& column) { GroupAnnoColumn(column); },
+						[&](std::size_t, AnnoColumn& column)
+						{
+							if (column.clusters)
 							{
-								
-								if(H5Utils::read_vector_string(labelDataSet, labelVector))
-								{
-									std::map<QString, std::vector<unsigned>> indices;
-									std::map<QString, QColor> colors;
-									bool all_ok = true;
-									for (std::size_t i = 0; i < labelVector.size(); ++i)
-									{
-										QString current_label = labelVector[i];
-										QColor current_color = colorVector[i];
-										indices[current_label].push_back(i);
-										if(colors.find(current_label) == colors.cend())
-										{
-											colors[current_label] = current_color;
-										}
-										else
-										{
-											all_ok = false;
-											assert(colors[current_label] == current_color);
-										}
-									}
-
-									if(all_ok)
-									{
-										H5Utils::addClusterMetaData(indices, label.c_str(), points);
-									}
-								}
+								H5Utils::addClusterMetaData(column.indices, column.label.c_str(), points, column.colors);
 							}
-							else
+							else if (column.numericalLabels)
 							{
-								std::vector<double> labelVector;
-								if(H5Utils::read_vector(anno, label + "_label", &labelVector))
-								{
-									std::map<double, std::vector<unsigned>> indices;
-									std::map<double, QColor> colors;
-									bool all_ok = true;
-									for (std::size_t i = 0; i < labelVector.size(); ++i)
-									{
-										auto current_label = labelVector[i];//QString::number(labelVector[i],'f',12);
-										indices[current_label].push_back(i);
-										QColor current_color = colorVector[i];
-										if (colors.find(current_label) == colors.cend())
-										{
-											colors[current_label] = current_color;
-										}
-										else
-										{
-											all_ok = false;
-											assert(colors[current_label] == current_color);
-										}
-									}
-									std::size_t threshold = 0.75 * labelVector.size();
-									if (all_ok && (indices.size() < threshold))
-									{
-										
-										int precision = 10;
-										bool precision_ok = true;
-										do
-										{
-											std::map<QString, std::vector<unsigned>> indicesS;
-											std::map<QString, QColor> colorsS;
-											precision_ok = true;
-											for (auto it = indices.cbegin(); it != indices.cend(); ++it)
-											{
-												QString x = QString::number(it->first, 'f', precision);
-												indicesS[x] = it->second;
-												if (colorsS.find(x) == colorsS.cend())
-												{
-													colorsS[x] = colors[it->first];
-												}
-												else
-												{
-													precision_ok = false;
-													++precision;
-													std::cout << "increasing precision to " << precision << std::endl;
-												}
-											}
-											if (precision_ok)
-											{
-												H5Utils::addClusterMetaData(indicesS, label.c_str(), points, colorsS);
-											}
-										} while (precision_ok == false);
-									}
-									else
-									{
-										numericalMetaData.insert(numericalMetaData.end(), labelVector.cbegin(), labelVector.cend());
-										numericalMetaDataDimensionNames.push_back(label.c_str());
-									}
-									
-									numericalValues = true;
-								}
+								numericalMetaData.insert(numericalMetaData.end(), column.numericalLabelVector.cbegin(), column.numericalLabelVector.cend());
+								numericalMetaDataDimensionNames.push_back(column.label.c_str());
 							}
-						}
-					}
+						});
 				}
 			}
 			H5Utils::addNumericalMetaData(numericalMetaData, numericalMetaDataDimensionNames, true, points);
@@ -346,8 +505,20 @@ HDF5_TOME_Loader::HDF5_TOME_Loader(mv::CoreInterface *core)
 	_core = core;
 }
 
-bool HDF5_TOME_Loader::open(const QString &fileName, TRANSFORM::Type conversionIndex, bool normalize)
+void HDF5_TOME_Loader::setMemoryBudget(std::uint64_t bytes)
+{
+	_memoryBudget = bytes;
+}
+
+void HDF5_TOME_Loader::setFileAccessProfile(H5Utils::FileAccessProfile profile)
 {
+	_fileAccessProfile = profile;
+}
+
+bool HDF5_TOME_Loader::open(const QString &fileName, TRANSFORM::Type conversionIndex, bool normalize, int storageType)
+{
+	MV_H5_TRACE_SCOPE("HDF5_TOME_Loader::open");
+	Dataset<Points> points;
 	try
 	{
 		bool ok;
@@ -359,56 +530,84 @@ bool HDF5_TOME_Loader::open(const QString &fileName, TRANSFORM::Type conversionI
 			return false;
 		}
 
-		auto points = mv::data().createDataset<Points>("Points", dataSetName);
+		H5Utils::ReadTask readTask(fileName);
+		points = mv::data().createDataset<Points>("Points", dataSetName);
 
 		if (!points.isValid())
 			return false;
 
 		std::shared_ptr<DataContainerInterface> rawData(new DataContainerInterface(points.get<Points>()));
 
-		H5::H5File file(fileName.toLatin1().constData(), H5F_ACC_RDONLY);
+		H5Utils::LoadReport report("TOME", fileName);
+		std::unique_ptr<H5::H5File> file;
+		{
+			H5Utils::LoadReport::Phase phase(&report, "open");
+			file = H5Utils::open_file(fileName, _fileAccessProfile, _memoryBudget);
+		}
 
-		auto nrOfObjects = file.getNumObjs();
+		auto nrOfObjects = file->getNumObjs();
 
-		
+		const QString cacheKey = H5Utils::matrix_cache_key(fileName, QString("tome storageType=%1 transform=%2,%3 normalize=%4").arg(storageType).arg(conversionIndex.first).arg(conversionIndex.second).arg(normalize));
+		bool storeInCache = false;
 
 		// first read mandatory stuff
 		
 		for (auto fo = 0; fo < nrOfObjects; ++fo)
 		{
-			std::string objectName1 = file.getObjnameByIdx(fo);
+			std::string objectName1 = file->getObjnameByIdx(fo);
 
-			H5G_obj_t objectType1 = file.getObjTypeByIdx(fo);
+			H5G_obj_t objectType1 = file->getObjTypeByIdx(fo);
 			if (objectType1 == H5G_GROUP)
 			{
 
 				if (objectName1 == "data")
 				{
-					H5::Group group = file.openGroup(objectName1);
-					TOME::LoadData(group, rawData, conversionIndex, normalize,0);
+					H5::Group group = file->openGroup(objectName1);
+					{
+						H5Utils::LoadReport::Phase phase(&report, "matrix cache");
+						const bool cacheHit = H5Utils::load_cached_matrix(cacheKey, points);
+						report.set("cacheHit", cacheHit);
+						if (cacheHit)
+							continue;
+					}
+					if (!TOME::LoadData(group, rawData, conversionIndex, normalize, storageType, _memoryBudget, &report))
+					{
+						mv::data().removeDataset(points);
+						return false;
+					}
+					storeInCache = true;
 				}
 				else if (objectName1 == "sample_meta")
 				{
-					H5::Group group = file.openGroup(objectName1);
+					H5Utils::LoadReport::Phase phase(&report, "metadata");
+					H5::Group group = file->openGroup(objectName1);
 					TOME::LoadSampleMeta(group, rawData->points(),_core);
 				}
 			}
 			else if (objectType1 == H5G_DATASET)
 			{
 
+				H5Utils::LoadReport::Phase phase(&report, "metadata");
 				if (objectName1 == "gene_names")
 				{
-					H5::DataSet dataset = file.openDataSet(objectName1);
+					H5::DataSet dataset = file->openDataSet(objectName1);
 					TOME::LoadGeneNames(dataset, rawData->points());
 				}
 				else if (objectName1 == "sample_names")
 				{
-					H5::DataSet dataset = file.openDataSet(objectName1);
+					H5::DataSet dataset = file->openDataSet(objectName1);
 					TOME::LoadSampleNames(dataset, rawData->points());
 				}
 			}
 		}
 
+		// stored once the gene and sample names are set
+		if (storeInCache)
+		{
+			H5Utils::LoadReport::Phase phase(&report, "matrix cache");
+			H5Utils::store_cached_matrix(cacheKey, points);
+		}
+
 // 		if (file.exists("projection"))
 // 		{
 // 			H5::Group group = file.openGroup("projection");
@@ -418,12 +617,18 @@ bool HDF5_TOME_Loader::open(const QString &fileName, TRANSFORM::Type conversionI
 
 		events().notifyDatasetAdded(points);
 
+		report.set("rows", static_cast<double>(points->getNumPoints()));
+		report.set("columns", static_cast<double>(points->getNumDimensions()));
+		report.setFileStatistics(*file);
+		report.finish(points);
 
 		return points.get();
 	}
 	catch (std::exception &e)
 	{
 		std::cout << "TOME Loader: " << e.what() << std::endl;
+		if (points.isValid())
+			mv::data().removeDataset(points);
 		return false;
 	}
 
@@ -2,6 +2,9 @@
 
 #include <QString>
 #include "DataTransform.h"
+#include "FileAccess.h"
+
+#include <cstdint>
 
 namespace mv
 {
@@ -13,10 +16,18 @@ class Points;
 class HDF5_TOME_Loader 
 {
 	mv::CoreInterface *_core;
+	std::uint64_t _memoryBudget = 0;
+	H5Utils::FileAccessProfile _fileAccessProfile = H5Utils::FileAccessProfile::Automatic;
 
 public:
 	HDF5_TOME_Loader(mv::CoreInterface *core);
 
-	bool open(const QString &fileName, TRANSFORM::Type conversionIndex, bool normalize);
+	bool open(const QString &fileName, TRANSFORM::Type conversionIndex, bool normalize, int storageType);
+
+	// Memory budget in bytes, 0 uses the default of H5Utils::LoadPlanner.
+	void setMemoryBudget(std::uint64_t bytes);
+
+	// How open() accesses the file, see H5Utils::FileAccessProfile.
+	void setFileAccessProfile(H5Utils::FileAccessProfile profile);
 
 };
\ No newline at end of file
@@ -4,6 +4,8 @@
 
 #include "DataTransform.h"
 #include "HDF5_TOME_Loader.h"
+#include "MatrixCache.h"
+#include "Trace.h"
 
 #include <QInputDialog>
 #include <QFileDialog>
@@ -16,6 +18,8 @@
 #include <QStringList>
 #include <QMessageBox>
 
+#include <algorithm>
+
 Q_PLUGIN_METADATA(IID "nl.lumc.TOMELoader")
 
 // =============================================================================
@@ -52,9 +56,15 @@ namespace
 	{
 		const QString conversionIndexKey("conversionIndex");
 		const QString transformValueKey("transformValue");
+		const QString fileAccessKey("fileAccess");
 		const QString fileNameKey("fileName");
+		const QString matrixCacheLimitKey("matrixCacheLimitMB"); // size limit of the matrix cache, 0 disables it
+		const QString memoryBudgetKey("memoryBudgetMB"); // 0 uses 80% of the available memory
 		const QString normalizeKey("normalize");
 		const QString selectedNameFilterKey("selectedNameFilter");
+		const QString shardedReadWorkersKey("shardedReadWorkers"); // worker processes for large reads, 0 reads in-process
+		const QString storageValueKey("storageValue");
+		const QString traceFileKey("traceFile"); // Chrome trace of the last load, only recorded in builds with MV_H5_ENABLE_TRACING
 	}
 
 }	// Unnamed namespace
@@ -92,6 +102,37 @@ void TOMELoader::loadData()
 
 	int rowCount = fileDialogLayout->rowCount();
 
+	QComboBox* storageTypeComboBox = new QComboBox;
+	QLabel* storageTypeLabel = new QLabel("Data Type");
+
+	storageTypeComboBox->addItem("Optimized (lossless)", -3);
+	storageTypeComboBox->addItem("Optimized (incl bfloat16)", -2);
+	storageTypeComboBox->addItem("Original", -1);
+	auto elementTypeNames = PointData::getElementTypeNames();
+	QStringList dataTypeList(elementTypeNames.cbegin(), elementTypeNames.cend());
+	for (int i = 0; i < dataTypeList.size(); ++i)
+	{
+		storageTypeComboBox->addItem(dataTypeList[i], i);
+	}
+
+	storageTypeComboBox->setCurrentIndex([this]
+		{
+			const auto value = getSetting(Keys::storageValueKey, 0);
+			return value.toInt();
+		}());
+
+	fileDialogLayout->addWidget(storageTypeLabel, rowCount, 0);
+	fileDialogLayout->addWidget(storageTypeComboBox, rowCount++, 1);
+
+	QComboBox* fileAccessComboBox = new QComboBox;
+	QLabel* fileAccessLabel = new QLabel("File Access");
+	for (auto profile : H5Utils::available_file_access_profiles())
+		fileAccessComboBox->addItem(H5Utils::file_access_profile_name(profile), static_cast<int>(profile));
+	fileAccessComboBox->setCurrentIndex(std::min(getSetting(Keys::fileAccessKey, 0).toInt(), fileAccessComboBox->count() - 1));
+
+	fileDialogLayout->addWidget(fileAccessLabel, rowCount, 0);
+	fileDialogLayout->addWidget(fileAccessComboBox, rowCount++, 1);
+
 	TRANSFORM::Control transform(fileDialogLayout);
 
 #ifdef USE_HDF5_TRANSFORM
@@ -164,6 +205,8 @@ void TOMELoader::loadData()
 		setSetting(Keys::transformValueKey, transform_setting.second);
 		setSetting(Keys::fileNameKey, firstFileName);
 		setSetting(Keys::normalizeKey, normalize);
+		setSetting(Keys::storageValueKey, storageTypeComboBox->currentIndex());
+		setSetting(Keys::fileAccessKey, fileAccessComboBox->currentIndex());
 		setSetting(Keys::selectedNameFilterKey, selectedNameFilter);
 		
 		if (selectedNameFilter == "TOME (*.tome)")
@@ -171,7 +214,13 @@ void TOMELoader::loadData()
 			for (const auto fileName : fileNames)
 			{
 				HDF5_TOME_Loader loader(_core);
-				loader.open(firstFileName, transform_setting, normalize);
+				H5Utils::set_sharded_read_workers(getSetting(Keys::shardedReadWorkersKey, 0).toUInt());
+				H5Utils::set_matrix_cache_limit(getSetting(Keys::matrixCacheLimitKey, 0).toULongLong() * 1024 * 1024);
+				H5Utils::set_trace_file(getSetting(Keys::traceFileKey, QString()).toString().toStdString());
+				loader.setMemoryBudget(getSetting(Keys::memoryBudgetKey, 0).toULongLong() * 1024 * 1024);
+				loader.setFileAccessProfile(static_cast<H5Utils::FileAccessProfile>(fileAccessComboBox->currentData().toInt()));
+				loader.open(firstFileName, transform_setting, normalize, storageTypeComboBox->currentData().toInt());
+				H5Utils::export_trace();
 			}
 		}
 		
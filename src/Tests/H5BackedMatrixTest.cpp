@@ -0,0 +1,171 @@
+/*
+* Checks H5Utils::BackedMatrix on the same matrix stored as csr and as dense X of two h5ad files: both serve the rows
+* the row block reader streams, selections and columns; a selection inside one block reads only that block and is
+* served from the cache the second time; the cache stays within its limit; the matrix keeps its file open.
+*
+* Usage: H5BackedMatrixTest <csr file> <dense file> <columns>
+*/
+
+#include "BackedMatrix.h"
+#include "RowBlockReader.h"
+
+#include <H5Cpp.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace local
+{
+	bool check(bool condition, const std::string& message)
+	{
+		if (!condition)
+			std::cout << "FAILED: " << message << std::endl;
+		return condition;
+	}
+
+	// Dense rows x columns values of the rows of a row block reader.
+	std::vector<float> read_all(const H5Utils::RowBlockReader& reader)
+	{
+		std::vector<float> result(reader.rows() * reader.columns(), 0.0f);
+		for (std::uint64_t b = 0; b < reader.blockCount(); ++b)
+		{
+			const H5Utils::RowBlock rowBlock = reader.block(b);
+			for (std::uint64_t row = 0; row < rowBlock.rows(); ++row)
+			{
+				for (std::uint64_t k = rowBlock.indptr[row]; k < rowBlock.indptr[row + 1]; ++k)
+					result[(rowBlock.firstRow + row) * reader.columns() + rowBlock.indices[k]] = rowBlock.values[k];
+			}
+		}
+		return result;
+	}
+
+	bool check_rows_and_columns(H5Utils::BackedMatrix& matrix, const std::vector<float>& reference, const std::string& name)
+	{
+		const std::uint64_t rows = matrix.rows();
+		const std::uint64_t columns = matrix.columns();
+		bool ok = true;
+
+		// unsorted, with a duplicate and one row past the end that reads as zeros
+		const std::vector<std::uint64_t> rowIndices = { rows - 1, 0, 17, rows / 2, 17, rows };
+		const std::vector<float> selection = matrix.readRows(rowIndices);
+		for (std::size_t i = 0; ok && (i < rowIndices.size()); ++i)
+		{
+			for (std::uint64_t c = 0; ok && (c < columns); ++c)
+			{
+				const float expected = (rowIndices[i] < rows) ? reference[rowIndices[i] * columns + c] : 0.0f;
+				ok = check(selection[i * columns + c] == expected, name + ": value of row " + std::to_string(rowIndices[i]) + ", column " + std::to_string(c));
+			}
+		}
+
+		const std::vector<std::uint64_t> columnIndices = { columns - 1, 3, 0, columns };
+		const std::vector<float> values = matrix.columns(columnIndices);
+		for (std::uint64_t row = 0; ok && (row < rows); ++row)
+		{
+			for (std::size_t c = 0; ok && (c < columnIndices.size()); ++c)
+			{
+				const float expected = (columnIndices[c] < columns) ? reference[row * columns + columnIndices[c]] : 0.0f;
+				ok = check(values[row * columnIndices.size() + c] == expected, name + ": value of column " + std::to_string(columnIndices[c]) + ", row " + std::to_string(row));
+			}
+		}
+		return ok;
+	}
+
+	bool check_cache(H5Utils::BackedMatrix& matrix)
+	{
+		matrix.setBlockRows(64);
+		bool ok = check(matrix.statistics().cachedBytes == 0, "setBlockRows clears the cache");
+
+		// rows of the third block only
+		const std::vector<std::uint64_t> rowIndices = { 130, 128, 191 };
+		const auto before = matrix.statistics();
+		matrix.readRows(rowIndices);
+		const auto once = matrix.statistics();
+		ok = check(once.blockReads == before.blockReads + 1, "a selection inside one block reads one block") && ok;
+		matrix.readRows(rowIndices);
+		const auto twice = matrix.statistics();
+		ok = check((twice.blockReads == once.blockReads) && (twice.cacheHits == once.cacheHits + 1), "the same selection is served from the cache") && ok;
+
+		const std::uint64_t blockBytes = matrix.block(2)->bytes();
+		const std::uint64_t limit = 3 * blockBytes;
+		matrix.setCacheLimit(limit);
+		std::uint64_t largestBlock = 0;
+		for (std::uint64_t b = 0; b < matrix.blockCount(); ++b)
+		{
+			largestBlock = std::max(largestBlock, matrix.block(b)->bytes());
+			ok = check(matrix.statistics().cachedBytes <= limit + largestBlock, "the cache stays within its limit after block " + std::to_string(b)) && ok;
+		}
+		const auto all = matrix.statistics();
+		matrix.block(0);
+		ok = check(matrix.statistics().blockReads == all.blockReads + 1, "the oldest block was evicted") && ok;
+
+		matrix.setCacheLimit(0);
+		matrix.block(1);
+		ok = check(matrix.statistics().cachedBytes == matrix.block(1)->bytes(), "the block read last is kept below the limit") && ok;
+		matrix.setCacheLimit(H5Utils::backed_matrix_cache_limit);
+		return ok;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc != 4)
+	{
+		std::cout << "Usage: H5BackedMatrixTest <csr file> <dense file> <columns>" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		H5::Exception::dontPrint();
+		const std::uint64_t columns = std::stoull(argv[3]);
+
+		std::vector<float> reference;
+		{
+			H5::H5File file(argv[1], H5F_ACC_RDONLY);
+			const H5Utils::RowBlockReader reader(file.openGroup("X"), columns);
+			if (!local::check(reader.valid(), "open the row block reader"))
+				return EXIT_FAILURE;
+			reference = local::read_all(reader);
+		}
+
+		// the matrices hold the only references to their files
+		auto sparseFile = std::make_shared<H5::H5File>(argv[1], H5F_ACC_RDONLY);
+		H5Utils::BackedMatrix sparse(sparseFile, sparseFile->openGroup("X"), columns);
+		sparseFile.reset();
+		auto denseFile = std::make_shared<H5::H5File>(argv[2], H5F_ACC_RDONLY);
+		H5Utils::BackedMatrix dense(denseFile, denseFile->openDataSet("X"));
+		denseFile.reset();
+
+		bool ok = local::check(sparse.valid() && sparse.sparse(), "open the sparse backed matrix");
+		ok = local::check(dense.valid() && !dense.sparse(), "open the dense backed matrix") && ok;
+		ok = ok && local::check((dense.rows() == sparse.rows()) && (dense.columns() == columns), "the dense and sparse matrices have the same shape");
+		ok = ok && local::check(sparse.rows() * columns == reference.size(), "the backed matrix has the rows of the reader");
+		if (!ok)
+			return EXIT_FAILURE;
+
+		ok = local::check_rows_and_columns(sparse, reference, "sparse");
+		ok = local::check_rows_and_columns(dense, reference, "dense") && ok;
+		ok = local::check_cache(sparse) && ok;
+		ok = local::check_cache(dense) && ok;
+		if (!ok)
+			return EXIT_FAILURE;
+	}
+	catch (const H5::Exception& e)
+	{
+		std::cout << "FAILED: HDF5 error " << e.getDetailMsg() << std::endl;
+		return EXIT_FAILURE;
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << "FAILED: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "passed" << std::endl;
+	return EXIT_SUCCESS;
+}
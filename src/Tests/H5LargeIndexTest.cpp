@@ -0,0 +1,124 @@
+/*
+* Checks a sparse matrix with more than 2^32 nonzeros against the same matrix without its padding row, see
+* H5SyntheticGenerator --padding: the index pointers are read as 64 bit and validate, and the rows streamed from
+* beyond the 2^32 boundary match the reference. Only the index pointers and the rows after the padding row are read,
+* so the check needs little memory.
+*
+* Usage: H5LargeIndexTest <padded file> <reference file> <group> <padding> <columns>
+*/
+
+#include "IndexVector.h"
+#include "RowBlockReader.h"
+
+#include <H5Cpp.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <string>
+
+namespace local
+{
+	bool check(bool condition, const std::string& message)
+	{
+		if (!condition)
+			std::cout << "FAILED: " << message << std::endl;
+		return condition;
+	}
+
+	std::uint64_t dataset_size(const H5::Group& group, const std::string& name)
+	{
+		return group.openDataSet(name).getSpace().getSimpleExtentNpoints();
+	}
+
+	bool check_index_pointers(H5::Group& padded, H5::Group& reference, std::uint64_t padding)
+	{
+		const std::uint64_t paddedNnz = dataset_size(padded, "data");
+		const std::uint64_t referenceNnz = dataset_size(reference, "data");
+		bool ok = check(paddedNnz == padding + referenceNnz, "the padded file holds padding + reference nonzeros");
+		ok = ok && check(paddedNnz > std::numeric_limits<std::uint32_t>::max(), "the padded file has more than 2^32 nonzeros");
+
+		H5Utils::IndexVectorHolder paddedIndptr;
+		H5Utils::IndexVectorHolder referenceIndptr;
+		ok = ok && check(H5Utils::read_index_vector(padded, "indptr", paddedNnz, paddedIndptr), "read the padded indptr");
+		ok = ok && check(H5Utils::read_index_vector(reference, "indptr", referenceNnz, referenceIndptr), "read the reference indptr");
+		if (!ok)
+			return false;
+
+		ok = check(paddedIndptr.H5DataType() == H5::PredType::NATIVE_UINT64, "the padded indptr is read as uint64");
+		ok = check(referenceIndptr.H5DataType() != H5::PredType::NATIVE_UINT64, "the reference indptr is read narrower than uint64") && ok;
+		ok = check(H5Utils::validate_index_pointers(paddedIndptr, paddedNnz), "the padded indptr validates") && ok;
+		ok = check(paddedIndptr.size() == referenceIndptr.size() + 1, "the padded file has one row more") && ok;
+		if (!ok)
+			return false;
+
+		// without a bound, the type is selected from the (int64) type of indptr in the file
+		H5Utils::IndexVectorHolder unbounded;
+		ok = check(H5Utils::read_index_vector(padded, "indptr", unbounded) && (unbounded.H5DataType() == H5::PredType::NATIVE_UINT64), "the padded indptr is read as uint64 without a bound");
+
+		ok = check(paddedIndptr[1] == padding, "the padding row holds the padding") && ok;
+		for (std::size_t row = 0; ok && (row < referenceIndptr.size()); ++row)
+			ok = check(paddedIndptr[row + 1] == padding + referenceIndptr[row], "index pointer " + std::to_string(row + 1) + " is shifted by the padding");
+		return ok;
+	}
+
+	bool check_rows(const H5::Group& padded, const H5::Group& reference, std::uint64_t columns)
+	{
+		const H5Utils::RowBlockReader paddedReader(padded, columns);
+		const H5Utils::RowBlockReader referenceReader(reference, columns);
+		if (!check(paddedReader.valid() && referenceReader.valid(), "open the row block readers"))
+			return false;
+
+		// small blocks, so several of them straddle the 2^32 boundary
+		constexpr std::uint64_t blockRows = 256;
+		bool ok = true;
+		for (std::uint64_t firstRow = 0; ok && (firstRow < referenceReader.rows()); firstRow += blockRows)
+		{
+			const H5Utils::RowBlock paddedBlock = paddedReader.readRows(firstRow + 1, blockRows);
+			const H5Utils::RowBlock referenceBlock = referenceReader.readRows(firstRow, blockRows);
+			const std::string rows = "rows " + std::to_string(firstRow) + " + " + std::to_string(referenceBlock.rows());
+			ok = check(paddedBlock.indptr == referenceBlock.indptr, rows + ": indptr matches");
+			ok = check(paddedBlock.indices == referenceBlock.indices, rows + ": indices match") && ok;
+			ok = check(paddedBlock.values == referenceBlock.values, rows + ": values match") && ok;
+		}
+		return ok;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc != 6)
+	{
+		std::cout << "Usage: H5LargeIndexTest <padded file> <reference file> <group> <padding> <columns>" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		H5::Exception::dontPrint();
+		H5::H5File paddedFile(argv[1], H5F_ACC_RDONLY);
+		H5::H5File referenceFile(argv[2], H5F_ACC_RDONLY);
+		H5::Group padded = paddedFile.openGroup(argv[3]);
+		H5::Group reference = referenceFile.openGroup(argv[3]);
+		const std::uint64_t padding = std::stoull(argv[4]);
+		const std::uint64_t columns = std::stoull(argv[5]);
+
+		if (!local::check_index_pointers(padded, reference, padding) || !local::check_rows(padded, reference, columns))
+			return EXIT_FAILURE;
+	}
+	catch (const H5::Exception& e)
+	{
+		std::cout << "FAILED: HDF5 error " << e.getDetailMsg() << std::endl;
+		return EXIT_FAILURE;
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << "FAILED: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "passed" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,205 @@
+/*
+* Checks the sharded reads of ShardedReader.h on the X of a small h5ad file, with the shard size lowered so every read
+* has more shards than workers:
+* - workers: reads with 2 and 3 workers match the in-process read, for values converted to other memory types too;
+* - killed_worker: a read whose workers are killed fails, so the caller reads in-process;
+* - cancelled: cancelling a read with running workers throws ReadCancelled quickly.
+* After every read no worker process and no shared memory descriptor is left behind.
+*
+* The test runs as its own worker for the last two cases, selected with MV_H5_SHARD_TEST_WORKER.
+*
+* Usage: H5ShardedReadTest <test> <worker executable> <h5ad file>
+*/
+
+#include "ShardedReader.h"
+
+#include <H5Cpp.h>
+
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace local
+{
+	constexpr const char* worker_mode_variable = "MV_H5_SHARD_TEST_WORKER";
+
+	// Small enough to split the datasets of the test file in a dozen shards.
+	constexpr std::uint64_t shard_bytes = 16 * 1024;
+
+	bool check(bool condition, const std::string& message)
+	{
+		if (!condition)
+			std::cout << "FAILED: " << message << std::endl;
+		return condition;
+	}
+
+	// Open file descriptors of the process, -1 where /proc/self/fd is not available.
+	std::int64_t open_descriptors()
+	{
+		std::error_code error;
+		std::int64_t count = 0;
+		for (std::filesystem::directory_iterator entry("/proc/self/fd", error), end; !error && (entry != end); entry.increment(error))
+			++count;
+		return error ? -1 : count;
+	}
+
+	bool no_children_left()
+	{
+		int status = 0;
+		return (waitpid(-1, &status, WNOHANG) < 0) && (errno == ECHILD);
+	}
+
+	bool check_cleanup(std::int64_t descriptorsBefore, const std::string& name)
+	{
+		bool ok = check(no_children_left(), name + ": no worker process is left");
+		return check(open_descriptors() == descriptorsBefore, name + ": no shared memory descriptor is left") && ok;
+	}
+
+	template<typename T>
+	bool check_read(const H5::DataSet& dataset, const H5::PredType& memoryType, unsigned workers, const std::string& name)
+	{
+		const std::uint64_t size = dataset.getSpace().getSimpleExtentNpoints();
+		std::vector<T> expected(size);
+		dataset.read(expected.data(), memoryType);
+
+		H5Utils::set_sharded_read_workers(workers);
+		const std::int64_t descriptors = open_descriptors();
+		std::vector<T> values(size);
+		bool ok = check(H5Utils::read_sharded(dataset, memoryType, values.data()), name + ": the sharded read succeeds");
+		ok = check(values == expected, name + ": the values match the in-process read") && ok;
+		return check_cleanup(descriptors, name) && ok;
+	}
+
+	bool test_workers(const std::string&, const std::string& worker, H5::H5File& file)
+	{
+		H5Utils::set_sharded_read_worker_path(worker);
+		const H5::DataSet data = file.openDataSet("X/data");
+		const H5::DataSet indices = file.openDataSet("X/indices");
+		bool ok = true;
+		for (const unsigned workers : { 2u, 3u })
+		{
+			const std::string name = std::to_string(workers) + " workers";
+			ok = check_read<float>(data, H5::PredType::NATIVE_FLOAT, workers, name + ", data as float") && ok;
+			ok = check_read<double>(data, H5::PredType::NATIVE_DOUBLE, workers, name + ", data as double") && ok;
+			ok = check_read<std::uint64_t>(indices, H5::PredType::NATIVE_UINT64, workers, name + ", indices as uint64") && ok;
+		}
+		return ok;
+	}
+
+	bool test_killed_worker(const std::string& self, const std::string&, H5::H5File& file)
+	{
+		// the worker of the first shard reads, the others are killed
+		H5Utils::set_sharded_read_worker_path(self);
+		H5Utils::set_sharded_read_workers(3);
+		setenv(worker_mode_variable, "kill", 1);
+		const H5::DataSet data = file.openDataSet("X/data");
+		std::vector<float> values(data.getSpace().getSimpleExtentNpoints());
+		const std::int64_t descriptors = open_descriptors();
+		bool ok = check(!H5Utils::read_sharded(data, H5::PredType::NATIVE_FLOAT, values.data()), "a read with killed workers fails");
+		unsetenv(worker_mode_variable);
+		return check_cleanup(descriptors, "killed worker") && ok;
+	}
+
+	bool test_cancelled(const std::string& self, const std::string&, H5::H5File& file)
+	{
+		H5Utils::set_sharded_read_worker_path(self);
+		H5Utils::set_sharded_read_workers(2);
+		setenv(worker_mode_variable, "sleep", 1);
+		const H5::DataSet data = file.openDataSet("X/data");
+		std::vector<float> values(data.getSpace().getSimpleExtentNpoints());
+		const std::int64_t descriptors = open_descriptors();
+
+		bool cancelled = false;
+		const auto start = std::chrono::steady_clock::now();
+		{
+			H5Utils::ShardedReadCancellation cancellation;
+			std::thread canceller([&cancellation]()
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(200));
+					cancellation.cancel();
+				});
+			try
+			{
+				H5Utils::read_sharded(data, H5::PredType::NATIVE_FLOAT, values.data());
+			}
+			catch (const H5Utils::ReadCancelled&)
+			{
+				cancelled = true;
+			}
+			canceller.join();
+		}
+		unsetenv(worker_mode_variable);
+		bool ok = check(cancelled, "a cancelled read throws ReadCancelled");
+		ok = check(std::chrono::steady_clock::now() - start < std::chrono::seconds(10), "the sleeping workers are killed when the read is cancelled") && ok;
+		return check_cleanup(descriptors, "cancelled") && ok;
+	}
+
+	// Runs the test executable as a worker: "kill" kills the workers of all but the first shard, "sleep" sleeps.
+	int run_worker(int argc, char* argv[], const std::string& mode)
+	{
+		if (mode == "sleep")
+		{
+			std::this_thread::sleep_for(std::chrono::seconds(60));
+			return 0;
+		}
+		if ((mode == "kill") && (argc > 5) && (std::strcmp(argv[5], "0") != 0))
+			raise(SIGKILL);
+		return H5Utils::sharded_read_worker_main(argc, argv);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (const char* mode = std::getenv(local::worker_mode_variable))
+		return local::run_worker(argc, argv, mode);
+
+	const std::map<std::string, std::function<bool(const std::string&, const std::string&, H5::H5File&)>> tests =
+	{
+		{ "workers", local::test_workers },
+		{ "killed_worker", local::test_killed_worker },
+		{ "cancelled", local::test_cancelled }
+	};
+
+	if (argc != 4)
+	{
+		std::cout << "Usage: H5ShardedReadTest <test> <worker executable> <h5ad file>" << std::endl;
+		return EXIT_FAILURE;
+	}
+	const auto test = tests.find(argv[1]);
+	if (test == tests.cend())
+	{
+		std::cout << "Unknown test " << argv[1] << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	bool ok = false;
+	try
+	{
+		H5::Exception::dontPrint();
+		H5::H5File file(argv[3], H5F_ACC_RDONLY);
+		H5Utils::set_sharded_read_sizes(0, local::shard_bytes);
+		const std::string self = std::filesystem::absolute(argv[0]).string();
+		ok = test->second(self, argv[2], file);
+	}
+	catch (const H5::Exception& e)
+	{
+		std::cout << "FAILED: HDF5 error " << e.getDetailMsg() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << (ok ? "passed " : "FAILED ") << argv[1] << std::endl;
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,350 @@
+/*
+* Checks the kernels of SparseKernels.h on small in-memory matrices, with skewed rows that a split by row count would
+* balance badly. Run with the name of a test, or without arguments for all of them.
+*
+* Usage: H5SparseKernelsTest [test]
+*/
+
+#include "SparseKernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace local
+{
+	bool check(bool condition, const std::string& message)
+	{
+		if (!condition)
+			std::cout << "FAILED: " << message << std::endl;
+		return condition;
+	}
+
+	// Offsets of rows whose nonzero counts are drawn from a heavy tailed distribution, the first percent of the rows are
+	// very long, so most of the nonzeros are in the first part of an even split by rows.
+	std::vector<std::uint64_t> skewed_offsets(std::int64_t rows, std::uint32_t seed)
+	{
+		std::mt19937_64 generator(seed);
+		std::lognormal_distribution<double> nnz(1.0, 1.5);
+		std::vector<std::uint64_t> offsets(rows + 1, 0);
+		for (std::int64_t row = 0; row < rows; ++row)
+		{
+			std::uint64_t count = static_cast<std::uint64_t>(nnz(generator));
+			if (row < rows / 100)
+				count += 10000;
+			offsets[row + 1] = offsets[row] + count;
+		}
+		return offsets;
+	}
+
+	bool test_partition_by_nnz()
+	{
+		bool ok = true;
+		const std::int64_t rows = 10000;
+		const std::vector<std::uint64_t> offsets = skewed_offsets(rows, 1);
+		std::uint64_t maxRowNnz = 0;
+		for (std::int64_t row = 0; row < rows; ++row)
+			maxRowNnz = std::max(maxRowNnz, offsets[row + 1] - offsets[row]);
+
+		for (const std::int64_t parts : { 1, 2, 3, 8, 64 })
+		{
+			for (const std::uint64_t rowCost : { 1, 1000 })
+			{
+				const std::string name = std::to_string(parts) + " parts, row cost " + std::to_string(rowCost);
+				const std::vector<std::int64_t> boundaries = H5Utils::partition_by_nnz(offsets, rows, parts, rowCost);
+				ok = check(boundaries.size() == static_cast<std::size_t>(parts + 1), name + ": parts + 1 boundaries") && ok;
+				ok = check((boundaries.front() == 0) && (boundaries.back() == rows), name + ": the parts cover all rows") && ok;
+				ok = check(std::is_sorted(boundaries.cbegin(), boundaries.cend()), name + ": the boundaries are ordered") && ok;
+
+				// every part is within one row of its share of the work
+				const std::uint64_t total = rows * rowCost + offsets[rows];
+				const std::uint64_t maxRowWork = rowCost + maxRowNnz;
+				for (std::int64_t part = 0; ok && (part < parts); ++part)
+				{
+					const std::uint64_t work = (boundaries[part + 1] - boundaries[part]) * rowCost + (offsets[boundaries[part + 1]] - offsets[boundaries[part]]);
+					ok = check(work <= total / parts + maxRowWork, name + ": part " + std::to_string(part) + " holds at most its share plus one row");
+				}
+			}
+		}
+
+		// the offsets of a slice of a larger matrix do not start at 0
+		const std::vector<std::uint64_t> shifted = { 100, 100, 200, 201, 202, 300 };
+		const std::vector<std::int64_t> shiftedBoundaries = H5Utils::partition_by_nnz(shifted, 5, 2);
+		ok = check(shiftedBoundaries == std::vector<std::int64_t>({ 0, 2, 5 }), "offsets that do not start at 0") && ok;
+
+		// a single row is never split, the other parts are empty
+		const std::vector<std::uint32_t> single = { 0, 1000000 };
+		ok = check(H5Utils::partition_by_nnz(single, 1, 4) == std::vector<std::int64_t>({ 0, 1, 1, 1, 1 }), "a single long row") && ok;
+
+		const std::vector<std::uint16_t> none = { 0 };
+		ok = check(H5Utils::partition_by_nnz(none, 0, 3) == std::vector<std::int64_t>({ 0, 0, 0, 0 }), "no rows") && ok;
+		return ok;
+	}
+
+	bool test_parallel_for_nnz_ranges()
+	{
+		bool ok = true;
+		for (const std::int64_t rows : { 0, 1, 7, 10000 })
+		{
+			const std::vector<std::uint64_t> offsets = skewed_offsets(rows, 2);
+			std::vector<std::atomic<int>> visits(rows);
+			H5Utils::parallel_for_nnz_ranges(offsets, rows, "test", [&visits](std::int64_t rowBegin, std::int64_t rowEnd)
+				{
+					for (std::int64_t row = rowBegin; row < rowEnd; ++row)
+						++visits[row];
+				});
+			for (std::int64_t row = 0; ok && (row < rows); ++row)
+				ok = check(visits[row] == 1, std::to_string(rows) + " rows: row " + std::to_string(row) + " is visited once");
+		}
+		return ok;
+	}
+
+	// Row compressed matrix with skewed rows, a few explicit zeros and a few column indices past the last column that
+	// the kernels have to skip.
+	struct SparseMatrix
+	{
+		std::int64_t rows = 0;
+		std::int64_t columns = 0;
+		std::vector<std::uint64_t> offsets;
+		std::vector<std::uint32_t> indices;
+		std::vector<float> values;
+	};
+
+	SparseMatrix skewed_matrix(std::int64_t rows, std::int64_t columns, std::uint32_t seed)
+	{
+		SparseMatrix matrix;
+		matrix.rows = rows;
+		matrix.columns = columns;
+		matrix.offsets.assign(rows + 1, 0);
+		std::mt19937_64 generator(seed);
+		std::lognormal_distribution<double> nnz(1.0, 1.5);
+		std::uniform_int_distribution<std::int64_t> column(0, columns + 1);
+		std::uniform_int_distribution<int> value(0, 9);
+		std::vector<std::uint32_t> rowIndices;
+		for (std::int64_t row = 0; row < rows; ++row)
+		{
+			const std::int64_t count = std::min<std::int64_t>(static_cast<std::int64_t>(nnz(generator)) + ((row < rows / 100) ? columns / 2 : 0), columns);
+			rowIndices.clear();
+			for (std::int64_t i = 0; i < count; ++i)
+				rowIndices.push_back(static_cast<std::uint32_t>(column(generator)));
+			std::sort(rowIndices.begin(), rowIndices.end());
+			rowIndices.erase(std::unique(rowIndices.begin(), rowIndices.end()), rowIndices.end());
+			for (const auto index : rowIndices)
+			{
+				matrix.indices.push_back(index);
+				matrix.values.push_back(static_cast<float>(value(generator)));
+			}
+			matrix.offsets[row + 1] = matrix.indices.size();
+		}
+		return matrix;
+	}
+
+	// The same matrix column compressed, indices are rows.
+	SparseMatrix transpose(const SparseMatrix& matrix)
+	{
+		SparseMatrix result;
+		result.rows = matrix.columns + 2; // the skipped indices past the last column
+		result.columns = matrix.rows;
+		result.offsets.assign(result.rows + 1, 0);
+		for (const auto index : matrix.indices)
+			++result.offsets[index + 1];
+		for (std::int64_t row = 0; row < result.rows; ++row)
+			result.offsets[row + 1] += result.offsets[row];
+		result.indices.resize(matrix.indices.size());
+		result.values.resize(matrix.values.size());
+		std::vector<std::uint64_t> position(result.offsets.cbegin(), result.offsets.cend() - 1);
+		for (std::int64_t row = 0; row < matrix.rows; ++row)
+		{
+			for (std::uint64_t i = matrix.offsets[row]; i < matrix.offsets[row + 1]; ++i)
+			{
+				const std::uint64_t p = position[matrix.indices[i]]++;
+				result.indices[p] = static_cast<std::uint32_t>(row);
+				result.values[p] = matrix.values[i];
+			}
+		}
+		result.offsets.resize(matrix.columns + 1); // drop the columns past the last one
+		return result;
+	}
+
+	// Straightforward single threaded scatter to compare the kernels with, rounded to float after the addition as they do.
+	void add_dense(std::vector<float>& dense, const SparseMatrix& matrix, TRANSFORM::Type transform)
+	{
+		for (std::int64_t row = 0; row < matrix.rows; ++row)
+		{
+			for (std::uint64_t i = matrix.offsets[row]; i < matrix.offsets[row + 1]; ++i)
+			{
+				if ((matrix.indices[i] < matrix.columns) && (matrix.values[i] != 0))
+					dense[row * matrix.columns + matrix.indices[i]] += H5Utils::transform_value(matrix.values[i], transform);
+			}
+		}
+	}
+
+	void no_progress(std::uint64_t)
+	{
+	}
+
+	// What was in the memory before, the zero filling kernels have to overwrite it.
+	constexpr float Garbage = -12345.0f;
+
+	bool test_scatter_rows_zero_fill()
+	{
+		bool ok = true;
+		const SparseMatrix exon = skewed_matrix(3000, 200, 3);
+		const SparseMatrix intron = skewed_matrix(3000, 200, 4);
+		for (const auto& transform : { TRANSFORM::None(), TRANSFORM::Type(TRANSFORM::LOG, false) })
+		{
+			std::vector<float> expected(exon.rows * exon.columns, 0.0f);
+			add_dense(expected, exon, transform);
+
+			std::vector<float> zeroed(expected.size(), 0.0f);
+			H5Utils::scatter_sparse_rows<false>(zeroed.begin(), exon.rows, exon.columns, exon.indices, exon.offsets, exon.values, transform, no_progress);
+			ok = check(zeroed == expected, "CSR into zeroed memory") && ok;
+
+			std::vector<float> uninitialized(expected.size(), Garbage);
+			H5Utils::scatter_sparse_rows<false, true>(uninitialized.begin(), exon.rows, exon.columns, exon.indices, exon.offsets, exon.values, transform, no_progress);
+			ok = check(uninitialized == expected, "CSR with zero fill") && ok;
+
+			// exon plus intron, as the TOME loader accumulates them
+			add_dense(expected, intron, transform);
+			H5Utils::scatter_sparse_rows<true>(uninitialized.begin(), intron.rows, intron.columns, intron.indices, intron.offsets, intron.values, transform, no_progress);
+			ok = check(uninitialized == expected, "CSR accumulated after a zero filled scatter") && ok;
+		}
+		return ok;
+	}
+
+	bool test_scatter_columns_zero_fill()
+	{
+		bool ok = true;
+		// the wide matrix has fewer rows per block than the narrow one, both have several blocks
+		for (const std::int64_t columns : { 200, 5000 })
+		{
+			const SparseMatrix exon = skewed_matrix(3000, columns, 5);
+			const SparseMatrix intron = skewed_matrix(3000, columns, 6);
+			const SparseMatrix exonPerColumn = transpose(exon);
+			const SparseMatrix intronPerColumn = transpose(intron);
+			const std::string name = std::to_string(columns) + " columns";
+
+			std::vector<float> expected(exon.rows * exon.columns, 0.0f);
+			add_dense(expected, exon, TRANSFORM::None());
+
+			std::vector<float> zeroed(expected.size(), 0.0f);
+			H5Utils::scatter_sparse_columns<false>(zeroed.begin(), exon.rows, exon.columns, exonPerColumn.indices, exonPerColumn.offsets, exonPerColumn.values, TRANSFORM::None(), no_progress);
+			ok = check(zeroed == expected, name + ": CSC into zeroed memory") && ok;
+
+			std::vector<float> uninitialized(expected.size(), Garbage);
+			H5Utils::scatter_sparse_columns<false, true>(uninitialized.begin(), exon.rows, exon.columns, exonPerColumn.indices, exonPerColumn.offsets, exonPerColumn.values, TRANSFORM::None(), no_progress);
+			ok = check(uninitialized == expected, name + ": CSC with zero fill") && ok;
+
+			add_dense(expected, intron, TRANSFORM::None());
+			H5Utils::scatter_sparse_columns<true>(uninitialized.begin(), intron.rows, intron.columns, intronPerColumn.indices, intronPerColumn.offsets, intronPerColumn.values, TRANSFORM::None(), no_progress);
+			ok = check(uninitialized == expected, name + ": CSC accumulated after a zero filled scatter") && ok;
+		}
+		return ok;
+	}
+
+	// The nonzeros [base, base + values.size()) of a larger matrix, as when the rows after a padding row of more than
+	// 2^32 nonzeros are read. An index outside the window, such as a wrapped 32 bit offset, is recorded, not read.
+	template<typename T>
+	struct NonzeroWindow
+	{
+		std::uint64_t base;
+		const std::vector<T>& values;
+		std::atomic<bool>& outOfRange;
+
+		T operator[](std::uint64_t i) const
+		{
+			if ((i < base) || (i - base >= values.size()))
+			{
+				outOfRange = true;
+				return T(0);
+			}
+			return values[i - base];
+		}
+	};
+
+	bool test_scatter_rows_past_2_32()
+	{
+		bool ok = true;
+		const SparseMatrix matrix = skewed_matrix(3000, 200, 7);
+		// behind a padding row, so all offsets and nonzero positions of these rows are past 2^32
+		const std::uint64_t base = (std::uint64_t(1) << 32) + 12345;
+		std::vector<std::uint64_t> offsets(matrix.offsets.size());
+		std::transform(matrix.offsets.cbegin(), matrix.offsets.cend(), offsets.begin(), [base](std::uint64_t offset) { return base + offset; });
+
+		std::atomic<bool> outOfRange(false);
+		const NonzeroWindow<std::uint32_t> indices = { base, matrix.indices, outOfRange };
+		const NonzeroWindow<float> values = { base, matrix.values, outOfRange };
+		for (const auto& transform : { TRANSFORM::None(), TRANSFORM::Type(TRANSFORM::LOG, false) })
+		{
+			std::vector<float> expected(matrix.rows * matrix.columns, 0.0f);
+			add_dense(expected, matrix, transform);
+
+			std::vector<float> zeroed(expected.size(), 0.0f);
+			H5Utils::scatter_sparse_rows<false>(zeroed.begin(), matrix.rows, matrix.columns, indices, offsets, values, transform, no_progress);
+			ok = check(zeroed == expected, "CSR with offsets past 2^32") && ok;
+
+			std::vector<float> uninitialized(expected.size(), Garbage);
+			H5Utils::scatter_sparse_rows<false, true>(uninitialized.begin(), matrix.rows, matrix.columns, indices, offsets, values, transform, no_progress);
+			ok = check(uninitialized == expected, "CSR with zero fill and offsets past 2^32") && ok;
+
+			add_dense(expected, matrix, transform);
+			H5Utils::scatter_sparse_rows<true>(uninitialized.begin(), matrix.rows, matrix.columns, indices, offsets, values, transform, no_progress);
+			ok = check(uninitialized == expected, "CSR accumulated with offsets past 2^32") && ok;
+		}
+		return check(!outOfRange, "only nonzeros of the window are read") && ok;
+	}
+
+	bool test_parallel_zero_fill()
+	{
+		const std::int64_t rows = 1001;
+		const std::uint64_t columns = 37;
+		std::vector<float> matrix(rows * columns + 1, Garbage);
+		H5Utils::parallel_zero_fill(matrix.begin(), rows, columns);
+		bool ok = check(std::all_of(matrix.cbegin(), matrix.cend() - 1, [](float value) { return value == 0.0f; }), "the matrix is zero filled");
+		return check(matrix.back() == Garbage, "the memory after the matrix is untouched") && ok;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const std::map<std::string, std::function<bool()>> tests =
+	{
+		{ "partition_by_nnz", local::test_partition_by_nnz },
+		{ "parallel_for_nnz_ranges", local::test_parallel_for_nnz_ranges },
+		{ "scatter_rows_zero_fill", local::test_scatter_rows_zero_fill },
+		{ "scatter_columns_zero_fill", local::test_scatter_columns_zero_fill },
+		{ "scatter_rows_past_2_32", local::test_scatter_rows_past_2_32 },
+		{ "parallel_zero_fill", local::test_parallel_zero_fill }
+	};
+
+	if (argc > 2)
+	{
+		std::cout << "Usage: H5SparseKernelsTest [test]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	bool ok = true;
+	bool found = false;
+	for (const auto& [name, test] : tests)
+	{
+		if ((argc == 2) && (name != argv[1]))
+			continue;
+		found = true;
+		const bool passed = test();
+		std::cout << (passed ? "passed " : "FAILED ") << name << std::endl;
+		ok = ok && passed;
+	}
+	if (!found)
+	{
+		std::cout << "Unknown test " << argv[1] << std::endl;
+		return EXIT_FAILURE;
+	}
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
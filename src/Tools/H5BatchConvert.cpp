@@ -0,0 +1,489 @@
+/*
+* Converts the 10X, TOME and h5ad files listed in a manifest to h5ad files with a dense float X, the layout the
+* H5AD loader reads fastest, without ManiVault or any dialog. The files are decoded by H5Utils::decode_matrix, with the
+* readers and the scatter of the loader plugins. Files are converted in parallel processes with fixed options, so a
+* batch is bound by the machine rather than by clicking. Every file gets a line with its shape, time,
+* throughput and peak memory, optionally also written to a CSV report. Run without arguments for the options.
+*
+* Manifest: one input file per line, optionally followed by a tab and the output file. Empty lines and lines starting
+* with # are skipped.
+*/
+
+#include "H5WriteUtils.h"
+
+#include "MatrixDecoder.h"
+#include "MemoryTracker.h"
+#include "Trace.h"
+
+#include <H5Cpp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/wait.h>
+#include <unistd.h>
+#define MV_H5_BATCH_PROCESSES
+#endif
+
+using namespace H5Tools;
+
+namespace local
+{
+	struct Options : StorageOptions
+	{
+		std::string manifest;
+		std::string outputDirectory;	// next to the input when empty
+		std::string report;				// CSV report, none when empty
+		H5Utils::DecodeOptions read;
+		int jobs = 1;					// files converted at the same time
+		int threads = 0;				// OpenMP threads per file, 0 divides the cores over the jobs
+		bool readOnly = false;			// only decode, to time decode_matrix
+	};
+
+	struct Entry
+	{
+		std::string input;
+		std::string output;
+	};
+
+	// Sent from a conversion process to the batch process, so plain data only.
+	struct FileResult
+	{
+		bool ok = false;
+		H5Utils::FileFormat format = H5Utils::FileFormat::Unknown;
+		std::uint64_t rows = 0;
+		std::uint64_t columns = 0;
+		std::uint64_t nnz = 0;
+		std::uint64_t inputBytes = 0;
+		std::uint64_t peakResidentBytes = 0;
+		double readSeconds = 0;
+		double writeSeconds = 0;
+	};
+
+	class DenseSink : public H5Utils::MatrixSink
+	{
+	public:
+		float* allocate(std::uint64_t rows, std::uint64_t columns) override
+		{
+			float* data = allocateUninitialized(rows, columns);
+			std::fill(data, data + rows * columns, 0.0f);
+			return data;
+		}
+
+		// new float[] leaves the values uninitialized, the reader zero fills them in parallel with the scatter
+		float* allocateUninitialized(std::uint64_t rows, std::uint64_t columns) override
+		{
+			matrix.reset(); // release a previous matrix before allocating the next
+			this->rows = rows;
+			this->columns = columns;
+			matrix.reset(new float[rows * columns]);
+			_trackedMatrix.setBytes(rows * columns * sizeof(float));
+			return matrix.get();
+		}
+
+		void setRowNames(std::vector<std::string> names) override { rowNames = std::move(names); }
+		void setColumnNames(std::vector<std::string> names) override { columnNames = std::move(names); }
+		void addRowLabels(const std::string& name, std::vector<std::string> labels) override { rowLabels.emplace_back(name, std::move(labels)); }
+
+		std::uint64_t rows = 0;
+		std::uint64_t columns = 0;
+		std::unique_ptr<float[]> matrix;
+		std::vector<std::string> rowNames;
+		std::vector<std::string> columnNames;
+		std::vector<std::pair<std::string, std::vector<std::string>>> rowLabels;
+
+	private:
+		H5Utils::TrackedBuffer _trackedMatrix{ "dense matrix" };
+	};
+
+	void print_usage()
+	{
+		std::cout << "Usage: H5BatchConvert <manifest> [options]\n"
+			<< "  manifest: one input file per line, optionally followed by a tab and the output file\n"
+			<< "  --output-directory DIR  directory of outputs without a name in the manifest (next to the input)\n"
+			<< "  --transform NAME        none, log, sqrt or arcsin5 (none)\n"
+			<< "  --no-metadata           skip the categorical metadata\n"
+			<< "  --jobs N                files converted at the same time, each in its own process (1)\n"
+			<< "  --threads N             threads per file (the cores divided over the jobs)\n"
+			<< "  --chunk N               chunk size of the written X in elements, 0 for contiguous (0)\n"
+			<< "  --compression L         gzip level 0-9 of the written X, needs --chunk (0)\n"
+			<< "  --read-only             only decode the files, to time the decode path of the loaders\n"
+			<< "  --report FILE           CSV with a line per file\n";
+	}
+
+	bool parse_transform(const std::string& name, TRANSFORM::Type& transform)
+	{
+		if (name == "none") transform = TRANSFORM::None();
+		else if (name == "log") transform = std::make_pair(TRANSFORM::LOG, 0.0);
+		else if (name == "sqrt") transform = std::make_pair(TRANSFORM::SQRT, 0.0);
+		else if (name == "arcsin5") transform = std::make_pair(TRANSFORM::ARCSIN5, 0.0);
+		else
+			return false;
+		return true;
+	}
+
+	bool parse_options(int argc, char* argv[], Options& options)
+	{
+		if (argc < 2)
+			return false;
+		options.manifest = argv[1];
+
+		for (int a = 2; a < argc; ++a)
+		{
+			const std::string name = argv[a];
+			if (name == "--no-metadata")
+			{
+				options.read.metadata = false;
+				continue;
+			}
+			if (name == "--read-only")
+			{
+				options.readOnly = true;
+				continue;
+			}
+			if (a + 1 >= argc)
+			{
+				std::cout << "Missing value for " << name << std::endl;
+				return false;
+			}
+			const std::string value = argv[++a];
+			try
+			{
+				if (name == "--output-directory") options.outputDirectory = value;
+				else if (name == "--report") options.report = value;
+				else if (name == "--jobs") options.jobs = std::max(1, std::stoi(value));
+				else if (name == "--threads") options.threads = std::max(0, std::stoi(value));
+				else if (name == "--chunk") options.chunk = std::stoull(value);
+				else if (name == "--compression") options.compression = std::stoi(value);
+				else if (name == "--transform")
+				{
+					if (!parse_transform(value, options.read.transform))
+					{
+						std::cout << "Unknown transform " << value << std::endl;
+						return false;
+					}
+				}
+				else
+				{
+					std::cout << "Unknown option " << name << std::endl;
+					return false;
+				}
+			}
+			catch (const std::exception&)
+			{
+				std::cout << "Invalid value " << value << " for " << name << std::endl;
+				return false;
+			}
+		}
+		if ((options.chunk == 0) && (options.compression > 0))
+		{
+			std::cout << "Compression needs --chunk" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	bool read_manifest(const Options& options, std::vector<Entry>& entries)
+	{
+		std::ifstream manifest(options.manifest);
+		if (!manifest)
+		{
+			std::cout << "Could not open " << options.manifest << std::endl;
+			return false;
+		}
+		std::string line;
+		while (std::getline(manifest, line))
+		{
+			if (!line.empty() && (line.back() == '\r'))
+				line.pop_back();
+			if (line.empty() || (line[0] == '#'))
+				continue;
+
+			Entry entry;
+			const auto tab = line.find('\t');
+			entry.input = line.substr(0, tab);
+			if (tab != std::string::npos)
+				entry.output = line.substr(tab + 1);
+			if (entry.output.empty())
+			{
+				std::filesystem::path output(entry.input);
+				output.replace_extension(".dense.h5ad");
+				if (!options.outputDirectory.empty())
+					output = std::filesystem::path(options.outputDirectory) / output.filename();
+				entry.output = output.string();
+			}
+			entries.push_back(entry);
+		}
+		return true;
+	}
+
+	// Codes into the sorted distinct labels, as an h5ad categorical column.
+	void write_categorical(H5::Group& obs, const std::string& name, const std::vector<std::string>& labels)
+	{
+		std::map<std::string, std::int32_t> codeOfLabel;
+		for (const auto& label : labels)
+			codeOfLabel.emplace(label, 0);
+		std::vector<std::string> categories;
+		categories.reserve(codeOfLabel.size());
+		for (auto& item : codeOfLabel)
+		{
+			item.second = static_cast<std::int32_t>(categories.size());
+			categories.push_back(item.first);
+		}
+		std::vector<std::int32_t> codes(labels.size());
+		for (std::size_t i = 0; i < labels.size(); ++i)
+			codes[i] = codeOfLabel[labels[i]];
+
+		H5::Group column = obs.createGroup(name);
+		write_encoding(column, "categorical", "0.2.0");
+		const bool ordered = false;
+		H5::Attribute attribute = column.createAttribute("ordered", H5::PredType::NATIVE_HBOOL, H5::DataSpace(H5S_SCALAR));
+		attribute.write(H5::PredType::NATIVE_HBOOL, &ordered);
+		write_strings(column, "categories", categories);
+		if (categories.size() <= 127)
+			write_converted<std::int8_t>(column, "codes", codes, StorageOptions());
+		else if (categories.size() <= 32767)
+			write_converted<std::int16_t>(column, "codes", codes, StorageOptions());
+		else
+			write_vector(column, "codes", codes, StorageOptions());
+	}
+
+	std::vector<std::string> names_or_numbers(const std::vector<std::string>& names, std::uint64_t count)
+	{
+		if (names.size() == count)
+			return names;
+		std::vector<std::string> numbers(count);
+		for (std::uint64_t i = 0; i < count; ++i)
+			numbers[i] = std::to_string(i);
+		return numbers;
+	}
+
+	void write_dense_h5ad(const std::string& fileName, const DenseSink& sink, const StorageOptions& storage)
+	{
+		H5::H5File file(fileName, H5F_ACC_TRUNC);
+		H5::Group root = file.openGroup("/");
+		write_encoding(root, "anndata");
+
+		write_dataset(root, "X", sink.matrix.get(), { sink.rows, sink.columns }, storage);
+		H5::DataSet x = root.openDataSet("X");
+		write_encoding(x, "array", "0.2.0");
+
+		H5::Group obs = file.createGroup("obs");
+		write_encoding(obs, "dataframe", "0.2.0");
+		write_string_attribute(obs, "_index", "_index");
+		write_strings(obs, "_index", names_or_numbers(sink.rowNames, sink.rows));
+		std::vector<std::string> columnOrder;
+		for (const auto& [name, labels] : sink.rowLabels)
+		{
+			if ((name == "_index") || obs.exists(name))
+				continue;
+			write_categorical(obs, name, labels);
+			columnOrder.push_back(name);
+		}
+		write_string_array_attribute(obs, "column-order", columnOrder);
+
+		H5::Group var = file.createGroup("var");
+		write_encoding(var, "dataframe", "0.2.0");
+		write_string_attribute(var, "_index", "_index");
+		write_strings(var, "_index", names_or_numbers(sink.columnNames, sink.columns));
+		write_string_array_attribute(var, "column-order", {});
+	}
+
+	FileResult convert(const Entry& entry, const Options& options)
+	{
+		FileResult result;
+		std::error_code error;
+		const auto inputBytes = std::filesystem::file_size(entry.input, error);
+		result.inputBytes = error ? 0 : inputBytes;
+
+		H5Utils::MemoryHighWater highWater;
+		{
+			DenseSink sink;
+			H5Utils::DecodeResult read;
+			const auto start = std::chrono::steady_clock::now();
+			result.ok = H5Utils::decode_matrix(entry.input, sink, options.read, &read);
+			const auto readEnd = std::chrono::steady_clock::now();
+			result.readSeconds = std::chrono::duration<double>(readEnd - start).count();
+			result.format = read.format;
+			result.rows = read.rows;
+			result.columns = read.columns;
+			result.nnz = read.nnz;
+
+			if (result.ok && !options.readOnly)
+			{
+				try
+				{
+					const auto directory = std::filesystem::path(entry.output).parent_path();
+					if (!directory.empty())
+						std::filesystem::create_directories(directory, error);
+					write_dense_h5ad(entry.output, sink, options);
+				}
+				catch (const H5::Exception& e)
+				{
+					std::cout << "Could not write " << entry.output << ": " << e.getDetailMsg() << std::endl;
+					result.ok = false;
+				}
+				result.writeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - readEnd).count();
+			}
+		}
+		highWater.end();
+		result.peakResidentBytes = highWater.peakResident();
+		return result;
+	}
+
+	void print_result(const Entry& entry, const FileResult& result)
+	{
+		const double megabytes = result.inputBytes / (1024.0 * 1024.0);
+		std::cout << (result.ok ? "done   " : "FAILED ") << entry.input << ": " << H5Utils::file_format_name(result.format) << " " << result.rows << " x " << result.columns
+			<< ", " << result.nnz << " values, read " << std::fixed << std::setprecision(2) << result.readSeconds << " s ("
+			<< (result.readSeconds > 0 ? megabytes / result.readSeconds : 0.0) << " MB/s), write " << result.writeSeconds << " s, peak "
+			<< (result.peakResidentBytes / (1024.0 * 1024.0)) << " MB" << std::defaultfloat << std::endl;
+	}
+
+	void write_report(const std::string& fileName, const std::vector<Entry>& entries, const std::vector<FileResult>& results)
+	{
+		std::ofstream report(fileName, std::ios::trunc);
+		report << "input,output,status,format,rows,columns,values,input_bytes,read_seconds,read_mb_per_second,write_seconds,peak_resident_bytes\n";
+		for (std::size_t i = 0; i < entries.size(); ++i)
+		{
+			const FileResult& result = results[i];
+			const double megabytes = result.inputBytes / (1024.0 * 1024.0);
+			report << '"' << entries[i].input << "\",\"" << entries[i].output << "\"," << (result.ok ? "ok" : "failed") << ',' << H5Utils::file_format_name(result.format)
+				<< ',' << result.rows << ',' << result.columns << ',' << result.nnz << ',' << result.inputBytes << ',' << result.readSeconds
+				<< ',' << (result.readSeconds > 0 ? megabytes / result.readSeconds : 0.0) << ',' << result.writeSeconds << ',' << result.peakResidentBytes << '\n';
+		}
+		if (!report)
+			std::cout << "Could not write report " << fileName << std::endl;
+	}
+
+	void set_threads(const Options& options)
+	{
+#if defined(_OPENMP)
+		const int threads = options.threads > 0 ? options.threads : std::max(1, omp_get_num_procs() / options.jobs);
+		omp_set_num_threads(threads);
+#endif
+	}
+
+	// The files are converted in child processes, the HDF5 library is not thread safe and a file that fails
+	// (out of memory, corrupt) only takes down its own process.
+	void convert_all(const std::vector<Entry>& entries, const Options& options, std::vector<FileResult>& results)
+	{
+#if defined(MV_H5_BATCH_PROCESSES)
+		if (options.jobs > 1)
+		{
+			std::map<pid_t, std::pair<std::size_t, int>> running; // file index and read end of its result pipe
+			std::size_t next = 0;
+			while ((next < entries.size()) || !running.empty())
+			{
+				while ((running.size() < static_cast<std::size_t>(options.jobs)) && (next < entries.size()))
+				{
+					int pipeEnds[2];
+					if (pipe(pipeEnds) != 0)
+						break;
+					std::cout.flush();
+					const pid_t pid = fork();
+					if (pid == 0)
+					{
+						close(pipeEnds[0]);
+						set_threads(options);
+						const FileResult result = convert(entries[next], options);
+						print_result(entries[next], result);
+						std::cout.flush();
+						const bool sent = (write(pipeEnds[1], &result, sizeof(result)) == static_cast<ssize_t>(sizeof(result)));
+						_exit((result.ok && sent) ? EXIT_SUCCESS : EXIT_FAILURE);
+					}
+					close(pipeEnds[1]);
+					if (pid < 0)
+					{
+						close(pipeEnds[0]);
+						break;
+					}
+					running[pid] = { next++, pipeEnds[0] };
+				}
+				if (running.empty())
+				{
+					// no process could be started, convert the next file in this one
+					set_threads(options);
+					results[next] = convert(entries[next], options);
+					print_result(entries[next], results[next]);
+					++next;
+					continue;
+				}
+
+				int status = 0;
+				const pid_t pid = waitpid(-1, &status, 0);
+				const auto it = running.find(pid);
+				if (it == running.end())
+					continue;
+				const auto [index, readEnd] = it->second;
+				FileResult result;
+				if (read(readEnd, &result, sizeof(result)) != static_cast<ssize_t>(sizeof(result)))
+				{
+					result = FileResult();
+					std::cout << "FAILED " << entries[index].input << ": the conversion process ended without a result" << std::endl;
+				}
+				close(readEnd);
+				results[index] = result;
+				running.erase(it);
+			}
+			return;
+		}
+#endif
+		set_threads(options);
+		for (std::size_t i = 0; i < entries.size(); ++i)
+		{
+			results[i] = convert(entries[i], options);
+			print_result(entries[i], results[i]);
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	local::Options options;
+	std::vector<local::Entry> entries;
+	if (!local::parse_options(argc, argv, options))
+	{
+		local::print_usage();
+		return EXIT_FAILURE;
+	}
+	if (!local::read_manifest(options, entries))
+		return EXIT_FAILURE;
+
+	H5::Exception::dontPrint();
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<local::FileResult> results(entries.size());
+	local::convert_all(entries, options, results);
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::size_t failed = 0;
+	std::uint64_t inputBytes = 0;
+	for (const auto& result : results)
+	{
+		failed += result.ok ? 0 : 1;
+		inputBytes += result.inputBytes;
+	}
+	std::cout << "Converted " << (entries.size() - failed) << " of " << entries.size() << " files, " << (inputBytes / (1024.0 * 1024.0)) << " MB in " << seconds << " s" << std::endl;
+
+	if (!options.report.empty())
+		local::write_report(options.report, entries, results);
+	// the spans of the conversions in this process, use --jobs 1 to trace all files
+	H5Utils::export_trace();
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
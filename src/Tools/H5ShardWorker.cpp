@@ -0,0 +1,11 @@
+/*
+* Worker process of the sharded reads of the HDF5 loaders (see ShardedReader.h). The loaders start it next to the
+* plugins with posix_spawn; it reads a range of rows of one dataset into the shared memory it inherits and exits.
+*/
+
+#include "ShardedReader.h"
+
+int main(int argc, char* argv[])
+{
+	return H5Utils::sharded_read_worker_main(argc, argv);
+}
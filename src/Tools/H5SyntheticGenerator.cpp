@@ -0,0 +1,691 @@
+/*
+* Writes synthetic 10X, TOME and h5ad files with a configurable shape, nonzero distribution, element types, chunking
+* and compression, to compare the loading strategies on reproducible inputs. Only depends on HDF5, so it runs on any
+* machine the loaders build on. Run without arguments for the options.
+*
+* The layouts follow what the loaders read:
+*	10X		<group>/barcodes, genes, indptr, indices, data or data16 (bfloat16 bits), shape, meta/<label>/{l,c}
+*	TOME	data/{exon,intron} (per gene) and data/{t_exon,t_intron} (per sample) with x, i, p, dims,
+*			gene_names, sample_names, sample_meta/anno/<label>_label and <label>_color
+*	h5ad	X (dense, csr_matrix or csc_matrix), obs and var dataframes with categorical columns (categories/codes),
+*			obsm/X_synthetic and layers/<layer> (csr_matrix)
+*
+* --padding N prepends a row of N nonzeros that are never written (a 10X or csr X matrix), so a file with more than
+* 2^32 nonzeros, and the 64 bit index pointers that come with it, takes little more disk space or time than one
+* without. The padding row reads as N zeros in column 0, the other rows are those of the file without padding.
+*/
+
+#include "H5WriteUtils.h"
+
+#include <H5Cpp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+using namespace H5Tools;
+
+namespace local
+{
+	struct Options : StorageOptions
+	{
+		std::string format;					// 10x, tome or h5ad
+		std::string fileName;
+		std::uint64_t rows = 10000;			// cells or samples
+		std::uint64_t columns = 2000;		// genes
+		double density = 0.05;				// mean fraction of nonzeros per row
+		std::string distribution = "uniform";	// nonzeros per row: uniform (binomial) or skewed (log-normal row scale)
+		std::string values = "counts";		// counts (small integers) or real (log-normal)
+		std::string dtype = "float32";		// element type of the stored values
+		std::string indexType = "int32";	// element type of indices and indptr, indptr is widened when the nonzeros do not fit
+		std::string layout = "csr";			// h5ad X: dense, csr or csc
+		bool bf16 = false;					// 10X: store data16 instead of data
+		std::uint32_t seed = 1;
+		std::uint32_t metaColumns = 3;		// categorical metadata columns
+		std::uint32_t categories = 20;		// categories per metadata column
+		std::uint32_t obsmDimensions = 2;	// h5ad: columns of obsm/X_synthetic, 0 for none
+		std::uint32_t layers = 0;			// h5ad: number of layers
+		std::uint64_t padding = 0;			// 10x, h5ad csr: unwritten nonzeros of a leading padding row
+	};
+
+	// Row compressed, the values are kept as float, they are converted to the requested type when written.
+	struct SparseMatrix
+	{
+		std::uint64_t rows = 0;
+		std::uint64_t columns = 0;
+		std::vector<std::uint64_t> offsets;
+		std::vector<std::uint32_t> indices;
+		std::vector<float> values;
+		std::uint64_t padding = 0;		// nonzeros before indices and values that are not held
+
+		std::uint64_t nnz() const { return padding + values.size(); }
+	};
+
+	void print_usage()
+	{
+		const Options defaults;
+		std::cout << "Usage: H5SyntheticGenerator <10x|tome|h5ad> <output file> [options]\n"
+			<< "  --rows N             cells or samples (" << defaults.rows << ")\n"
+			<< "  --columns N          genes (" << defaults.columns << ")\n"
+			<< "  --density D          mean fraction of nonzeros per row (" << defaults.density << ")\n"
+			<< "  --distribution NAME  nonzeros per row: uniform or skewed (" << defaults.distribution << ")\n"
+			<< "  --values NAME        counts or real (" << defaults.values << ")\n"
+			<< "  --dtype NAME         float32, float64, int32, uint32, int16, uint16, uint8 (" << defaults.dtype << ")\n"
+			<< "  --index-type NAME    int32, uint32, int64, uint64 (" << defaults.indexType << ")\n"
+			<< "  --layout NAME        h5ad X: dense, csr or csc (" << defaults.layout << ")\n"
+			<< "  --bf16               10X: write data16 (bfloat16) instead of data\n"
+			<< "  --chunk N            chunk size in elements, 0 for contiguous (" << defaults.chunk << ")\n"
+			<< "  --compression L      gzip level 0-9, needs --chunk (" << defaults.compression << ")\n"
+			<< "  --shuffle            shuffle filter, needs --chunk\n"
+			<< "  --seed N             (" << defaults.seed << ")\n"
+			<< "  --meta-columns N     categorical metadata columns (" << defaults.metaColumns << ")\n"
+			<< "  --categories N       categories per metadata column (" << defaults.categories << ")\n"
+			<< "  --obsm-dimensions N  h5ad: columns of obsm/X_synthetic (" << defaults.obsmDimensions << ")\n"
+			<< "  --layers N           h5ad: number of sparse layers (" << defaults.layers << ")\n"
+			<< "  --padding N          10x, h5ad csr: leading row of N unwritten nonzeros, needs --chunk (" << defaults.padding << ")\n";
+	}
+
+	bool parse_options(int argc, char* argv[], Options& options)
+	{
+		if (argc < 3)
+			return false;
+		options.format = argv[1];
+		options.fileName = argv[2];
+
+		for (int a = 3; a < argc; ++a)
+		{
+			const std::string name = argv[a];
+			if (name == "--bf16")
+			{
+				options.bf16 = true;
+				continue;
+			}
+			if (name == "--shuffle")
+			{
+				options.shuffle = true;
+				continue;
+			}
+			if (a + 1 >= argc)
+			{
+				std::cout << "Missing value for " << name << std::endl;
+				return false;
+			}
+			const std::string value = argv[++a];
+			try
+			{
+				if (name == "--rows") options.rows = std::stoull(value);
+				else if (name == "--columns") options.columns = std::stoull(value);
+				else if (name == "--density") options.density = std::stod(value);
+				else if (name == "--distribution") options.distribution = value;
+				else if (name == "--values") options.values = value;
+				else if (name == "--dtype") options.dtype = value;
+				else if (name == "--index-type") options.indexType = value;
+				else if (name == "--layout") options.layout = value;
+				else if (name == "--chunk") options.chunk = std::stoull(value);
+				else if (name == "--compression") options.compression = std::stoi(value);
+				else if (name == "--seed") options.seed = static_cast<std::uint32_t>(std::stoul(value));
+				else if (name == "--meta-columns") options.metaColumns = static_cast<std::uint32_t>(std::stoul(value));
+				else if (name == "--categories") options.categories = static_cast<std::uint32_t>(std::stoul(value));
+				else if (name == "--obsm-dimensions") options.obsmDimensions = static_cast<std::uint32_t>(std::stoul(value));
+				else if (name == "--layers") options.layers = static_cast<std::uint32_t>(std::stoul(value));
+				else if (name == "--padding") options.padding = std::stoull(value);
+				else
+				{
+					std::cout << "Unknown option " << name << std::endl;
+					return false;
+				}
+			}
+			catch (const std::exception&)
+			{
+				std::cout << "Invalid value " << value << " for " << name << std::endl;
+				return false;
+			}
+		}
+
+		if ((options.format != "10x") && (options.format != "tome") && (options.format != "h5ad"))
+		{
+			std::cout << "Unknown format " << options.format << std::endl;
+			return false;
+		}
+		if ((options.density < 0) || (options.density > 1))
+		{
+			std::cout << "The density must be in [0, 1]" << std::endl;
+			return false;
+		}
+		if (options.columns > std::numeric_limits<std::uint32_t>::max())
+		{
+			std::cout << "At most " << std::numeric_limits<std::uint32_t>::max() << " columns are supported" << std::endl;
+			return false;
+		}
+		if ((options.chunk == 0) && ((options.compression > 0) || options.shuffle))
+		{
+			std::cout << "Compression and shuffle need --chunk" << std::endl;
+			return false;
+		}
+		if ((options.padding > 0) && ((options.chunk == 0) || (options.format == "tome") || ((options.format == "h5ad") && (options.layout != "csr"))))
+		{
+			std::cout << "Padding needs --chunk and a 10x file or an h5ad file with csr layout" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	template<typename FunctionObject>
+	bool visit_element_type(const std::string& name, FunctionObject functionObject)
+	{
+		if (name == "float32") functionObject(std::type_identity<float>());
+		else if (name == "float64") functionObject(std::type_identity<double>());
+		else if (name == "int32") functionObject(std::type_identity<std::int32_t>());
+		else if (name == "uint32") functionObject(std::type_identity<std::uint32_t>());
+		else if (name == "int16") functionObject(std::type_identity<std::int16_t>());
+		else if (name == "uint16") functionObject(std::type_identity<std::uint16_t>());
+		else if (name == "int8") functionObject(std::type_identity<std::int8_t>());
+		else if (name == "uint8") functionObject(std::type_identity<std::uint8_t>());
+		else if (name == "int64") functionObject(std::type_identity<std::int64_t>());
+		else if (name == "uint64") functionObject(std::type_identity<std::uint64_t>());
+		else
+			return false;
+		return true;
+	}
+
+	// Each row draws from its own generator, so the output does not depend on the number of threads.
+	std::mt19937_64 row_generator(std::uint32_t seed, std::uint64_t row)
+	{
+		std::seed_seq sequence{ seed, static_cast<std::uint32_t>(row), static_cast<std::uint32_t>(row >> 32) };
+		return std::mt19937_64(sequence);
+	}
+
+	std::uint64_t draw_row_nnz(std::mt19937_64& generator, std::uint64_t columns, const Options& options)
+	{
+		if (options.distribution == "skewed")
+		{
+			// log-normal row scale with mean 1, a few rows get many times the mean number of nonzeros
+			std::lognormal_distribution<double> scale(-0.5, 1.0);
+			const double mean = options.density * columns * scale(generator);
+			std::poisson_distribution<std::uint64_t> nnz(std::max(mean, 1e-9));
+			return std::min<std::uint64_t>(nnz(generator), columns);
+		}
+		std::binomial_distribution<std::uint64_t> nnz(columns, options.density);
+		return nnz(generator);
+	}
+
+	SparseMatrix generate_sparse(std::uint64_t rows, std::uint64_t columns, std::uint32_t seed, const Options& options)
+	{
+		SparseMatrix matrix;
+		matrix.rows = rows;
+		matrix.columns = columns;
+		matrix.offsets.assign(rows + 1, 0);
+
+		const std::int64_t lrows = static_cast<std::int64_t>(rows);
+		#pragma omp parallel for schedule(dynamic, 256)
+		for (std::int64_t row = 0; row < lrows; ++row)
+		{
+			std::mt19937_64 generator = row_generator(seed, row);
+			matrix.offsets[row + 1] = draw_row_nnz(generator, columns, options);
+		}
+		for (std::uint64_t row = 0; row < rows; ++row)
+			matrix.offsets[row + 1] += matrix.offsets[row];
+
+		matrix.indices.resize(matrix.offsets.back());
+		matrix.values.resize(matrix.offsets.back());
+		const bool counts = (options.values != "real");
+
+		#pragma omp parallel
+		{
+			std::vector<char> taken(columns, 0);
+			#pragma omp for schedule(dynamic, 256)
+			for (std::int64_t row = 0; row < lrows; ++row)
+			{
+				std::mt19937_64 generator = row_generator(seed, row);
+				const std::uint64_t nnz = draw_row_nnz(generator, columns, options);
+				auto indices = matrix.indices.begin() + matrix.offsets[row];
+
+				// Floyd's sampling of nnz distinct columns
+				std::uint64_t n = 0;
+				for (std::uint64_t j = columns - nnz; j < columns; ++j)
+				{
+					std::uniform_int_distribution<std::uint64_t> column(0, j);
+					std::uint64_t c = column(generator);
+					if (taken[c])
+						c = j;
+					taken[c] = 1;
+					indices[n++] = static_cast<std::uint32_t>(c);
+				}
+				std::sort(indices, indices + nnz);
+				for (std::uint64_t i = 0; i < nnz; ++i)
+					taken[indices[i]] = 0;
+
+				auto values = matrix.values.begin() + matrix.offsets[row];
+				if (counts)
+				{
+					std::geometric_distribution<int> count(0.4);
+					for (std::uint64_t i = 0; i < nnz; ++i)
+						values[i] = static_cast<float>(1 + count(generator));
+				}
+				else
+				{
+					std::lognormal_distribution<float> value(0.0f, 1.0f);
+					for (std::uint64_t i = 0; i < nnz; ++i)
+						values[i] = value(generator);
+				}
+			}
+		}
+		return matrix;
+	}
+
+	// Prepends a row of padding nonzeros, they only shift the offsets of the other rows.
+	void prepend_padding_row(SparseMatrix& matrix, std::uint64_t padding)
+	{
+		matrix.offsets.insert(matrix.offsets.begin(), 0);
+		for (std::size_t row = 1; row < matrix.offsets.size(); ++row)
+			matrix.offsets[row] += padding;
+		++matrix.rows;
+		matrix.padding = padding;
+	}
+
+	// Row compressed -> column compressed, the result has rows and columns swapped.
+	SparseMatrix transpose(const SparseMatrix& matrix)
+	{
+		SparseMatrix result;
+		result.rows = matrix.columns;
+		result.columns = matrix.rows;
+		result.offsets.assign(result.rows + 1, 0);
+		for (const auto column : matrix.indices)
+			++result.offsets[column + 1];
+		for (std::uint64_t row = 0; row < result.rows; ++row)
+			result.offsets[row + 1] += result.offsets[row];
+
+		result.indices.resize(matrix.nnz());
+		result.values.resize(matrix.nnz());
+		std::vector<std::uint64_t> position(result.offsets.cbegin(), result.offsets.cend() - 1);
+		for (std::uint64_t row = 0; row < matrix.rows; ++row)
+		{
+			for (std::uint64_t i = matrix.offsets[row]; i < matrix.offsets[row + 1]; ++i)
+			{
+				const std::uint64_t p = position[matrix.indices[i]]++;
+				result.indices[p] = static_cast<std::uint32_t>(row);
+				result.values[p] = matrix.values[i];
+			}
+		}
+		return result;
+	}
+
+	void write_values(H5::Group& group, const std::string& name, const std::vector<float>& values, const Options& options, std::uint64_t offset = 0)
+	{
+		visit_element_type(options.dtype, [&](auto typeIdentity)
+			{
+				write_converted<typename decltype(typeIdentity)::type>(group, name, values, options, offset);
+			});
+	}
+
+	// bfloat16 bits as read by the 10X loader from data16, rounded to nearest even.
+	void write_bfloat16(H5::Group& group, const std::string& name, const std::vector<float>& values, const Options& options, std::uint64_t offset = 0)
+	{
+		std::vector<std::uint16_t> bits(values.size());
+		#pragma omp parallel for
+		for (std::int64_t i = 0; i < static_cast<std::int64_t>(values.size()); ++i)
+		{
+			std::uint32_t raw;
+			std::memcpy(&raw, &values[i], sizeof(raw));
+			raw += 0x7FFF + ((raw >> 16) & 1);
+			bits[i] = static_cast<std::uint16_t>(raw >> 16);
+		}
+		write_vector(group, name, bits, options, offset);
+	}
+
+	void write_index_vectors(H5::Group& group, const SparseMatrix& matrix, const Options& options, const std::string& indicesName = "indices", const std::string& indptrName = "indptr")
+	{
+		visit_element_type(options.indexType, [&](auto typeIdentity)
+			{
+				typedef typename decltype(typeIdentity)::type T;
+				write_converted<T>(group, indicesName, matrix.indices, options, matrix.padding);
+				if (matrix.nnz() <= static_cast<std::uint64_t>(std::numeric_limits<T>::max()))
+					write_converted<T>(group, indptrName, matrix.offsets, options);
+				else if constexpr (std::is_signed_v<T>)
+					write_converted<std::int64_t>(group, indptrName, matrix.offsets, options);
+				else
+					write_converted<std::uint64_t>(group, indptrName, matrix.offsets, options);
+			});
+	}
+
+	std::vector<std::string> numbered_names(const std::string& prefix, std::uint64_t count)
+	{
+		std::vector<std::string> names(count);
+		char buffer[32];
+		for (std::uint64_t i = 0; i < count; ++i)
+		{
+			std::snprintf(buffer, sizeof(buffer), "%s%08llu", prefix.c_str(), static_cast<unsigned long long>(i));
+			names[i] = buffer;
+		}
+		return names;
+	}
+
+	std::string color_name(std::uint32_t category, std::uint32_t categories)
+	{
+		// evenly spread hues, full saturation
+		const double hue = 6.0 * category / std::max<std::uint32_t>(categories, 1);
+		const double x = 1.0 - std::abs(std::fmod(hue, 2.0) - 1.0);
+		double rgb[3] = { 0, 0, 0 };
+		switch (static_cast<int>(hue))
+		{
+		case 0: rgb[0] = 1; rgb[1] = x; break;
+		case 1: rgb[0] = x; rgb[1] = 1; break;
+		case 2: rgb[1] = 1; rgb[2] = x; break;
+		case 3: rgb[1] = x; rgb[2] = 1; break;
+		case 4: rgb[0] = x; rgb[2] = 1; break;
+		default: rgb[0] = 1; rgb[2] = x; break;
+		}
+		char buffer[8];
+		std::snprintf(buffer, sizeof(buffer), "#%02x%02x%02x", static_cast<int>(rgb[0] * 255), static_cast<int>(rgb[1] * 255), static_cast<int>(rgb[2] * 255));
+		return buffer;
+	}
+
+	// Category per row of metadata column m, with a skewed (Zipf like) category size distribution.
+	std::vector<std::uint32_t> category_codes(std::uint64_t rows, std::uint32_t m, const Options& options)
+	{
+		std::vector<double> weights(std::max<std::uint32_t>(options.categories, 1));
+		for (std::size_t c = 0; c < weights.size(); ++c)
+			weights[c] = 1.0 / (c + 1);
+		std::discrete_distribution<std::uint32_t> category(weights.cbegin(), weights.cend());
+		std::mt19937_64 generator(row_generator(options.seed + 7919 * (m + 1), 0));
+		std::vector<std::uint32_t> codes(rows);
+		for (auto& code : codes)
+			code = category(generator);
+		return codes;
+	}
+
+	void write_10x(H5::H5File& file, const Options& options)
+	{
+		SparseMatrix matrix = generate_sparse(options.rows, options.columns, options.seed, options);
+		if (options.padding > 0)
+			prepend_padding_row(matrix, options.padding);
+		const std::uint64_t rows = matrix.rows;
+
+		H5::Group group = file.createGroup("matrix");
+		write_strings(group, "barcodes", numbered_names("CELL_", rows));
+		write_strings(group, "genes", numbered_names("GENE_", options.columns));
+		write_index_vectors(group, matrix, options);
+		if (options.bf16)
+			write_bfloat16(group, "data16", matrix.values, options, matrix.padding);
+		else
+			write_values(group, "data", matrix.values, options, matrix.padding);
+		const std::vector<std::uint64_t> shape = { options.columns, rows };
+		write_vector(group, "shape", shape, Options());
+
+		H5::Group meta = group.createGroup("meta");
+		for (std::uint32_t m = 0; m < options.metaColumns; ++m)
+		{
+			const std::vector<std::uint32_t> codes = category_codes(rows, m, options);
+			std::vector<std::string> labels(rows);
+			std::vector<std::uint8_t> colors(3 * rows);
+			for (std::uint64_t row = 0; row < rows; ++row)
+			{
+				labels[row] = "category " + std::to_string(codes[row]);
+				const std::string color = color_name(codes[row], options.categories);
+				for (int c = 0; c < 3; ++c)
+					colors[3 * row + c] = static_cast<std::uint8_t>(std::stoi(color.substr(1 + 2 * c, 2), nullptr, 16));
+			}
+			H5::Group label = meta.createGroup("label" + std::to_string(m));
+			write_strings(label, "l", labels);
+			write_vector(label, "c", colors, Options());
+		}
+	}
+
+	// exon/intron are column compressed per gene, t_exon/t_intron row compressed per sample.
+	void write_tome_matrix(H5::Group& data, const std::string& name, const std::string& transposedName, const SparseMatrix& matrix, const Options& options)
+	{
+		{
+			H5::Group group = data.createGroup(transposedName);
+			write_values(group, "x", matrix.values, options);
+			write_index_vectors(group, matrix, options, "i", "p");
+			const std::vector<std::int32_t> dims = { static_cast<std::int32_t>(matrix.columns), static_cast<std::int32_t>(matrix.rows) };
+			write_vector(group, "dims", dims, Options());
+		}
+		{
+			const SparseMatrix perGene = transpose(matrix);
+			H5::Group group = data.createGroup(name);
+			write_values(group, "x", perGene.values, options);
+			write_index_vectors(group, perGene, options, "i", "p");
+			const std::vector<std::int32_t> dims = { static_cast<std::int32_t>(matrix.rows), static_cast<std::int32_t>(matrix.columns) };
+			write_vector(group, "dims", dims, Options());
+		}
+	}
+
+	void write_tome(H5::H5File& file, const Options& options)
+	{
+		if ((options.rows > static_cast<std::uint64_t>(std::numeric_limits<std::int32_t>::max())) || (options.columns > static_cast<std::uint64_t>(std::numeric_limits<std::int32_t>::max())))
+			throw std::runtime_error("TOME dims are 32 bit");
+
+		H5::Group data = file.createGroup("data");
+		write_tome_matrix(data, "exon", "t_exon", generate_sparse(options.rows, options.columns, options.seed, options), options);
+		write_tome_matrix(data, "intron", "t_intron", generate_sparse(options.rows, options.columns, options.seed + 1, options), options);
+
+		H5::Group root = file.openGroup("/");
+		write_strings(root, "gene_names", numbered_names("GENE_", options.columns));
+		write_strings(root, "sample_names", numbered_names("SAMPLE_", options.rows));
+
+		H5::Group sampleMeta = file.createGroup("sample_meta");
+		H5::Group anno = sampleMeta.createGroup("anno");
+		for (std::uint32_t m = 0; m < options.metaColumns; ++m)
+		{
+			const std::vector<std::uint32_t> codes = category_codes(options.rows, m, options);
+			std::vector<std::string> labels(options.rows);
+			std::vector<std::string> colors(options.rows);
+			for (std::uint64_t row = 0; row < options.rows; ++row)
+			{
+				labels[row] = "category " + std::to_string(codes[row]);
+				colors[row] = color_name(codes[row], options.categories);
+			}
+			const std::string name = "label" + std::to_string(m);
+			write_strings(anno, name + "_label", labels);
+			write_strings(anno, name + "_color", colors);
+		}
+	}
+
+	void write_h5ad_sparse(H5::Group& parent, const std::string& name, const SparseMatrix& matrix, bool csc, const Options& options)
+	{
+		H5::Group group = parent.createGroup(name);
+		write_encoding(group, csc ? "csc_matrix" : "csr_matrix");
+		const hsize_t two = 2;
+		const std::int64_t shape[2] = { static_cast<std::int64_t>(matrix.rows), static_cast<std::int64_t>(matrix.columns) };
+		H5::Attribute attribute = group.createAttribute("shape", H5::PredType::NATIVE_INT64, H5::DataSpace(1, &two));
+		attribute.write(H5::PredType::NATIVE_INT64, shape);
+
+		if (csc)
+		{
+			const SparseMatrix perColumn = transpose(matrix);
+			write_values(group, "data", perColumn.values, options);
+			write_index_vectors(group, perColumn, options);
+		}
+		else
+		{
+			write_values(group, "data", matrix.values, options, matrix.padding);
+			write_index_vectors(group, matrix, options);
+		}
+	}
+
+	// Dense X, written in slabs of rows so the dense matrix never has to fit in memory at once.
+	void write_h5ad_dense(H5::H5File& file, const SparseMatrix& matrix, const Options& options)
+	{
+		visit_element_type(options.dtype, [&](auto typeIdentity)
+			{
+				typedef typename decltype(typeIdentity)::type T;
+				const std::vector<hsize_t> dimensions = { matrix.rows, matrix.columns };
+				H5::DataSpace fileSpace(2, dimensions.data());
+				H5::DataSet dataset = file.createDataSet("X", pred_type<T>(), fileSpace, create_properties(dimensions, options));
+				write_encoding(dataset, "array", "0.2.0");
+
+				const std::uint64_t rowsPerSlab = std::max<std::uint64_t>(1, (64ull << 20) / std::max<std::uint64_t>(1, matrix.columns * sizeof(T)));
+				std::vector<T> slab;
+				for (std::uint64_t firstRow = 0; firstRow < matrix.rows; firstRow += rowsPerSlab)
+				{
+					const std::uint64_t rows = std::min(rowsPerSlab, matrix.rows - firstRow);
+					slab.assign(rows * matrix.columns, T(0));
+					for (std::uint64_t row = 0; row < rows; ++row)
+					{
+						for (std::uint64_t i = matrix.offsets[firstRow + row]; i < matrix.offsets[firstRow + row + 1]; ++i)
+							slab[row * matrix.columns + matrix.indices[i]] = static_cast<T>(matrix.values[i]);
+					}
+					const hsize_t offset[2] = { firstRow, 0 };
+					const hsize_t count[2] = { rows, matrix.columns };
+					fileSpace.selectHyperslab(H5S_SELECT_SET, count, offset);
+					H5::DataSpace memorySpace(2, count);
+					dataset.write(slab.data(), pred_type<T>(), memorySpace, fileSpace);
+				}
+			});
+	}
+
+	void write_dataframe(H5::H5File& file, const std::string& name, const std::vector<std::string>& index, std::uint32_t nrOfCategoricalColumns, const Options& options)
+	{
+		H5::Group group = file.createGroup(name);
+		write_encoding(group, "dataframe", "0.2.0");
+		write_string_attribute(group, "_index", "_index");
+		write_strings(group, "_index", index);
+
+		std::vector<std::string> columnOrder;
+		for (std::uint32_t m = 0; m < nrOfCategoricalColumns; ++m)
+		{
+			const std::string columnName = "label" + std::to_string(m);
+			columnOrder.push_back(columnName);
+			H5::Group column = group.createGroup(columnName);
+			write_encoding(column, "categorical", "0.2.0");
+			const bool ordered = false;
+			H5::Attribute attribute = column.createAttribute("ordered", H5::PredType::NATIVE_HBOOL, H5::DataSpace(H5S_SCALAR));
+			attribute.write(H5::PredType::NATIVE_HBOOL, &ordered);
+
+			std::vector<std::string> categories(std::max<std::uint32_t>(options.categories, 1));
+			for (std::size_t c = 0; c < categories.size(); ++c)
+				categories[c] = "category " + std::to_string(c);
+			write_strings(column, "categories", categories);
+
+			const std::vector<std::uint32_t> codes = category_codes(index.size(), m, options);
+			if (categories.size() <= 127)
+				write_converted<std::int8_t>(column, "codes", codes, Options());
+			else if (categories.size() <= 32767)
+				write_converted<std::int16_t>(column, "codes", codes, Options());
+			else
+				write_converted<std::int32_t>(column, "codes", codes, Options());
+		}
+
+		// one numerical column
+		{
+			std::vector<float> values(index.size());
+			std::mt19937_64 generator(row_generator(options.seed + 104729, 0));
+			std::normal_distribution<float> value(0.0f, 1.0f);
+			for (auto& v : values)
+				v = value(generator);
+			write_vector(group, "score", values, Options());
+			H5::DataSet dataset = group.openDataSet("score");
+			write_encoding(dataset, "array", "0.2.0");
+			columnOrder.push_back("score");
+		}
+		write_string_array_attribute(group, "column-order", columnOrder);
+	}
+
+	void write_h5ad(H5::H5File& file, const Options& options)
+	{
+		H5::Group root = file.openGroup("/");
+		write_encoding(root, "anndata");
+
+		SparseMatrix matrix = generate_sparse(options.rows, options.columns, options.seed, options);
+		if (options.padding > 0)
+			prepend_padding_row(matrix, options.padding);
+		const std::uint64_t rows = matrix.rows;
+
+		if (options.layout == "dense")
+			write_h5ad_dense(file, matrix, options);
+		else if ((options.layout == "csr") || (options.layout == "csc"))
+			write_h5ad_sparse(root, "X", matrix, options.layout == "csc", options);
+		else
+			throw std::runtime_error("unknown layout " + options.layout);
+
+		write_dataframe(file, "obs", numbered_names("CELL_", rows), options.metaColumns, options);
+		write_dataframe(file, "var", numbered_names("GENE_", options.columns), 0, options);
+
+		H5::Group obsm = file.createGroup("obsm");
+		write_encoding(obsm, "dict");
+		if (options.obsmDimensions > 0)
+		{
+			std::vector<float> embedding(rows * options.obsmDimensions);
+			std::mt19937_64 generator(row_generator(options.seed + 15485863, 0));
+			std::normal_distribution<float> value(0.0f, 10.0f);
+			for (auto& v : embedding)
+				v = value(generator);
+			write_dataset(obsm, "X_synthetic", embedding.data(), { rows, options.obsmDimensions }, options);
+			H5::DataSet dataset = obsm.openDataSet("X_synthetic");
+			write_encoding(dataset, "array", "0.2.0");
+		}
+
+		H5::Group layers = file.createGroup("layers");
+		write_encoding(layers, "dict");
+		for (std::uint32_t l = 0; l < options.layers; ++l)
+			write_h5ad_sparse(layers, "layer" + std::to_string(l), generate_sparse(rows, options.columns, options.seed + 2 + l, options), false, options);
+
+		for (const char* name : { "obsp", "varm", "varp", "uns" })
+		{
+			H5::Group group = file.createGroup(name);
+			write_encoding(group, "dict");
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	local::Options options;
+	if (!local::parse_options(argc, argv, options))
+	{
+		local::print_usage();
+		return EXIT_FAILURE;
+	}
+	if (!local::visit_element_type(options.dtype, [](auto) {}) || !local::visit_element_type(options.indexType, [](auto) {}))
+	{
+		std::cout << "Unknown element type " << options.dtype << " or " << options.indexType << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	try
+	{
+		H5::Exception::dontPrint();
+		H5::H5File file(options.fileName, H5F_ACC_TRUNC);
+		if (options.format == "10x")
+			local::write_10x(file, options);
+		else if (options.format == "tome")
+			local::write_tome(file, options);
+		else
+			local::write_h5ad(file, options);
+	}
+	catch (const H5::Exception& e)
+	{
+		std::cout << "HDF5 error writing " << options.fileName << ": " << e.getDetailMsg() << std::endl;
+		return EXIT_FAILURE;
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << "Error writing " << options.fileName << ": " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::error_code error;
+	const auto fileSize = std::filesystem::file_size(options.fileName, error);
+	std::cout << "Wrote " << options.format << " " << options.rows << " x " << options.columns << " (density " << options.density << ", " << options.distribution << ") to "
+		<< options.fileName << ", " << (error ? 0 : fileSize) << " bytes in " << seconds << " s" << std::endl;
+	return EXIT_SUCCESS;
+}
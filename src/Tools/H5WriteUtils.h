@@ -0,0 +1,151 @@
+#pragma once
+
+#include <H5Cpp.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// HDF5 writing shared by the command line tools.
+
+namespace H5Tools
+{
+	struct StorageOptions
+	{
+		std::uint64_t chunk = 0;			// chunk size in elements, 0 writes contiguous datasets
+		int compression = 0;				// gzip level, needs chunk
+		bool shuffle = false;				// shuffle filter, needs chunk
+	};
+
+	template<typename T>
+	H5::PredType pred_type()
+	{
+		if constexpr (std::is_same_v<T, float>) return H5::PredType::NATIVE_FLOAT;
+		else if constexpr (std::is_same_v<T, double>) return H5::PredType::NATIVE_DOUBLE;
+		else if constexpr (std::is_same_v<T, std::int8_t>) return H5::PredType::NATIVE_INT8;
+		else if constexpr (std::is_same_v<T, std::uint8_t>) return H5::PredType::NATIVE_UINT8;
+		else if constexpr (std::is_same_v<T, std::int16_t>) return H5::PredType::NATIVE_INT16;
+		else if constexpr (std::is_same_v<T, std::uint16_t>) return H5::PredType::NATIVE_UINT16;
+		else if constexpr (std::is_same_v<T, std::int32_t>) return H5::PredType::NATIVE_INT32;
+		else if constexpr (std::is_same_v<T, std::uint32_t>) return H5::PredType::NATIVE_UINT32;
+		else if constexpr (std::is_same_v<T, std::int64_t>) return H5::PredType::NATIVE_INT64;
+		else
+		{
+			static_assert(std::is_same_v<T, std::uint64_t>, "unsupported element type");
+			return H5::PredType::NATIVE_UINT64;
+		}
+	}
+
+	inline H5::DSetCreatPropList create_properties(const std::vector<hsize_t>& dimensions, const StorageOptions& options)
+	{
+		H5::DSetCreatPropList properties;
+		hsize_t size = 1;
+		for (const auto dimension : dimensions)
+			size *= dimension;
+		if ((options.chunk == 0) || (size == 0))
+			return properties;
+
+		// the chunk spans whole rows of a 2D dataset
+		std::vector<hsize_t> chunk = dimensions;
+		const hsize_t rowSize = (dimensions.size() > 1) ? std::max<hsize_t>(1, size / dimensions[0]) : 1;
+		chunk[0] = std::clamp<hsize_t>(options.chunk / rowSize, 1, dimensions[0]);
+		properties.setChunk(static_cast<int>(chunk.size()), chunk.data());
+		if (options.shuffle)
+			properties.setShuffle();
+		if (options.compression > 0)
+			properties.setDeflate(options.compression);
+		return properties;
+	}
+
+	template<typename T>
+	void write_dataset(H5::Group& group, const std::string& name, const T* values, const std::vector<hsize_t>& dimensions, const StorageOptions& options)
+	{
+		H5::DataSpace space(static_cast<int>(dimensions.size()), dimensions.data());
+		H5::DataSet dataset = group.createDataSet(name, pred_type<T>(), space, create_properties(dimensions, options));
+		dataset.write(values, pred_type<T>());
+	}
+
+	// Writes values at offset of a dataset of offset + values.size() elements. The elements before offset are never
+	// written, so a chunked dataset does not store them and reads them as zero.
+	template<typename T>
+	void write_vector(H5::Group& group, const std::string& name, const std::vector<T>& values, const StorageOptions& options, std::uint64_t offset = 0)
+	{
+		if (offset == 0)
+		{
+			write_dataset(group, name, values.data(), { values.size() }, options);
+			return;
+		}
+		const std::vector<hsize_t> dimensions = { offset + values.size() };
+		H5::DataSpace fileSpace(1, dimensions.data());
+		H5::DataSet dataset = group.createDataSet(name, pred_type<T>(), fileSpace, create_properties(dimensions, options));
+		const hsize_t start = offset;
+		const hsize_t count = values.size();
+		if (count == 0)
+			return;
+		fileSpace.selectHyperslab(H5S_SELECT_SET, &count, &start);
+		H5::DataSpace memorySpace(1, &count);
+		dataset.write(values.data(), pred_type<T>(), memorySpace, fileSpace);
+	}
+
+	template<typename T, typename S>
+	void write_converted(H5::Group& group, const std::string& name, const std::vector<S>& values, const StorageOptions& options, std::uint64_t offset = 0)
+	{
+		if constexpr (std::is_same_v<T, S>)
+		{
+			write_vector(group, name, values, options, offset);
+		}
+		else
+		{
+			std::vector<T> converted(values.size());
+			#pragma omp parallel for
+			for (std::int64_t i = 0; i < static_cast<std::int64_t>(values.size()); ++i)
+				converted[i] = static_cast<T>(values[i]);
+			write_vector(group, name, converted, options, offset);
+		}
+	}
+
+	inline H5::StrType string_type()
+	{
+		H5::StrType type(H5::PredType::C_S1, H5T_VARIABLE);
+		type.setCset(H5T_CSET_UTF8);
+		return type;
+	}
+
+	inline void write_strings(H5::Group& group, const std::string& name, const std::vector<std::string>& strings)
+	{
+		std::vector<const char*> pointers(strings.size());
+		for (std::size_t i = 0; i < strings.size(); ++i)
+			pointers[i] = strings[i].c_str();
+		const hsize_t size = strings.size();
+		H5::DataSpace space(1, &size);
+		H5::DataSet dataset = group.createDataSet(name, string_type(), space);
+		if (size)
+			dataset.write(pointers.data(), string_type());
+	}
+
+	inline void write_string_attribute(H5::H5Object& object, const std::string& name, const std::string& value)
+	{
+		const char* pointer = value.c_str();
+		H5::Attribute attribute = object.createAttribute(name, string_type(), H5::DataSpace(H5S_SCALAR));
+		attribute.write(string_type(), &pointer);
+	}
+
+	inline void write_string_array_attribute(H5::H5Object& object, const std::string& name, const std::vector<std::string>& values)
+	{
+		std::vector<const char*> pointers(values.size());
+		for (std::size_t i = 0; i < values.size(); ++i)
+			pointers[i] = values[i].c_str();
+		const hsize_t size = values.size();
+		H5::Attribute attribute = object.createAttribute(name, string_type(), H5::DataSpace(1, &size));
+		if (size)
+			attribute.write(string_type(), pointers.data());
+	}
+
+	inline void write_encoding(H5::H5Object& object, const std::string& type, const std::string& version = "0.1.0")
+	{
+		write_string_attribute(object, "encoding-type", type);
+		write_string_attribute(object, "encoding-version", version);
+	}
+}